@@ -71,17 +71,15 @@ struct Configuration
 /*!
  * @brief Run the experiment and write values to output stream
  * @param config	Configuration to run
- * @param buildings Buildings to consider
+ * @param env		Environment containing the buildings
  * @param os		Stream to write the values to
  */
 void
 RunExperiment(const Configuration& config,
-		const BuildingList& buildings,
+		Ptr<gemv2::Environment> env,
 		std::ostream& os)
 {
   auto propagation = CreateObject<Gemv2PropagationLossModel> ();
-  Ptr<gemv2::Environment> env = Create<gemv2::Environment> ();
-  env->AddBuildings (buildings);
   propagation->SetEnviroment (env);
 
   os << "x y rxpower_mean rxpower_var rxpower_min rxpower_max" << std::endl;
@@ -120,11 +118,15 @@ main (int argc, char *argv[])
   bool verbose = false;
   std::string outputFile = "";
   std::string buildingFile = "";
+  std::string binaryFile = "";
+  std::string saveBinaryFile = "";
 
   CommandLine cmd;
   config.ConfigureCommandLine(cmd);
   cmd.AddValue ("output", "File to write the output data to", outputFile);
   cmd.AddValue ("buildings", "File to read buildings from (as WKT polygons", buildingFile);
+  cmd.AddValue ("binary", "File to load buildings from (as written by save-binary)", binaryFile);
+  cmd.AddValue ("save-binary", "File to save the buildings to for faster loading", saveBinaryFile);
   cmd.AddValue ("verbose", "Generate verbose logging output", verbose);
   cmd.Parse (argc,argv);
 
@@ -139,30 +141,53 @@ main (int argc, char *argv[])
 	  LogLevel (LOG_LEVEL_ALL | LOG_PREFIX_FUNC | LOG_PREFIX_TIME));
     }
 
-  BuildingList buildings;
+  Ptr<gemv2::Environment> env = Create<gemv2::Environment> ();
 
-  if (buildingFile.empty())
+  if (!binaryFile.empty())
     {
-      std::stringstream ss(defaultBuildings);
-      buildings = createBuildings(ss);
+      if (!env->LoadStaticLayer (binaryFile))
+	{
+	  std::cerr << "Failed to load binary file: " << binaryFile << std::endl;
+	  return 1;
+	}
     }
   else
     {
-      std::fstream inFile(buildingFile, std::fstream::in);
-      buildings = createBuildings(inFile);
+      BuildingList buildings;
+
+      if (buildingFile.empty())
+	{
+	  std::stringstream ss(defaultBuildings);
+	  buildings = createBuildings(ss);
+	}
+      else
+	{
+	  std::fstream inFile(buildingFile, std::fstream::in);
+	  buildings = createBuildings(inFile);
+	}
+
+      env->SetBulkLoading (true);
+      env->AddBuildings (buildings);
+      env->Finalize ();
+    }
+
+  if (!saveBinaryFile.empty() && !env->SaveStaticLayer (saveBinaryFile))
+    {
+      std::cerr << "Failed to save binary file: " << saveBinaryFile << std::endl;
+      return 1;
     }
 
 
   if (outputFile.empty())
     {
-      RunExperiment (config, buildings, std::cout);
+      RunExperiment (config, env, std::cout);
     }
   else
     {
       std::fstream fs(outputFile.c_str(), std::fstream::out | std::fstream::trunc);
       if (fs.is_open())
       	{
-      	  RunExperiment (config, buildings, fs);
+      	  RunExperiment (config, env, fs);
       	  fs.close();
       	}
       else
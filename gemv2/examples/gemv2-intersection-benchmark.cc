@@ -0,0 +1,300 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/core-module.h"
+#include "ns3/gemv2-module.h"
+
+#include <boost/geometry/io/wkt/read.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <fstream>
+#include <random>
+
+using namespace ns3;
+
+using BuildingList = gemv2::Environment::BuildingList;
+
+/*
+ * Compares the line intersection tests for buildings with boost geometry,
+ * the flat polygon kernel, the wall index and the convex part index. Use
+ * real building footprints from a file with one WKT polygon per line (e.g.
+ * exported from OpenStreetMap) for meaningful numbers. Without a file, a
+ * grid of concave footprints is generated.
+ *
+ * With a simplification tolerance, the buildings are also simplified and
+ * the vertex reduction, the speedup of the queries and the number of
+ * changed LOS classifications (i.e. lines with a different result of
+ * IntersectsAnyBuildings) are reported.
+ *
+ * With merging enabled, touching buildings are merged into blocks and the
+ * number of buildings hit per line and the speedup are reported.
+ */
+
+BuildingList
+ReadBuildings (std::istream& is)
+{
+  BuildingList buildings;
+
+  std::string line;
+  while (std::getline (is, line))
+    {
+      if (!line.empty ())
+	{
+	  gemv2::Polygon2d polygon;
+	  boost::geometry::read_wkt (line, polygon);
+	  buildings.push_back (Create<gemv2::Building> (polygon));
+	}
+    }
+
+  return buildings;
+}
+
+BuildingList
+GenerateBuildings (std::size_t number, double spacing, std::size_t vertices)
+{
+  BuildingList buildings;
+
+  auto perRow = static_cast<std::size_t> (std::ceil (std::sqrt (number)));
+  for (std::size_t i = 0; i < number; ++i)
+    {
+      double cx = (i % perRow) * spacing;
+      double cy = (i / perRow) * spacing;
+
+      // star shaped, thus concave outline
+      gemv2::Polygon2d polygon;
+      for (std::size_t v = 0; v < vertices; ++v)
+	{
+	  double angle = 2 * M_PI * v / vertices;
+	  double radius = spacing * (v % 2 == 0 ? 0.4 : 0.25);
+	  polygon.outer ().push_back (
+	      gemv2::Point2d (cx + radius * std::cos (angle),
+			      cy + radius * std::sin (angle)));
+	}
+      polygon.outer ().push_back (polygon.outer ().front ());
+      buildings.push_back (Create<gemv2::Building> (polygon));
+    }
+
+  return buildings;
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string buildingFile = "";
+  std::size_t numOfBuildings = 2500;
+  std::size_t numOfVertices = 64;
+  std::size_t numOfLines = 100000;
+  double maxLineLength = 500.0;
+  double tolerance = 0.0;
+  bool merge = false;
+
+  CommandLine cmd;
+  cmd.AddValue ("buildings", "File to read buildings from (as WKT polygons)", buildingFile);
+  cmd.AddValue ("generated", "Number of generated buildings without file", numOfBuildings);
+  cmd.AddValue ("vertices", "Vertices of the generated buildings", numOfVertices);
+  cmd.AddValue ("lines", "Number of lines to test", numOfLines);
+  cmd.AddValue ("max-length", "Maximum length of the lines in meters", maxLineLength);
+  cmd.AddValue ("simplify", "Tolerance for simplified buildings in meters (0 = off)", tolerance);
+  cmd.AddValue ("merge", "Merge touching buildings into blocks", merge);
+  cmd.Parse (argc, argv);
+
+  BuildingList buildings;
+  if (buildingFile.empty ())
+    {
+      buildings = GenerateBuildings (numOfBuildings, 50.0, numOfVertices);
+    }
+  else
+    {
+      std::ifstream inFile (buildingFile);
+      if (!inFile.is_open ())
+	{
+	  std::cerr << "Failed to open building file: " << buildingFile << std::endl;
+	  return 1;
+	}
+      buildings = ReadBuildings (inFile);
+    }
+
+  if (buildings.empty ())
+    {
+      std::cerr << "No buildings" << std::endl;
+      return 1;
+    }
+
+  auto env = Create<gemv2::Environment> ();
+  env->SetBulkLoading (true);
+  env->AddBuildings (buildings);
+  env->Finalize ();
+
+  gemv2::Box2d area;
+  boost::geometry::assign_inverse (area);
+  std::size_t edges = 0;
+  for (auto const& b : buildings)
+    {
+      boost::geometry::expand (area, b->GetBoundingBox ());
+      edges += b->GetFlatShape ().GetNumEdges ();
+    }
+
+  // random lines within the covered area
+  std::mt19937 rng (42);
+  std::uniform_real_distribution<double> x (area.min_corner ().x (), area.max_corner ().x ());
+  std::uniform_real_distribution<double> y (area.min_corner ().y (), area.max_corner ().y ());
+  std::uniform_real_distribution<double> length (0.0, maxLineLength);
+  std::uniform_real_distribution<double> angle (0.0, 2 * M_PI);
+
+  std::vector<gemv2::LineSegment2d> lines;
+  for (std::size_t i = 0; i < numOfLines; ++i)
+    {
+      gemv2::Point2d p (x (rng), y (rng));
+      double l = length (rng);
+      double a = angle (rng);
+      lines.push_back (gemv2::LineSegment2d (
+	  p, gemv2::Point2d (p.x () + l * std::cos (a), p.y () + l * std::sin (a))));
+    }
+
+  std::cout << buildings.size () << " buildings with " << edges << " edges, "
+	    << lines.size () << " lines" << std::endl;
+
+  std::vector<bool> results[4];
+  std::vector<std::size_t> hits[4];
+  double anyTimes[4];
+  double allTimes[4];
+  const char* names[] = {"boost", "fast", "walls", "convex"};
+  for (int mode = 0; mode < 4; ++mode)
+    {
+      env->SetFastLineIntersection (mode == 1);
+      env->SetWallIndex (mode == 2);
+      env->SetConvexDecomposition (mode == 3);
+      if (mode >= 2)
+	{
+	  // build the lazy index outside of the measurement
+	  env->IntersectsAnyBuildings (lines.front ());
+	}
+
+      auto start = std::chrono::steady_clock::now ();
+      for (auto const& line : lines)
+	{
+	  results[mode].push_back (env->IntersectsAnyBuildings (line));
+	}
+      double anyTime = std::chrono::duration<double> (
+	  std::chrono::steady_clock::now () - start).count ();
+      anyTimes[mode] = anyTime;
+
+      start = std::chrono::steady_clock::now ();
+      for (auto const& line : lines)
+	{
+	  hits[mode].push_back (env->IntersectBuildings (line).size ());
+	}
+      double allTime = std::chrono::duration<double> (
+	  std::chrono::steady_clock::now () - start).count ();
+      allTimes[mode] = allTime;
+
+      std::cout << names[mode] << ": IntersectsAnyBuildings "
+		<< 1e6 * anyTime / lines.size () << " us/line, "
+		<< "IntersectBuildings "
+		<< 1e6 * allTime / lines.size () << " us/line" << std::endl;
+    }
+
+  std::size_t mismatches = 0;
+  for (std::size_t i = 0; i < lines.size (); ++i)
+    {
+      for (int mode = 1; mode < 4; ++mode)
+	{
+	  if (results[0][i] != results[mode][i] || hits[0][i] != hits[mode][i])
+	    {
+	      ++mismatches;
+	    }
+	}
+    }
+  std::cout << "mismatches: " << mismatches << std::endl;
+
+  if (tolerance > 0)
+    {
+      // same topology preserving simplification as the importers
+      std::vector<gemv2::Polygon2d> shapes;
+      std::size_t verticesBefore = 0;
+      for (auto const& b : buildings)
+	{
+	  shapes.push_back (b->GetShape ());
+	  verticesBefore += gemv2::GetNumVertices (shapes.back ());
+	}
+      std::size_t kept = gemv2::SimplifyPolygons (shapes, tolerance);
+
+      BuildingList simplified;
+      std::size_t verticesAfter = 0;
+      for (auto const& shape : shapes)
+	{
+	  verticesAfter += gemv2::GetNumVertices (shape);
+	  simplified.push_back (Create<gemv2::Building> (shape));
+	}
+
+      auto simplifiedEnv = Create<gemv2::Environment> ();
+      simplifiedEnv->SetBulkLoading (true);
+      simplifiedEnv->AddBuildings (simplified);
+      simplifiedEnv->Finalize ();
+      simplifiedEnv->SetFastLineIntersection (true);
+
+      std::size_t changed = 0;
+      auto start = std::chrono::steady_clock::now ();
+      for (std::size_t i = 0; i < lines.size (); ++i)
+	{
+	  if (simplifiedEnv->IntersectsAnyBuildings (lines[i]) != results[1][i])
+	    {
+	      ++changed;
+	    }
+	}
+      double simplifiedTime = std::chrono::duration<double> (
+	  std::chrono::steady_clock::now () - start).count ();
+
+      std::cout << "simplified (" << tolerance << " m): vertices "
+		<< verticesBefore << " -> " << verticesAfter
+		<< " (" << kept << " buildings kept), IntersectsAnyBuildings "
+		<< 1e6 * simplifiedTime / lines.size () << " us/line, speedup "
+		<< anyTimes[1] / simplifiedTime << " (fast), changed LOS "
+		<< changed << " (" << 100.0 * changed / lines.size () << " %)"
+		<< std::endl;
+    }
+
+  if (merge)
+    {
+      auto start = std::chrono::steady_clock::now ();
+      auto blocks = gemv2::MergeBuildings (buildings);
+      double mergeTime = std::chrono::duration<double> (
+	  std::chrono::steady_clock::now () - start).count ();
+
+      auto mergedEnv = Create<gemv2::Environment> ();
+      mergedEnv->SetBulkLoading (true);
+      mergedEnv->AddBuildings (blocks);
+      mergedEnv->Finalize ();
+      mergedEnv->SetFastLineIntersection (true);
+
+      std::size_t hitsBefore = 0;
+      std::size_t hitsAfter = 0;
+      std::size_t changed = 0;
+      start = std::chrono::steady_clock::now ();
+      for (std::size_t i = 0; i < lines.size (); ++i)
+	{
+	  hitsBefore += hits[1][i];
+	  hitsAfter += mergedEnv->IntersectBuildings (lines[i]).size ();
+	}
+      double mergedTime = std::chrono::duration<double> (
+	  std::chrono::steady_clock::now () - start).count ();
+      for (std::size_t i = 0; i < lines.size (); ++i)
+	{
+	  if (mergedEnv->IntersectsAnyBuildings (lines[i]) != results[1][i])
+	    {
+	      ++changed;
+	    }
+	}
+
+      std::cout << "merged in " << mergeTime << " s: buildings "
+		<< buildings.size () << " -> " << blocks.size ()
+		<< ", hits/line " << static_cast<double> (hitsBefore) / lines.size ()
+		<< " -> " << static_cast<double> (hitsAfter) / lines.size ()
+		<< ", IntersectBuildings " << 1e6 * mergedTime / lines.size ()
+		<< " us/line, speedup " << allTimes[1] / mergedTime
+		<< " (fast), changed LOS " << changed << std::endl;
+    }
+
+  return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "gemv2-building-merging.h"
+#include "gemv2-polygon-simplification.h"
+
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include <boost/geometry/index/rtree.hpp>
+#include <boost/geometry/geometries/multi_polygon.hpp>
+#include <boost/function_output_iterator.hpp>
+
+#include <ns3/log.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("Gemv2BuildingMerging");
+
+namespace gemv2 {
+
+namespace {
+
+//! Tolerance to remove the collinear vertices left by shared walls [m]
+const double COLLINEAR_TOLERANCE = 1e-6;
+
+//! Find the representative of the group of @a i with path halving
+std::size_t
+FindGroup (std::vector<std::size_t>& parents, std::size_t i)
+{
+  while (parents[i] != i)
+    {
+      parents[i] = parents[parents[i]];
+      i = parents[i];
+    }
+  return i;
+}
+
+}  // namespace
+
+Environment::BuildingList
+MergeBuildings (const Environment::BuildingList& buildings)
+{
+  namespace bg = boost::geometry;
+  namespace bgi = boost::geometry::index;
+
+  using Entry = std::pair<Box2d, std::size_t>;
+  using MultiPolygon2d = bg::model::multi_polygon<Polygon2d>;
+
+  std::vector<Entry> entries;
+  entries.reserve (buildings.size ());
+  for (std::size_t i = 0; i < buildings.size (); ++i)
+    {
+      entries.emplace_back (buildings[i]->GetBoundingBox (), i);
+    }
+  bgi::rtree<Entry, bgi::quadratic<16>> tree (entries);
+
+  // group buildings that share at least one point
+  std::vector<std::size_t> parents (buildings.size ());
+  std::iota (parents.begin (), parents.end (), 0);
+  for (std::size_t i = 0; i < buildings.size (); ++i)
+    {
+      auto const& shape = buildings[i]->GetShape ();
+      tree.query (bgi::intersects (buildings[i]->GetBoundingBox ()),
+		  boost::make_function_output_iterator (
+		      [&] (const Entry& e) {
+			if (e.second > i &&
+			    bg::intersects (shape, buildings[e.second]->GetShape ()))
+			  {
+			    parents[FindGroup (parents, e.second)] = FindGroup (parents, i);
+			  }
+		      }));
+    }
+
+  std::vector<std::vector<std::size_t>> groups (buildings.size ());
+  for (std::size_t i = 0; i < buildings.size (); ++i)
+    {
+      groups[FindGroup (parents, i)].push_back (i);
+    }
+
+  Environment::BuildingList merged;
+  for (std::size_t i = 0; i < buildings.size (); ++i)
+    {
+      auto const& group = groups[FindGroup (parents, i)];
+      if (group.front () != i)
+	{
+	  // group has already been merged at its first building
+	  continue;
+	}
+      if (group.size () == 1)
+	{
+	  merged.push_back (buildings[i]);
+	  continue;
+	}
+
+      MultiPolygon2d block;
+      double area = 0;
+      double weightedPermittivity = 0;
+      for (auto member : group)
+	{
+	  auto const& building = buildings[member];
+	  MultiPolygon2d result;
+	  bg::union_ (block, building->GetShape (), result);
+	  block = std::move (result);
+	  area += building->GetArea ();
+	  weightedPermittivity += building->GetArea () * building->GetRelativePermittivity ();
+	}
+
+      NS_LOG_LOGIC ("Merged " << group.size () << " buildings into "
+		    << block.size () << " blocks");
+      for (auto& p : block)
+	{
+	  SimplifyPolygon (p, COLLINEAR_TOLERANCE);
+	  auto building = Create<Building> (p);
+	  if (area > 0)
+	    {
+	      building->SetRelativePermittivity (weightedPermittivity / area);
+	    }
+	  merged.push_back (building);
+	}
+    }
+
+  NS_LOG_INFO ("Merged " << buildings.size () << " buildings into "
+	       << merged.size () << " blocks");
+  return merged;
+}
+
+}  // namespace gemv2
+}  // namespace ns3
@@ -0,0 +1,48 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GEMV2_BUILDING_MERGING_H
+#define GEMV2_BUILDING_MERGING_H
+
+#include <ns3/gemv2-environment.h>
+
+namespace ns3 {
+namespace gemv2 {
+
+/*!
+ * @brief Merge touching or overlapping buildings into blocks.
+ *
+ * Buildings that share at least one point (e.g. row houses with a common
+ * wall) are grouped transitively and replaced by the union of their
+ * outlines. Collinear vertices where the walls met are removed. The
+ * relative permittivity of a block is the area weighted mean of its
+ * buildings. Buildings without neighbors are passed through unchanged.
+ *
+ * If the union of a group consists of several polygons (e.g. buildings
+ * that only touch at a corner), one building is created per polygon.
+ * The buildings must not be compact (see Building::Compact()).
+ *
+ * @param buildings	Buildings to merge
+ * @return Merged buildings, blocks follow the order of their first building
+ */
+Environment::BuildingList
+MergeBuildings (const Environment::BuildingList& buildings);
+
+}  // namespace gemv2
+}  // namespace ns3
+
+#endif /* GEMV2_BUILDING_MERGING_H */
@@ -1,11 +1,90 @@
-/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
-
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
 #include "gemv2-helper.h"
 
+#include <ns3/abort.h>
+#include <ns3/assert.h>
+#include <ns3/log.h>
+#include <ns3/mobility-model.h>
+
+#include <ns3/gemv2-vehicle-adapter.h>
+
 namespace ns3 {
 
-/* ... */
+NS_LOG_COMPONENT_DEFINE("Gemv2Helper");
+
+namespace {
+
+//! Dimensions of the default vehicles [m]
+constexpr double DEFAULT_VEHICLE_LENGTH = 4.5;
+constexpr double DEFAULT_VEHICLE_WIDTH = 1.8;
+constexpr double DEFAULT_VEHICLE_HEIGHT = 1.5;
 
+}  // namespace
+
+Gemv2Helper::Gemv2Helper ()
+  : m_environment (gemv2::Environment::GetGlobal ()),
+    m_shapeTemplate (gemv2::VehicleShapeTemplate::GetBox (
+	DEFAULT_VEHICLE_LENGTH, DEFAULT_VEHICLE_WIDTH, DEFAULT_VEHICLE_HEIGHT))
+{
+}
+
+void
+Gemv2Helper::SetEnvironment (Ptr<gemv2::Environment> environment)
+{
+  NS_ASSERT_MSG (environment, "environment must not be null");
+  m_environment = environment;
+}
+
+void
+Gemv2Helper::SetShapeTemplate (Ptr<const gemv2::VehicleShapeTemplate> shapeTemplate)
+{
+  NS_ASSERT_MSG (shapeTemplate, "shape template must not be null");
+  m_shapeTemplate = shapeTemplate;
+}
+
+Ptr<gemv2::Vehicle>
+Gemv2Helper::Install (Ptr<Node> node) const
+{
+  NS_LOG_FUNCTION (this << node);
+
+  auto mobility = node->GetObject<MobilityModel> ();
+  NS_ABORT_MSG_UNLESS (mobility, "node " << node->GetId () << " has no mobility model");
+
+  auto vehicle = Create<gemv2::Vehicle> (m_shapeTemplate);
+  auto adapter = CreateObject<Gemv2VehicleAdapter> ();
+  adapter->SetVehicle (vehicle);
+  mobility->AggregateObject (adapter);
+
+  // tracking moves the vehicle to its initial position before it is indexed
+  adapter->Track (mobility, m_environment);
+  m_environment->AddVehicle (vehicle);
+
+  return vehicle;
+}
 
+void
+Gemv2Helper::Install (NodeContainer nodes) const
+{
+  for (auto it = nodes.Begin (); it != nodes.End (); ++it)
+    {
+      Install (*it);
+    }
 }
 
+}  // namespace ns3
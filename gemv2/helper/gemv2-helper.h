@@ -1,12 +1,94 @@
-/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
 #ifndef GEMV2_HELPER_H
 #define GEMV2_HELPER_H
 
+#include <ns3/node.h>
+#include <ns3/node-container.h>
+#include <ns3/ptr.h>
+
+#include <ns3/gemv2-environment.h>
+#include <ns3/gemv2-vehicle.h>
+#include <ns3/gemv2-vehicle-shape-template.h>
+
 namespace ns3 {
 
-/* ... */
+/*!
+ * @brief Creates GEMV^2 vehicles for nodes and keeps them in sync.
+ *
+ * For each node, a vehicle is created from the shape template, linked to
+ * the mobility model of the node with a Gemv2VehicleAdapter and added to
+ * the environment. The course changes of the mobility model are queued
+ * in the environment and applied in bulk before its next vehicle query,
+ * thus moving many nodes between two transmissions stays cheap.
+ *
+ * Vehicles may be indexed with the pose of the last rebuild of the
+ * vehicle tree (see gemv2::Environment::SetVehicleTreeRebuildInterval()).
+ */
+class Gemv2Helper
+{
+public:
+  /*!
+   * @brief Create helper for the global environment and 4.5 x 1.8 x 1.5 m boxes.
+   */
+  Gemv2Helper ();
 
-}
+  /*!
+   * @brief Set the environment the vehicles are added to.
+   * @param environment	Environment to use, must not be null
+   */
+  void
+  SetEnvironment (Ptr<gemv2::Environment> environment);
 
-#endif /* GEMV2_HELPER_H */
+  /*!
+   * @brief Set the shape of the vehicles created by Install().
+   * @param shapeTemplate	Template of the vehicles, must not be null
+   */
+  void
+  SetShapeTemplate (Ptr<const gemv2::VehicleShapeTemplate> shapeTemplate);
+
+  /*!
+   * @brief Create a vehicle for a node.
+   *
+   * The node must have a mobility model.
+   *
+   * @param node	Node to create the vehicle for
+   * @return Vehicle following the mobility model of @a node
+   */
+  Ptr<gemv2::Vehicle>
+  Install (Ptr<Node> node) const;
+
+  /*!
+   * @brief Create a vehicle for each node.
+   * @param nodes	Nodes to create the vehicles for
+   */
+  void
+  Install (NodeContainer nodes) const;
 
+private:
+
+  //! Environment the vehicles are added to
+  Ptr<gemv2::Environment> m_environment;
+
+  //! Shape of the created vehicles
+  Ptr<const gemv2::VehicleShapeTemplate> m_shapeTemplate;
+};
+
+}  // namespace ns3
+
+#endif /* GEMV2_HELPER_H */
@@ -0,0 +1,228 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GEMV2_OBSTACLE_IMPORTER_H
+#define GEMV2_OBSTACLE_IMPORTER_H
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <ns3/gemv2-geometry.h>
+#include <ns3/gemv2-environment.h>
+
+namespace ns3 {
+namespace gemv2 {
+
+/*!
+ * @brief Text formats for building and foliage outlines
+ */
+enum class ObstacleFileFormat
+{
+  WKT,		//!< One WKT POLYGON or MULTIPOLYGON per line
+  GEOJSON	//!< GeoJSON features or geometries, see ParseObstacleLine()
+};
+
+/*!
+ * @brief Parse a single line of an obstacle file.
+ *
+ * For GeoJSON, Polygon and MultiPolygon geometries are supported, either
+ * directly or as geometry of a feature, in any order of their keys. A
+ * line may hold any number of geometries, e.g. a whole FeatureCollection
+ * or one feature of a collection spread over several lines. Lines without
+ * geometry (e.g. the start and end of such a collection) yield no
+ * polygons. Point and line geometries are ignored, geometries of unknown
+ * type or with invalid coordinates make the line invalid. The polygons of
+ * the other geometries on the line are still added.
+ *
+ * @param line		Line to parse
+ * @param format	Format of the line
+ * @param polygons	Parsed polygons are added here
+ * @return False if the line or one of its geometries could not be parsed
+ */
+bool
+ParseObstacleLine (const std::string& line, ObstacleFileFormat format,
+		   std::vector<Polygon2d>& polygons);
+
+/*!
+ * @brief Parallel importer for building and foliage outlines.
+ *
+ * The input is read in chunks of complete lines. Each chunk is parsed on
+ * a worker thread, which also creates the objects (i.e. corrects the
+ * polygons and calculates bounding box, area and flat shape). The objects
+ * are added to the environment in the order of the input with a single
+ * bulk index build.
+ *
+ * If simplification is enabled, the workers only parse the outlines. All
+ * outlines are simplified together with SimplifyPolygons(), so walls
+ * shared by neighbors stay the same, and the objects are created in
+ * parallel afterwards.
+ */
+class ObstacleImporter
+{
+public:
+  //! Statistics about an import
+  struct Statistics
+  {
+    //! Number of imported objects
+    std::size_t objects;
+    //! Number of lines that could not be parsed completely
+    std::size_t invalidLines;
+    //! Number of bytes read
+    std::size_t bytes;
+    //! Wall clock time for reading, parsing, creating and merging the objects [s]
+    double parseTime;
+    //! Wall clock time for building the index [s]
+    double indexTime;
+    //! Imported objects per second of total wall clock time
+    double objectsPerSecond;
+    //! Number of vertices before simplification
+    std::size_t verticesBefore;
+    //! Number of vertices of the imported objects
+    std::size_t verticesAfter;
+  };
+
+  /*!
+   * @brief Create importer using all available cores.
+   */
+  ObstacleImporter ();
+
+  /*!
+   * @brief Set the number of worker threads.
+   * @param threads	Number of threads, 0 to use all available cores
+   */
+  void
+  SetNumThreads (unsigned threads);
+
+  /*!
+   * @brief Set the size of the chunks handed to the worker threads.
+   * @param bytes	Approximate number of bytes per chunk
+   */
+  void
+  SetChunkSize (std::size_t bytes);
+
+  /*!
+   * @brief Set the tolerance for simplifying the imported outlines.
+   *
+   * The outlines are simplified with SimplifyPolygons(), which keeps the
+   * vertices shared by several outlines. All outlines of an import are
+   * kept in memory until they are simplified.
+   *
+   * @param tolerance	Tolerance for SimplifyPolygons() [m], 0 to disable
+   */
+  void
+  SetSimplificationTolerance (double tolerance);
+
+  /*!
+   * @brief Enable merging of touching buildings into blocks.
+   * @param enable	True to merge the buildings with MergeBuildings()
+   */
+  void
+  SetMergeBuildings (bool enable);
+
+  /*!
+   * @brief Import buildings from a stream.
+   *
+   * The buildings are bulk loaded into @a env. If bulk loading was
+   * disabled before, the buildings are finalized together with other
+   * buffered objects, otherwise they stay buffered until the next call of
+   * Environment::Finalize(). If merging is enabled, @a objects of the
+   * statistics is the number of blocks.
+   *
+   * @param is		Stream to read from
+   * @param format	Format of the input
+   * @param env		Environment to add the buildings to
+   * @return Statistics about the import
+   */
+  Statistics
+  ImportBuildings (std::istream& is, ObstacleFileFormat format, Environment& env) const;
+
+  /*!
+   * @brief Import foliage objects from a stream.
+   * @param is		Stream to read from
+   * @param format	Format of the input
+   * @param env		Environment to add the foliage to
+   * @return Statistics about the import
+   * @see ImportBuildings()
+   */
+  Statistics
+  ImportFoliage (std::istream& is, ObstacleFileFormat format, Environment& env) const;
+
+  /*!
+   * @brief Import buildings from a file.
+   *
+   * The format is derived from the extension: .json, .geojson and
+   * .geojsonl files are read as GeoJSON, everything else as WKT.
+   *
+   * @param fileName	File to read from
+   * @param env		Environment to add the buildings to
+   * @return Statistics about the import, no objects if the file
+   *	     could not be opened
+   */
+  Statistics
+  ImportBuildings (const std::string& fileName, Environment& env) const;
+
+  /*!
+   * @brief Import foliage objects from a file.
+   * @param fileName	File to read from
+   * @param env		Environment to add the foliage to
+   * @return Statistics about the import
+   * @see ImportBuildings(const std::string&, Environment&)
+   */
+  Statistics
+  ImportFoliage (const std::string& fileName, Environment& env) const;
+
+  /*!
+   * @brief Guess the format of a file from its extension.
+   * @param fileName	Name of the file
+   * @return Format of the file
+   */
+  static ObstacleFileFormat
+  GetFormatFromFileName (const std::string& fileName);
+
+private:
+
+  /*!
+   * @brief Read and parse objects in parallel.
+   * @param is		Stream to read from
+   * @param format	Format of the input
+   * @param objects	Created objects in input order
+   * @param statistics	Parse statistics are updated here
+   */
+  template<typename T>
+  void
+  ReadObjects (std::istream& is, ObstacleFileFormat format,
+	       std::vector<Ptr<T>>& objects, Statistics& statistics) const;
+
+  //! Number of worker threads
+  unsigned m_numThreads;
+
+  //! Approximate size of a chunk [bytes]
+  std::size_t m_chunkSize;
+
+  //! Tolerance for the simplification of outlines [m]
+  double m_simplificationTolerance;
+
+  //! Merge touching buildings into blocks
+  bool m_mergeBuildings;
+};
+
+}  // namespace gemv2
+}  // namespace ns3
+
+#endif /* GEMV2_OBSTACLE_IMPORTER_H */
@@ -0,0 +1,546 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "gemv2-osm-importer.h"
+#include "gemv2-building-merging.h"
+#include "gemv2-polygon-simplification.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <boost/geometry/geometries/linestring.hpp>
+#include <boost/geometry/geometries/multi_polygon.hpp>
+
+#include <ns3/log.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("Gemv2OsmImporter");
+
+namespace gemv2 {
+
+namespace {
+
+//! Mean earth radius [m]
+const double EARTH_RADIUS = 6371000.0;
+
+//! Latitude and longitude of a node [deg]
+using LatLon = std::pair<double, double>;
+
+/*!
+ * @brief Minimal streaming reader for the elements of an XML file.
+ *
+ * Text content, comments and processing instructions are skipped, only
+ * element names and attributes are reported. This is all that is needed
+ * for OSM files.
+ */
+class XmlElementReader
+{
+public:
+  explicit XmlElementReader (std::istream& is)
+    : m_is (is),
+      m_isEnd (false),
+      m_isEmpty (false)
+  {
+  }
+
+  /*!
+   * @brief Read the next start or end tag.
+   * @return False at the end of the stream
+   */
+  bool
+  Next ()
+  {
+    while (std::getline (m_is, m_text, '>'))
+      {
+	auto pos = m_text.find ('<');
+	if (pos == std::string::npos || pos + 1 == m_text.size ())
+	  {
+	    continue;
+	  }
+	++pos;
+	if (m_text[pos] == '!' || m_text[pos] == '?')
+	  {
+	    continue;
+	  }
+
+	m_isEnd = m_text[pos] == '/';
+	if (m_isEnd)
+	  {
+	    ++pos;
+	  }
+	m_isEmpty = m_text.back () == '/';
+
+	auto nameEnd = m_text.find_first_of (" \t\r\n/", pos);
+	m_name.assign (m_text, pos, nameEnd - pos);
+	ParseAttributes (nameEnd);
+	return true;
+      }
+    return false;
+  }
+
+  //! Name of the current element
+  const std::string&
+  GetName () const
+  {
+    return m_name;
+  }
+
+  //! True if the current tag is an end tag
+  bool
+  IsEnd () const
+  {
+    return m_isEnd;
+  }
+
+  //! True if the current tag is an empty element tag, i.e. <tag/>
+  bool
+  IsEmpty () const
+  {
+    return m_isEmpty;
+  }
+
+  //! Value of an attribute of the current element, null if not present
+  const std::string*
+  GetAttribute (const char* name) const
+  {
+    for (auto const& a : m_attributes)
+      {
+	if (a.first == name)
+	  {
+	    return &a.second;
+	  }
+      }
+    return nullptr;
+  }
+
+private:
+  void
+  ParseAttributes (std::size_t pos)
+  {
+    m_attributes.clear ();
+    while (pos < m_text.size ())
+      {
+	auto eq = m_text.find ('=', pos);
+	if (eq == std::string::npos)
+	  {
+	    return;
+	  }
+	auto quote = m_text.find_first_of ("\"'", eq);
+	if (quote == std::string::npos)
+	  {
+	    return;
+	  }
+	auto end = m_text.find (m_text[quote], quote + 1);
+	if (end == std::string::npos)
+	  {
+	    return;
+	  }
+
+	auto keyBegin = m_text.find_first_not_of (" \t\r\n", pos);
+	auto keyEnd = m_text.find_last_not_of (" \t\r\n", eq - 1) + 1;
+	m_attributes.emplace_back (m_text.substr (keyBegin, keyEnd - keyBegin),
+				   Decode (quote + 1, end));
+	pos = end + 1;
+      }
+  }
+
+  //! Replace the predefined entities in an attribute value
+  std::string
+  Decode (std::size_t begin, std::size_t end) const
+  {
+    static const std::pair<const char*, char> entities[] = {
+      {"&quot;", '"'}, {"&apos;", '\''}, {"&lt;", '<'}, {"&gt;", '>'}, {"&amp;", '&'}
+    };
+
+    std::string value;
+    for (auto i = begin; i < end; ++i)
+      {
+	char c = m_text[i];
+	if (c == '&')
+	  {
+	    for (auto const& e : entities)
+	      {
+		auto length = std::char_traits<char>::length (e.first);
+		if (m_text.compare (i, length, e.first) == 0)
+		  {
+		    c = e.second;
+		    i += length - 1;
+		    break;
+		  }
+	      }
+	  }
+	value.push_back (c);
+      }
+    return value;
+  }
+
+  std::istream& m_is;
+  std::string m_text;
+  std::string m_name;
+  std::vector<std::pair<std::string, std::string>> m_attributes;
+  bool m_isEnd;
+  bool m_isEmpty;
+};
+
+//! Kind of object described by a way, ordered by priority
+enum WayKind
+{
+  WAY_NONE,
+  WAY_TREE_ROW,
+  WAY_FOLIAGE,
+  WAY_BUILDING
+};
+
+//! Update the kind of a way with one of its tags
+WayKind
+ClassifyTag (const std::string& key, const std::string& value, WayKind kind)
+{
+  WayKind tagKind = WAY_NONE;
+  if (key == "building" && value != "no")
+    {
+      tagKind = WAY_BUILDING;
+    }
+  else if ((key == "natural" && value == "wood") ||
+	   (key == "landuse" && value == "forest"))
+    {
+      tagKind = WAY_FOLIAGE;
+    }
+  else if (key == "natural" && value == "tree_row")
+    {
+      tagKind = WAY_TREE_ROW;
+    }
+  return std::max (kind, tagKind);
+}
+
+//! Parse an OSM id, 0 if the attribute is missing
+std::int64_t
+GetId (const XmlElementReader& reader, const char* name)
+{
+  auto value = reader.GetAttribute (name);
+  return value ? std::strtoll (value->c_str (), nullptr, 10) : 0;
+}
+
+/*!
+ * @brief Way currently read from the file.
+ */
+struct WayState
+{
+  bool active = false;
+  WayKind kind = WAY_NONE;
+  std::vector<std::int64_t> nodes;
+
+  //! Handle an element, true if a way has been completed
+  bool
+  Update (const XmlElementReader& reader)
+  {
+    auto const& name = reader.GetName ();
+    if (name == "way")
+      {
+	if (reader.IsEnd ())
+	  {
+	    active = false;
+	    return kind != WAY_NONE;
+	  }
+	active = !reader.IsEmpty ();
+	kind = WAY_NONE;
+	nodes.clear ();
+      }
+    else if (active && name == "nd")
+      {
+	nodes.push_back (GetId (reader, "ref"));
+      }
+    else if (active && name == "tag")
+      {
+	auto key = reader.GetAttribute ("k");
+	auto value = reader.GetAttribute ("v");
+	if (key && value)
+	  {
+	    kind = ClassifyTag (*key, *value, kind);
+	  }
+      }
+    return false;
+  }
+};
+
+}  // namespace
+
+OsmImporter::OsmImporter ()
+  : m_originLatitude (0),
+    m_originLongitude (0),
+    m_hasOrigin (false),
+    m_treeRowWidth (5),
+    m_simplificationTolerance (0),
+    m_mergeBuildings (false)
+{
+}
+
+void
+OsmImporter::SetOrigin (double latitude, double longitude)
+{
+  m_originLatitude = latitude;
+  m_originLongitude = longitude;
+  m_hasOrigin = true;
+}
+
+void
+OsmImporter::SetTreeRowWidth (double width)
+{
+  m_treeRowWidth = width;
+}
+
+void
+OsmImporter::SetSimplificationTolerance (double tolerance)
+{
+  m_simplificationTolerance = tolerance;
+}
+
+void
+OsmImporter::SetMergeBuildings (bool enable)
+{
+  m_mergeBuildings = enable;
+}
+
+OsmImporter::Statistics
+OsmImporter::Import (std::istream& is, Environment& env) const
+{
+  NS_LOG_FUNCTION (this);
+
+  Statistics statistics {0, 0, 0, 0, 0, 0, 0};
+  auto start = std::chrono::steady_clock::now ();
+
+  // first pass: collect the nodes of matching ways
+  std::unordered_set<std::int64_t> usedNodes;
+  {
+    XmlElementReader reader (is);
+    WayState way;
+    while (reader.Next ())
+      {
+	if (way.Update (reader) &&
+	    (way.kind != WAY_TREE_ROW || m_treeRowWidth > 0))
+	  {
+	    usedNodes.insert (way.nodes.begin (), way.nodes.end ());
+	  }
+      }
+  }
+  NS_LOG_LOGIC ("Found " << usedNodes.size () << " nodes of matching ways");
+
+  is.clear ();
+  is.seekg (0);
+  if (!is)
+    {
+      NS_LOG_ERROR ("OSM input is not seekable");
+      return statistics;
+    }
+
+  // second pass: keep the used node positions, create objects from the ways
+  std::unordered_map<std::int64_t, LatLon> positions;
+  positions.reserve (usedNodes.size ());
+
+  double latitude0 = m_originLatitude;
+  double longitude0 = m_originLongitude;
+  bool hasOrigin = m_hasOrigin;
+  double metersPerDegree = EARTH_RADIUS * M_PI / 180;
+  double metersPerDegreeLongitude = 0;
+
+  bool bulkLoading = env.IsBulkLoading ();
+  env.SetBulkLoading (true);
+  // buildings are only kept if they are merged at the end
+  Environment::BuildingList buildings;
+  bool merge = m_mergeBuildings;
+  auto addShape = [&env, &buildings, &statistics, merge] (const Polygon2d& shape,
+							  bool building)
+  {
+    statistics.verticesAfter += GetNumVertices (shape);
+    if (building && merge)
+      {
+	buildings.push_back (Create<Building> (shape));
+      }
+    else if (building)
+      {
+	env.AddBuilding (Create<Building> (shape));
+	++statistics.buildings;
+      }
+    else
+      {
+	env.AddFoliage (Create<Foliage> (shape));
+	++statistics.foliage;
+      }
+  };
+
+  // with simplification, closed ways are kept until all are read to
+  // simplify them together
+  bool simplify = m_simplificationTolerance > 0;
+  std::vector<Polygon2d> shapes;
+  std::vector<bool> isBuilding;
+
+  XmlElementReader reader (is);
+  WayState way;
+  while (reader.Next ())
+    {
+      if (reader.GetName () == "node" && !reader.IsEnd ())
+	{
+	  auto id = GetId (reader, "id");
+	  auto lat = reader.GetAttribute ("lat");
+	  auto lon = reader.GetAttribute ("lon");
+	  if (lat && lon && usedNodes.count (id))
+	    {
+	      positions[id] = LatLon (std::atof (lat->c_str ()), std::atof (lon->c_str ()));
+	    }
+	  continue;
+	}
+
+      if (!way.Update (reader) ||
+	  (way.kind == WAY_TREE_ROW && m_treeRowWidth <= 0))
+	{
+	  continue;
+	}
+
+      if (!hasOrigin)
+	{
+	  // nodes precede the ways, so all positions are known here
+	  latitude0 = std::numeric_limits<double>::max ();
+	  longitude0 = std::numeric_limits<double>::max ();
+	  for (auto const& p : positions)
+	    {
+	      latitude0 = std::min (latitude0, p.second.first);
+	      longitude0 = std::min (longitude0, p.second.second);
+	    }
+	  hasOrigin = true;
+	  NS_LOG_INFO ("Origin of local coordinates: " << latitude0 << ", " << longitude0);
+	}
+      if (metersPerDegreeLongitude == 0)
+	{
+	  metersPerDegreeLongitude = metersPerDegree * std::cos (latitude0 * M_PI / 180);
+	}
+
+      boost::geometry::model::linestring<Point2d> line;
+      bool complete = true;
+      for (auto id : way.nodes)
+	{
+	  auto it = positions.find (id);
+	  if (it == positions.end ())
+	    {
+	      complete = false;
+	      break;
+	    }
+	  line.push_back (Point2d ((it->second.second - longitude0) * metersPerDegreeLongitude,
+				   (it->second.first - latitude0) * metersPerDegree));
+	}
+
+      bool closed = way.nodes.size () >= 4 && way.nodes.front () == way.nodes.back ();
+      if (!complete || (way.kind == WAY_TREE_ROW ? line.size () < 2 : !closed))
+	{
+	  NS_LOG_LOGIC ("Skipping incomplete or open way");
+	  ++statistics.skippedWays;
+	  continue;
+	}
+
+      if (way.kind == WAY_TREE_ROW)
+	{
+	  namespace bs = boost::geometry::strategy::buffer;
+	  boost::geometry::model::multi_polygon<Polygon2d> area;
+	  boost::geometry::buffer (line, area,
+				   bs::distance_symmetric<double> (m_treeRowWidth / 2),
+				   bs::side_straight (), bs::join_miter (),
+				   bs::end_flat (), bs::point_square ());
+	  for (auto const& p : area)
+	    {
+	      statistics.verticesBefore += GetNumVertices (p);
+	      statistics.verticesAfter += GetNumVertices (p);
+	      env.AddFoliage (Create<Foliage> (p));
+	      ++statistics.foliage;
+	    }
+	  continue;
+	}
+
+      Polygon2d shape;
+      shape.outer ().assign (line.begin (), line.end ());
+      statistics.verticesBefore += GetNumVertices (shape);
+      if (simplify)
+	{
+	  shapes.push_back (std::move (shape));
+	  isBuilding.push_back (way.kind == WAY_BUILDING);
+	}
+      else
+	{
+	  addShape (shape, way.kind == WAY_BUILDING);
+	}
+    }
+
+  // simplify all outlines at once, so walls shared by neighbors stay the same
+  if (simplify)
+    {
+      SimplifyPolygons (shapes, m_simplificationTolerance);
+      for (std::size_t i = 0; i < shapes.size (); ++i)
+	{
+	  addShape (shapes[i], isBuilding[i]);
+	}
+      shapes.clear ();
+    }
+
+  if (merge)
+    {
+      buildings = MergeBuildings (buildings);
+      env.AddBuildings (buildings);
+      statistics.buildings = buildings.size ();
+    }
+  env.SetBulkLoading (bulkLoading);
+
+  statistics.storedNodes = positions.size ();
+  statistics.time = std::chrono::duration<double> (
+      std::chrono::steady_clock::now () - start).count ();
+
+  NS_LOG_INFO ("Imported " << statistics.buildings << " buildings and "
+	       << statistics.foliage << " foliage objects in "
+	       << statistics.time << " s (" << statistics.skippedWays
+	       << " ways skipped)");
+
+  return statistics;
+}
+
+OsmImporter::Statistics
+OsmImporter::Import (const std::string& fileName, Environment& env) const
+{
+  auto pbf = std::string (".pbf");
+  if (fileName.size () >= pbf.size () &&
+      fileName.compare (fileName.size () - pbf.size (), pbf.size (), pbf) == 0)
+    {
+      NS_LOG_ERROR ("PBF files are not supported, convert " << fileName << " to OSM XML");
+      return Statistics {0, 0, 0, 0, 0, 0, 0};
+    }
+
+  std::ifstream is (fileName, std::ios::binary);
+  if (!is.is_open ())
+    {
+      NS_LOG_ERROR ("Failed to open " << fileName);
+      return Statistics {0, 0, 0, 0, 0, 0, 0};
+    }
+  return Import (is, env);
+}
+
+}  // namespace gemv2
+}  // namespace ns3
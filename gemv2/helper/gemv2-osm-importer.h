@@ -0,0 +1,161 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GEMV2_OSM_IMPORTER_H
+#define GEMV2_OSM_IMPORTER_H
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+#include <ns3/gemv2-geometry.h>
+#include <ns3/gemv2-environment.h>
+
+namespace ns3 {
+namespace gemv2 {
+
+/*!
+ * @brief Importer for buildings and foliage from OpenStreetMap XML files.
+ *
+ * Closed ways tagged with building=* (except building=no) are imported
+ * as buildings. Closed ways tagged with natural=wood or landuse=forest
+ * are imported as foliage, as well as ways tagged with natural=tree_row,
+ * which are widened to a polygon of configurable width.
+ *
+ * The file is read in two streaming passes. The first pass collects the
+ * ids of the nodes used by matching ways, the second one keeps only the
+ * positions of these nodes and creates the objects while reading the
+ * ways (after the pass if simplification is enabled, see
+ * SetSimplificationTolerance()). Other nodes, ways and all relations are
+ * never held in memory.
+ *
+ * Coordinates are projected to a local plane (equirectangular projection
+ * around the origin), which is accurate enough for city sized areas.
+ */
+class OsmImporter
+{
+public:
+  //! Statistics about an import
+  struct Statistics
+  {
+    //! Number of imported buildings (blocks if merging is enabled)
+    std::size_t buildings;
+    //! Number of imported foliage objects
+    std::size_t foliage;
+    //! Number of matching ways skipped because of missing nodes or open rings
+    std::size_t skippedWays;
+    //! Number of node positions kept in memory
+    std::size_t storedNodes;
+    //! Wall clock time of the import [s]
+    double time;
+    //! Number of vertices before simplification
+    std::size_t verticesBefore;
+    //! Number of vertices of the imported objects
+    std::size_t verticesAfter;
+  };
+
+  /*!
+   * @brief Create importer with the origin at the south west corner
+   *	    of the imported objects and 5 m wide tree rows.
+   */
+  OsmImporter ();
+
+  /*!
+   * @brief Set the origin of the local coordinates.
+   * @param latitude	Latitude of the origin [deg]
+   * @param longitude	Longitude of the origin [deg]
+   */
+  void
+  SetOrigin (double latitude, double longitude);
+
+  /*!
+   * @brief Set the width of the polygons created for tree rows.
+   * @param width	Width of a tree row [m], 0 to ignore tree rows
+   */
+  void
+  SetTreeRowWidth (double width);
+
+  /*!
+   * @brief Set the tolerance for simplifying the imported outlines.
+   *
+   * The outlines are simplified with SimplifyPolygons(), which keeps the
+   * nodes shared by several ways, so neighbors keep their common walls.
+   * The outlines of all ways are therefore kept in memory until the end
+   * of the second pass.
+   *
+   * @param tolerance	Tolerance for SimplifyPolygons() [m], 0 to disable
+   */
+  void
+  SetSimplificationTolerance (double tolerance);
+
+  /*!
+   * @brief Enable merging of touching buildings into blocks.
+   * @param enable	True to merge the buildings with MergeBuildings()
+   */
+  void
+  SetMergeBuildings (bool enable);
+
+  /*!
+   * @brief Import buildings and foliage from a stream.
+   *
+   * The stream is read twice and therefore must be seekable. The objects
+   * are bulk loaded into @a env. If bulk loading was disabled before,
+   * the objects are finalized together with other buffered objects,
+   * otherwise they stay buffered until Environment::Finalize() is called.
+   *
+   * @param is		Stream with OSM XML data
+   * @param env		Environment to add the objects to
+   * @return Statistics about the import
+   */
+  Statistics
+  Import (std::istream& is, Environment& env) const;
+
+  /*!
+   * @brief Import buildings and foliage from a file.
+   *
+   * Only OSM XML files are supported. PBF files have to be converted to
+   * XML first, e.g. with osmium cat.
+   *
+   * @param fileName	OSM XML file to read from
+   * @param env		Environment to add the objects to
+   * @return Statistics about the import, no objects if the file
+   *	     could not be read
+   */
+  Statistics
+  Import (const std::string& fileName, Environment& env) const;
+
+private:
+  //! Origin of the local coordinates [deg]
+  double m_originLatitude;
+  double m_originLongitude;
+  //! True if the origin is set explicitly
+  bool m_hasOrigin;
+
+  //! Width of tree rows [m]
+  double m_treeRowWidth;
+
+  //! Tolerance for the simplification of outlines [m]
+  double m_simplificationTolerance;
+
+  //! Merge touching buildings into blocks
+  bool m_mergeBuildings;
+};
+
+}  // namespace gemv2
+}  // namespace ns3
+
+#endif /* GEMV2_OSM_IMPORTER_H */
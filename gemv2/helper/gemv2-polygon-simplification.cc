@@ -0,0 +1,225 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "gemv2-polygon-simplification.h"
+
+#include <algorithm>
+#include <functional>
+
+#include <ns3/log.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("Gemv2PolygonSimplification");
+
+namespace gemv2 {
+
+namespace {
+
+//! Number of attempts with decreasing tolerance
+const int SIMPLIFICATION_ATTEMPTS = 4;
+
+//! Key of a vertex, equal positions have equal keys
+std::pair<double, double>
+MakeKey (const Point2d& p)
+{
+  // adding zero turns -0 into +0, which hash differently
+  return std::make_pair (p.x () + 0.0, p.y () + 0.0);
+}
+
+/*!
+ * @brief Simplify a closed ring but keep the locked vertices.
+ *
+ * The ring is split at the locked vertices and each part is simplified
+ * on its own, which keeps the end points of the parts.
+ *
+ * @param ring		Ring to simplify
+ * @param simplified	Simplified ring
+ * @param tolerance	Tolerance of the Douglas-Peucker algorithm
+ * @param locked	Vertices to keep
+ */
+void
+SimplifyRing (const Polygon2d::ring_type& ring, Polygon2d::ring_type& simplified,
+	      double tolerance, const SharedVertices& locked)
+{
+  std::size_t n = ring.size () - 1;
+  std::size_t first = 0;
+  while (first < n && !locked.IsShared (ring[first]))
+    {
+      ++first;
+    }
+  if (first == n)
+    {
+      boost::geometry::simplify (ring, simplified, tolerance);
+      return;
+    }
+
+  // walk around the ring, starting and ending at a locked vertex
+  using Part = boost::geometry::model::linestring<Point2d>;
+  Part part {ring[first]};
+  simplified.clear ();
+  for (std::size_t i = 1; i <= n; ++i)
+    {
+      auto const& p = ring[(first + i) % n];
+      part.push_back (p);
+      if (i == n || locked.IsShared (p))
+	{
+	  Part simplifiedPart;
+	  boost::geometry::simplify (part, simplifiedPart, tolerance);
+	  simplified.insert (simplified.end (), simplifiedPart.begin (),
+			     simplifiedPart.end () - 1);
+	  part = Part {p};
+	}
+    }
+  simplified.push_back (ring[first]);
+}
+
+}  // namespace
+
+std::size_t
+SharedVertices::PointHash::operator() (const std::pair<double, double>& p) const
+{
+  std::hash<double> hash;
+  return hash (p.first) * 31 + hash (p.second);
+}
+
+void
+SharedVertices::Add (const Polygon2d& polygon)
+{
+  std::vector<std::pair<double, double>> vertices;
+  vertices.reserve (GetNumVertices (polygon));
+  for (auto const& p : polygon.outer ())
+    {
+      vertices.push_back (MakeKey (p));
+    }
+  for (auto const& ring : polygon.inners ())
+    {
+      for (auto const& p : ring)
+	{
+	  vertices.push_back (MakeKey (p));
+	}
+    }
+
+  std::sort (vertices.begin (), vertices.end ());
+  vertices.erase (std::unique (vertices.begin (), vertices.end ()), vertices.end ());
+  for (auto const& v : vertices)
+    {
+      if (++m_counts[v] == 2)
+	{
+	  ++m_shared;
+	}
+    }
+}
+
+bool
+SharedVertices::IsShared (const Point2d& p) const
+{
+  if (m_shared == 0)
+    {
+      return false;
+    }
+  auto it = m_counts.find (MakeKey (p));
+  return it != m_counts.end () && it->second > 1;
+}
+
+bool
+SharedVertices::IsEmpty () const
+{
+  return m_shared == 0;
+}
+
+std::size_t
+GetNumVertices (const Polygon2d& polygon)
+{
+  std::size_t vertices = polygon.outer ().size ();
+  for (auto const& ring : polygon.inners ())
+    {
+      vertices += ring.size ();
+    }
+  return vertices;
+}
+
+bool
+SimplifyPolygon (Polygon2d& polygon, double tolerance)
+{
+  return SimplifyPolygon (polygon, tolerance, SharedVertices ());
+}
+
+bool
+SimplifyPolygon (Polygon2d& polygon, double tolerance,
+		 const SharedVertices& locked)
+{
+  boost::geometry::correct (polygon);
+
+  for (int attempt = 0; attempt < SIMPLIFICATION_ATTEMPTS && tolerance > 0;
+       ++attempt, tolerance /= 2)
+    {
+      Polygon2d simplified;
+      if (locked.IsEmpty ())
+	{
+	  boost::geometry::simplify (polygon, simplified, tolerance);
+	}
+      else
+	{
+	  SimplifyRing (polygon.outer (), simplified.outer (), tolerance, locked);
+	  simplified.inners ().resize (polygon.inners ().size ());
+	  for (std::size_t i = 0; i < polygon.inners ().size (); ++i)
+	    {
+	      SimplifyRing (polygon.inners ()[i], simplified.inners ()[i],
+			    tolerance, locked);
+	    }
+	}
+
+      // Douglas-Peucker does not preserve the topology on its own, and
+      // newer boost versions silently drop rings that collapse
+      if (simplified.inners ().size () == polygon.inners ().size () &&
+	  boost::geometry::is_valid (simplified))
+	{
+	  NS_LOG_LOGIC ("Simplified polygon from " << GetNumVertices (polygon)
+			<< " to " << GetNumVertices (simplified)
+			<< " vertices with tolerance " << tolerance);
+	  polygon = std::move (simplified);
+	  return true;
+	}
+    }
+
+  NS_LOG_LOGIC ("Keeping polygon with " << GetNumVertices (polygon) << " vertices");
+  return false;
+}
+
+std::size_t
+SimplifyPolygons (std::vector<Polygon2d>& polygons, double tolerance)
+{
+  SharedVertices locked;
+  for (auto const& p : polygons)
+    {
+      locked.Add (p);
+    }
+
+  std::size_t unchanged = 0;
+  for (auto& p : polygons)
+    {
+      if (!SimplifyPolygon (p, tolerance, locked))
+	{
+	  ++unchanged;
+	}
+    }
+  return unchanged;
+}
+
+}  // namespace gemv2
+}  // namespace ns3
@@ -0,0 +1,152 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GEMV2_POLYGON_SIMPLIFICATION_H
+#define GEMV2_POLYGON_SIMPLIFICATION_H
+
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <ns3/gemv2-geometry.h>
+
+namespace ns3 {
+namespace gemv2 {
+
+/*!
+ * @brief Get the number of vertices of a polygon.
+ * @param polygon	Polygon to count the vertices of
+ * @return Number of points in the outer and all inner rings
+ */
+std::size_t
+GetNumVertices (const Polygon2d& polygon);
+
+/*!
+ * @brief Vertices shared by several polygons.
+ *
+ * Neighboring obstacles often share a wall, i.e. the vertices along the
+ * wall appear in both outlines with exactly the same coordinates (e.g.
+ * nodes shared by OSM ways). Simplifying the outlines independently
+ * could move the wall differently in each of them and open a sliver
+ * between the obstacles or let them overlap. Such vertices are locked,
+ * so the simplification keeps them in all outlines (see SimplifyPolygon()).
+ *
+ * Only exact matches are found. A vertex lying on the edge of another
+ * polygon (a T-junction) is not shared and may still drift apart from
+ * that edge by up to the tolerance.
+ */
+class SharedVertices
+{
+public:
+  /*!
+   * @brief Count the vertices of a polygon.
+   *
+   * Vertices repeated within the same polygon are counted once.
+   *
+   * @param polygon	Polygon to add
+   */
+  void
+  Add (const Polygon2d& polygon);
+
+  /*!
+   * @brief Check if a vertex belongs to more than one added polygon.
+   * @param p	Vertex to check
+   * @return True if @a p is a vertex of at least two polygons
+   */
+  bool
+  IsShared (const Point2d& p) const;
+
+  /*!
+   * @brief Check if any vertex is shared at all.
+   * @return True if no vertex belongs to more than one polygon
+   */
+  bool
+  IsEmpty () const;
+
+private:
+  //! Hash of the coordinates of a vertex
+  struct PointHash
+  {
+    std::size_t operator() (const std::pair<double, double>& p) const;
+  };
+
+  //! Number of polygons containing each vertex
+  std::unordered_map<std::pair<double, double>, std::size_t, PointHash> m_counts;
+
+  //! Number of vertices contained in more than one polygon
+  std::size_t m_shared = 0;
+};
+
+/*!
+ * @brief Simplify an obstacle outline with the Douglas-Peucker algorithm.
+ *
+ * The polygon is corrected first. If the simplified polygon is not valid
+ * (e.g. a ring collapsed or rings intersect each other), the tolerance is
+ * halved and the simplification is repeated. If no valid polygon is found
+ * after a few attempts, the polygon is left unchanged.
+ *
+ * The topology is only preserved within the polygon. Use the overload
+ * with locked vertices (or SimplifyPolygons()) for obstacles sharing walls.
+ *
+ * @param polygon	Polygon to simplify in place
+ * @param tolerance	Maximum distance of removed vertices to the
+ *			simplified outline [m]
+ * @return False if the polygon was left unchanged because no valid
+ *	   simplification was found
+ */
+bool
+SimplifyPolygon (Polygon2d& polygon, double tolerance);
+
+/*!
+ * @brief Simplify an obstacle outline but keep shared vertices.
+ *
+ * Same as SimplifyPolygon() above, but the vertices shared with other
+ * polygons are kept and only the parts of the rings between them are
+ * simplified. A wall shared with a neighbor thus stays the same in both
+ * outlines if both are simplified with the same @a locked vertices.
+ *
+ * @param polygon	Polygon to simplify in place
+ * @param tolerance	Maximum distance of removed vertices to the
+ *			simplified outline [m]
+ * @param locked	Vertices to keep
+ * @return False if the polygon was left unchanged because no valid
+ *	   simplification was found
+ */
+bool
+SimplifyPolygon (Polygon2d& polygon, double tolerance,
+		 const SharedVertices& locked);
+
+/*!
+ * @brief Simplify neighboring obstacle outlines consistently.
+ *
+ * Vertices shared by several of @a polygons are locked (see
+ * SharedVertices), the polygons are simplified with SimplifyPolygon().
+ *
+ * @param polygons	Polygons to simplify in place
+ * @param tolerance	Maximum distance of removed vertices to the
+ *			simplified outlines [m]
+ * @return Number of polygons left unchanged because no valid
+ *	   simplification was found
+ */
+std::size_t
+SimplifyPolygons (std::vector<Polygon2d>& polygons, double tolerance);
+
+}  // namespace gemv2
+}  // namespace ns3
+
+#endif /* GEMV2_POLYGON_SIMPLIFICATION_H */
@@ -0,0 +1,538 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GEMV2_AGGREGATE_TREE_H
+#define GEMV2_AGGREGATE_TREE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <boost/geometry/index/indexable.hpp>
+
+#include <ns3/gemv2-geometry.h>
+#include <ns3/gemv2-bounding-boxes.h>
+
+namespace ns3
+{
+namespace gemv2
+{
+namespace detail
+{
+
+//! Weight getter for trees that only count objects
+struct NoWeight
+{
+  template<typename Value>
+  double
+  operator() (const Value&) const
+  {
+    return 0.0;
+  }
+};
+
+//! A node of an AggregateTree, independent of the stored values
+struct AggregateNode
+{
+  //! Box around all objects in the subtree
+  Box2d box;
+  //! Index of the first child node or object
+  std::uint32_t first;
+  //! Number of children
+  std::uint32_t count;
+  //! Number of objects in the subtree
+  std::size_t objects;
+  //! Summed weight of the objects in the subtree
+  double weight;
+  //! True if the children are objects
+  bool leaf;
+};
+
+}  // namespace detail
+
+/*!
+ * @brief Static bounding box tree with aggregated values per node.
+ *
+ * Each node stores the number of objects and the summed weight (e.g. the
+ * area) of its subtree. Aggregates over an ellipse can thus accept whole
+ * subtrees if their box lies inside the ellipse and only need to look at
+ * single objects close to the border of the ellipse.
+ *
+ * The tree is packed once with the sort-tile-recursive (STR) algorithm
+ * and stored in flat arrays. It has to be built again after any change.
+ *
+ * @tparam Value		Type of the stored objects
+ * @tparam IndexableGetter	Function object returning the Box2d of a value
+ * @tparam WeightGetter		Function object returning the weight of a value
+ */
+template<typename Value,
+	 typename IndexableGetter = boost::geometry::index::indexable<Value>,
+	 typename WeightGetter = detail::NoWeight>
+class AggregateTree
+{
+public:
+  //! Type of the stored objects
+  using value_type = Value;
+
+  //! Maximum number of children per node
+  static const std::size_t NODE_CAPACITY = 16;
+
+  //! A node of the tree
+  using Node = detail::AggregateNode;
+
+  //! Aggregated values of a set of objects
+  struct Aggregate
+  {
+    //! Number of objects
+    std::size_t objects;
+    //! Summed weight of the objects
+    double weight;
+  };
+
+  /*!
+   * @brief Create empty tree.
+   */
+  AggregateTree ()
+    : m_root (0)
+  {
+  }
+
+  /*!
+   * @brief Replace the content of the tree.
+   * @param first	Begin of the objects to store
+   * @param last	End of the objects to store
+   */
+  template<typename Iterator>
+  void
+  Build (Iterator first, Iterator last)
+  {
+    clear ();
+
+    std::vector<Value> values (first, last);
+    if (values.empty ())
+      {
+	return;
+      }
+
+    // pack the objects into leaves
+    std::vector<std::size_t> order (values.size ());
+    for (std::size_t i = 0; i < order.size (); ++i)
+      {
+	order[i] = i;
+      }
+    SortTileRecursive (
+	order, [this, &values] (std::size_t i) -> const Box2d&
+	{ return m_getter (values[i]); });
+
+    m_values.reserve (values.size ());
+    m_boxes.reserve (values.size ());
+    m_weights.reserve (values.size ());
+    for (auto i : order)
+      {
+	m_values.push_back (values[i]);
+	m_boxes.push_back (m_getter (values[i]));
+	m_weights.push_back (m_weightGetter (values[i]));
+      }
+
+    std::vector<Node> level;
+    for (std::size_t first = 0; first < m_values.size (); first += NODE_CAPACITY)
+      {
+	Node leaf;
+	leaf.first = static_cast<std::uint32_t> (first);
+	leaf.count = static_cast<std::uint32_t> (
+	    std::min (NODE_CAPACITY, m_values.size () - first));
+	leaf.leaf = true;
+	leaf.objects = leaf.count;
+	leaf.weight = 0;
+	leaf.box = m_boxes[first];
+	for (std::size_t i = first; i < first + leaf.count; ++i)
+	  {
+	    boost::geometry::expand (leaf.box, m_boxes[i]);
+	    leaf.weight += m_weights[i];
+	  }
+	level.push_back (leaf);
+      }
+
+    // pack the nodes of each level into parents until only the root is left
+    while (level.size () > 1)
+      {
+	SortTileRecursive (level, [] (const Node& n) -> const Box2d&
+			   { return n.box; });
+
+	auto offset = m_nodes.size ();
+	m_nodes.insert (m_nodes.end (), level.begin (), level.end ());
+
+	std::vector<Node> parents;
+	for (std::size_t first = 0; first < level.size (); first += NODE_CAPACITY)
+	  {
+	    Node parent;
+	    parent.first = static_cast<std::uint32_t> (offset + first);
+	    parent.count = static_cast<std::uint32_t> (
+		std::min (NODE_CAPACITY, level.size () - first));
+	    parent.leaf = false;
+	    parent.objects = 0;
+	    parent.weight = 0;
+	    parent.box = level[first].box;
+	    for (std::size_t i = first; i < first + parent.count; ++i)
+	      {
+		boost::geometry::expand (parent.box, level[i].box);
+		parent.objects += level[i].objects;
+		parent.weight += level[i].weight;
+	      }
+	    parents.push_back (parent);
+	  }
+	level.swap (parents);
+      }
+
+    m_root = m_nodes.size ();
+    m_nodes.push_back (level.front ());
+  }
+
+  /*!
+   * @brief Restore the tree from the nodes of a previously built one.
+   *
+   * This skips the packing, e.g. when loading a tree from a file.
+   *
+   * @param first	Begin of the objects in the order of GetValues()
+   * @param last	End of the objects
+   * @param nodes	Nodes as returned by GetNodes()
+   */
+  template<typename Iterator>
+  void
+  Restore (Iterator first, Iterator last, std::vector<Node> nodes)
+  {
+    clear ();
+
+    for (; first != last; ++first)
+      {
+	m_values.push_back (*first);
+	m_boxes.push_back (m_getter (m_values.back ()));
+	m_weights.push_back (m_weightGetter (m_values.back ()));
+      }
+
+    // the root is always added last
+    m_nodes.swap (nodes);
+    m_root = m_nodes.empty () ? 0 : m_nodes.size () - 1;
+  }
+
+  /*!
+   * @brief Get all nodes of the tree, e.g. to store them.
+   * @return Nodes with the root as last element
+   */
+  const std::vector<Node>&
+  GetNodes () const
+  {
+    return m_nodes;
+  }
+
+  /*!
+   * @brief Get all stored objects.
+   * @return Objects in the order of the leaves
+   */
+  const std::vector<Value>&
+  GetValues () const
+  {
+    return m_values;
+  }
+
+  /*!
+   * @brief Remove all objects.
+   */
+  void
+  clear ()
+  {
+    m_nodes.clear ();
+    m_values.clear ();
+    m_boxes.clear ();
+    m_weights.clear ();
+    m_root = 0;
+  }
+
+  /*!
+   * @brief Get the number of stored objects.
+   * @return Number of stored objects
+   */
+  std::size_t
+  size () const
+  {
+    return m_values.size ();
+  }
+
+  /*!
+   * @brief Check if the tree is empty.
+   * @return True if no objects are stored
+   */
+  bool
+  empty () const
+  {
+    return m_values.empty ();
+  }
+
+  /*!
+   * @brief Visit all objects whose box intersects a geometry.
+   * @param g		Geometry to test
+   * @param visitor	Called for each object
+   */
+  template<typename Geometry, typename Visitor>
+  void
+  Visit (const Geometry& g, Visitor visitor) const
+  {
+    if (!m_nodes.empty ())
+      {
+	Visit (m_nodes[m_root], g, visitor);
+      }
+  }
+
+  /*!
+   * @brief Aggregate all objects within an ellipse.
+   *
+   * An object is counted if its box intersects @a bBox and the rotated
+   * rectangle around the ellipse and @a predicate accepts it. Subtrees
+   * and objects with a box completely inside @a bBox and the ellipse are
+   * accepted without calling @a predicate. Those with a box outside of the
+   * ellipse are skipped.
+   *
+   * Both shortcuts require that the box of each object covers the tested
+   * shape of the object, i.e. @a predicate has to be the exact ellipse
+   * test on a shape enclosed by the box. Otherwise, set
+   * @a boxesCoverObjects to false to test every candidate.
+   *
+   * @param bBox		Bounding box to limit the search
+   * @param p1			First focal point
+   * @param p2			Second focal point
+   * @param range		Maximum distance from @a p1 and @a p2 combined
+   * @param predicate		Exact test for a single object
+   * @param boxesCoverObjects	Enable the shortcuts based on the node boxes
+   * @return Number and summed weight of the matching objects
+   */
+  template<typename Predicate>
+  Aggregate
+  Accumulate (const Box2d& bBox, const Point2d& p1, const Point2d& p2,
+	      double range, Predicate predicate,
+	      bool boxesCoverObjects = true) const
+  {
+    Aggregate result {0, 0.0};
+    if (!m_nodes.empty ())
+      {
+	auto rectangle = MakeBoundingRectangleEllipse (p1, p2, range);
+	Accumulate (m_nodes[m_root], bBox, rectangle, p1, p2, range,
+		    predicate, boxesCoverObjects, result);
+      }
+    return result;
+  }
+
+  /*!
+   * @brief Check if Accumulate() counts an object.
+   *
+   * This applies the classification of Accumulate() to a single object
+   * with the box it was stored with. Subtrees accepted or rejected as a
+   * whole classify their objects the same way, so the result matches the
+   * traversal even if the object moved out of its box since.
+   *
+   * @param value		Stored object
+   * @param bBox		Bounding box passed to Accumulate()
+   * @param p1			First focal point
+   * @param p2			Second focal point
+   * @param range		Maximum distance from @a p1 and @a p2 combined
+   * @param predicate		Exact test passed to Accumulate()
+   * @param boxesCoverObjects	Same as for Accumulate()
+   * @return True if @a value contributes to the result of Accumulate()
+   */
+  template<typename Predicate>
+  bool
+  IsCounted (const Value& value, const Box2d& bBox, const Point2d& p1,
+	     const Point2d& p2, double range, Predicate predicate,
+	     bool boxesCoverObjects = true) const
+  {
+    auto rectangle = MakeBoundingRectangleEllipse (p1, p2, range);
+    return IsAccepted (m_getter (value), value, bBox, rectangle, p1, p2,
+		       range, predicate, boxesCoverObjects);
+  }
+
+private:
+
+  //! Classification of a single object in Accumulate ()
+  template<typename Predicate>
+  static bool
+  IsAccepted (const Box2d& box, const Value& value, const Box2d& bBox,
+	      const OrientedRectangle& rectangle,
+	      const Point2d& p1, const Point2d& p2, double range,
+	      Predicate& predicate, bool boxesCoverObjects)
+  {
+    if (!boost::geometry::intersects (box, bBox) ||
+	!Intersects (box, rectangle))
+      {
+	return false;
+      }
+
+    // same classification as in FindObjectsInEllipse ()
+    if (boxesCoverObjects &&
+	IsBoxOutsideEllipse (box, p1, p2, range))
+      {
+	return false;
+      }
+    else if (boxesCoverObjects &&
+	     IsBoxInsideEllipse (box, p1, p2, range))
+      {
+	return true;
+      }
+    return predicate (value);
+  }
+
+  /*!
+   * @brief Order items with the sort-tile-recursive algorithm.
+   *
+   * Afterwards, each consecutive run of NODE_CAPACITY items forms a
+   * compact node.
+   *
+   * @param items	Items to order
+   * @param box		Function returning the box of an item
+   */
+  template<typename T, typename BoxGetter>
+  static void
+  SortTileRecursive (std::vector<T>& items, BoxGetter box)
+  {
+    auto centerX = [&box] (const T& a)
+    { return box (a).min_corner ().x () + box (a).max_corner ().x (); };
+    auto centerY = [&box] (const T& a)
+    { return box (a).min_corner ().y () + box (a).max_corner ().y (); };
+
+    auto nodes = (items.size () + NODE_CAPACITY - 1) / NODE_CAPACITY;
+    auto slices = static_cast<std::size_t> (
+	std::ceil (std::sqrt (static_cast<double> (nodes))));
+    auto sliceSize = slices * NODE_CAPACITY;
+
+    std::sort (items.begin (), items.end (),
+	       [&centerX] (const T& a, const T& b)
+	       { return centerX (a) < centerX (b); });
+
+    for (std::size_t first = 0; first < items.size (); first += sliceSize)
+      {
+	auto last = std::min (first + sliceSize, items.size ());
+	std::sort (items.begin () + first, items.begin () + last,
+		   [&centerY] (const T& a, const T& b)
+		   { return centerY (a) < centerY (b); });
+      }
+  }
+
+  //! Recursive part of the public Visit ()
+  template<typename Geometry, typename Visitor>
+  void
+  Visit (const Node& node, const Geometry& g, Visitor& visitor) const
+  {
+    if (!boost::geometry::intersects (node.box, g))
+      {
+	return;
+      }
+
+    for (std::size_t i = node.first; i < node.first + node.count; ++i)
+      {
+	if (!node.leaf)
+	  {
+	    Visit (m_nodes[i], g, visitor);
+	  }
+	else if (boost::geometry::intersects (m_boxes[i], g))
+	  {
+	    visitor (m_values[i]);
+	  }
+      }
+  }
+
+  //! Recursive part of the public Accumulate ()
+  template<typename Predicate>
+  void
+  Accumulate (const Node& node, const Box2d& bBox,
+	      const OrientedRectangle& rectangle,
+	      const Point2d& p1, const Point2d& p2, double range,
+	      Predicate& predicate, bool boxesCoverObjects,
+	      Aggregate& result) const
+  {
+    if (!boost::geometry::intersects (node.box, bBox) ||
+	!Intersects (node.box, rectangle))
+      {
+	return;
+      }
+
+    if (boxesCoverObjects)
+      {
+	if (IsBoxOutsideEllipse (node.box, p1, p2, range))
+	  {
+	    return;
+	  }
+
+	if (boost::geometry::covered_by (node.box, bBox) &&
+	    IsBoxInsideEllipse (node.box, p1, p2, range))
+	  {
+	    result.objects += node.objects;
+	    result.weight += node.weight;
+	    return;
+	  }
+      }
+
+    if (node.leaf)
+      {
+	for (std::size_t i = node.first; i < node.first + node.count; ++i)
+	  {
+	    if (IsAccepted (m_boxes[i], m_values[i], bBox, rectangle, p1, p2,
+			    range, predicate, boxesCoverObjects))
+	      {
+		++result.objects;
+		result.weight += m_weights[i];
+	      }
+	  }
+      }
+    else
+      {
+	for (std::size_t i = node.first; i < node.first + node.count; ++i)
+	  {
+	    Accumulate (m_nodes[i], bBox, rectangle, p1, p2, range,
+			predicate, boxesCoverObjects, result);
+	  }
+      }
+  }
+
+  //! All nodes, children of a node are stored consecutively
+  std::vector<Node> m_nodes;
+
+  //! Index of the root node in m_nodes
+  std::size_t m_root;
+
+  //! Stored objects in leaf order
+  std::vector<Value> m_values;
+
+  //! Boxes of the stored objects
+  std::vector<Box2d> m_boxes;
+
+  //! Weights of the stored objects
+  std::vector<double> m_weights;
+
+  //! Access to the box of a value
+  IndexableGetter m_getter;
+
+  //! Access to the weight of a value
+  WeightGetter m_weightGetter;
+};
+
+// std::min () binds the capacity to a reference, so it needs a definition
+template<typename Value, typename IndexableGetter, typename WeightGetter>
+const std::size_t AggregateTree<Value, IndexableGetter, WeightGetter>::NODE_CAPACITY;
+
+}  // namespace gemv2
+}  // namespace ns3
+
+#endif /* GEMV2_AGGREGATE_TREE_H */
@@ -17,35 +17,124 @@
  */
 #include "gemv2-bounding-boxes.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace ns3 {
 namespace gemv2 {
 
 Box2d
 MakeBoundingBoxCircle (const Point2d& center, double radius)
 {
-  double range = radius / 2;
-  return Box2d (Point2d (center.x () - range, center.y () - range),
-		Point2d (center.y () + range, center.y () + range));
+  return Box2d (Point2d (center.x () - radius, center.y () - radius),
+		Point2d (center.x () + radius, center.y () + radius));
 }
 
 Box2d
 MakeBoundingBoxEllipse (const Point2d& p1, const Point2d& p2, double range)
 {
-  double padding = (range - boost::geometry::distance (p1, p2)) / 2;
+  auto rectangle = MakeBoundingRectangleEllipse (p1, p2, range);
 
   /*
-   * Make bounding box around ellipse
+   * Extent of the rotated ellipse along the axes
    *
-   * This approach might be over conservative and leads to a
-   * box larger than the area covered by the ellipse. However,
-   * getting a tight box requires more computations beforehand.
-   * I'm not sure if it is worth it.
+   * Padding the focal points by half of the remaining range is not enough
+   * here, since the minor semi-axis is larger than that distance.
    */
+  double a = rectangle.halfLength;
+  double b = rectangle.halfWidth;
+  double c2 = rectangle.cosAngle * rectangle.cosAngle;
+  double s2 = rectangle.sinAngle * rectangle.sinAngle;
+  double dx = std::sqrt (a * a * c2 + b * b * s2);
+  double dy = std::sqrt (a * a * s2 + b * b * c2);
+
   return Box2d
-      (Point2d (std::min(p1.x (), p2.x ()) - padding,
-		std::min(p1.y (), p2.y ()) - padding),
-       Point2d (std::max(p1.x (), p2.x ()) + padding,
-		std::max(p1.y (), p2.y ()) + padding));
+      (Point2d (rectangle.center.x () - dx, rectangle.center.y () - dy),
+       Point2d (rectangle.center.x () + dx, rectangle.center.y () + dy));
+}
+
+OrientedRectangle
+MakeBoundingRectangleEllipse (const Point2d& p1, const Point2d& p2, double range)
+{
+  double distance = boost::geometry::distance (p1, p2);
+
+  OrientedRectangle rectangle;
+  rectangle.center = Point2d ((p1.x () + p2.x ()) / 2, (p1.y () + p2.y ()) / 2);
+  rectangle.cosAngle = distance > 0 ? (p2.x () - p1.x ()) / distance : 1.0;
+  rectangle.sinAngle = distance > 0 ? (p2.y () - p1.y ()) / distance : 0.0;
+  rectangle.halfLength = std::max (range / 2, 0.0);
+  rectangle.halfWidth = std::sqrt (
+      std::max (range * range - distance * distance, 0.0)) / 2;
+  return rectangle;
+}
+
+bool
+Intersects (const Box2d& box, const OrientedRectangle& rectangle)
+{
+  double cx = (box.min_corner ().x () + box.max_corner ().x ()) / 2;
+  double cy = (box.min_corner ().y () + box.max_corner ().y ()) / 2;
+  double ex = (box.max_corner ().x () - box.min_corner ().x ()) / 2;
+  double ey = (box.max_corner ().y () - box.min_corner ().y ()) / 2;
+
+  double tx = cx - rectangle.center.x ();
+  double ty = cy - rectangle.center.y ();
+  double c = std::abs (rectangle.cosAngle);
+  double s = std::abs (rectangle.sinAngle);
+
+  // axes of the box
+  if (std::abs (tx) > ex + rectangle.halfLength * c + rectangle.halfWidth * s ||
+      std::abs (ty) > ey + rectangle.halfLength * s + rectangle.halfWidth * c)
+    {
+      return false;
+    }
+
+  // axes of the rectangle
+  double u = tx * rectangle.cosAngle + ty * rectangle.sinAngle;
+  double v = -tx * rectangle.sinAngle + ty * rectangle.cosAngle;
+  return std::abs (u) <= rectangle.halfLength + ex * c + ey * s &&
+      std::abs (v) <= rectangle.halfWidth + ex * s + ey * c;
+}
+
+namespace {
+
+//! Combined distance of a point to both focal points
+double
+FocalDistanceSum (double x, double y, const Point2d& p1, const Point2d& p2)
+{
+  return std::hypot (x - p1.x (), y - p1.y ()) +
+      std::hypot (x - p2.x (), y - p2.y ());
+}
+
+//! Distance of a point to a box, zero if the point is inside
+double
+DistanceToBox (const Point2d& p, const Box2d& box)
+{
+  double dx = std::max ({box.min_corner ().x () - p.x (), 0.0,
+			 p.x () - box.max_corner ().x ()});
+  double dy = std::max ({box.min_corner ().y () - p.y (), 0.0,
+			 p.y () - box.max_corner ().y ()});
+  return std::hypot (dx, dy);
+}
+
+}  // namespace
+
+bool
+IsBoxInsideEllipse (const Box2d& box,
+		    const Point2d& p1, const Point2d& p2, double range)
+{
+  auto const& min = box.min_corner ();
+  auto const& max = box.max_corner ();
+  return FocalDistanceSum (min.x (), min.y (), p1, p2) < range &&
+      FocalDistanceSum (min.x (), max.y (), p1, p2) < range &&
+      FocalDistanceSum (max.x (), min.y (), p1, p2) < range &&
+      FocalDistanceSum (max.x (), max.y (), p1, p2) < range;
+}
+
+bool
+IsBoxOutsideEllipse (const Box2d& box,
+		     const Point2d& p1, const Point2d& p2, double range)
+{
+  return DistanceToBox (p1, box) + DistanceToBox (p2, box) >= range;
 }
 
 }  // namespace gemv2
@@ -44,11 +44,90 @@ MakeBoundingBoxCircle (const Point2d& center, double radius);
  * @param p1		First point
  * @param p2		Second point
  * @param range		Length of the major diameter of the ellipse
- * @return Bounding box around the ellipse
+ * @return Smallest axis-aligned box around the ellipse
  */
 Box2d
 MakeBoundingBoxEllipse (const Point2d& p1, const Point2d& p2, double range);
 
+/*!
+ * @brief Rectangle aligned with the axes of an ellipse.
+ */
+struct OrientedRectangle
+{
+  //! Center of the rectangle
+  Point2d center;
+  //! Cosine of the angle between the major axis and the x axis
+  double cosAngle;
+  //! Sine of the angle between the major axis and the x axis
+  double sinAngle;
+  //! Half extent along the major axis
+  double halfLength;
+  //! Half extent along the minor axis
+  double halfWidth;
+};
+
+/*!
+ * @brief Make rectangle around communication ellipse
+ *
+ * Contrary to MakeBoundingBoxEllipse() the rectangle is rotated with the
+ * ellipse. It is considerably smaller than the axis-aligned box for
+ * elongated ellipses that are not parallel to an axis.
+ *
+ * @param p1		First focal point
+ * @param p2		Second focal point
+ * @param range		Length of the major diameter of the ellipse
+ * @return Smallest rectangle around the ellipse
+ */
+OrientedRectangle
+MakeBoundingRectangleEllipse (const Point2d& p1, const Point2d& p2, double range);
+
+/*!
+ * @brief Test if a box and a rotated rectangle intersect.
+ *
+ * This uses the separating axis test and does not require any square roots.
+ *
+ * @param box		Axis-aligned box
+ * @param rectangle	Rotated rectangle
+ * @return True if @a box and @a rectangle share at least one point
+ */
+bool
+Intersects (const Box2d& box, const OrientedRectangle& rectangle);
+
+/*!
+ * @brief Test if a box lies completely inside an ellipse.
+ *
+ * The ellipse is described by all points p where:
+ * distance(p, p1) + distance(p, p2) < range
+ *
+ * Since the ellipse is convex, it is sufficient to test the corners.
+ *
+ * @param box		Box to test
+ * @param p1		First focal point
+ * @param p2		Second focal point
+ * @param range		Length of the major diameter of the ellipse
+ * @return True if every point of @a box is inside the ellipse
+ */
+bool
+IsBoxInsideEllipse (const Box2d& box,
+		    const Point2d& p1, const Point2d& p2, double range);
+
+/*!
+ * @brief Test if no object within a box can be inside an ellipse.
+ *
+ * This is a conservative test using the distance of the box to both focal
+ * points as lower bound for the distance sum of any object in the box.
+ *
+ * @param box		Box to test
+ * @param p1		First focal point
+ * @param p2		Second focal point
+ * @param range		Length of the major diameter of the ellipse
+ * @return True if the distance sum of every object in @a box is at
+ *         least @a range
+ */
+bool
+IsBoxOutsideEllipse (const Box2d& box,
+		     const Point2d& p1, const Point2d& p2, double range);
+
 }  // namespace gemv2
 }  // namespace ns3
 
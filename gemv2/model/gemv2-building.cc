@@ -18,6 +18,7 @@
 #include "gemv2-building.h"
 
 #include <boost/geometry/io/wkt/wkt.hpp>
+#include <ns3/assert.h>
 #include <ns3/log.h>
 
 namespace ns3 {
@@ -27,26 +28,119 @@ NS_LOG_COMPONENT_DEFINE("Gemv2Building");
 namespace gemv2 {
 
 Building::Building (Polygon2d const& shape)
-  : m_shape (shape),
+  : m_exactShape (new ExactShape {shape, FlatPolygon ()}),
+    m_indexed (false),
     m_relativePermittivity (4.5)
 {
   // fix potential issues with shape
-  boost::geometry::correct (m_shape);
-  NS_LOG_LOGIC ("Created building with outline: " << boost::geometry::wkt (m_shape));
+  auto& exact = *m_exactShape;
+  boost::geometry::correct (exact.shape);
+  NS_LOG_LOGIC ("Created building with outline: " << boost::geometry::wkt (exact.shape));
+
+  // flatten edges for the intersection kernel
+  exact.flatShape = FlatPolygon (exact.shape);
 
   // calculate bounding box
-  boost::geometry::envelope (m_shape, m_boundingBox);
+  boost::geometry::envelope (exact.shape, m_boundingBox);
   NS_LOG_LOGIC ("Building bounding box: " << boost::geometry::wkt (m_boundingBox));
 
   // calculate area
-  m_area = boost::geometry::area (m_shape);
+  m_area = boost::geometry::area (exact.shape);
   NS_LOG_LOGIC ("Area of the building: " << m_area << " m^2");
 }
 
 Polygon2d const&
 Building::GetShape () const
 {
-  return m_shape;
+  NS_ASSERT_MSG (!IsCompact (), "shape of compact building requested, use DecodeShape ()");
+  return m_exactShape->shape;
+}
+
+Polygon2d
+Building::DecodeShape () const
+{
+  if (IsCompact ())
+    {
+      return m_compactShape.GetPolygon ();
+    }
+  return m_exactShape->shape;
+}
+
+FlatPolygon const&
+Building::GetFlatShape () const
+{
+  NS_ASSERT_MSG (!IsCompact (), "flat shape of compact building requested");
+  return m_exactShape->flatShape;
+}
+
+void
+Building::Compact ()
+{
+  if (IsCompact ())
+    {
+      return;
+    }
+  NS_ASSERT_MSG (!m_indexed, "building in an environment must not be compacted");
+
+  m_compactShape = CompactPolygon (m_exactShape->shape);
+
+  // box and area have to match the rounded vertices
+  auto shape = m_compactShape.GetPolygon ();
+  boost::geometry::envelope (shape, m_boundingBox);
+  m_area = boost::geometry::area (shape);
+
+  // release the memory of the other shapes
+  m_exactShape.reset ();
+
+  NS_LOG_LOGIC ("Compacted building with " << m_compactShape.GetNumEdges () << " edges");
+}
+
+bool
+Building::IsCompact () const
+{
+  return m_exactShape == nullptr;
+}
+
+void
+Building::MarkIndexed ()
+{
+  m_indexed = true;
+}
+
+bool
+Building::IsIndexed () const
+{
+  return m_indexed;
+}
+
+bool
+Building::Intersects (LineSegment2d const& line) const
+{
+  if (IsCompact ())
+    {
+      return m_compactShape.Intersects (line);
+    }
+  return m_exactShape->flatShape.Intersects (line);
+}
+
+bool
+Building::Contains (Point2d const& p) const
+{
+  if (IsCompact ())
+    {
+      return m_compactShape.Contains (p);
+    }
+  return m_exactShape->flatShape.Contains (p);
+}
+
+double
+Building::GetDistance (Point2d const& p) const
+{
+  if (IsCompact ())
+    {
+      return m_compactShape.GetDistance (p);
+    }
+  return boost::geometry::distance (p, m_exactShape->shape);
 }
 
 Box2d const&
@@ -73,5 +167,11 @@ Building::SetRelativePermittivity (double perm)
   m_relativePermittivity = perm;
 }
 
+double
+GetShapeDistance (const Point2d& p, const Building& building)
+{
+  return building.GetDistance (p);
+}
+
 }  // namespace gemv2
 }  // namespace ns3
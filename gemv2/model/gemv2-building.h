@@ -18,8 +18,12 @@
 #ifndef GEMV2_BUILDING_H
 #define GEMV2_BUILDING_H
 
+#include <memory>
+
 #include <ns3/simple-ref-count.h>
 #include <ns3/gemv2-geometry.h>
+#include <ns3/gemv2-flat-polygon.h>
+#include <ns3/gemv2-compact-polygon.h>
 
 namespace ns3 {
 namespace gemv2 {
@@ -39,11 +43,92 @@ public:
 
   /*!
    * @brief Get the shape of the building
+   *
+   * Only available if the building is not compact.
+   *
    * @return Shape of the building
    */
   Polygon2d const&
   GetShape () const;
 
+  /*!
+   * @brief Get the shape of the building, also if it is compact.
+   *
+   * Compact shapes are decoded, other shapes are copied.
+   *
+   * @return Shape of the building
+   */
+  Polygon2d
+  DecodeShape () const;
+
+  /*!
+   * @brief Get the shape of the building for fast intersection tests
+   *
+   * Only available if the building is not compact.
+   *
+   * @return Edges of the building in a flat array
+   */
+  FlatPolygon const&
+  GetFlatShape () const;
+
+  /*!
+   * @brief Store the shape with quantized vertices.
+   *
+   * Replaces the shape and the flat shape by a CompactPolygon, which
+   * needs a fraction of the memory. Vertices are rounded to
+   * COMPACT_POLYGON_RESOLUTION, bounding box and area are updated
+   * accordingly. Must not be called once the building was added to an
+   * environment, since the indexes depend on the bounding box.
+   */
+  void
+  Compact ();
+
+  /*!
+   * @brief Check if the shape is stored in compact form.
+   * @return True if Compact() was called
+   */
+  bool
+  IsCompact () const;
+
+  /*!
+   * @brief Note that an environment indexes the building.
+   *
+   * Called by the environment, the building can not be compacted afterwards.
+   */
+  void
+  MarkIndexed ();
+
+  /*!
+   * @brief Check if any environment indexed the building.
+   * @return True if MarkIndexed() was called
+   */
+  bool
+  IsIndexed () const;
+
+  /*!
+   * @brief Test if a line segment intersects with the building.
+   * @param line	Line segment to test
+   * @return True if @a line touches or enters the building
+   */
+  bool
+  Intersects (LineSegment2d const& line) const;
+
+  /*!
+   * @brief Test if a point is inside of the building.
+   * @param p	Point to test
+   * @return True if @a p is inside
+   */
+  bool
+  Contains (Point2d const& p) const;
+
+  /*!
+   * @brief Get the distance of a point to the building.
+   * @param p	Point to calculate the distance for
+   * @return Distance to the shape, 0 if @a p is inside
+   */
+  double
+  GetDistance (Point2d const& p) const;
+
   /*!
    * @brief Get the bounding box of the building
    * @return Bounding box of the building
@@ -74,8 +159,22 @@ public:
 
 private:
 
-  //! Shape of the building
-  Polygon2d m_shape;
+  //! Exact shape and the same shape for fast intersection tests
+  struct ExactShape
+  {
+    Polygon2d shape;
+    FlatPolygon flatShape;
+  };
+
+  //! Exact shape, null if the building is compact
+  std::unique_ptr<ExactShape> m_exactShape;
+
+  /*!
+   * @brief Quantized shape, empty unless the building is compact.
+   *
+   * Stored inline, so a compact building only allocates the vertex buffer.
+   */
+  CompactPolygon m_compactShape;
 
   //! Bounding box of the building
   Box2d m_boundingBox;
@@ -83,10 +182,22 @@ private:
   //! Area covered by the building
   double m_area;
 
+  //! Whether an environment indexes the building, see MarkIndexed()
+  bool m_indexed;
+
   //! Relative permittivity of the buildings surface
   double m_relativePermittivity;
 };
 
+/*!
+ * @brief Distance of a point to a building for the ellipse queries.
+ * @param p	Point to calculate the distance for
+ * @param building	Building to calculate the distance to
+ * @return Distance of @a p to the shape of @a building
+ */
+double
+GetShapeDistance (const Point2d& p, const Building& building);
+
 }  // namespace gemv2
 }  // namespace ns3
 
@@ -0,0 +1,296 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "gemv2-compact-polygon.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <ns3/assert.h>
+
+namespace ns3 {
+namespace gemv2 {
+
+namespace {
+
+//! Round a coordinate to the global grid
+std::int64_t
+Quantize (double v)
+{
+  return std::llround (v / COMPACT_POLYGON_RESOLUTION);
+}
+
+//! Offset of a grid coordinate to the origin
+std::int32_t
+MakeOffset (std::int64_t v, std::int64_t origin)
+{
+  NS_ASSERT_MSG (v - origin <= std::numeric_limits<std::int32_t>::max (),
+		 "polygon is too large for compact storage");
+  return static_cast<std::int32_t> (v - origin);
+}
+
+}  // namespace
+
+CompactPolygon::CompactPolygon ()
+  : m_originX (0),
+    m_originY (0)
+{
+}
+
+CompactPolygon::CompactPolygon (Polygon2d const& shape)
+  : m_originX (0),
+    m_originY (0)
+{
+  std::vector<Polygon2d::ring_type const*> rings {&shape.outer ()};
+  for (auto const& ring : shape.inners ())
+    {
+      rings.push_back (&ring);
+    }
+
+  std::vector<std::int64_t> xs;
+  std::vector<std::int64_t> ys;
+  std::vector<std::int32_t> ends;
+  for (auto ring : rings)
+    {
+      if (ring->size () < 2)
+	{
+	  continue;
+	}
+
+      std::size_t first = xs.size ();
+      for (auto const& p : *ring)
+	{
+	  xs.push_back (Quantize (p.x ()));
+	  ys.push_back (Quantize (p.y ()));
+	}
+
+      // close open rings
+      if (xs[first] != xs.back () || ys[first] != ys.back ())
+	{
+	  xs.push_back (xs[first]);
+	  ys.push_back (ys[first]);
+	}
+      ends.push_back (static_cast<std::int32_t> (xs.size ()));
+    }
+
+  if (xs.empty ())
+    {
+      return;
+    }
+
+  m_originX = *std::min_element (xs.begin (), xs.end ());
+  m_originY = *std::min_element (ys.begin (), ys.end ());
+
+  m_buffer.reserve (1 + ends.size () + 2 * xs.size ());
+  m_buffer.push_back (static_cast<std::int32_t> (ends.size ()));
+  m_buffer.insert (m_buffer.end (), ends.begin (), ends.end ());
+  for (auto x : xs)
+    {
+      m_buffer.push_back (MakeOffset (x, m_originX));
+    }
+  for (auto y : ys)
+    {
+      m_buffer.push_back (MakeOffset (y, m_originY));
+    }
+}
+
+template<typename Visitor>
+bool
+CompactPolygon::VisitEdges (Visitor visitor) const
+{
+  if (m_buffer.empty ())
+    {
+      return false;
+    }
+
+  std::size_t numRings = m_buffer[0];
+  const std::int32_t* ends = m_buffer.data () + 1;
+  std::size_t numVertices = ends[numRings - 1];
+  const std::int32_t* x = ends + numRings;
+  const std::int32_t* y = x + numVertices;
+
+  std::size_t start = 0;
+  for (std::size_t r = 0; r < numRings; ++r)
+    {
+      std::size_t end = ends[r];
+      for (std::size_t i = start; i + 1 < end; ++i)
+	{
+	  if (visitor (x[i], y[i], x[i + 1], y[i + 1]))
+	    {
+	      return true;
+	    }
+	}
+      start = end;
+    }
+  return false;
+}
+
+double
+CompactPolygon::ToGridX (double x) const
+{
+  return x / COMPACT_POLYGON_RESOLUTION - m_originX;
+}
+
+double
+CompactPolygon::ToGridY (double y) const
+{
+  return y / COMPACT_POLYGON_RESOLUTION - m_originY;
+}
+
+bool
+CompactPolygon::Intersects (LineSegment2d const& segment) const
+{
+  double px = ToGridX (segment.first.x ());
+  double py = ToGridY (segment.first.y ());
+  double qx = ToGridX (segment.second.x ());
+  double qy = ToGridY (segment.second.y ());
+
+  double minX = std::min (px, qx);
+  double maxX = std::max (px, qx);
+  double minY = std::min (py, qy);
+  double maxY = std::max (py, qy);
+  double dx = qx - px;
+  double dy = qy - py;
+
+  // same test as in FlatPolygon::IntersectsAnyEdge ()
+  bool crossesBorder = VisitEdges (
+      [px, py, qx, qy, minX, maxX, minY, maxY, dx, dy]
+      (double x0, double y0, double x1, double y1)
+      {
+	if (std::max (x0, x1) < minX || std::min (x0, x1) > maxX ||
+	    std::max (y0, y1) < minY || std::min (y0, y1) > maxY)
+	  {
+	    return false;
+	  }
+
+	double ex = x1 - x0;
+	double ey = y1 - y0;
+	double d1 = ex * (py - y0) - ey * (px - x0);
+	double d2 = ex * (qy - y0) - ey * (qx - x0);
+	double d3 = dx * (y0 - py) - dy * (x0 - px);
+	double d4 = dx * (y1 - py) - dy * (x1 - px);
+	return d1 * d2 <= 0 && d3 * d4 <= 0;
+      });
+
+  // without crossing the border, the segment is either completely
+  // inside or completely outside
+  return crossesBorder || Contains (segment.first);
+}
+
+bool
+CompactPolygon::Contains (Point2d const& p) const
+{
+  double px = ToGridX (p.x ());
+  double py = ToGridY (p.y ());
+
+  // even-odd rule, holes are handled by the edges of the inner rings
+  int crossings = 0;
+  VisitEdges (
+      [px, py, &crossings](double x0, double y0, double x1, double y1)
+      {
+	int straddles = (y0 > py) != (y1 > py);
+	int left = ((px - x0) * (y1 - y0) < (x1 - x0) * (py - y0)) == (y1 > y0);
+	crossings += straddles & left;
+	return false;
+      });
+
+  return (crossings & 1) != 0;
+}
+
+double
+CompactPolygon::GetDistance (Point2d const& p) const
+{
+  if (Contains (p))
+    {
+      return 0;
+    }
+
+  double px = ToGridX (p.x ());
+  double py = ToGridY (p.y ());
+
+  double minDistance2 = std::numeric_limits<double>::infinity ();
+  VisitEdges (
+      [px, py, &minDistance2](double x0, double y0, double x1, double y1)
+      {
+	double ex = x1 - x0;
+	double ey = y1 - y0;
+	double length2 = ex * ex + ey * ey;
+	double t = length2 > 0 ? ((px - x0) * ex + (py - y0) * ey) / length2 : 0;
+	t = std::min (1.0, std::max (0.0, t));
+	double dx = x0 + t * ex - px;
+	double dy = y0 + t * ey - py;
+	minDistance2 = std::min (minDistance2, dx * dx + dy * dy);
+	return false;
+      });
+
+  return std::sqrt (minDistance2) * COMPACT_POLYGON_RESOLUTION;
+}
+
+Polygon2d
+CompactPolygon::GetPolygon () const
+{
+  Polygon2d shape;
+  if (m_buffer.empty ())
+    {
+      return shape;
+    }
+
+  std::size_t numRings = m_buffer[0];
+  const std::int32_t* ends = m_buffer.data () + 1;
+  std::size_t numVertices = ends[numRings - 1];
+  const std::int32_t* x = ends + numRings;
+  const std::int32_t* y = x + numVertices;
+
+  shape.inners ().resize (numRings - 1);
+  std::size_t start = 0;
+  for (std::size_t r = 0; r < numRings; ++r)
+    {
+      auto& ring = r == 0 ? shape.outer () : shape.inners ()[r - 1];
+      std::size_t end = ends[r];
+      ring.reserve (end - start);
+      for (std::size_t i = start; i < end; ++i)
+	{
+	  ring.push_back (Point2d (
+	      static_cast<double> (m_originX + x[i]) * COMPACT_POLYGON_RESOLUTION,
+	      static_cast<double> (m_originY + y[i]) * COMPACT_POLYGON_RESOLUTION));
+	}
+      start = end;
+    }
+  return shape;
+}
+
+std::size_t
+CompactPolygon::GetNumEdges () const
+{
+  if (m_buffer.empty ())
+    {
+      return 0;
+    }
+
+  std::size_t numRings = m_buffer[0];
+  return m_buffer[numRings] - numRings;
+}
+
+bool
+CompactPolygon::IsEmpty () const
+{
+  return m_buffer.empty ();
+}
+
+}  // namespace gemv2
+}  // namespace ns3
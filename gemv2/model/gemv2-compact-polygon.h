@@ -0,0 +1,153 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GEMV2_COMPACT_POLYGON_H
+#define GEMV2_COMPACT_POLYGON_H
+
+#include <cstdint>
+#include <vector>
+
+#include <ns3/gemv2-geometry.h>
+
+namespace ns3 {
+namespace gemv2 {
+
+//! Grid spacing of the vertices of compact polygons [m]
+const double COMPACT_POLYGON_RESOLUTION = 1e-3;
+
+/*!
+ * @brief Polygon with quantized vertices in a single buffer.
+ *
+ * The vertices are rounded to a global grid with a spacing of
+ * COMPACT_POLYGON_RESOLUTION and stored as 32 bit offsets from the lower
+ * left corner of the polygon. Ring sizes and coordinates share one
+ * buffer, which needs 8 bytes per vertex instead of about 48 bytes for
+ * a Polygon2d with a FlatPolygon.
+ *
+ * Tests transform the query into the grid of the polygon instead of
+ * decoding the vertices. Since rounding to the global grid is
+ * idempotent, compacting the decoded polygon again gives the same result.
+ */
+class CompactPolygon
+{
+public:
+  /*!
+   * @brief Create polygon without vertices.
+   */
+  CompactPolygon ();
+
+  /*!
+   * @brief Create compact representation of a polygon.
+   *
+   * The polygon must not extend more than about 2000 km.
+   *
+   * @param shape	Polygon to convert
+   */
+  explicit CompactPolygon (Polygon2d const& shape);
+
+  /*!
+   * @brief Test if a line segment intersects with the polygon.
+   *
+   * This includes segments touching the border and segments completely
+   * inside of the polygon.
+   *
+   * @param segment	Segment to test
+   * @return True if @a segment and the polygon share at least one point
+   */
+  bool
+  Intersects (LineSegment2d const& segment) const;
+
+  /*!
+   * @brief Test if a point is inside the polygon.
+   *
+   * Points on the border might be reported as inside or outside.
+   *
+   * @param p	Point to test
+   * @return True if @a p is inside of the polygon
+   */
+  bool
+  Contains (Point2d const& p) const;
+
+  /*!
+   * @brief Get the distance of a point to the polygon.
+   * @param p	Point to calculate the distance for
+   * @return Distance to the closest edge, 0 if @a p is inside
+   */
+  double
+  GetDistance (Point2d const& p) const;
+
+  /*!
+   * @brief Decode the polygon.
+   * @return Polygon with the rounded vertices, closed rings
+   */
+  Polygon2d
+  GetPolygon () const;
+
+  /*!
+   * @brief Get the number of edges.
+   * @return Number of edges of all rings
+   */
+  std::size_t
+  GetNumEdges () const;
+
+  /*!
+   * @brief Check if the polygon has no vertices.
+   * @return True if created with the default constructor
+   */
+  bool
+  IsEmpty () const;
+
+private:
+
+  /*!
+   * @brief Visit all edges in grid coordinates.
+   * @param visitor	Called with start x, start y, end x and end y of each
+   *			edge, stops the iteration by returning true
+   * @return True if the visitor stopped the iteration
+   */
+  template<typename Visitor>
+  bool
+  VisitEdges (Visitor visitor) const;
+
+  //! X coordinate of a point in the grid of the polygon
+  double
+  ToGridX (double x) const;
+
+  //! Y coordinate of a point in the grid of the polygon
+  double
+  ToGridY (double y) const;
+
+  //! Lower left corner in multiples of the resolution
+  std::int64_t m_originX;
+
+  //! Lower left corner in multiples of the resolution
+  std::int64_t m_originY;
+
+  /*!
+   * @brief Rings and vertices.
+   *
+   * Number of rings, end of each ring (exclusive), x offsets of all
+   * vertices and y offsets of all vertices. Rings are closed explicitly,
+   * the outer ring comes first.
+   */
+  std::vector<std::int32_t> m_buffer;
+};
+
+}  // namespace gemv2
+}  // namespace ns3
+
+#endif /* GEMV2_COMPACT_POLYGON_H */
@@ -0,0 +1,324 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "gemv2-convex-part-index.h"
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+
+#include <boost/geometry/index/rtree.hpp>
+#include <boost/function_output_iterator.hpp>
+
+#include <ns3/log.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("Gemv2ConvexPartIndex");
+
+namespace gemv2 {
+
+double
+GetShapeDistance (const Point2d& p, const ConvexParts& parts)
+{
+  if (parts.undecomposed)
+    {
+      return parts.undecomposed->GetDistance (p);
+    }
+
+  double distance = std::numeric_limits<double>::infinity ();
+  for (auto part = parts.begin; part != parts.end && distance > 0; ++part)
+    {
+      distance = std::min (distance, part->GetDistance (p));
+    }
+  return distance;
+}
+
+/*
+ * Index data structures
+ */
+struct ConvexPartIndex::Data
+{
+  //! A single part or an undecomposed building
+  struct Part
+  {
+    //! Box around the part
+    Box2d box;
+    //! Index of the part in @a polygons, only valid for decomposed buildings
+    std::size_t polygon;
+    //! Building the part belongs to
+    Ptr<Building> building;
+  };
+
+  //! Access to the box of a part
+  struct PartIndexable
+  {
+    using result_type = Box2d const&;	// required for rtree
+    result_type operator()(Part const& p) const { return p.box; }
+  };
+
+  //! Compare parts by building and index, required for rtree
+  struct PartEqual
+  {
+    bool
+    operator()(Part const& a, Part const& b) const
+    {
+      return a.building == b.building && a.polygon == b.polygon;
+    }
+  };
+
+  /*!
+   * @brief Type of the part tree
+   *
+   * The tree is built with the packing algorithm, buildings added or
+   * removed later (e.g. with tiles) are updated in place.
+   */
+  using PartTree =
+      boost::geometry::index::rtree<
+      Part, boost::geometry::index::rstar<16>, PartIndexable, PartEqual>;
+
+  //! Marks parts of undecomposed buildings
+  static const std::size_t UNDECOMPOSED = std::numeric_limits<std::size_t>::max ();
+
+  //! All parts
+  PartTree parts;
+
+  //! Convex parts of all buildings, grouped by building
+  std::vector<ConvexPolygon> polygons;
+
+  //! Range of the parts of each building in @a polygons
+  std::unordered_map<const Building*, std::pair<std::size_t, std::size_t>> ranges;
+
+  //! Number of polygons in @a polygons belonging to removed buildings
+  std::size_t removedPolygons = 0;
+
+  /*!
+   * @brief Split buildings into parts.
+   * @param buildings	Buildings to split
+   * @param parts	The parts are added here
+   * @return Number of buildings which could not be decomposed
+   */
+  std::size_t
+  AddParts (const std::vector<Ptr<Building>>& buildings, std::vector<Part>& parts)
+  {
+    std::size_t undecomposed = 0;
+    std::vector<Polygon2d> shapes;
+    for (auto const& b : buildings)
+      {
+	shapes.clear ();
+	if (!DecomposeConvex (b->DecodeShape (), shapes))
+	  {
+	    // keep the building as a whole
+	    parts.push_back (Part {b->GetBoundingBox (), UNDECOMPOSED, b});
+	    ++undecomposed;
+	    continue;
+	  }
+
+	std::size_t first = polygons.size ();
+	for (auto const& shape : shapes)
+	  {
+	    polygons.emplace_back (shape);
+	    parts.push_back (Part {polygons.back ().GetBoundingBox (),
+				   polygons.size () - 1, b});
+	  }
+	ranges[PeekPointer (b)] = std::make_pair (first, polygons.size ());
+      }
+    return undecomposed;
+  }
+
+  //! Drop the polygons of removed buildings and renumber the parts
+  void
+  Compact ()
+  {
+    std::vector<ConvexPolygon> kept;
+    kept.reserve (polygons.size () - removedPolygons);
+    std::unordered_map<const Building*, std::pair<std::size_t, std::size_t>> renumbered;
+    for (auto& range : ranges)
+      {
+	std::size_t first = kept.size ();
+	kept.insert (kept.end (), polygons.begin () + range.second.first,
+		     polygons.begin () + range.second.second);
+	renumbered[range.first] = std::make_pair (range.second.first, first);
+	range.second = std::make_pair (first, kept.size ());
+      }
+
+    std::vector<Part> keptParts (parts.begin (), parts.end ());
+    for (auto& part : keptParts)
+      {
+	if (part.polygon != UNDECOMPOSED)
+	  {
+	    auto const& first = renumbered.at (PeekPointer (part.building));
+	    part.polygon = part.polygon - first.first + first.second;
+	  }
+      }
+
+    PartTree packed (keptParts.begin (), keptParts.end ());
+    parts.swap (packed);
+    polygons.swap (kept);
+    removedPolygons = 0;
+  }
+
+  //! Test if a part intersects with a line
+  bool
+  Intersects (const Part& part, const LineSegment2d& line) const
+  {
+    if (part.polygon == UNDECOMPOSED)
+      {
+	return part.building->Intersects (line);
+      }
+    return polygons[part.polygon].Intersects (line);
+  }
+
+  /*!
+   * @brief Check if a part is the first of its building hit by a line.
+   *
+   * The part itself has to intersect with @a line.
+   */
+  bool
+  IsFirstHit (const Part& part, const LineSegment2d& line) const
+  {
+    if (part.polygon == UNDECOMPOSED)
+      {
+	return true;
+      }
+
+    auto const& range = ranges.at (PeekPointer (part.building));
+    for (std::size_t i = range.first; i < part.polygon; ++i)
+      {
+	if (polygons[i].Intersects (line))
+	  {
+	    return false;
+	  }
+      }
+    return true;
+  }
+};
+
+ConvexPartIndex::ConvexPartIndex ()
+  : m_data (new Data)
+{
+}
+
+ConvexPartIndex::~ConvexPartIndex () = default;
+
+void
+ConvexPartIndex::Build (const std::vector<Ptr<Building>>& buildings)
+{
+  Clear ();
+
+  std::vector<Data::Part> parts;
+  auto undecomposed = m_data->AddParts (buildings, parts);
+
+  NS_LOG_INFO ("Split " << buildings.size () << " buildings into "
+	       << m_data->polygons.size () << " convex parts (" << undecomposed
+	       << " buildings not decomposed)");
+
+  Data::PartTree packed (parts.begin (), parts.end ());
+  m_data->parts.swap (packed);
+}
+
+void
+ConvexPartIndex::Insert (const std::vector<Ptr<Building>>& buildings)
+{
+  std::vector<Data::Part> parts;
+  m_data->AddParts (buildings, parts);
+  m_data->parts.insert (parts.begin (), parts.end ());
+}
+
+void
+ConvexPartIndex::Remove (const std::vector<Ptr<Building>>& buildings)
+{
+  auto& data = *m_data;
+  for (auto const& b : buildings)
+    {
+      auto it = data.ranges.find (PeekPointer (b));
+      if (it == data.ranges.end ())
+	{
+	  data.parts.remove (Data::Part {b->GetBoundingBox (), Data::UNDECOMPOSED, b});
+	  continue;
+	}
+
+      for (std::size_t i = it->second.first; i < it->second.second; ++i)
+	{
+	  data.parts.remove (Data::Part {data.polygons[i].GetBoundingBox (), i, b});
+	}
+      data.removedPolygons += it->second.second - it->second.first;
+      data.ranges.erase (it);
+    }
+
+  if (data.removedPolygons > data.polygons.size () / 2)
+    {
+      data.Compact ();
+    }
+}
+
+void
+ConvexPartIndex::Clear ()
+{
+  m_data->parts.clear ();
+  m_data->polygons.clear ();
+  m_data->ranges.clear ();
+  m_data->removedPolygons = 0;
+}
+
+std::size_t
+ConvexPartIndex::GetNumParts () const
+{
+  return m_data->polygons.size ();
+}
+
+bool
+ConvexPartIndex::IntersectsAny (const LineSegment2d& line) const
+{
+  return m_data->parts.qbegin (
+      boost::geometry::index::intersects (line) &&
+      boost::geometry::index::satisfies (
+	  [this, &line](const Data::Part& p)
+	  { return m_data->Intersects (p, line); })
+      ) != m_data->parts.qend ();
+}
+
+void
+ConvexPartIndex::Intersect (const LineSegment2d& line,
+			    const BuildingVisitor& visitor) const
+{
+  // report each building only for the first of its parts hit by the line
+  m_data->parts.query (
+      boost::geometry::index::intersects (line) &&
+      boost::geometry::index::satisfies (
+	  [this, &line](const Data::Part& p)
+	  { return m_data->Intersects (p, line) && m_data->IsFirstHit (p, line); }),
+      boost::make_function_output_iterator (
+	  [&visitor](const Data::Part& p) { visitor (p.building); }));
+}
+
+ConvexParts
+ConvexPartIndex::GetParts (const Building& building) const
+{
+  auto it = m_data->ranges.find (&building);
+  if (it == m_data->ranges.end ())
+    {
+      return ConvexParts {nullptr, nullptr, &building};
+    }
+
+  const ConvexPolygon* polygons = m_data->polygons.data ();
+  return ConvexParts {polygons + it->second.first, polygons + it->second.second, nullptr};
+}
+
+}  // namespace gemv2
+}  // namespace ns3
@@ -0,0 +1,164 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GEMV2_CONVEX_PART_INDEX_H
+#define GEMV2_CONVEX_PART_INDEX_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <ns3/ptr.h>
+
+#include <ns3/gemv2-geometry.h>
+#include <ns3/gemv2-building.h>
+#include <ns3/gemv2-convex-polygon.h>
+
+namespace ns3 {
+namespace gemv2 {
+
+/*!
+ * @brief The convex parts of a single building.
+ *
+ * Buildings that could not be decomposed have no parts, their shape is
+ * used directly instead.
+ */
+struct ConvexParts
+{
+  //! First part of the building
+  const ConvexPolygon* begin;
+  //! Behind the last part of the building
+  const ConvexPolygon* end;
+  //! Building without parts, null if the building has been decomposed
+  const Building* undecomposed;
+};
+
+/*!
+ * @brief Get the distance of a point to a decomposed building.
+ *
+ * Overload of GetShapeDistance() used by FindObjectsInEllipse().
+ *
+ * @param p	Point to calculate the distance for
+ * @param parts	Parts of the building
+ * @return Distance to the closest part
+ */
+double
+GetShapeDistance (const Point2d& p, const ConvexParts& parts);
+
+/*!
+ * @brief Spatial index of the convex parts of buildings.
+ *
+ * Each building is split into convex parts (see DecomposeConvex()), which
+ * are indexed with their own bounding boxes. Line tests only look at the
+ * parts close to the line and need neither a crossing test for every
+ * edge nor a point in polygon test. The parts keep a reference to their
+ * building, area and permittivity are still taken from the building.
+ */
+class ConvexPartIndex
+{
+public:
+  //! Callback for buildings found by a query
+  using BuildingVisitor = std::function<void (const Ptr<Building>&)>;
+
+  /*!
+   * @brief Create empty index.
+   */
+  ConvexPartIndex ();
+
+  ~ConvexPartIndex ();
+
+  /*!
+   * @brief Replace the content of the index with the parts of @a buildings.
+   * @param buildings	Buildings to index
+   */
+  void
+  Build (const std::vector<Ptr<Building>>& buildings);
+
+  /*!
+   * @brief Add the parts of buildings to the index.
+   *
+   * The parts are inserted one by one, so queries are slightly slower
+   * than after Build().
+   *
+   * @param buildings	Buildings to add, must not be indexed yet
+   */
+  void
+  Insert (const std::vector<Ptr<Building>>& buildings);
+
+  /*!
+   * @brief Remove the parts of buildings from the index.
+   *
+   * The storage of the removed parts is reclaimed once they make up
+   * more than half of all stored parts.
+   *
+   * @param buildings	Buildings added with Build() or Insert() before
+   */
+  void
+  Remove (const std::vector<Ptr<Building>>& buildings);
+
+  /*!
+   * @brief Remove all parts.
+   */
+  void
+  Clear ();
+
+  /*!
+   * @brief Get the number of indexed convex parts.
+   * @return Number of parts of all decomposed buildings
+   */
+  std::size_t
+  GetNumParts () const;
+
+  /*!
+   * @brief Test if a line intersects with any building.
+   * @param line	Line to test
+   * @return True if @a line intersects at least one part
+   */
+  bool
+  IntersectsAny (const LineSegment2d& line) const;
+
+  /*!
+   * @brief Visit all buildings intersecting with a line.
+   *
+   * Each building is visited once, even if several of its parts are hit.
+   *
+   * @param line	Line to test
+   * @param visitor	Called for each building intersecting with @a line
+   */
+  void
+  Intersect (const LineSegment2d& line, const BuildingVisitor& visitor) const;
+
+  /*!
+   * @brief Get the parts of a building.
+   * @param building	Indexed building
+   * @return Parts of @a building, no parts if it is not indexed
+   */
+  ConvexParts
+  GetParts (const Building& building) const;
+
+private:
+  // Index data structures
+  struct Data;
+
+  //! Internal data structures moved to the implementation file.
+  std::unique_ptr<Data> m_data;
+};
+
+}  // namespace gemv2
+}  // namespace ns3
+
+#endif /* GEMV2_CONVEX_PART_INDEX_H */
@@ -0,0 +1,556 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "gemv2-convex-polygon.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <numeric>
+
+#include <ns3/gemv2-wall-index.h>
+
+namespace ns3 {
+namespace gemv2 {
+
+namespace {
+
+/*!
+ * @brief Relative tolerance for the turn at a vertex.
+ *
+ * Vertices with a smaller turn are treated as straight, i.e. they are
+ * neither ears nor do they prevent merging two parts.
+ */
+const double TURN_TOLERANCE = 1e-9;
+
+//! Ring of a decomposition, indexes into the vertex table, counter-clockwise
+using IndexRing = std::vector<std::size_t>;
+
+//! Turn at @a b on the way from @a a to @a c, positive for left turns
+double
+Turn (const Point2d& a, const Point2d& b, const Point2d& c)
+{
+  return (b.x () - a.x ()) * (c.y () - b.y ()) -
+      (b.y () - a.y ()) * (c.x () - b.x ());
+}
+
+//! Check if the turn at @a b is a left turn, straight within the tolerance
+bool
+IsConvex (const Point2d& a, const Point2d& b, const Point2d& c)
+{
+  double scale = boost::geometry::distance (a, b) * boost::geometry::distance (b, c);
+  return Turn (a, b, c) >= -TURN_TOLERANCE * scale;
+}
+
+//! Check if @a p is inside the counter-clockwise triangle or on its border
+bool
+InTriangle (const Point2d& p, const Point2d& a, const Point2d& b, const Point2d& c)
+{
+  return Turn (a, b, p) >= 0 && Turn (b, c, p) >= 0 && Turn (c, a, p) >= 0;
+}
+
+/*!
+ * @brief Add a ring to the vertex table.
+ * @param ring		Closed boost ring
+ * @param points	Vertex table
+ * @param ccw		True to store the ring counter-clockwise
+ * @return Indexes of the ring, not closed
+ */
+IndexRing
+AddRing (const Polygon2d::ring_type& ring, std::vector<Point2d>& points, bool ccw)
+{
+  IndexRing indexes;
+  for (std::size_t i = 0; i + 1 < ring.size (); ++i)
+    {
+      indexes.push_back (points.size ());
+      points.push_back (ring[i]);
+    }
+  if ((boost::geometry::area (ring) < 0) != ccw)
+    {
+      std::reverse (indexes.begin (), indexes.end ());
+    }
+  return indexes;
+}
+
+/*!
+ * @brief Connect a hole to the outer ring with a bridge edge.
+ *
+ * The bridge starts at the hole vertex with the largest x coordinate and
+ * ends at the closest vertex of the outer ring that can be reached without
+ * touching any other edge. The bridge is walked in both directions, so
+ * the result is a single ring again.
+ *
+ * @param outer		Outer ring, counter-clockwise
+ * @param hole		Hole, clockwise
+ * @param others	Holes not connected yet
+ * @param points	Vertex table
+ * @return False if no bridge could be found
+ */
+bool
+BridgeHole (IndexRing& outer, const IndexRing& hole,
+	    const std::vector<IndexRing>& others, const std::vector<Point2d>& points)
+{
+  std::size_t m = 0;
+  for (std::size_t i = 1; i < hole.size (); ++i)
+    {
+      if (points[hole[i]].x () > points[hole[m]].x ())
+	{
+	  m = i;
+	}
+    }
+  const Point2d& start = points[hole[m]];
+
+  std::vector<std::size_t> candidates (outer.size ());
+  std::iota (candidates.begin (), candidates.end (), 0);
+  std::sort (candidates.begin (), candidates.end (),
+	     [&](std::size_t a, std::size_t b)
+	     {
+	       return boost::geometry::comparable_distance (start, points[outer[a]]) <
+		   boost::geometry::comparable_distance (start, points[outer[b]]);
+	     });
+
+  auto blocks = [&points](const IndexRing& ring, const LineSegment2d& bridge,
+			  std::size_t from, std::size_t to)
+  {
+    for (std::size_t i = 0; i < ring.size (); ++i)
+      {
+	std::size_t a = ring[i];
+	std::size_t b = ring[(i + 1) % ring.size ()];
+	if (a == from || b == from || a == to || b == to)
+	  {
+	    continue;
+	  }
+	if (SegmentsIntersect (bridge, LineSegment2d (points[a], points[b])))
+	  {
+	    return true;
+	  }
+      }
+    return false;
+  };
+
+  for (auto candidate : candidates)
+    {
+      std::size_t to = outer[candidate];
+      LineSegment2d bridge (start, points[to]);
+      if (blocks (outer, bridge, hole[m], to) || blocks (hole, bridge, hole[m], to) ||
+	  std::any_of (others.begin (), others.end (),
+		       [&](const IndexRing& other)
+		       { return blocks (other, bridge, hole[m], to); }))
+	{
+	  continue;
+	}
+
+      // ..., to, hole from m around to m, to, ...
+      IndexRing bridged (outer.begin (), outer.begin () + candidate + 1);
+      for (std::size_t i = 0; i <= hole.size (); ++i)
+	{
+	  bridged.push_back (hole[(m + i) % hole.size ()]);
+	}
+      bridged.insert (bridged.end (), outer.begin () + candidate, outer.end ());
+      outer.swap (bridged);
+      return true;
+    }
+
+  return false;
+}
+
+/*!
+ * @brief Split a counter-clockwise ring into triangles by ear clipping.
+ * @param ring		Ring to split
+ * @param points	Vertex table
+ * @param triangles	Triangles are added here
+ * @return False if no ear could be found
+ */
+bool
+Triangulate (IndexRing ring, const std::vector<Point2d>& points,
+	     std::vector<IndexRing>& triangles)
+{
+  while (ring.size () > 3)
+    {
+      std::size_t n = ring.size ();
+      bool clipped = false;
+      for (std::size_t i = 0; i < n && !clipped; ++i)
+	{
+	  const Point2d& a = points[ring[(i + n - 1) % n]];
+	  const Point2d& b = points[ring[i]];
+	  const Point2d& c = points[ring[(i + 1) % n]];
+	  if (Turn (a, b, c) <= 0)
+	    {
+	      continue;
+	    }
+
+	  // no other vertex may be in the ear, bridge vertices appear twice
+	  bool ear = true;
+	  for (std::size_t j = 0; j < n && ear; ++j)
+	    {
+	      const Point2d& p = points[ring[j]];
+	      if (!boost::geometry::equals (p, a) && !boost::geometry::equals (p, b) &&
+		  !boost::geometry::equals (p, c) && InTriangle (p, a, b, c))
+		{
+		  ear = false;
+		}
+	    }
+
+	  if (ear)
+	    {
+	      triangles.push_back ({ring[(i + n - 1) % n], ring[i], ring[(i + 1) % n]});
+	      ring.erase (ring.begin () + i);
+	      clipped = true;
+	    }
+	}
+
+      if (!clipped)
+	{
+	  // drop a straight vertex, e.g. a collinear point or a spike
+	  for (std::size_t i = 0; i < n && !clipped; ++i)
+	    {
+	      const Point2d& a = points[ring[(i + n - 1) % n]];
+	      const Point2d& b = points[ring[i]];
+	      const Point2d& c = points[ring[(i + 1) % n]];
+	      if (std::abs (Turn (a, b, c)) <= TURN_TOLERANCE *
+		  boost::geometry::distance (a, b) * boost::geometry::distance (b, c))
+		{
+		  ring.erase (ring.begin () + i);
+		  clipped = true;
+		}
+	    }
+	}
+
+      if (!clipped)
+	{
+	  return false;
+	}
+    }
+
+  if (ring.size () == 3 &&
+      Turn (points[ring[0]], points[ring[1]], points[ring[2]]) > 0)
+    {
+      triangles.push_back (ring);
+    }
+  return true;
+}
+
+/*!
+ * @brief Merge two parts along a common edge if the result stays convex.
+ * @param a		First part, contains the edge from @a u to @a v
+ * @param b		Second part, contains the edge from @a v to @a u
+ * @param ia		Position of @a u in @a a
+ * @param ib		Position of @a v in @a b
+ * @param points	Vertex table
+ * @param merged	The merged part if the function returns true
+ * @return True if the merged part is convex
+ */
+bool
+MergeParts (const IndexRing& a, const IndexRing& b, std::size_t ia, std::size_t ib,
+	    const std::vector<Point2d>& points, IndexRing& merged)
+{
+  // walk a from v around to u, then b from u around to v without the ends
+  merged.clear ();
+  for (std::size_t i = 1; i <= a.size (); ++i)
+    {
+      merged.push_back (a[(ia + i) % a.size ()]);
+    }
+  for (std::size_t i = 2; i < b.size (); ++i)
+    {
+      merged.push_back (b[(ib + i) % b.size ()]);
+    }
+
+  // only the turns at the ends of the removed edge change
+  std::size_t n = merged.size ();
+  std::size_t u = a.size () - 1;
+  for (std::size_t i : {std::size_t (0), u})
+    {
+      if (!IsConvex (points[merged[(i + n - 1) % n]], points[merged[i]],
+		     points[merged[(i + 1) % n]]))
+	{
+	  return false;
+	}
+    }
+  return true;
+}
+
+}  // namespace
+
+ConvexPolygon::ConvexPolygon ()
+{
+}
+
+ConvexPolygon::ConvexPolygon (Polygon2d const& shape)
+{
+  auto const& ring = shape.outer ();
+  std::size_t n = ring.size ();
+  if (n > 1 && boost::geometry::equals (ring.front (), ring.back ()))
+    {
+      --n;
+    }
+
+  m_x.reserve (n);
+  m_y.reserve (n);
+  for (std::size_t i = 0; i < n; ++i)
+    {
+      m_x.push_back (ring[i].x ());
+      m_y.push_back (ring[i].y ());
+    }
+
+  // boost rings are clockwise by default
+  if (boost::geometry::area (ring) > 0)
+    {
+      std::reverse (m_x.begin (), m_x.end ());
+      std::reverse (m_y.begin (), m_y.end ());
+    }
+}
+
+bool
+ConvexPolygon::Intersects (LineSegment2d const& segment) const
+{
+  std::size_t n = m_x.size ();
+  if (n == 0)
+    {
+      return false;
+    }
+
+  double px = segment.first.x ();
+  double py = segment.first.y ();
+  double dx = segment.second.x () - px;
+  double dy = segment.second.y () - py;
+
+  // clip the parameter range [0, 1] of the segment against all edges
+  double enter = 0;
+  double leave = 1;
+  for (std::size_t i = 0, j = n - 1; i < n; j = i++)
+    {
+      double ex = m_x[i] - m_x[j];
+      double ey = m_y[i] - m_y[j];
+
+      // points left of the edge are inside
+      double side = ex * (py - m_y[j]) - ey * (px - m_x[j]);
+      double slope = ex * dy - ey * dx;
+      if (slope == 0)
+	{
+	  if (side < 0)
+	    {
+	      return false;
+	    }
+	  continue;
+	}
+
+      double t = -side / slope;
+      if (slope > 0)
+	{
+	  enter = std::max (enter, t);
+	}
+      else
+	{
+	  leave = std::min (leave, t);
+	}
+      if (enter > leave)
+	{
+	  return false;
+	}
+    }
+
+  return true;
+}
+
+bool
+ConvexPolygon::Contains (Point2d const& p) const
+{
+  std::size_t n = m_x.size ();
+  if (n == 0)
+    {
+      return false;
+    }
+
+  double px = p.x ();
+  double py = p.y ();
+
+  int outside = 0;
+  for (std::size_t i = 0, j = n - 1; i < n; j = i++)
+    {
+      outside |= (m_x[i] - m_x[j]) * (py - m_y[j]) <
+	  (m_y[i] - m_y[j]) * (px - m_x[j]);
+    }
+  return !outside;
+}
+
+double
+ConvexPolygon::GetDistance (Point2d const& p) const
+{
+  std::size_t n = m_x.size ();
+  if (n == 0)
+    {
+      return std::numeric_limits<double>::infinity ();
+    }
+  if (Contains (p))
+    {
+      return 0;
+    }
+
+  double px = p.x ();
+  double py = p.y ();
+
+  double minDistance2 = std::numeric_limits<double>::infinity ();
+  for (std::size_t i = 0, j = n - 1; i < n; j = i++)
+    {
+      double ex = m_x[i] - m_x[j];
+      double ey = m_y[i] - m_y[j];
+      double wx = px - m_x[j];
+      double wy = py - m_y[j];
+
+      // closest point on the edge
+      double length2 = ex * ex + ey * ey;
+      double t = length2 > 0 ? (wx * ex + wy * ey) / length2 : 0;
+      t = std::min (std::max (t, 0.0), 1.0);
+      double cx = wx - t * ex;
+      double cy = wy - t * ey;
+      minDistance2 = std::min (minDistance2, cx * cx + cy * cy);
+    }
+
+  return std::sqrt (minDistance2);
+}
+
+Box2d
+ConvexPolygon::GetBoundingBox () const
+{
+  Box2d box;
+  boost::geometry::assign_inverse (box);
+  for (std::size_t i = 0; i < m_x.size (); ++i)
+    {
+      boost::geometry::expand (box, Point2d (m_x[i], m_y[i]));
+    }
+  return box;
+}
+
+std::size_t
+ConvexPolygon::GetNumVertices () const
+{
+  return m_x.size ();
+}
+
+bool
+DecomposeConvex (Polygon2d const& polygon, std::vector<Polygon2d>& parts)
+{
+  Polygon2d corrected = polygon;
+  boost::geometry::correct (corrected);
+  if (!boost::geometry::is_valid (corrected))
+    {
+      return false;
+    }
+
+  // single counter-clockwise ring with all holes bridged to the outside
+  std::vector<Point2d> points;
+  auto ring = AddRing (corrected.outer (), points, true);
+  std::vector<IndexRing> holes;
+  for (auto const& inner : corrected.inners ())
+    {
+      holes.push_back (AddRing (inner, points, false));
+    }
+  while (!holes.empty ())
+    {
+      auto hole = std::move (holes.back ());
+      holes.pop_back ();
+      if (!BridgeHole (ring, hole, holes, points))
+	{
+	  return false;
+	}
+    }
+
+  std::vector<IndexRing> convex;
+  if (!Triangulate (ring, points, convex))
+    {
+      return false;
+    }
+
+  // Hertel-Mehlhorn: remove the diagonals between the triangles as long
+  // as the merged parts stay convex
+  std::map<std::pair<std::size_t, std::size_t>, std::size_t> owners;
+  for (std::size_t i = 0; i < convex.size (); ++i)
+    {
+      for (std::size_t j = 0; j < 3; ++j)
+	{
+	  owners[std::make_pair (convex[i][j], convex[i][(j + 1) % 3])] = i;
+	}
+    }
+
+  std::vector<bool> removed (convex.size (), false);
+  std::vector<std::pair<std::size_t, std::size_t>> diagonals;
+  for (auto const& edge : owners)
+    {
+      if (edge.first.first < edge.first.second &&
+	  owners.count (std::make_pair (edge.first.second, edge.first.first)))
+	{
+	  diagonals.push_back (edge.first);
+	}
+    }
+
+  IndexRing merged;
+  for (auto const& diagonal : diagonals)
+    {
+      std::size_t pa = owners[diagonal];
+      std::size_t pb = owners[std::make_pair (diagonal.second, diagonal.first)];
+      if (pa == pb)
+	{
+	  continue;
+	}
+
+      auto const& a = convex[pa];
+      auto const& b = convex[pb];
+      std::size_t ia = std::find (a.begin (), a.end (), diagonal.first) - a.begin ();
+      std::size_t ib = std::find (b.begin (), b.end (), diagonal.second) - b.begin ();
+      // bridge vertices appear twice, make sure the edge follows
+      while (a[(ia + 1) % a.size ()] != diagonal.second)
+	{
+	  ia = std::find (a.begin () + ia + 1, a.end (), diagonal.first) - a.begin ();
+	}
+      while (b[(ib + 1) % b.size ()] != diagonal.first)
+	{
+	  ib = std::find (b.begin () + ib + 1, b.end (), diagonal.second) - b.begin ();
+	}
+
+      if (MergeParts (a, b, ia, ib, points, merged))
+	{
+	  for (std::size_t i = 0; i < b.size (); ++i)
+	    {
+	      owners[std::make_pair (b[i], b[(i + 1) % b.size ()])] = pa;
+	    }
+	  convex[pa].swap (merged);
+	  removed[pb] = true;
+	}
+    }
+
+  for (std::size_t i = 0; i < convex.size (); ++i)
+    {
+      if (removed[i])
+	{
+	  continue;
+	}
+      auto const& part = convex[i];
+      Polygon2d p;
+      for (auto i : part)
+	{
+	  p.outer ().push_back (points[i]);
+	}
+      p.outer ().push_back (points[part.front ()]);
+      boost::geometry::correct (p);
+      parts.push_back (std::move (p));
+    }
+  return true;
+}
+
+}  // namespace gemv2
+}  // namespace ns3
@@ -0,0 +1,125 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GEMV2_CONVEX_POLYGON_H
+#define GEMV2_CONVEX_POLYGON_H
+
+#include <vector>
+
+#include <ns3/gemv2-geometry.h>
+
+namespace ns3 {
+namespace gemv2 {
+
+/*!
+ * @brief Convex polygon for cheap line and distance tests.
+ *
+ * The vertices are stored counter-clockwise in two flat arrays. Since the
+ * polygon is convex, a point is inside if it is left of all edges, and a
+ * segment can be clipped against the edges in a single pass without
+ * testing for crossings.
+ */
+class ConvexPolygon
+{
+public:
+  /*!
+   * @brief Create polygon without vertices.
+   */
+  ConvexPolygon ();
+
+  /*!
+   * @brief Create from the outer ring of a convex polygon.
+   *
+   * The orientation of @a shape does not matter, inner rings are ignored.
+   * The result is undefined if @a shape is not convex.
+   *
+   * @param shape	Convex polygon to convert
+   */
+  explicit ConvexPolygon (Polygon2d const& shape);
+
+  /*!
+   * @brief Test if a line segment intersects with the polygon.
+   *
+   * This includes segments touching the border and segments completely
+   * inside of the polygon.
+   *
+   * @param segment	Segment to test
+   * @return True if @a segment and the polygon share at least one point
+   */
+  bool
+  Intersects (LineSegment2d const& segment) const;
+
+  /*!
+   * @brief Test if a point is inside the polygon or on its border.
+   * @param p	Point to test
+   * @return True if @a p is not outside of the polygon
+   */
+  bool
+  Contains (Point2d const& p) const;
+
+  /*!
+   * @brief Get the distance of a point to the polygon.
+   * @param p	Point to calculate the distance for
+   * @return Distance to the closest point of the polygon, 0 if
+   *	     @a p is inside
+   */
+  double
+  GetDistance (Point2d const& p) const;
+
+  /*!
+   * @brief Get the bounding box of the polygon.
+   * @return Box around all vertices
+   */
+  Box2d
+  GetBoundingBox () const;
+
+  /*!
+   * @brief Get the number of vertices.
+   * @return Number of vertices (the ring is not closed explicitly)
+   */
+  std::size_t
+  GetNumVertices () const;
+
+private:
+  //! X coordinates of the vertices, counter-clockwise
+  std::vector<double> m_x;
+
+  //! Y coordinates of the vertices, counter-clockwise
+  std::vector<double> m_y;
+};
+
+/*!
+ * @brief Split a polygon into convex parts.
+ *
+ * Holes are connected to the outer ring, the resulting ring is split
+ * into triangles by ear clipping, and neighboring triangles are merged
+ * as long as the result stays convex (Hertel-Mehlhorn). The parts only
+ * use the original vertices. Their number is at most four times the
+ * minimum, which is good enough for building footprints.
+ *
+ * @param polygon	Polygon to split
+ * @param parts		The convex parts are added here
+ * @return False if the polygon could not be split, e.g. because it is
+ *	   not valid. No parts are added in this case.
+ */
+bool
+DecomposeConvex (Polygon2d const& polygon, std::vector<Polygon2d>& parts);
+
+}  // namespace gemv2
+}  // namespace ns3
+
+#endif /* GEMV2_CONVEX_POLYGON_H */
@@ -18,16 +18,71 @@
 #include "gemv2-environment.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <boost/geometry/index/rtree.hpp>
+#include <boost/geometry/index/detail/rtree/utilities/statistics.hpp>
 #include <boost/geometry/io/wkt/wkt.hpp>
 #include <boost/function_output_iterator.hpp>
 
 #include <ns3/log.h>
+#include <ns3/abort.h>
 #include <ns3/assert.h>
 #include <ns3/simulator.h>
+#include <ns3/mobility-model.h>
 
+#include <ns3/gemv2-aggregate-tree.h>
 #include <ns3/gemv2-rtree-queries.h>
+#include <ns3/gemv2-spatial-grid.h>
+#include <ns3/gemv2-static-layer-file.h>
+#include <ns3/gemv2-vehicle-store.h>
+
+namespace {
+
+//! Wall clock time elapsed since @a start in seconds
+double
+ElapsedSeconds (std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double> (
+      std::chrono::steady_clock::now () - start).count ();
+}
+
+/*!
+ * @brief Collect the statistics of a tree.
+ * @param tree			Tree to analyze
+ * @param constructionTime	Time spent constructing the tree [s]
+ * @return Statistics of @a tree
+ */
+template<typename TreeType>
+ns3::gemv2::Environment::TreeStatistics
+MakeTreeStatistics (const TreeType& tree, double constructionTime)
+{
+  auto stats =
+      boost::geometry::index::detail::rtree::utilities::statistics (tree);
+
+  ns3::gemv2::Environment::TreeStatistics result;
+  result.levels = boost::get<0> (stats);
+  result.nodes = boost::get<1> (stats);
+  result.leaves = boost::get<2> (stats);
+  result.objects = boost::get<3> (stats);
+  result.minObjectsPerLeaf = boost::get<4> (stats);
+  result.maxObjectsPerLeaf = boost::get<5> (stats);
+  result.leafFillRatio =
+      result.leaves > 0 ?
+	  static_cast<double> (result.objects) /
+	  (result.leaves * TreeType::parameters_type::max_elements) : 0.0;
+  result.constructionTime = constructionTime;
+  return result;
+}
+
+}  // namespace
 
 namespace ns3 {
 
@@ -50,17 +105,38 @@ struct Environment::Data
   };
 
   /*!
-   * @brief Adapter to access the shape directly on the provided tree object.
+   * @brief Test a line against a building or foliage object with boost geometry.
+   *
+   * Compact objects have no exact shape and use their own test.
+   *
+   * @param object	Building or foliage object
+   * @param line	Line to test
+   * @return True if @a line intersects with @a object
+   */
+  template<typename T>
+  static bool
+  IntersectsExactShape (const Ptr<T>& object, const LineSegment2d& line)
+  {
+    if (object->IsCompact ())
+      {
+	return object->Intersects (line);
+      }
+    return boost::geometry::intersects (object->GetShape (), line);
+  }
+
+  /*!
+   * @brief Adapter to pass the tree object itself as shape.
    *
-   * This uses ptr->GetShape () to access the shape of the object.
+   * Used for buildings and foliage, which calculate distances on their
+   * own (see GetShapeDistance()) without decoding compact shapes.
    */
   template<typename TreeType>
-  struct DirectShapeAdapter
+  struct ObjectAdapter
   {
     auto
-    operator() (const typename TreeType::value_type& v) -> decltype (v->GetShape ())
+    operator() (const typename TreeType::value_type& v) -> decltype (*v)
     {
-      return v->GetShape ();
+      return *v;
     }
   };
 
@@ -75,9 +151,6 @@ struct Environment::Data
       boost::geometry::index::rtree<
       Ptr<Building>, boost::geometry::index::rstar<16>, PtrIndex<Building>>;
 
-  //! The range tree containing all buildings
-  BuildingTree buildings;
-
   /*!
    * @brief Type of a range tree for foliage
    *
@@ -89,14 +162,835 @@ struct Environment::Data
       boost::geometry::index::rtree<
       Ptr<Foliage>, boost::geometry::index::rstar<16>, PtrIndex<Foliage>>;
 
-  //! The range tree containing all foliage objects
-  FoliageTree foliage;
+  //! Weight getter using the area of an object
+  template <typename T>
+  struct AreaWeight
+  {
+    double operator()(Ptr<T> const& v) const { return v->GetArea (); }
+  };
+
+  //! Building tree with aggregated area for occupancy queries
+  using BuildingAggregateTree =
+      AggregateTree<Ptr<Building>, PtrIndex<Building>, AreaWeight<Building>>;
+
+  //! Foliage tree with aggregated area for occupancy queries
+  using FoliageAggregateTree =
+      AggregateTree<Ptr<Foliage>, PtrIndex<Foliage>, AreaWeight<Foliage>>;
+
+  /*!
+   * @brief Buildings and foliage with their indexes.
+   *
+   * The layer can be shared by several environments (see
+   * Environment::CloneStaticLayer()). Objects are never added to a shared
+   * layer, an environment adding objects gets its own copy first.
+   *
+   * With tiles, the residency of the tiles belongs to the layer as well.
+   * Tiles loaded or evicted by one environment update the objects and
+   * indexes seen by all environments sharing the layer. The tiles of the
+   * last vehicle snapshot of each environment are pinned.
+   *
+   * The indexes built on first use and the tiles are guarded by mutexes,
+   * so the environments sharing the layer may be used from different
+   * threads one after another. Only snapshot queries may overlap, like
+   * for a single environment.
+   */
+  struct StaticLayer
+  {
+    //! The range tree containing all buildings
+    BuildingTree buildings;
+
+    //! Buildings buffered for bulk loading
+    std::vector<Ptr<Building>> pendingBuildings;
+
+    //! Time spent constructing the building tree [s]
+    double buildingTreeTime = 0;
+
+    //! The range tree containing all foliage objects
+    FoliageTree foliage;
+
+    //! Foliage objects buffered for bulk loading
+    std::vector<Ptr<Foliage>> pendingFoliage;
+
+    //! Time spent constructing the foliage tree [s]
+    double foliageTreeTime = 0;
+
+    //! Aggregated copy of the building tree
+    BuildingAggregateTree buildingAggregates;
+
+    //! Aggregated copy of the foliage tree
+    FoliageAggregateTree foliageAggregates;
+
+    //! True if the aggregate trees contain all buildings and foliage
+    //! except those of the resident tiles
+    std::atomic<bool> aggregatesValid {false};
+
+    //! Aggregate trees of the objects of a single tile
+    struct TileAggregates
+    {
+      //! Aggregated buildings of the tile
+      BuildingAggregateTree buildings;
+      //! Aggregated foliage of the tile
+      FoliageAggregateTree foliage;
+    };
+
+    //! Aggregate trees of the resident tiles by tile index
+    std::map<std::size_t, std::shared_ptr<const TileAggregates>> tileAggregates;
+
+    //! Index of all building walls
+    WallIndex walls;
+
+    //! True if the wall index contains all buildings
+    std::atomic<bool> wallIndexValid {false};
+
+    //! Index of the convex parts of all buildings
+    ConvexPartIndex convexParts;
+
+    //! True if the convex part index contains all buildings
+    std::atomic<bool> convexPartsValid {false};
+
+    //! Guards the construction of the lazily built indexes
+    std::mutex lazyIndexMutex;
+
+    //! Tiles loaded on demand, null if all static objects are loaded
+    std::unique_ptr<StaticLayerTileCache> tiles;
+
+    //! Guards loading and evicting tiles
+    mutable std::mutex tileMutex;
+
+    /*!
+     * @brief Copy the objects and their trees.
+     *
+     * The copy starts with the same resident tiles, but loads and evicts
+     * tiles on its own afterwards.
+     *
+     * @return New layer, the lazily built indexes are not copied
+     */
+    std::shared_ptr<StaticLayer>
+    Copy () const
+    {
+      std::lock_guard<std::mutex> lock (tileMutex);
+      auto copy = std::make_shared<StaticLayer> ();
+      if (tiles)
+	{
+	  copy->tiles.reset (new StaticLayerTileCache (*tiles));
+	}
+      copy->buildings = buildings;
+      copy->pendingBuildings = pendingBuildings;
+      copy->buildingTreeTime = buildingTreeTime;
+      copy->foliage = foliage;
+      copy->pendingFoliage = pendingFoliage;
+      copy->foliageTreeTime = foliageTreeTime;
+      copy->tileAggregates = tileAggregates;
+      return copy;
+    }
+
+    //! Mark the lazily built indexes as outdated
+    void
+    Invalidate ()
+    {
+      aggregatesValid = false;
+      wallIndexValid = false;
+      convexPartsValid = false;
+    }
+
+    //! Build the aggregate trees for buildings and foliage if necessary
+    void
+    CheckAggregates ()
+    {
+      if (!aggregatesValid)
+	{
+	  std::lock_guard<std::mutex> lock (lazyIndexMutex);
+	  if (!aggregatesValid)
+	    {
+	      if (tileAggregates.empty ())
+		{
+		  buildingAggregates.Build (buildings.begin (), buildings.end ());
+		  foliageAggregates.Build (foliage.begin (), foliage.end ());
+		}
+	      else
+		{
+		  BuildAggregatesWithoutTiles ();
+		}
+	      aggregatesValid = true;
+	    }
+	}
+    }
+
+    //! Build the aggregate trees for the objects not loaded from tiles
+    void
+    BuildAggregatesWithoutTiles ()
+    {
+      std::unordered_set<const void*> tiled;
+      for (auto const& tile : tileAggregates)
+	{
+	  for (auto const& b : tile.second->buildings.GetValues ())
+	    {
+	      tiled.insert (PeekPointer (b));
+	    }
+	  for (auto const& f : tile.second->foliage.GetValues ())
+	    {
+	      tiled.insert (PeekPointer (f));
+	    }
+	}
+
+      BuildingList remainingBuildings;
+      for (auto const& b : buildings)
+	{
+	  if (tiled.count (PeekPointer (b)) == 0)
+	    {
+	      remainingBuildings.push_back (b);
+	    }
+	}
+      FoliageList remainingFoliage;
+      for (auto const& f : foliage)
+	{
+	  if (tiled.count (PeekPointer (f)) == 0)
+	    {
+	      remainingFoliage.push_back (f);
+	    }
+	}
+
+      buildingAggregates.Build (remainingBuildings.begin (), remainingBuildings.end ());
+      foliageAggregates.Build (remainingFoliage.begin (), remainingFoliage.end ());
+    }
+
+    /*!
+     * @brief Add the objects of a tile.
+     *
+     * The aggregate trees of the tile are kept on their own, the other
+     * indexes are updated in place if they have been built already.
+     *
+     * @param tile		Index of the tile
+     * @param contents		Objects of the tile
+     * @param restore		Use the stored aggregate trees of the tile
+     */
+    void
+    LoadTile (std::size_t tile, const StaticLayerContents& contents, bool restore)
+    {
+      buildings.insert (contents.buildings.begin (), contents.buildings.end ());
+      foliage.insert (contents.foliage.begin (), contents.foliage.end ());
+
+      auto aggregates = std::make_shared<TileAggregates> ();
+      if (restore)
+	{
+	  aggregates->buildings.Restore (contents.buildings.begin (),
+					 contents.buildings.end (),
+					 contents.buildingNodes);
+	  aggregates->foliage.Restore (contents.foliage.begin (),
+				       contents.foliage.end (),
+				       contents.foliageNodes);
+	}
+      else
+	{
+	  aggregates->buildings.Build (contents.buildings.begin (),
+				       contents.buildings.end ());
+	  aggregates->foliage.Build (contents.foliage.begin (),
+				     contents.foliage.end ());
+	}
+      tileAggregates[tile] = aggregates;
+
+      if (wallIndexValid)
+	{
+	  walls.Insert (contents.buildings);
+	}
+      if (convexPartsValid)
+	{
+	  convexParts.Insert (contents.buildings);
+	}
+    }
+
+    /*!
+     * @brief Remove the objects of a tile added with LoadTile().
+     * @param tile		Index of the tile
+     * @param contents		Objects of the tile
+     */
+    void
+    EvictTile (std::size_t tile, const StaticLayerContents& contents)
+    {
+      buildings.remove (contents.buildings.begin (), contents.buildings.end ());
+      foliage.remove (contents.foliage.begin (), contents.foliage.end ());
+      tileAggregates.erase (tile);
+
+      if (wallIndexValid)
+	{
+	  walls.Remove (contents.buildings);
+	}
+      if (convexPartsValid)
+	{
+	  convexParts.Remove (contents.buildings);
+	}
+    }
+
+    //! Build the wall index if buildings have been added
+    void
+    CheckWallIndex ()
+    {
+      if (!wallIndexValid)
+	{
+	  std::lock_guard<std::mutex> lock (lazyIndexMutex);
+	  if (!wallIndexValid)
+	    {
+	      walls.Build (BuildingList (buildings.begin (), buildings.end ()));
+	      wallIndexValid = true;
+	    }
+	}
+    }
+
+    //! Build the convex part index if buildings have been added
+    void
+    CheckConvexParts ()
+    {
+      if (!convexPartsValid)
+	{
+	  std::lock_guard<std::mutex> lock (lazyIndexMutex);
+	  if (!convexPartsValid)
+	    {
+	      convexParts.Build (BuildingList (buildings.begin (), buildings.end ()));
+	      convexPartsValid = true;
+	    }
+	}
+    }
+
+    /*!
+     * @brief Sum up the area of buildings and foliage within an ellipse.
+     *
+     * The aggregate trees (and the convex part index if used) have to be
+     * up to date.
+     *
+     * @param bBox		Bounding box of the ellipse
+     * @param p1			First focal point
+     * @param p2			Second focal point
+     * @param range		Maximum combined distance to @a p1 and @a p2
+     * @param useConvexParts	Calculate the distance to buildings from their parts
+     * @return Summed area of all objects in the ellipse
+     */
+    double
+    GetObjectAreaInEllipse (const Box2d& bBox, const Point2d& p1,
+			    const Point2d& p2, double range,
+			    bool useConvexParts) const
+    {
+      NS_ASSERT (aggregatesValid);
+      NS_ASSERT (!useConvexParts || convexPartsValid);
+
+      auto isBuildingInside =
+	  [this, &p1, &p2, range, useConvexParts](const Ptr<Building>& b)
+	  {
+	    if (useConvexParts)
+	      {
+		auto parts = convexParts.GetParts (*b);
+		return GetShapeDistance (p1, parts) + GetShapeDistance (p2, parts) < range;
+	      }
+	    return b->GetDistance (p1) + b->GetDistance (p2) < range;
+	  };
+      auto isFoliageInside =
+	  [&p1, &p2, range](const Ptr<Foliage>& f)
+	  { return f->GetDistance (p1) + f->GetDistance (p2) < range; };
+
+      double area =
+	  buildingAggregates.Accumulate (bBox, p1, p2, range, isBuildingInside).weight +
+	  foliageAggregates.Accumulate (bBox, p1, p2, range, isFoliageInside).weight;
+
+      // each object belongs to exactly one tile
+      for (auto const& tile : tileAggregates)
+	{
+	  area += tile.second->buildings.Accumulate (
+	      bBox, p1, p2, range, isBuildingInside).weight;
+	  area += tile.second->foliage.Accumulate (
+	      bBox, p1, p2, range, isFoliageInside).weight;
+	}
+
+      return area;
+    }
+
+    /*!
+     * @brief Find buildings that completely contain a point.
+     * @param p			Point to test
+     * @param outputIterator	Buildings containing @a p are added here
+     */
+    template<typename OutputIterator>
+    void
+    FindBuildingsContaining (const Point2d& p, OutputIterator outputIterator) const
+    {
+      buildings.query (
+	  boost::geometry::index::intersects (p) &&
+	  boost::geometry::index::satisfies (
+	      [&p](const Ptr<Building>& b)
+	      { return b->Contains (p); }),
+	  outputIterator);
+    }
+
+    /*!
+     * @brief Visit the buildings intersecting a line using the wall index.
+     *
+     * The wall index has to be up to date, see CheckWallIndex().
+     *
+     * @param line	Line to test
+     * @param visitor	Called once for each intersecting building
+     */
+    void
+    VisitBuildingsThatIntersectWalls (const LineSegment2d& line,
+				      const BuildingVisitor& visitor) const
+    {
+      std::vector<const Building*> found;
+      walls.IntersectBuildings (
+	  line, [&found, &visitor](const Building& b)
+	  {
+	    found.push_back (&b);
+	    visitor (b);
+	  });
+
+      // lines inside of a building do not hit any wall
+      FindBuildingsContaining (
+	  line.first,
+	  boost::make_function_output_iterator (
+	      [&found, &visitor](const Ptr<Building>& b)
+	      {
+		if (std::find (found.begin (), found.end (), PeekPointer (b)) == found.end ())
+		  {
+		    visitor (*b);
+		  }
+	      }));
+    }
+
+    /*!
+     * @brief Test if any building completely contains a point.
+     * @param p	Point to test
+     * @return True if at least one building contains @a p
+     */
+    bool
+    AnyBuildingContains (const Point2d& p) const
+    {
+      return buildings.qbegin (
+	  boost::geometry::index::intersects (p) &&
+	  boost::geometry::index::satisfies (
+	      [&p](const Ptr<Building>& b)
+	      { return b->Contains (p); })
+	  ) != buildings.qend ();
+    }
+
+    /*!
+     * @brief Check if all static objects are in their trees.
+     * @return True if no buildings or foliage objects are buffered
+     */
+    bool
+    IsFinalized () const
+    {
+      return pendingBuildings.empty () && pendingFoliage.empty ();
+    }
+  };
+
+  //! Buildings and foliage, possibly shared with other environments
+  std::shared_ptr<StaticLayer> statics = std::make_shared<StaticLayer> ();
+
+  /*!
+   * @brief Get the static layer for modification.
+   *
+   * The layer is copied if it is shared with other environments. The
+   * lazily built indexes are invalidated.
+   *
+   * @return Layer owned by this environment
+   */
+  StaticLayer&
+  MutableStatics ()
+  {
+    if (statics.use_count () > 1)
+      {
+	statics = statics->Copy ();
+      }
+    statics->Invalidate ();
+    return *statics;
+  }
+
+  //! Use the flat polygon kernel for line intersections
+  bool fastLineIntersection = true;
+
+  //! Use the wall index for line intersections with buildings
+  bool useWallIndex = false;
+
+  //! Use the convex parts of the buildings for line and distance tests
+  bool useConvexParts = false;
+
+  //! Store the shapes of new buildings and foliage in compact form
+  bool compactStorage = false;
+
+  /*!
+   * @brief Prepare a static object for the trees of an environment.
+   *
+   * Objects already indexed by another environment keep their exact
+   * shape, since compacting would change the bounding box stored in the
+   * trees of that environment.
+   *
+   * @param object	Building or foliage object to insert
+   * @param compact	Convert the shape to compact form
+   */
+  template<typename T>
+  static void
+  PrepareObject (const Ptr<T>& object, bool compact)
+  {
+    if (compact && !object->IsIndexed ())
+      {
+	object->Compact ();
+      }
+    object->MarkIndexed ();
+  }
+
+  /*!
+   * @brief Prepare static objects for the trees of an environment.
+   * @param objects	Buildings or foliage objects to insert
+   * @param compact	Convert the shapes to compact form
+   */
+  template<typename ObjectList>
+  static void
+  PrepareObjects (const ObjectList& objects, bool compact)
+  {
+    for (auto const& o : objects)
+      {
+	PrepareObject (o, compact);
+      }
+  }
+
+  /*!
+   * @brief Load the tiles touching a box.
+   *
+   * The objects of loaded tiles are inserted into the trees, the objects
+   * of evicted tiles are removed. Nothing happens without tiles.
+   *
+   * @param box	Bounding box of a query
+   */
+  void
+  PageTiles (const Box2d& box)
+  {
+    if (statics->tiles)
+      {
+	PageTiles (std::vector<Box2d> {box});
+      }
+  }
+
+  /*!
+   * @brief Load the tiles touching any of several boxes in one request.
+   * @param boxes	Bounding boxes of the queries
+   * @param pinned	If not null, the tiles are pinned and their indexes
+   *			are stored here
+   */
+  void
+  PageTiles (const std::vector<Box2d>& boxes,
+	     std::vector<std::size_t>* pinned = nullptr)
+  {
+    auto& layer = *statics;
+    if (!layer.tiles)
+      {
+	return;
+      }
+
+    // the tiles are loaded into the layer shared with other environments
+    bool compact = compactStorage;
+    auto load = [&layer, compact](std::size_t tile, const StaticLayerContents& contents)
+    {
+      PrepareObjects (contents.buildings, compact);
+      PrepareObjects (contents.foliage, compact);
+      // the stored node boxes do not match compact shapes
+      layer.LoadTile (tile, contents, !compact);
+    };
+    auto evict = [&layer](std::size_t tile, const StaticLayerContents& contents)
+    {
+      layer.EvictTile (tile, contents);
+    };
+
+    std::lock_guard<std::mutex> lock (layer.tileMutex);
+    if (pinned)
+      {
+	*pinned = layer.tiles->Pin (boxes, load, evict);
+      }
+    else
+      {
+	layer.tiles->Request (boxes, load, evict);
+      }
+  }
+
+  //! Layer containing the tiles pinned for the last vehicle snapshot
+  std::weak_ptr<StaticLayer> pinnedLayer;
+
+  //! Tiles pinned for the last vehicle snapshot
+  std::vector<std::size_t> pinnedTiles;
+
+  /*!
+   * @brief Load and pin the tiles of a new vehicle snapshot.
+   *
+   * The tiles of the previous snapshot are released afterwards, so tiles
+   * used by both stay resident. Other environments sharing the layer
+   * cannot evict pinned tiles.
+   *
+   * @param boxes	Reach of the vehicles of the snapshot
+   */
+  void
+  PinSnapshotTiles (const std::vector<Box2d>& boxes)
+  {
+    std::vector<std::size_t> pinned;
+    PageTiles (boxes, &pinned);
+    UnpinSnapshotTiles ();
+    pinnedLayer = statics;
+    pinnedTiles = std::move (pinned);
+  }
+
+  //! Release the tiles pinned for the last vehicle snapshot
+  void
+  UnpinSnapshotTiles ()
+  {
+    // the layer is gone if no environment uses it anymore
+    auto layer = pinnedLayer.lock ();
+    if (layer && layer->tiles)
+      {
+	std::lock_guard<std::mutex> lock (layer->tileMutex);
+	layer->tiles->Unpin (pinnedTiles);
+      }
+    pinnedLayer.reset ();
+    pinnedTiles.clear ();
+  }
+
+  ~Data ()
+  {
+    UnpinSnapshotTiles ();
+  }
+
+  /*!
+   * @brief Check if a snapshot query can run without modifying anything.
+   *
+   * Snapshot queries may run on several threads at the same time, so
+   * the indexes they use have to be built and the tiles they touch have
+   * to be loaded by Environment::PublishVehicleSnapshot() already.
+   *
+   * @param box	Bounding box of the query
+   * @return True if the query does not need to load or build anything
+   */
+  bool
+  IsPreparedForSnapshot (const Box2d& box) const
+  {
+    return statics->IsFinalized () && statics->aggregatesValid &&
+	(!useWallIndex || statics->wallIndexValid) &&
+	(!useConvexParts || statics->convexPartsValid) &&
+	(!statics->tiles || statics->tiles->IsResident (box));
+  }
+
+  /*!
+   * @brief Reject snapshots older than the last published one.
+   *
+   * The static objects only match the last snapshot, e.g. the tiles of
+   * older snapshots may be evicted already.
+   *
+   * @param snapshot	Snapshot passed to a snapshot query
+   */
+  void
+  CheckSnapshotEpoch (const VehicleSnapshot& snapshot) const
+  {
+    NS_ABORT_MSG_UNLESS (snapshot.GetEpoch () == snapshotEpoch,
+			 "snapshot " << snapshot.GetEpoch () << " is outdated, "
+			 "use the last published snapshot " << snapshotEpoch);
+  }
+
+  /*!
+   * @brief Load the tiles touching a line.
+   * @param line	Line of a query
+   */
+  void
+  PageTiles (const LineSegment2d& line)
+  {
+    if (statics->tiles)
+      {
+	Box2d box;
+	boost::geometry::envelope (line, box);
+	PageTiles (box);
+      }
+  }
+
+  /*!
+   * @brief Find buildings in an ellipse.
+   *
+   * The distance to the buildings is calculated from their convex parts
+   * if enabled.
+   *
+   * @param bBox		Bounding box of the ellipse
+   * @param p1			First focal point
+   * @param p2			Second focal point
+   * @param range		Maximum combined distance to @a p1 and @a p2
+   * @param outputIterator	All buildings in the ellipse are added here
+   */
+  template<typename OutputIterator>
+  void
+  FindBuildingsInEllipse (const Box2d& bBox, const Point2d& p1,
+			  const Point2d& p2, double range,
+			  OutputIterator outputIterator) const
+  {
+    if (useConvexParts)
+      {
+	statics->CheckConvexParts ();
+	auto const& parts = statics->convexParts;
+	FindObjectsInEllipse (
+	    statics->buildings, bBox, p1, p2, range, outputIterator,
+	    [&parts](const Ptr<Building>& b) { return parts.GetParts (*b); });
+      }
+    else
+      {
+	FindObjectsInEllipse (statics->buildings, bBox, p1, p2, range,
+			      outputIterator);
+      }
+  }
+
+  /*!
+   * @brief Find buildings intersecting a line using the wall index.
+   * @param line	Line to test
+   * @param found	All intersecting buildings are added here
+   */
+  void
+  FindBuildingsThatIntersectWalls (const LineSegment2d& line, BuildingList& found)
+  {
+    statics->CheckWallIndex ();
+
+    std::size_t numHits = found.size ();
+    statics->walls.IntersectBuildings (line, found);
+
+    // lines inside of a building do not hit any wall
+    statics->FindBuildingsContaining (
+	line.first,
+	boost::make_function_output_iterator (
+	    [&found, numHits](const Ptr<Building>& b)
+	    {
+	      if (std::find (found.begin () + numHits, found.end (), b) == found.end ())
+		{
+		  found.push_back (b);
+		}
+	    }));
+  }
+
+  /*!
+   * @brief Test if a line intersects with any object in a static tree.
+   * @param tree	Building or foliage tree
+   * @param line	Line to test
+   * @return True if @a line intersects at least with one object
+   */
+  template<typename TreeType>
+  bool
+  IntersectsAnyObject (const TreeType& tree, const LineSegment2d& line) const
+  {
+    bool fast = fastLineIntersection;
+    return detail::IndexQuery<TreeType>::Any (
+	tree, line,
+	[&line, fast](const typename TreeType::value_type& v)
+	{ return fast ? v->Intersects (line) : IntersectsExactShape (v, line); });
+  }
+
+  /*!
+   * @brief Find objects in a static tree intersecting a line.
+   * @param tree		Building or foliage tree
+   * @param line		Line to test
+   * @param outputIterator	All intersecting objects are added here
+   */
+  template<typename TreeType, typename OutputIterator>
+  void
+  FindObjectsThatIntersectLine (const TreeType& tree, const LineSegment2d& line,
+				OutputIterator outputIterator) const
+  {
+    bool fast = fastLineIntersection;
+    detail::IndexQuery<TreeType>::Query (
+	tree, line,
+	[&line, fast](const typename TreeType::value_type& v)
+	{ return fast ? v->Intersects (line) : IntersectsExactShape (v, line); },
+	outputIterator);
+  }
+
+  /*!
+   * @brief Pack the buffered objects into the tree.
+   * @param tree		Tree to add the objects to
+   * @param pending		Buffered objects, will be cleared
+   * @return Time spent to construct the tree [s]
+   */
+  template<typename TreeType>
+  static double
+  PackTree (TreeType& tree,
+	    std::vector<typename TreeType::value_type>& pending)
+  {
+    auto start = std::chrono::steady_clock::now ();
+
+    // the packing algorithm needs all objects at once
+    pending.insert (pending.end (), tree.begin (), tree.end ());
+    TreeType packed (pending.begin (), pending.end ());
+    tree.swap (packed);
+    pending.clear ();
+
+    return ElapsedSeconds (start);
+  }
+
+  /*!
+   * @brief All registered vehicles
+   *
+   * Each vehicle is stored with the bounding box it is currently indexed
+   * with in the vehicle tree. The box is required to remove the vehicle
+   * from the tree again.
+   */
+  VehicleStore vehicles;
+
+  //! Vehicles with queued pose changes
+  VehicleList queuedVehicles;
+
+  //! Queued position of each vehicle in @a queuedVehicles
+  std::vector<Vector> queuedPositions;
+
+  //! Queued heading of each vehicle in @a queuedVehicles
+  std::vector<double> queuedHeadings;
+
+  //! Index of each vehicle in @a queuedVehicles
+  std::unordered_map<const Vehicle*, std::size_t> queuedIndexes;
+
+  //! Vehicle following a mobility model
+  struct TrackedVehicle
+  {
+    //! The tracked vehicle
+    Ptr<Vehicle> vehicle;
+
+    //! Mobility model providing the pose
+    Ptr<const MobilityModel> mobility;
+
+    //! Heading derived from the last known velocity [degree]
+    double heading;
+
+    //! True if the vehicle is listed in @a movingVehicles
+    bool moving;
+
+    /*!
+     * @brief Sample the current pose of the mobility model.
+     * @param position	Current position
+     * @return False if the vehicle stands still
+     */
+    bool
+    Sample (Vector& position)
+    {
+      position = mobility->GetPosition ();
+      auto velocity = mobility->GetVelocity ();
+      if (velocity.x != 0 || velocity.y != 0)
+	{
+	  // clockwise from north (y axis), see Vehicle::SetHeading()
+	  heading = std::atan2 (velocity.x, velocity.y) * 180 / M_PI;
+	}
+      return velocity.x != 0 || velocity.y != 0 || velocity.z != 0;
+    }
+  };
+
+  //! Vehicles following a mobility model, by address
+  std::unordered_map<const Vehicle*, TrackedVehicle> trackedVehicles;
 
-  //! Set of all registered vehicles
-  std::set<Ptr<Vehicle>> vehicles;
+  //! Tracked vehicles to sample before each query
+  std::vector<const Vehicle*> movingVehicles;
 
-  //! Vehicle and a bounding box
-  using BoxedVehicle = std::pair<Box2d, Ptr<Vehicle>>;
+  //! Simulation time @a movingVehicles were sampled at last
+  Time lastVehicleSample = Time::Min ();
+
+  /*!
+   * @brief Vehicle and a bounding box
+   *
+   * The vehicles are owned by @a vehicles. The indexes only refer to them
+   * by address, so they can be built without touching the (non-atomic)
+   * reference counts, e.g. on a worker thread.
+   */
+  using BoxedVehicle = std::pair<Box2d, Vehicle*>;
 
   //! Type of the tree for vehicle search
   using VehicleTree =
@@ -116,6 +1010,178 @@ struct Environment::Data
 
   //! Current tree of assigned vehicles
   VehicleTree vehicleTree;
+
+  //! Type of the grid for vehicle search
+  using VehicleGrid = SpatialGrid<BoxedVehicle>;
+
+  //! Current grid of assigned vehicles
+  VehicleGrid vehicleGrid;
+
+  //! Index used for vehicles
+  VehicleIndexType vehicleIndexType = VEHICLE_INDEX_RTREE;
+
+  //! Vehicle tree with aggregated count for occupancy queries
+  using VehicleAggregateTree = AggregateTree<BoxedVehicle>;
+
+  //! Aggregated copy of the vehicle index
+  VehicleAggregateTree vehicleAggregates;
+
+  //! True if the aggregate tree matches the vehicle index
+  bool vehicleAggregatesValid = false;
+
+  //! Build the aggregate tree for vehicles
+  void
+  UpdateVehicleAggregates ()
+  {
+    std::vector<BoxedVehicle> indexed;
+    indexed.reserve (vehicles.GetSize ());
+    for (std::size_t i = 0; i < vehicles.GetSize (); ++i)
+      {
+	indexed.push_back (std::make_pair (vehicles.GetIndexedBox (i),
+					   PeekPointer (vehicles.GetVehicle (i))));
+      }
+    vehicleAggregates.Build (indexed.begin (), indexed.end ());
+    vehicleAggregatesValid = true;
+  }
+
+  //! Last published vehicle snapshot, only accessed atomically
+  std::shared_ptr<const VehicleSnapshot> vehicleSnapshot;
+
+  //! Number of published vehicle snapshots
+  std::uint64_t snapshotEpoch = 0;
+
+  //! Maximum range of snapshot based queries, see SetSnapshotQueryRange()
+  double snapshotQueryRange = 0;
+
+  //! Add a vehicle to the active vehicle index
+  void
+  InsertVehicle (const BoxedVehicle& v)
+  {
+    vehicleAggregatesValid = false;
+    if (vehicleIndexType == VEHICLE_INDEX_GRID)
+      {
+	vehicleGrid.insert (v);
+      }
+    else
+      {
+	vehicleTree.insert (v);
+      }
+  }
+
+  //! Remove a vehicle from the active vehicle index
+  void
+  RemoveVehicle (const BoxedVehicle& v)
+  {
+    vehicleAggregatesValid = false;
+    if (vehicleIndexType == VEHICLE_INDEX_GRID)
+      {
+	vehicleGrid.remove (v);
+      }
+    else
+      {
+	vehicleTree.remove (v);
+      }
+  }
+
+  //! Remove all vehicles from both vehicle indexes
+  void
+  ClearVehicleIndex ()
+  {
+    vehicleAggregatesValid = false;
+    vehicleTree.clear ();
+    vehicleGrid.clear ();
+  }
+
+  //! Vehicle tree packed on a worker thread
+  struct PackedVehicleTree
+  {
+    //! The packed tree
+    VehicleTree tree;
+    //! Wall clock time spent packing the tree [s]
+    double packTime;
+  };
+
+  //! Next vehicle tree, valid while a background rebuild is running
+  std::future<PackedVehicleTree> pendingTree;
+
+  //! Boxes the next vehicle tree is built from
+  std::vector<BoxedVehicle> pendingBoxes;
+
+  //! Simulation time the boxes of the next vehicle tree refer to
+  Time pendingTime;
+
+  //! Vehicles removed while the next vehicle tree is built
+  std::vector<const Vehicle*> removedSincePending;
+
+  //! Statistics about the vehicle tree rebuilds
+  VehicleTreeRebuildStatistics rebuildStatistics {0, 0, 0, 0};
+
+  //! Pack a vehicle tree, run on a worker thread
+  static PackedVehicleTree
+  PackVehicleTree (const std::vector<BoxedVehicle>& boxes)
+  {
+    auto start = std::chrono::steady_clock::now ();
+    PackedVehicleTree packed {VehicleTree (boxes.begin (), boxes.end ()), 0};
+    packed.packTime = ElapsedSeconds (start);
+    return packed;
+  }
+
+  //! Wait for a running background rebuild and drop the result
+  void
+  DiscardPendingTree ()
+  {
+    if (pendingTree.valid ())
+      {
+	pendingTree.wait ();
+	pendingTree = std::future<PackedVehicleTree> ();
+      }
+    pendingBoxes.clear ();
+    removedSincePending.clear ();
+  }
+
+  /*!
+   * @brief Find vehicles intersecting a line in the active vehicle index.
+   * @param line		Line to check for intersections
+   * @param outputIterator	Intersecting vehicles are added here
+   */
+  template<typename OutputIterator>
+  void
+  FindVehiclesThatIntersect (const LineSegment2d& line,
+			     OutputIterator outputIterator) const
+  {
+    if (vehicleIndexType == VEHICLE_INDEX_GRID)
+      {
+	FindObjectsThatIntersect (vehicleGrid, line, outputIterator);
+      }
+    else
+      {
+	FindObjectsThatIntersect (vehicleTree, line, outputIterator);
+      }
+  }
+
+  /*!
+   * @brief Find vehicles in an ellipse in the active vehicle index.
+   * @param bBox		Bounding box to limit the search
+   * @param p1			First focal point
+   * @param p2			Second focal point
+   * @param range		Maximum distance from @a p1 and @a p2 combined
+   * @param outputIterator	Vehicles in the ellipse are added here
+   */
+  template<typename OutputIterator>
+  void
+  FindVehiclesInEllipse (const Box2d& bBox,
+			 const Point2d& p1, const Point2d& p2, double range,
+			 OutputIterator outputIterator) const
+  {
+    if (vehicleIndexType == VEHICLE_INDEX_GRID)
+      {
+	FindObjectsInEllipse (vehicleGrid, bBox, p1, p2, range, outputIterator);
+      }
+    else
+      {
+	FindObjectsInEllipse (vehicleTree, bBox, p1, p2, range, outputIterator);
+      }
+  }
 };
 
 /*
@@ -128,14 +1194,14 @@ template<>
 struct ShapeAdapterTrait<Environment::Data::BuildingTree>
 {
   using AdapterType =
-      Environment::Data::DirectShapeAdapter<Environment::Data::BuildingTree>;
+      Environment::Data::ObjectAdapter<Environment::Data::BuildingTree>;
 };
 
 template<>
 struct ShapeAdapterTrait<Environment::Data::FoliageTree>
 {
   using AdapterType =
-      Environment::Data::DirectShapeAdapter<Environment::Data::FoliageTree>;
+      Environment::Data::ObjectAdapter<Environment::Data::FoliageTree>;
 };
 
 template<>
@@ -144,18 +1210,35 @@ struct ShapeAdapterTrait<Environment::Data::VehicleTree>
   using AdapterType = Environment::Data::VehicleShapeAdapter;
 };
 
-}  // namespace detail
+template<>
+struct ShapeAdapterTrait<Environment::Data::VehicleGrid>
+{
+  using AdapterType = Environment::Data::VehicleShapeAdapter;
+};
 
+// vehicles might have left their indexed box since the last update
+template<>
+struct BoxCoversShapeTrait<Environment::Data::VehicleTree> : std::false_type {};
 
-/*
- * And now the actual Environment implementation
+template<>
+struct BoxCoversShapeTrait<Environment::Data::VehicleGrid> : std::false_type {};
+
+}  // namespace detail
+
+
+/*
+ * And now the actual Environment implementation
  */
 
 Environment::Environment()
   : m_data (new Data),
     m_lastVehicleTreeRebuild (-1.0),
     m_vehicleTreeRebuildInterval (Seconds (1.0)),
-    m_forceVehicleTreeRebuild (false)
+    m_maxVehicleSpeed (0),
+    m_vehicleTreeUpdateMode (VEHICLE_TREE_UPDATE_FULL_REBUILD),
+    m_bulkLoading (false),
+    m_forceVehicleTreeRebuild (false),
+    m_backgroundVehicleTreeRebuild (false)
 {
 }
 
@@ -178,13 +1261,328 @@ void
 Environment::SetVehicleTreeRebuildInterval (Time t)
 {
   m_vehicleTreeRebuildInterval = t;
+
+  // the motion padding of the indexed boxes depends on the interval
+  if (m_maxVehicleSpeed > 0)
+    {
+      m_forceVehicleTreeRebuild = true;
+    }
+}
+
+void
+Environment::SetMaxVehicleSpeed (double speed)
+{
+  NS_LOG_FUNCTION (this << speed);
+  NS_ASSERT_MSG (speed >= 0, "speed must not be negative");
+  m_maxVehicleSpeed = speed;
+  m_forceVehicleTreeRebuild = true;
+}
+
+void
+Environment::SetVehicleIndexType (VehicleIndexType type)
+{
+  NS_LOG_FUNCTION (this << type);
+  if (m_data->vehicleIndexType != type)
+    {
+      m_data->vehicleIndexType = type;
+      m_forceVehicleTreeRebuild = true;
+    }
+}
+
+void
+Environment::SetVehicleGridCellSize (double cellSize)
+{
+  NS_LOG_FUNCTION (this << cellSize);
+  NS_ASSERT_MSG (cellSize > 0, "cell size must be positive");
+  m_data->vehicleGrid = Data::VehicleGrid (cellSize);
+  m_forceVehicleTreeRebuild = true;
+}
+
+void
+Environment::SetVehicleTreeUpdateMode (VehicleTreeUpdateMode mode)
+{
+  NS_LOG_FUNCTION (this << mode);
+  if (m_vehicleTreeUpdateMode != mode)
+    {
+      m_vehicleTreeUpdateMode = mode;
+      m_forceVehicleTreeRebuild = true;
+    }
+}
+
+void
+Environment::SetBackgroundVehicleTreeRebuild (bool enable)
+{
+  NS_LOG_FUNCTION (this << enable);
+  if (m_backgroundVehicleTreeRebuild != enable)
+    {
+      m_backgroundVehicleTreeRebuild = enable;
+      m_forceVehicleTreeRebuild = true;
+    }
+}
+
+Environment::VehicleTreeRebuildStatistics
+Environment::GetVehicleTreeRebuildStatistics () const
+{
+  return m_data->rebuildStatistics;
+}
+
+void
+Environment::SetBulkLoading (bool enable)
+{
+  NS_LOG_FUNCTION (this << enable);
+  m_bulkLoading = enable;
+  if (!enable)
+    {
+      Finalize ();
+    }
+}
+
+bool
+Environment::IsBulkLoading () const
+{
+  return m_bulkLoading;
+}
+
+void
+Environment::Finalize ()
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_data->statics->IsFinalized ())
+    {
+      return;
+    }
+
+  auto& statics = m_data->MutableStatics ();
+
+  if (!statics.pendingBuildings.empty ())
+    {
+      NS_LOG_LOGIC ("Packing " << statics.pendingBuildings.size ()
+		    << " buffered buildings");
+      statics.buildingTreeTime =
+	  Data::PackTree (statics.buildings, statics.pendingBuildings);
+      NS_LOG_INFO ("Constructed building tree with "
+		   << statics.buildings.size () << " buildings in "
+		   << statics.buildingTreeTime << "s");
+    }
+
+  if (!statics.pendingFoliage.empty ())
+    {
+      NS_LOG_LOGIC ("Packing " << statics.pendingFoliage.size ()
+		    << " buffered foliage objects");
+      statics.foliageTreeTime =
+	  Data::PackTree (statics.foliage, statics.pendingFoliage);
+      NS_LOG_INFO ("Constructed foliage tree with "
+		   << statics.foliage.size () << " objects in "
+		   << statics.foliageTreeTime << "s");
+    }
+}
+
+Environment::TreeStatistics
+Environment::GetBuildingTreeStatistics () const
+{
+  return MakeTreeStatistics (m_data->statics->buildings,
+			     m_data->statics->buildingTreeTime);
+}
+
+Environment::TreeStatistics
+Environment::GetFoliageTreeStatistics () const
+{
+  return MakeTreeStatistics (m_data->statics->foliage,
+			     m_data->statics->foliageTreeTime);
+}
+
+Ptr<Environment>
+Environment::CloneStaticLayer () const
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (m_data->statics->IsFinalized (),
+		 "Finalize () must be called before cloning");
+
+  auto clone = Create<Environment> ();
+  clone->m_data->statics = m_data->statics;
+  clone->m_data->fastLineIntersection = m_data->fastLineIntersection;
+  clone->m_data->useWallIndex = m_data->useWallIndex;
+  clone->m_data->useConvexParts = m_data->useConvexParts;
+  clone->m_data->compactStorage = m_data->compactStorage;
+  clone->m_data->snapshotQueryRange = m_data->snapshotQueryRange;
+  return clone;
+}
+
+bool
+Environment::SharesStaticLayer (const Environment& other) const
+{
+  return m_data->statics == other.m_data->statics;
+}
+
+bool
+Environment::SaveStaticLayer (const std::string& fileName) const
+{
+  NS_LOG_FUNCTION (this << fileName);
+  NS_ASSERT_MSG (m_data->statics->IsFinalized (),
+		 "Finalize () must be called before saving");
+
+  auto& statics = *m_data->statics;
+  StaticLayerContents contents;
+  if (statics.tileAggregates.empty ())
+    {
+      statics.CheckAggregates ();
+      contents.buildings = statics.buildingAggregates.GetValues ();
+      contents.buildingNodes = statics.buildingAggregates.GetNodes ();
+      contents.foliage = statics.foliageAggregates.GetValues ();
+      contents.foliageNodes = statics.foliageAggregates.GetNodes ();
+    }
+  else
+    {
+      // the objects of resident tiles are aggregated per tile
+      Data::BuildingAggregateTree buildings;
+      buildings.Build (statics.buildings.begin (), statics.buildings.end ());
+      Data::FoliageAggregateTree foliage;
+      foliage.Build (statics.foliage.begin (), statics.foliage.end ());
+      contents.buildings = buildings.GetValues ();
+      contents.buildingNodes = buildings.GetNodes ();
+      contents.foliage = foliage.GetValues ();
+      contents.foliageNodes = foliage.GetNodes ();
+    }
+  return WriteStaticLayerFile (fileName, contents);
+}
+
+bool
+Environment::LoadStaticLayer (const std::string& fileName)
+{
+  NS_LOG_FUNCTION (this << fileName);
+
+  StaticLayerContents contents;
+  if (!ReadStaticLayerFile (fileName, contents))
+    {
+      return false;
+    }
+
+  auto statics = std::make_shared<Data::StaticLayer> ();
+  Data::PrepareObjects (contents.buildings, m_data->compactStorage);
+  Data::PrepareObjects (contents.foliage, m_data->compactStorage);
+
+  // the stored node boxes do not match compact shapes, so the aggregate
+  // trees are rebuilt on first use
+  if (!m_data->compactStorage)
+    {
+      statics->buildingAggregates.Restore (contents.buildings.begin (),
+					   contents.buildings.end (),
+					   std::move (contents.buildingNodes));
+      statics->foliageAggregates.Restore (contents.foliage.begin (),
+					  contents.foliage.end (),
+					  std::move (contents.foliageNodes));
+      statics->aggregatesValid = true;
+    }
+
+  statics->buildingTreeTime =
+      Data::PackTree (statics->buildings, contents.buildings);
+  statics->foliageTreeTime =
+      Data::PackTree (statics->foliage, contents.foliage);
+
+  m_data->statics = statics;
+  return true;
+}
+
+bool
+Environment::SaveStaticLayerTiles (const std::string& directory,
+				   double tileSize) const
+{
+  NS_LOG_FUNCTION (this << directory << tileSize);
+  NS_ASSERT_MSG (m_data->statics->IsFinalized (),
+		 "Finalize () must be called before saving");
+  NS_ASSERT_MSG (tileSize > 0, "tile size must be positive");
+
+  // group the objects by the tile containing the center of their box
+  using Cell = std::pair<long, long>;
+  auto getCell = [tileSize](const Box2d& box)
+  {
+    Point2d center;
+    boost::geometry::centroid (box, center);
+    return Cell (static_cast<long> (std::floor (center.x () / tileSize)),
+		 static_cast<long> (std::floor (center.y () / tileSize)));
+  };
+
+  std::map<Cell, std::pair<BuildingList, FoliageList>> cells;
+  for (auto const& b : m_data->statics->buildings)
+    {
+      cells[getCell (b->GetBoundingBox ())].first.push_back (b);
+    }
+  for (auto const& f : m_data->statics->foliage)
+    {
+      cells[getCell (f->GetBoundingBox ())].second.push_back (f);
+    }
+
+  // pack the aggregate trees of each tile for fast loading
+  std::vector<StaticLayerContents> tiles;
+  for (auto const& cell : cells)
+    {
+      Data::BuildingAggregateTree buildings;
+      buildings.Build (cell.second.first.begin (), cell.second.first.end ());
+      Data::FoliageAggregateTree foliage;
+      foliage.Build (cell.second.second.begin (), cell.second.second.end ());
+
+      StaticLayerContents contents;
+      contents.buildings = buildings.GetValues ();
+      contents.buildingNodes = buildings.GetNodes ();
+      contents.foliage = foliage.GetValues ();
+      contents.foliageNodes = foliage.GetNodes ();
+      tiles.push_back (std::move (contents));
+    }
+
+  return WriteStaticLayerTiles (directory, tiles);
+}
+
+bool
+Environment::OpenStaticLayerTiles (const std::string& directory,
+				   std::uint64_t memoryBudget)
+{
+  NS_LOG_FUNCTION (this << directory << memoryBudget);
+
+  std::vector<StaticLayerTile> tiles;
+  if (!ReadStaticLayerTileManifest (directory, tiles))
+    {
+      return false;
+    }
+
+  NS_LOG_INFO ("Opened " << tiles.size () << " tiles in " << directory
+	       << " with a budget of " << memoryBudget << " bytes");
+
+  auto statics = std::make_shared<Data::StaticLayer> ();
+  statics->tiles.reset (
+      new StaticLayerTileCache (directory, std::move (tiles), memoryBudget));
+  m_data->statics = statics;
+  return true;
+}
+
+StaticLayerTileCache::Statistics
+Environment::GetTileStatistics () const
+{
+  auto const& statics = *m_data->statics;
+  if (!statics.tiles)
+    {
+      return StaticLayerTileCache::Statistics {0, 0, 0, 0, 0, 0};
+    }
+  std::lock_guard<std::mutex> lock (statics.tileMutex);
+  return statics.tiles->GetStatistics ();
 }
 
 void
 Environment::AddBuilding (Ptr<Building> building)
 {
   NS_ASSERT_MSG (building, "building must not be null");
-  m_data->buildings.insert (building);
+  Data::PrepareObject (building, m_data->compactStorage);
+  auto& statics = m_data->MutableStatics ();
+  if (m_bulkLoading)
+    {
+      statics.pendingBuildings.push_back (building);
+    }
+  else
+    {
+      auto start = std::chrono::steady_clock::now ();
+      statics.buildings.insert (building);
+      statics.buildingTreeTime += ElapsedSeconds (start);
+    }
 }
 
 void
@@ -194,7 +1592,20 @@ Environment::AddBuildings (const BuildingList& buildings)
     {
       NS_ASSERT_MSG (b, "building must not be null");
     }
-  m_data->buildings.insert (buildings.begin (), buildings.end ());
+  Data::PrepareObjects (buildings, m_data->compactStorage);
+
+  auto& statics = m_data->MutableStatics ();
+  if (m_bulkLoading)
+    {
+      statics.pendingBuildings.insert (statics.pendingBuildings.end (),
+				       buildings.begin (), buildings.end ());
+    }
+  else
+    {
+      auto start = std::chrono::steady_clock::now ();
+      statics.buildings.insert (buildings.begin (), buildings.end ());
+      statics.buildingTreeTime += ElapsedSeconds (start);
+    }
 }
 
 
@@ -202,23 +1613,126 @@ void
 Environment::AddFoliage (Ptr<Foliage> foliage)
 {
   NS_ASSERT_MSG (foliage, "foliage must not be null");
-  m_data->foliage.insert (foliage);
+  Data::PrepareObject (foliage, m_data->compactStorage);
+  auto& statics = m_data->MutableStatics ();
+  if (m_bulkLoading)
+    {
+      statics.pendingFoliage.push_back (foliage);
+    }
+  else
+    {
+      auto start = std::chrono::steady_clock::now ();
+      statics.foliage.insert (foliage);
+      statics.foliageTreeTime += ElapsedSeconds (start);
+    }
 }
 
 void
 Environment::AddVehicle (Ptr<Vehicle> vehicle)
 {
   NS_ASSERT_MSG (vehicle, "vehicle must not be null");
-  m_data->vehicles.insert (vehicle);
-  m_forceVehicleTreeRebuild = true;
+
+  if ((m_vehicleTreeUpdateMode == VEHICLE_TREE_UPDATE_INCREMENTAL ||
+       UseBackgroundVehicleTreeRebuild ()) && !m_forceVehicleTreeRebuild)
+    {
+      // tree is up to date, just add the new vehicle
+      auto box = MakeVehicleIndexBox (*vehicle);
+      if (m_data->vehicles.Add (vehicle, box))
+	{
+	  m_data->InsertVehicle (std::make_pair (box, PeekPointer (vehicle)));
+	}
+    }
+  else
+    {
+      // the box is updated on the next rebuild
+      m_data->vehicles.Add (vehicle, Box2d ());
+      m_forceVehicleTreeRebuild = true;
+    }
 }
 
 void
 Environment::RemoveVehicle (Ptr<Vehicle> vehicle)
 {
   NS_ASSERT_MSG (vehicle, "vehicle must not be null");
-  m_data->vehicles.erase (vehicle);
-  m_forceVehicleTreeRebuild = true;
+
+  auto slot = m_data->vehicles.Find (PeekPointer (vehicle));
+  if (slot == VehicleStore::NOT_FOUND)
+    {
+      return;
+    }
+
+  if ((m_vehicleTreeUpdateMode == VEHICLE_TREE_UPDATE_INCREMENTAL ||
+       UseBackgroundVehicleTreeRebuild ()) && !m_forceVehicleTreeRebuild)
+    {
+      // remove the vehicle with the box it was indexed with
+      m_data->RemoveVehicle (std::make_pair (m_data->vehicles.GetIndexedBox (slot),
+					     PeekPointer (vehicle)));
+      if (m_data->pendingTree.valid ())
+	{
+	  m_data->removedSincePending.push_back (PeekPointer (vehicle));
+	}
+    }
+  else
+    {
+      m_forceVehicleTreeRebuild = true;
+    }
+
+  m_data->vehicles.Remove (slot);
+}
+
+void
+Environment::UpdateVehicles (const VehicleList& vehicles,
+			     const std::vector<Vector>& positions,
+			     const std::vector<double>& headings)
+{
+  NS_LOG_FUNCTION (this << vehicles.size ());
+  NS_ASSERT_MSG (positions.size () == vehicles.size () &&
+		 headings.size () == vehicles.size (),
+		 "one position and heading per vehicle required");
+
+  auto& store = m_data->vehicles;
+  for (std::size_t i = 0; i < vehicles.size (); ++i)
+    {
+      NS_ASSERT_MSG (vehicles[i], "vehicle must not be null");
+      auto slot = store.Find (PeekPointer (vehicles[i]));
+      if (slot != VehicleStore::NOT_FOUND)
+	{
+	  store.SetPose (slot, positions[i], headings[i]);
+	}
+      else
+	{
+	  vehicles[i]->SetPosition (positions[i]);
+	  vehicles[i]->SetHeading (headings[i]);
+	}
+    }
+}
+
+void
+Environment::SetFastLineIntersection (bool enable)
+{
+  NS_LOG_FUNCTION (this << enable);
+  m_data->fastLineIntersection = enable;
+}
+
+void
+Environment::SetWallIndex (bool enable)
+{
+  NS_LOG_FUNCTION (this << enable);
+  m_data->useWallIndex = enable;
+}
+
+void
+Environment::SetConvexDecomposition (bool enable)
+{
+  NS_LOG_FUNCTION (this << enable);
+  m_data->useConvexParts = enable;
+}
+
+void
+Environment::SetCompactStorage (bool enable)
+{
+  NS_LOG_FUNCTION (this << enable);
+  m_data->compactStorage = enable;
 }
 
 void
@@ -231,40 +1745,125 @@ bool
 Environment::IntersectsAnyBuildings (const LineSegment2d& line) const
 {
   NS_LOG_FUNCTION (this << boost::geometry::wkt (line));
-  return IntersectsAny (m_data->buildings, line);
+  NS_ASSERT_MSG (m_data->statics->IsFinalized (), "Finalize () must be called before queries");
+  m_data->PageTiles (line);
+  if (m_data->useWallIndex)
+    {
+      m_data->statics->CheckWallIndex ();
+      // lines inside of a building do not hit any wall
+      return m_data->statics->walls.IntersectsAny (line) ||
+	  m_data->statics->AnyBuildingContains (line.first);
+    }
+  if (m_data->useConvexParts)
+    {
+      m_data->statics->CheckConvexParts ();
+      return m_data->statics->convexParts.IntersectsAny (line);
+    }
+  return m_data->IntersectsAnyObject (m_data->statics->buildings, line);
 }
 
 bool
 Environment::IntersectsAnyFoliage (const LineSegment2d& line) const
 {
   NS_LOG_FUNCTION (this << boost::geometry::wkt (line));
-  return IntersectsAny (m_data->foliage, line);
+  NS_ASSERT_MSG (m_data->statics->IsFinalized (), "Finalize () must be called before queries");
+  m_data->PageTiles (line);
+  return m_data->IntersectsAnyObject (m_data->statics->foliage, line);
 }
 
 Environment::BuildingList
 Environment::IntersectBuildings (const LineSegment2d& line) const
 {
   NS_LOG_FUNCTION (this << boost::geometry::wkt (line));
+  NS_ASSERT_MSG (m_data->statics->IsFinalized (), "Finalize () must be called before queries");
+  m_data->PageTiles (line);
   BuildingList intersectingBuildings;
-  FindObjectsThatIntersect (m_data->buildings, line,
-			    std::back_inserter(intersectingBuildings));
+  if (m_data->useWallIndex)
+    {
+      m_data->FindBuildingsThatIntersectWalls (line, intersectingBuildings);
+    }
+  else if (m_data->useConvexParts)
+    {
+      m_data->statics->CheckConvexParts ();
+      m_data->statics->convexParts.Intersect (
+	  line, [&intersectingBuildings](const Ptr<Building>& b)
+	  { intersectingBuildings.push_back (b); });
+    }
+  else
+    {
+      m_data->FindObjectsThatIntersectLine (
+	  m_data->statics->buildings, line, std::back_inserter(intersectingBuildings));
+    }
   NS_LOG_LOGIC ("Found " << intersectingBuildings.size ()
 		<< " intersections with buildings");
   return intersectingBuildings;
 }
 
+void
+Environment::IntersectBuildings (const LineSegment2d& line,
+				 const BuildingVisitor& visitor) const
+{
+  NS_LOG_FUNCTION (this << boost::geometry::wkt (line));
+  NS_ASSERT_MSG (m_data->statics->IsFinalized (), "Finalize () must be called before queries");
+  m_data->PageTiles (line);
+  auto output = boost::make_function_output_iterator (
+      [&visitor](const Ptr<Building>& b) { visitor (*b); });
+  if (m_data->useWallIndex)
+    {
+      m_data->statics->CheckWallIndex ();
+      m_data->statics->VisitBuildingsThatIntersectWalls (line, visitor);
+    }
+  else if (m_data->useConvexParts)
+    {
+      m_data->statics->CheckConvexParts ();
+      m_data->statics->convexParts.Intersect (
+	  line, [&visitor](const Ptr<Building>& b) { visitor (*b); });
+    }
+  else
+    {
+      m_data->FindObjectsThatIntersectLine (m_data->statics->buildings, line, output);
+    }
+}
+
+Environment::WallHitList
+Environment::IntersectWalls (const LineSegment2d& line) const
+{
+  NS_LOG_FUNCTION (this << boost::geometry::wkt (line));
+  NS_ASSERT_MSG (m_data->statics->IsFinalized (), "Finalize () must be called before queries");
+  m_data->PageTiles (line);
+  m_data->statics->CheckWallIndex ();
+  auto hits = m_data->statics->walls.Intersect (line);
+  NS_LOG_LOGIC ("Found " << hits.size () << " intersections with walls");
+  return hits;
+}
+
 Environment::FoliageList
 Environment::IntersectFoliage (const LineSegment2d& line) const
 {
   NS_LOG_FUNCTION (this << boost::geometry::wkt (line));
+  NS_ASSERT_MSG (m_data->statics->IsFinalized (), "Finalize () must be called before queries");
+  m_data->PageTiles (line);
   FoliageList intersectingFoliage;
-  FindObjectsThatIntersect (m_data->foliage, line,
-			    std::back_inserter(intersectingFoliage));
+  m_data->FindObjectsThatIntersectLine (
+      m_data->statics->foliage, line, std::back_inserter(intersectingFoliage));
   NS_LOG_LOGIC ("Found " << intersectingFoliage.size ()
 		<< " intersections with foliage");
   return intersectingFoliage;
 }
 
+void
+Environment::IntersectFoliage (const LineSegment2d& line,
+			       const FoliageVisitor& visitor) const
+{
+  NS_LOG_FUNCTION (this << boost::geometry::wkt (line));
+  NS_ASSERT_MSG (m_data->statics->IsFinalized (), "Finalize () must be called before queries");
+  m_data->PageTiles (line);
+  m_data->FindObjectsThatIntersectLine (
+      m_data->statics->foliage, line,
+      boost::make_function_output_iterator (
+	  [&visitor](const Ptr<Foliage>& f) { visitor (*f); }));
+}
+
 Environment::VehicleList
 Environment::IntersectVehicles (const LineSegment2d& line)
 {
@@ -275,11 +1874,11 @@ Environment::IntersectVehicles (const LineSegment2d& line)
 
   VehicleList intersectingVehicles;
 
-  FindObjectsThatIntersect (
-      m_data->vehicleTree, line,
+  m_data->FindVehiclesThatIntersect (
+      line,
       boost::make_function_output_iterator(
 	  [&intersectingVehicles](const typename Data::VehicleTree::value_type& v)
-	  { intersectingVehicles.push_back (v.second); }));
+	  { intersectingVehicles.push_back (Ptr<Vehicle> (v.second)); }));
 
   NS_LOG_LOGIC ("Found " << intersectingVehicles.size ()
 		<< " intersections with vehicles");
@@ -287,16 +1886,32 @@ Environment::IntersectVehicles (const LineSegment2d& line)
   return intersectingVehicles;
 }
 
+void
+Environment::IntersectVehicles (const LineSegment2d& line,
+				const VehicleVisitor& visitor)
+{
+  NS_LOG_FUNCTION (this << boost::geometry::wkt (line));
+
+  CheckVehcileTree ();
+  m_data->FindVehiclesThatIntersect (
+      line,
+      boost::make_function_output_iterator (
+	  [&visitor](const typename Data::VehicleTree::value_type& v)
+	  { visitor (*v.second); }));
+}
+
 Environment::BuildingList
 Environment::FindBuildingsInEllipse (const Point2d& p1, const Point2d& p2, double range) const
 {
   NS_LOG_FUNCTION (
       this << boost::geometry::wkt (p1) << boost::geometry::wkt (p2) << range);
+  NS_ASSERT_MSG (m_data->statics->IsFinalized (), "Finalize () must be called before queries");
+  m_data->PageTiles (MakeBoundingBoxEllipse (p1, p2, range));
 
   BuildingList buildings;
 
-  FindObjectsInEllipse (
-      m_data->buildings, p1, p2, range,
+  m_data->FindBuildingsInEllipse (
+      MakeBoundingBoxEllipse (p1, p2, range), p1, p2, range,
       std::back_inserter(buildings));
 
   NS_LOG_LOGIC ("Found " << buildings.size () << " buildings in ellipse r="
@@ -306,16 +1921,34 @@ Environment::FindBuildingsInEllipse (const Point2d& p1, const Point2d& p2, doubl
   return buildings;
 }
 
+void
+Environment::FindBuildingsInEllipse (const Point2d& p1, const Point2d& p2,
+				     double range,
+				     const BuildingVisitor& visitor) const
+{
+  NS_LOG_FUNCTION (
+      this << boost::geometry::wkt (p1) << boost::geometry::wkt (p2) << range);
+  NS_ASSERT_MSG (m_data->statics->IsFinalized (), "Finalize () must be called before queries");
+  m_data->PageTiles (MakeBoundingBoxEllipse (p1, p2, range));
+
+  m_data->FindBuildingsInEllipse (
+      MakeBoundingBoxEllipse (p1, p2, range), p1, p2, range,
+      boost::make_function_output_iterator (
+	  [&visitor](const Ptr<Building>& b) { visitor (*b); }));
+}
+
 Environment::FoliageList
 Environment::FindFoliageInEllipse (const Point2d& p1, const Point2d& p2, double range) const
 {
   NS_LOG_FUNCTION (
       this << boost::geometry::wkt (p1) << boost::geometry::wkt (p2) << range);
+  NS_ASSERT_MSG (m_data->statics->IsFinalized (), "Finalize () must be called before queries");
+  m_data->PageTiles (MakeBoundingBoxEllipse (p1, p2, range));
 
   FoliageList foliage;
 
   FindObjectsInEllipse (
-      m_data->foliage, p1, p2, range,
+      m_data->statics->foliage, p1, p2, range,
       std::back_inserter(foliage));
 
   NS_LOG_LOGIC ("Found " << foliage.size () << " foliage objects in ellipse r="
@@ -325,6 +1958,22 @@ Environment::FindFoliageInEllipse (const Point2d& p1, const Point2d& p2, double
   return foliage;
 }
 
+void
+Environment::FindFoliageInEllipse (const Point2d& p1, const Point2d& p2,
+				   double range,
+				   const FoliageVisitor& visitor) const
+{
+  NS_LOG_FUNCTION (
+      this << boost::geometry::wkt (p1) << boost::geometry::wkt (p2) << range);
+  NS_ASSERT_MSG (m_data->statics->IsFinalized (), "Finalize () must be called before queries");
+  m_data->PageTiles (MakeBoundingBoxEllipse (p1, p2, range));
+
+  FindObjectsInEllipse (
+      m_data->statics->foliage, p1, p2, range,
+      boost::make_function_output_iterator (
+	  [&visitor](const Ptr<Foliage>& f) { visitor (*f); }));
+}
+
 
 Environment::VehicleList
 Environment::FindVehiclesInEllipse (const Point2d& p1, const Point2d& p2, double range)
@@ -336,11 +1985,11 @@ Environment::FindVehiclesInEllipse (const Point2d& p1, const Point2d& p2, double
 
   VehicleList vehicles;
 
-  FindObjectsInEllipse (
-      m_data->vehicleTree, p1, p2, range,
+  m_data->FindVehiclesInEllipse (
+      MakeBoundingBoxEllipse (p1, p2, range), p1, p2, range,
       boost::make_function_output_iterator(
       	  [&vehicles](const typename Data::VehicleTree::value_type& v)
-      	  { vehicles.push_back (v.second); })
+      	  { vehicles.push_back (Ptr<Vehicle> (v.second)); })
       );
 
   NS_LOG_LOGIC ("Found " << vehicles.size () << " vehicles in ellipse r="
@@ -350,63 +1999,710 @@ Environment::FindVehiclesInEllipse (const Point2d& p1, const Point2d& p2, double
   return vehicles;
 }
 
+void
+Environment::FindVehiclesInEllipse (const Point2d& p1, const Point2d& p2,
+				    double range,
+				    const VehicleVisitor& visitor)
+{
+  NS_LOG_FUNCTION (
+      this << boost::geometry::wkt (p1) << boost::geometry::wkt (p2) << range);
+
+  CheckVehcileTree ();
+  m_data->FindVehiclesInEllipse (
+      MakeBoundingBoxEllipse (p1, p2, range), p1, p2, range,
+      boost::make_function_output_iterator (
+	  [&visitor](const typename Data::VehicleTree::value_type& v)
+	  { visitor (*v.second); }));
+}
+
 Environment::ObjectCollection
 Environment::FindAllObjectsInEllipse (const Point2d& p1, const Point2d& p2, double range)
 {
   NS_LOG_FUNCTION (
       this << boost::geometry::wkt (p1) << boost::geometry::wkt (p2) << range);
+  NS_ASSERT_MSG (m_data->statics->IsFinalized (), "Finalize () must be called before queries");
 
   // Calculate bounding box around ellipse
   auto bBox = MakeBoundingBoxEllipse (p1, p2, range);
+  m_data->PageTiles (bBox);
 
   NS_LOG_LOGIC ("Bounding box: " << boost::geometry::wkt (bBox));
 
   ObjectCollection objects;
 
   // collect buildings
-  FindObjectsInEllipse (
-      m_data->buildings, bBox, p1, p2, range,
-      std::back_inserter(objects.buildings));
+  m_data->FindBuildingsInEllipse (
+      bBox, p1, p2, range, std::back_inserter(objects.buildings));
 
   // collect foliage
   FindObjectsInEllipse (
-      m_data->foliage, bBox, p1, p2, range,
+      m_data->statics->foliage, bBox, p1, p2, range,
       std::back_inserter(objects.foliage));
 
   // collect vehicles
   CheckVehcileTree ();
-  FindObjectsInEllipse (
-      m_data->vehicleTree, bBox, p1, p2, range,
+  m_data->FindVehiclesInEllipse (
+      bBox, p1, p2, range,
       boost::make_function_output_iterator(
       	  [&objects](const typename Data::VehicleTree::value_type& v)
-      	  { objects.vehicles.push_back (v.second); })
+      	  { objects.vehicles.push_back (Ptr<Vehicle> (v.second)); })
       );
 
   return objects;
 }
 
+void
+Environment::FindAllObjectsInEllipse (const Point2d& p1, const Point2d& p2,
+				      double range,
+				      const BuildingVisitor& buildingVisitor,
+				      const FoliageVisitor& foliageVisitor,
+				      const VehicleVisitor& vehicleVisitor)
+{
+  NS_LOG_FUNCTION (
+      this << boost::geometry::wkt (p1) << boost::geometry::wkt (p2) << range);
+  NS_ASSERT_MSG (m_data->statics->IsFinalized (), "Finalize () must be called before queries");
+
+  // Calculate bounding box around ellipse
+  auto bBox = MakeBoundingBoxEllipse (p1, p2, range);
+  m_data->PageTiles (bBox);
+
+  if (buildingVisitor)
+    {
+      m_data->FindBuildingsInEllipse (
+	  bBox, p1, p2, range,
+	  boost::make_function_output_iterator (
+	      [&buildingVisitor](const Ptr<Building>& b) { buildingVisitor (*b); }));
+    }
+
+  if (foliageVisitor)
+    {
+      FindObjectsInEllipse (
+	  m_data->statics->foliage, bBox, p1, p2, range,
+	  boost::make_function_output_iterator (
+	      [&foliageVisitor](const Ptr<Foliage>& f) { foliageVisitor (*f); }));
+    }
+
+  if (vehicleVisitor)
+    {
+      CheckVehcileTree ();
+      m_data->FindVehiclesInEllipse (
+	  bBox, p1, p2, range,
+	  boost::make_function_output_iterator (
+	      [&vehicleVisitor](const typename Data::VehicleTree::value_type& v)
+	      { vehicleVisitor (*v.second); }));
+    }
+}
+
+Environment::EllipseOccupancy
+Environment::GetOccupancyInEllipse (const Point2d& p1, const Point2d& p2,
+				    double range,
+				    Ptr<const Vehicle> excluded1,
+				    Ptr<const Vehicle> excluded2)
+{
+  NS_LOG_FUNCTION (
+      this << boost::geometry::wkt (p1) << boost::geometry::wkt (p2) << range);
+  NS_ASSERT_MSG (m_data->statics->IsFinalized (), "Finalize () must be called before queries");
+
+  // Calculate bounding box around ellipse
+  auto bBox = MakeBoundingBoxEllipse (p1, p2, range);
+  m_data->PageTiles (bBox);
+
+  // exact test for objects close to the border of the ellipse
+  auto inEllipse = [&p1, &p2, range] (const Polygon2d& shape)
+  {
+    return boost::geometry::distance (p1, shape) +
+	boost::geometry::distance (p2, shape) < range;
+  };
+
+  m_data->statics->CheckAggregates ();
+  if (m_data->useConvexParts)
+    {
+      m_data->statics->CheckConvexParts ();
+    }
+
+  double objectArea = m_data->statics->GetObjectAreaInEllipse (
+      bBox, p1, p2, range, m_data->useConvexParts);
+
+  CheckVehcileTree ();
+  if (!m_data->vehicleAggregatesValid)
+    {
+      m_data->UpdateVehicleAggregates ();
+    }
+
+  const Vehicle* e1 = PeekPointer (excluded1);
+  const Vehicle* e2 = PeekPointer (excluded2);
+
+  // whole subtrees can only be accepted if the indexed boxes are padded
+  // to cover the vehicles until the next update
+  bool boxesCoverVehicles = m_maxVehicleSpeed > 0;
+
+  auto countVehicle =
+      [&inEllipse, boxesCoverVehicles, e1, e2](const Data::BoxedVehicle& v)
+      {
+	const Vehicle* vehicle = v.second;
+	return (boxesCoverVehicles || (vehicle != e1 && vehicle != e2)) &&
+	    inEllipse (v.second->GetShape ());
+      };
+
+  auto vehicles = m_data->vehicleAggregates.Accumulate (
+      bBox, p1, p2, range, countVehicle, boxesCoverVehicles);
+
+  if (boxesCoverVehicles)
+    {
+      // the excluded vehicles might be part of an accepted subtree, remove
+      // them if they have been counted, which depends on their indexed box
+      // rather than their current shape
+      for (const Vehicle* e : {e1, e2 != e1 ? e2 : nullptr})
+	{
+	  auto slot = e ? m_data->vehicles.Find (e) : VehicleStore::NOT_FOUND;
+	  if (slot != VehicleStore::NOT_FOUND &&
+	      m_data->vehicleAggregates.IsCounted (
+		  std::make_pair (m_data->vehicles.GetIndexedBox (slot),
+				  PeekPointer (m_data->vehicles.GetVehicle (slot))),
+		  bBox, p1, p2, range, countVehicle))
+	    {
+	      --vehicles.objects;
+	    }
+	}
+    }
+
+  EllipseOccupancy occupancy {vehicles.objects, objectArea};
+
+  NS_LOG_LOGIC ("Found " << occupancy.vehicles << " vehicles and "
+		<< occupancy.objectArea << " m^2 covered by objects in ellipse");
+
+  return occupancy;
+}
+
+Environment::VehicleSnapshotPtr
+Environment::PublishVehicleSnapshot ()
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (m_data->statics->IsFinalized (), "Finalize () must be called before queries");
+
+  ApplyQueuedVehicleUpdates ();
+
+  if (m_data->statics->tiles)
+    {
+      // snapshot queries cannot load tiles, load and pin the reach of
+      // each vehicle until the next snapshot
+      double reach = m_data->snapshotQueryRange / 2;
+      std::vector<Box2d> areas;
+      areas.reserve (m_data->vehicles.GetSize ());
+      for (std::size_t i = 0; i < m_data->vehicles.GetSize (); ++i)
+	{
+	  auto box = m_data->vehicles.GetVehicle (i)->GetBoundingBox ();
+	  areas.push_back (Box2d (
+	      Point2d (box.min_corner ().x () - reach, box.min_corner ().y () - reach),
+	      Point2d (box.max_corner ().x () + reach, box.max_corner ().y () + reach)));
+	}
+      m_data->PinSnapshotTiles (areas);
+    }
+
+  // bring all lazily built indexes up to date, const queries must not
+  // modify the environment while other threads are reading
+  m_data->statics->CheckAggregates ();
+  if (m_data->useWallIndex)
+    {
+      m_data->statics->CheckWallIndex ();
+    }
+  if (m_data->useConvexParts)
+    {
+      m_data->statics->CheckConvexParts ();
+    }
+
+  std::vector<VehicleSnapshot::Entry> entries;
+  entries.reserve (m_data->vehicles.GetSize ());
+  for (std::size_t i = 0; i < m_data->vehicles.GetSize (); ++i)
+    {
+      auto& vehicle = *m_data->vehicles.GetVehicle (i);
+      entries.push_back (VehicleSnapshot::Entry {
+	  &vehicle, vehicle.GetShape (),
+	  vehicle.GetBoundingBox (), vehicle.GetHeight ()});
+    }
+
+  VehicleSnapshotPtr snapshot = std::make_shared<const VehicleSnapshot> (
+      std::move (entries), ++m_data->snapshotEpoch, Simulator::Now ());
+  std::atomic_store (&m_data->vehicleSnapshot, snapshot);
+
+  NS_LOG_LOGIC ("Published vehicle snapshot " << snapshot->GetEpoch ()
+		<< " with " << snapshot->GetNumVehicles () << " vehicles");
+
+  return snapshot;
+}
+
+void
+Environment::SetSnapshotQueryRange (double range)
+{
+  NS_ASSERT_MSG (range >= 0, "range must not be negative");
+  m_data->snapshotQueryRange = range;
+}
+
+Environment::VehicleSnapshotPtr
+Environment::GetVehicleSnapshot () const
+{
+  return std::atomic_load (&m_data->vehicleSnapshot);
+}
+
+Environment::EllipseOccupancy
+Environment::GetOccupancyInEllipse (const VehicleSnapshot& snapshot,
+				    const Point2d& p1, const Point2d& p2,
+				    double range,
+				    const Vehicle* excluded1,
+				    const Vehicle* excluded2) const
+{
+  auto bBox = MakeBoundingBoxEllipse (p1, p2, range);
+  NS_ASSERT_MSG (m_data->IsPreparedForSnapshot (bBox),
+		 "PublishVehicleSnapshot () must be called after adding objects "
+		 "and the ellipse must be within the snapshot query range");
+
+  return EllipseOccupancy {
+    snapshot.CountVehiclesInEllipse (p1, p2, range, excluded1, excluded2),
+    m_data->statics->GetObjectAreaInEllipse (bBox, p1, p2, range,
+					     m_data->useConvexParts)};
+}
+
+void
+Environment::IntersectBuildings (const VehicleSnapshot& snapshot,
+				 const LineSegment2d& line,
+				 const BuildingVisitor& visitor) const
+{
+  Box2d bBox;
+  boost::geometry::envelope (line, bBox);
+  NS_ASSERT_MSG (m_data->IsPreparedForSnapshot (bBox),
+		 "PublishVehicleSnapshot () must be called after adding objects "
+		 "and the line must be within the snapshot query range");
+  m_data->CheckSnapshotEpoch (snapshot);
+
+  auto const& statics = *m_data->statics;
+  if (m_data->useWallIndex)
+    {
+      statics.VisitBuildingsThatIntersectWalls (line, visitor);
+    }
+  else if (m_data->useConvexParts)
+    {
+      statics.convexParts.Intersect (
+	  line, [&visitor](const Ptr<Building>& b) { visitor (*b); });
+    }
+  else
+    {
+      m_data->FindObjectsThatIntersectLine (
+	  statics.buildings, line,
+	  boost::make_function_output_iterator (
+	      [&visitor](const Ptr<Building>& b) { visitor (*b); }));
+    }
+}
+
+void
+Environment::IntersectFoliage (const VehicleSnapshot& snapshot,
+			       const LineSegment2d& line,
+			       const FoliageVisitor& visitor) const
+{
+  Box2d bBox;
+  boost::geometry::envelope (line, bBox);
+  NS_ASSERT_MSG (m_data->IsPreparedForSnapshot (bBox),
+		 "PublishVehicleSnapshot () must be called after adding objects "
+		 "and the line must be within the snapshot query range");
+  m_data->CheckSnapshotEpoch (snapshot);
+
+  m_data->FindObjectsThatIntersectLine (
+      m_data->statics->foliage, line,
+      boost::make_function_output_iterator (
+	  [&visitor](const Ptr<Foliage>& f) { visitor (*f); }));
+}
+
+void
+Environment::IntersectVehicles (const VehicleSnapshot& snapshot,
+				const LineSegment2d& line,
+				const VehicleSnapshot::EntryVisitor& visitor) const
+{
+  snapshot.IntersectVehicles (line, visitor);
+}
+
+void
+Environment::QueueVehicleUpdate (Ptr<Vehicle> vehicle, const Vector& position,
+				 double heading)
+{
+  NS_ASSERT_MSG (vehicle, "vehicle must not be null");
+
+  auto& data = *m_data;
+  auto inserted = data.queuedIndexes.insert (
+      std::make_pair (PeekPointer (vehicle), data.queuedVehicles.size ()));
+  if (inserted.second)
+    {
+      data.queuedVehicles.push_back (vehicle);
+      data.queuedPositions.push_back (position);
+      data.queuedHeadings.push_back (heading);
+    }
+  else
+    {
+      // only the latest pose matters
+      data.queuedPositions[inserted.first->second] = position;
+      data.queuedHeadings[inserted.first->second] = heading;
+    }
+}
+
+void
+Environment::TrackVehicle (Ptr<Vehicle> vehicle, Ptr<const MobilityModel> mobility)
+{
+  NS_LOG_FUNCTION (this << vehicle << mobility);
+  NS_ASSERT_MSG (vehicle && mobility, "vehicle and mobility must not be null");
+
+  auto& data = *m_data;
+  auto& tracked = data.trackedVehicles[PeekPointer (vehicle)];
+  if (!tracked.vehicle)
+    {
+      tracked.vehicle = vehicle;
+      tracked.heading = vehicle->GetHeading ();
+      tracked.moving = false;
+    }
+  tracked.mobility = mobility;
+
+  // the vehicle might not be registered yet, so move it directly
+  Vector position;
+  if (tracked.Sample (position) && !tracked.moving)
+    {
+      tracked.moving = true;
+      data.movingVehicles.push_back (PeekPointer (vehicle));
+    }
+  vehicle->SetPosition (position);
+  vehicle->SetHeading (tracked.heading);
+}
+
+void
+Environment::UntrackVehicle (Ptr<Vehicle> vehicle)
+{
+  NS_LOG_FUNCTION (this << vehicle);
+
+  auto& data = *m_data;
+  auto it = data.trackedVehicles.find (PeekPointer (vehicle));
+  if (it == data.trackedVehicles.end ())
+    {
+      return;
+    }
+
+  if (it->second.moving)
+    {
+      data.movingVehicles.erase (std::find (data.movingVehicles.begin (),
+					    data.movingVehicles.end (),
+					    it->first));
+    }
+  data.trackedVehicles.erase (it);
+}
+
+void
+Environment::NotifyCourseChange (const Vehicle* vehicle)
+{
+  auto& data = *m_data;
+  auto it = data.trackedVehicles.find (vehicle);
+  if (it == data.trackedVehicles.end ())
+    {
+      return;
+    }
+
+  // the course may change after the vehicles were sampled for this time
+  data.lastVehicleSample = Time::Min ();
+  if (!it->second.moving)
+    {
+      it->second.moving = true;
+      data.movingVehicles.push_back (vehicle);
+    }
+}
+
+void
+Environment::ApplyQueuedVehicleUpdates ()
+{
+  auto& data = *m_data;
+
+  // sample the moving vehicles and drop those which came to a stop,
+  // the poses cannot change without the simulation time advancing
+  if (data.lastVehicleSample != Simulator::Now ())
+    {
+      data.lastVehicleSample = Simulator::Now ();
+      auto stopped = std::remove_if (
+	  data.movingVehicles.begin (), data.movingVehicles.end (),
+	  [this, &data] (const Vehicle* vehicle)
+	  {
+	    auto& tracked = data.trackedVehicles.at (vehicle);
+	    Vector position;
+	    tracked.moving = tracked.Sample (position);
+	    QueueVehicleUpdate (tracked.vehicle, position, tracked.heading);
+	    return !tracked.moving;
+	  });
+      data.movingVehicles.erase (stopped, data.movingVehicles.end ());
+    }
+
+  if (data.queuedVehicles.empty ())
+    {
+      return;
+    }
+
+  NS_LOG_LOGIC ("Applying " << data.queuedVehicles.size ()
+		<< " queued vehicle updates");
+
+  UpdateVehicles (data.queuedVehicles, data.queuedPositions, data.queuedHeadings);
+  data.queuedVehicles.clear ();
+  data.queuedPositions.clear ();
+  data.queuedHeadings.clear ();
+  data.queuedIndexes.clear ();
+}
+
 void
 Environment::CheckVehcileTree ()
 {
-  if (m_forceVehicleTreeRebuild ||
-      (m_lastVehicleTreeRebuild + m_vehicleTreeRebuildInterval < Simulator::Now ()))
+  ApplyQueuedVehicleUpdates ();
+
+  if (m_forceVehicleTreeRebuild)
+    {
+      RebuildVehicleTree ();
+    }
+  else if (m_lastVehicleTreeRebuild + m_vehicleTreeRebuildInterval < Simulator::Now ())
+    {
+      switch (m_vehicleTreeUpdateMode)
+	{
+	case VEHICLE_TREE_UPDATE_INCREMENTAL:
+	  UpdateMovedVehicles ();
+	  break;
+	case VEHICLE_TREE_UPDATE_FULL_REBUILD:
+	default:
+	  if (!UseBackgroundVehicleTreeRebuild () || !SwapPendingVehicleTree ())
+	    {
+	      RebuildVehicleTree ();
+	    }
+	  break;
+	}
+    }
+
+  // start the next tree halfway through the interval
+  if (UseBackgroundVehicleTreeRebuild () && !m_data->pendingTree.valid () &&
+      m_lastVehicleTreeRebuild +
+      Seconds (m_vehicleTreeRebuildInterval.GetSeconds () / 2) < Simulator::Now ())
     {
-      NS_LOG_LOGIC ("Rebuilding vehicle tree");
+      StartPendingVehicleTree ();
+    }
+}
 
-      // clear existing tree
-      m_data->vehicleTree.clear ();
+Box2d
+Environment::MakeVehicleIndexBox (Vehicle& vehicle) const
+{
+  return MakeVehicleIndexBox (vehicle, m_vehicleTreeRebuildInterval);
+}
 
-      // add all vehicles to the tree
-      for (auto v : m_data->vehicles)
+Box2d
+Environment::MakeVehicleIndexBox (Vehicle& vehicle, Time horizon) const
+{
+  if (m_maxVehicleSpeed > 0)
+    {
+      // cover any heading and the movement within the horizon
+      double padding = m_maxVehicleSpeed * horizon.GetSeconds ();
+      return MakeBoundingBoxCircle (MakePoint2d (vehicle.GetPosition ()),
+				    vehicle.GetRadius () + padding);
+    }
+  else
+    {
+      return vehicle.GetBoundingBox ();
+    }
+}
+
+void
+Environment::MakeVehicleIndexBoxes (Time horizon, std::vector<Box2d>& boxes)
+{
+  if (m_maxVehicleSpeed > 0)
+    {
+      // same boxes as MakeVehicleIndexBox ()
+      m_data->vehicles.ComputeCircleBoxes (m_maxVehicleSpeed * horizon.GetSeconds (),
+					   boxes);
+    }
+  else
+    {
+      m_data->vehicles.ComputeBoundingBoxes (boxes);
+    }
+}
+
+void
+Environment::RebuildVehicleTree ()
+{
+  NS_LOG_LOGIC ("Rebuilding vehicle tree");
+
+  // a tree built in the background refers to older positions
+  m_data->DiscardPendingTree ();
+
+  // clear existing tree
+  m_data->ClearVehicleIndex ();
+
+  // compute the updated bounding boxes of all vehicles at once
+  auto& vehicles = m_data->vehicles;
+  std::vector<Box2d> boxes;
+  MakeVehicleIndexBoxes (m_vehicleTreeRebuildInterval, boxes);
+  vehicles.ClearDirty ();
+
+  std::vector<Data::BoxedVehicle> indexed;
+  indexed.reserve (boxes.size ());
+  for (std::size_t i = 0; i < boxes.size (); ++i)
+    {
+      vehicles.GetIndexedBox (i) = boxes[i];
+      indexed.push_back (std::make_pair (boxes[i], PeekPointer (vehicles.GetVehicle (i))));
+    }
+
+  // add all vehicles to the index, the tree is packed in one go
+  if (m_data->vehicleIndexType == VEHICLE_INDEX_GRID)
+    {
+      for (auto const& v : indexed)
 	{
-	  // insert vehicle with updated bounding box
-	  // TODO: enlarge bounding box to compensate for movement between updates
-	  m_data->vehicleTree.insert (std::make_pair (v->GetBoundingBox (), v));
+	  m_data->InsertVehicle (v);
 	}
+    }
+  else
+    {
+      Data::VehicleTree packed (indexed.begin (), indexed.end ());
+      m_data->vehicleTree.swap (packed);
+    }
 
-      m_lastVehicleTreeRebuild = Simulator::Now ();
-      m_forceVehicleTreeRebuild = false;
+  m_lastVehicleTreeRebuild = Simulator::Now ();
+  m_forceVehicleTreeRebuild = false;
+  ++m_data->rebuildStatistics.synchronousRebuilds;
+}
+
+void
+Environment::UpdateMovedVehicles ()
+{
+  std::size_t updated = 0;
+
+  // only vehicles moved since the last update can have left their box
+  auto& vehicles = m_data->vehicles;
+  auto moved = vehicles.TakeDirtySlots ();
+  double padding = m_maxVehicleSpeed * m_vehicleTreeRebuildInterval.GetSeconds ();
+  for (auto slot : moved)
+    {
+      // same boxes as MakeVehicleIndexBox ()
+      auto box = m_maxVehicleSpeed > 0 ?
+	  vehicles.ComputeCircleBox (slot, padding) :
+	  vehicles.ComputeBoundingBox (slot);
+
+      // the vehicle can stay if it cannot leave its indexed box
+      // until the next update
+      auto& indexedBox = vehicles.GetIndexedBox (slot);
+      if (!boost::geometry::covered_by (box, indexedBox))
+	{
+	  Vehicle* vehicle = PeekPointer (vehicles.GetVehicle (slot));
+	  m_data->RemoveVehicle (std::make_pair (indexedBox, vehicle));
+	  indexedBox = box;
+	  m_data->InsertVehicle (std::make_pair (indexedBox, vehicle));
+	  ++updated;
+	}
     }
+
+  NS_LOG_LOGIC ("Updated " << updated << " of " << moved.size () << " moved of "
+		<< vehicles.GetSize () << " vehicles in the vehicle tree");
+
+  m_lastVehicleTreeRebuild = Simulator::Now ();
+}
+
+bool
+Environment::UseBackgroundVehicleTreeRebuild () const
+{
+  // without motion padding, the results depend on the time the boxes
+  // are taken, which has to be the time of the rebuild
+  return m_backgroundVehicleTreeRebuild && m_maxVehicleSpeed > 0 &&
+      m_vehicleTreeUpdateMode == VEHICLE_TREE_UPDATE_FULL_REBUILD &&
+      m_data->vehicleIndexType == VEHICLE_INDEX_RTREE;
+}
+
+void
+Environment::StartPendingVehicleTree ()
+{
+  NS_LOG_LOGIC ("Starting background rebuild of the vehicle tree");
+
+  // the tree becomes active at the next interval boundary and stays
+  // active for one more interval
+  Time horizon = m_vehicleTreeRebuildInterval * 2;
+
+  std::vector<Box2d> boxes;
+  MakeVehicleIndexBoxes (horizon, boxes);
+
+  m_data->pendingBoxes.clear ();
+  m_data->pendingBoxes.reserve (boxes.size ());
+  for (std::size_t i = 0; i < boxes.size (); ++i)
+    {
+      m_data->pendingBoxes.push_back (
+	  std::make_pair (boxes[i], PeekPointer (m_data->vehicles.GetVehicle (i))));
+    }
+  m_data->pendingTime = Simulator::Now ();
+  m_data->removedSincePending.clear ();
+
+  // the worker only gets a copy of the boxes, it never touches a vehicle
+  m_data->pendingTree = std::async (std::launch::async, &Data::PackVehicleTree,
+				    m_data->pendingBoxes);
+}
+
+bool
+Environment::SwapPendingVehicleTree ()
+{
+  if (!m_data->pendingTree.valid ())
+    {
+      return false;
+    }
+
+  auto start = std::chrono::steady_clock::now ();
+  auto packed = m_data->pendingTree.get ();
+  double waitTime = ElapsedSeconds (start);
+
+  auto& statistics = m_data->rebuildStatistics;
+  statistics.waitTime += waitTime;
+
+  // the boxes have to cover the vehicles until the next boundary
+  if (m_data->pendingTime + m_vehicleTreeRebuildInterval * 2 <
+      Simulator::Now () + m_vehicleTreeRebuildInterval)
+    {
+      NS_LOG_LOGIC ("Background vehicle tree is outdated");
+      m_data->DiscardPendingTree ();
+      return false;
+    }
+
+  // apply vehicles removed in the meantime, this includes vehicles
+  // removed and added again
+  auto& vehicles = m_data->vehicles;
+  std::sort (m_data->removedSincePending.begin (),
+	     m_data->removedSincePending.end ());
+  std::vector<bool> packedVehicles (vehicles.GetSize (), false);
+  for (auto const& pending : m_data->pendingBoxes)
+    {
+      auto slot = vehicles.Find (pending.second);
+      if (slot == VehicleStore::NOT_FOUND ||
+	  std::binary_search (m_data->removedSincePending.begin (),
+			      m_data->removedSincePending.end (), pending.second))
+	{
+	  packed.tree.remove (pending);
+	  continue;
+	}
+      vehicles.GetIndexedBox (slot) = pending.first;
+      packedVehicles[slot] = true;
+    }
+
+  // apply vehicles added in the meantime
+  for (std::size_t i = 0; i < vehicles.GetSize (); ++i)
+    {
+      if (!packedVehicles[i])
+	{
+	  auto& vehicle = *vehicles.GetVehicle (i);
+	  vehicles.GetIndexedBox (i) = MakeVehicleIndexBox (vehicle);
+	  packed.tree.insert (std::make_pair (vehicles.GetIndexedBox (i), &vehicle));
+	}
+    }
+
+  m_data->vehicleTree.swap (packed.tree);
+  m_data->vehicleAggregatesValid = false;
+  vehicles.ClearDirty ();
+  m_data->DiscardPendingTree ();
+
+  ++statistics.backgroundRebuilds;
+  statistics.stallTimeSaved += std::max (packed.packTime - waitTime, 0.0);
+
+  NS_LOG_LOGIC ("Swapped in vehicle tree packed in " << packed.packTime
+		<< "s, waited " << waitTime << "s");
+
+  m_lastVehicleTreeRebuild = Simulator::Now ();
+  return true;
 }
 
 }  // namespace gemv2
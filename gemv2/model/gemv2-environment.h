@@ -30,17 +30,28 @@
  * https://svn.boost.org/trac/boost/ticket/12443
  */
 #include <iostream>
+#include <functional>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include <ns3/ptr.h>
 #include <ns3/simple-ref-count.h>
 #include <ns3/nstime.h>
 
+#include <ns3/gemv2-types.h>
 #include <ns3/gemv2-building.h>
 #include <ns3/gemv2-foliage.h>
 #include <ns3/gemv2-vehicle.h>
+#include <ns3/gemv2-wall-index.h>
+#include <ns3/gemv2-convex-part-index.h>
+#include <ns3/gemv2-vehicle-snapshot.h>
+#include <ns3/gemv2-static-layer-tiles.h>
 
 namespace ns3 {
+
+class MobilityModel;
+
 namespace gemv2 {
 
 /*!
@@ -48,6 +59,14 @@ namespace gemv2 {
  *
  * This class manages all objects (buildings, foliage, vehicles)
  * that influence the propagation behavior.
+ *
+ * The environment itself is not thread-safe, not even its const
+ * queries, which may load tiles, build indexes or copy object pointers.
+ * To calculate links in parallel, publish a VehicleSnapshot from the
+ * simulation thread and only use the overloads taking the snapshot from
+ * the worker threads: GetOccupancyInEllipse(), IntersectBuildings(),
+ * IntersectFoliage() and IntersectVehicles() with a visitor. No other
+ * method may be called while the worker threads are running.
  */
 class Environment : public SimpleRefCount<Environment>
 {
@@ -70,6 +89,21 @@ public:
   //! List of vehicles
   using VehicleList = PointerList<Vehicle>;
 
+  //! A list of hit walls sorted by distance
+  using WallHitList = WallIndex::WallHitList;
+
+  //! Shared reference to an immutable vehicle snapshot
+  using VehicleSnapshotPtr = std::shared_ptr<const VehicleSnapshot>;
+
+  //! Callback for buildings found by a query
+  using BuildingVisitor = std::function<void (const Building&)>;
+
+  //! Callback for foliage objects found by a query
+  using FoliageVisitor = std::function<void (const Foliage&)>;
+
+  //! Callback for vehicles found by a query
+  using VehicleVisitor = std::function<void (Vehicle&)>;
+
   //! Collection of objects
   struct ObjectCollection
   {
@@ -78,6 +112,49 @@ public:
     VehicleList vehicles;
   };
 
+  //! Aggregated occupancy of an ellipse
+  struct EllipseOccupancy
+  {
+    //! Number of vehicles in the ellipse
+    std::size_t vehicles;
+    //! Area covered by buildings and foliage in the ellipse [m^2]
+    double objectArea;
+  };
+
+  //! Construction time and structure of a tree for static objects
+  struct TreeStatistics
+  {
+    //! Number of objects in the tree
+    std::size_t objects;
+    //! Number of levels (including the leaf level)
+    std::size_t levels;
+    //! Number of internal nodes
+    std::size_t nodes;
+    //! Number of leaf nodes
+    std::size_t leaves;
+    //! Minimum number of objects in a leaf node
+    std::size_t minObjectsPerLeaf;
+    //! Maximum number of objects in a leaf node
+    std::size_t maxObjectsPerLeaf;
+    //! Average fill ratio of the leaf nodes (1.0 = all leaves full)
+    double leafFillRatio;
+    //! Wall clock time spent constructing the tree [s]
+    double constructionTime;
+  };
+
+  //! Statistics about the rebuilds of the vehicle tree
+  struct VehicleTreeRebuildStatistics
+  {
+    //! Number of trees built on the simulation thread
+    std::size_t synchronousRebuilds;
+    //! Number of trees built on a worker thread
+    std::size_t backgroundRebuilds;
+    //! Wall clock time spent waiting for worker threads [s]
+    double waitTime;
+    //! Wall clock time the worker threads spent in parallel to the simulation [s]
+    double stallTimeSaved;
+  };
+
   /*
    * Class members
    */
@@ -105,6 +182,249 @@ public:
   void
   SetVehicleTreeRebuildInterval (Time t);
 
+  /*!
+   * @brief Set the maximum speed of all vehicles.
+   *
+   * If set to a positive value, vehicles are indexed with a box covering
+   * every position they can reach at this speed within the rebuild interval
+   * (for any heading). Queries refine the candidates against the current
+   * vehicle shape, thus results stay exact while the tree only needs to be
+   * updated once per rebuild interval. Vehicles moving faster than this
+   * (e.g. teleported ones) require a call to ForceVehicleTreeRebuild().
+   *
+   * A value of 0 (default) indexes vehicles with their current bounding box.
+   *
+   * @param speed	Maximum speed of the vehicles [m/s]
+   */
+  void
+  SetMaxVehicleSpeed (double speed);
+
+  /*!
+   * @brief Select the spatial index used for vehicles.
+   *
+   * VEHICLE_INDEX_GRID stores vehicles in a uniform grid with constant
+   * time updates, which is best suited for dense scenarios with frequent
+   * updates (use together with VEHICLE_TREE_UPDATE_INCREMENTAL).
+   * Changing the index triggers a rebuild on the next query.
+   *
+   * @param type	Index used for vehicles
+   */
+  void
+  SetVehicleIndexType (VehicleIndexType type);
+
+  /*!
+   * @brief Set the cell size of the vehicle grid.
+   *
+   * This is only used with VEHICLE_INDEX_GRID. The cell size should be in
+   * the order of the indexed vehicle boxes.
+   *
+   * @param cellSize	Edge length of a grid cell [m]
+   */
+  void
+  SetVehicleGridCellSize (double cellSize);
+
+  /*!
+   * @brief Set the strategy used to keep the vehicle tree up to date.
+   *
+   * With VEHICLE_TREE_UPDATE_INCREMENTAL, added and removed vehicles are
+   * applied to the tree directly and only vehicles that left their indexed
+   * bounding box are re-inserted when the rebuild interval expires.
+   * Switching the mode triggers a full rebuild on the next query.
+   *
+   * @param mode	Update strategy for the vehicle tree
+   */
+  void
+  SetVehicleTreeUpdateMode (VehicleTreeUpdateMode mode);
+
+  /*!
+   * @brief Enable/disable building the vehicle tree on a worker thread.
+   *
+   * If enabled, the boxes of all vehicles are copied halfway through the
+   * rebuild interval and the next tree is packed from them on a worker
+   * thread, while queries keep using the current tree. The new tree is
+   * swapped in at the next interval boundary. Vehicles added or removed
+   * in the meantime are applied to the new tree before the swap.
+   *
+   * The copied boxes are padded to cover the vehicles until the end of
+   * the following interval. Since queries refine the candidates against
+   * the current vehicle shapes, they return the same vehicles as with a
+   * synchronous rebuild. The order of the returned vehicles follows the
+   * tree and may differ from a synchronous rebuild, it is unspecified in
+   * both modes. If no query happened for more than an interval,
+   * the outdated tree is dropped and the tree is rebuilt synchronously.
+   *
+   * This requires motion padding (see SetMaxVehicleSpeed()), the
+   * VEHICLE_TREE_UPDATE_FULL_REBUILD mode and VEHICLE_INDEX_RTREE.
+   * Otherwise, the tree is rebuilt synchronously.
+   *
+   * @param enable	True to build the vehicle tree in the background
+   */
+  void
+  SetBackgroundVehicleTreeRebuild (bool enable);
+
+  /*!
+   * @brief Get statistics about the rebuilds of the vehicle tree.
+   * @return Number of rebuilds and time saved by background rebuilds
+   */
+  VehicleTreeRebuildStatistics
+  GetVehicleTreeRebuildStatistics () const;
+
+  /*!
+   * @brief Enable/disable bulk loading of buildings and foliage.
+   *
+   * If enabled, added buildings and foliage objects are only buffered.
+   * The trees are constructed at once with the packing algorithm when
+   * Finalize() is called, which is much faster than inserting objects one
+   * by one and usually leads to a better tree structure. Buildings and
+   * foliage must not be queried before calling Finalize().
+   *
+   * Disabling bulk loading will finalize the buffered objects.
+   *
+   * @param enable	True to buffer static objects until Finalize()
+   */
+  void
+  SetBulkLoading (bool enable);
+
+  /*!
+   * @brief Check if bulk loading is enabled.
+   * @return True if static objects are buffered until Finalize()
+   */
+  bool
+  IsBulkLoading () const;
+
+  /*!
+   * @brief Construct the trees for all buffered buildings and foliage.
+   *
+   * Objects already in the trees are packed together with the buffered
+   * ones. Nothing happens if no objects are buffered.
+   */
+  void
+  Finalize ();
+
+  /*!
+   * @brief Get statistics about the building tree.
+   * @return Construction time and structure of the building tree
+   */
+  TreeStatistics
+  GetBuildingTreeStatistics () const;
+
+  /*!
+   * @brief Get statistics about the foliage tree.
+   * @return Construction time and structure of the foliage tree
+   */
+  TreeStatistics
+  GetFoliageTreeStatistics () const;
+
+  /*!
+   * @brief Create a new environment sharing the static objects.
+   *
+   * The new environment refers to the same buildings, foliage and trees
+   * without copying them, which makes it cheap to run many environments
+   * (e.g. for parameter sweeps) on the same city. Vehicles and vehicle
+   * index settings are not copied. The static objects are copied on
+   * demand if one of the environments adds buildings or foliage later.
+   *
+   * With tiles (see OpenStaticLayerTiles()), the resident tiles and the
+   * memory budget are shared as well: a tile loaded by one environment
+   * serves all of them, and tiles evicted by one environment are gone
+   * for all of them, except for the tiles loaded by
+   * PublishVehicleSnapshot(). Those stay resident until the same
+   * environment publishes its next snapshot or is destroyed.
+   *
+   * The environments sharing static objects follow the same rule as a
+   * single environment: only the snapshot based queries may run
+   * concurrently, on any of the environments, and no other method of any
+   * of them may be called meanwhile. Other queries copy ns-3 pointers,
+   * whose reference count is not thread-safe, and may load tiles.
+   *
+   * @return New environment without vehicles
+   */
+  Ptr<Environment>
+  CloneStaticLayer () const;
+
+  /*!
+   * @brief Check if two environments share their static objects.
+   * @param other	Environment to compare with
+   * @return True if both environments use the same buildings and foliage
+   */
+  bool
+  SharesStaticLayer (const Environment& other) const;
+
+  /*!
+   * @brief Write buildings and foliage to a binary file.
+   *
+   * The file contains the objects, their attributes and the packed
+   * aggregate trees (see WriteStaticLayerFile()). Finalize() must have
+   * been called before.
+   *
+   * @param fileName	File to write
+   * @return False if the file could not be written
+   */
+  bool
+  SaveStaticLayer (const std::string& fileName) const;
+
+  /*!
+   * @brief Replace buildings and foliage with the content of a binary file.
+   *
+   * The file is mapped into memory and the objects are created without
+   * parsing. The aggregate trees are restored as stored, the range trees
+   * are packed from the objects in index order.
+   *
+   * @param fileName	File written by SaveStaticLayer()
+   * @return False if the file could not be read, the environment is
+   *	     not modified in this case
+   */
+  bool
+  LoadStaticLayer (const std::string& fileName);
+
+  /*!
+   * @brief Write buildings and foliage as tiles to a directory.
+   *
+   * Each object is assigned to the square tile containing the center of
+   * its bounding box. Every tile is written as a static layer file and
+   * listed in a manifest (see WriteStaticLayerTiles()). Finalize() must
+   * have been called before.
+   *
+   * @param directory	Directory to write, created if necessary
+   * @param tileSize	Edge length of the tiles [m]
+   * @return False if a file could not be written
+   */
+  bool
+  SaveStaticLayerTiles (const std::string& directory, double tileSize) const;
+
+  /*!
+   * @brief Replace buildings and foliage with tiles loaded on demand.
+   *
+   * Only the manifest is read here. Each query loads the tiles touching
+   * its bounding box and adds their objects to the trees, so results are
+   * the same as with all objects loaded, also across tile boundaries.
+   * The least recently used tiles are evicted if the loaded tiles exceed
+   * @a memoryBudget, which is compared with the summed file sizes.
+   *
+   * Loading and evicting tiles updates the lazily constructed indexes
+   * (e.g. the wall index) in place. The aggregate trees are stored with
+   * the tiles and kept per tile, so they are never rebuilt. Snapshot based
+   * queries only see the tiles loaded by PublishVehicleSnapshot().
+   *
+   * Objects added later are kept until the end of the simulation. The
+   * tiles are shared with the environments cloned from this one (see
+   * CloneStaticLayer()).
+   *
+   * @param directory		Directory written by SaveStaticLayerTiles()
+   * @param memoryBudget	Maximum summed file size of loaded tiles [byte]
+   * @return False if the manifest could not be read, the environment is
+   *	     not modified in this case
+   */
+  bool
+  OpenStaticLayerTiles (const std::string& directory, std::uint64_t memoryBudget);
+
+  /*!
+   * @brief Get statistics about loaded and evicted tiles.
+   * @return Statistics of the tile cache, all zero without tiles
+   */
+  StaticLayerTileCache::Statistics
+  GetTileStatistics () const;
+
   /*!
    * @brief Add a building to the environment.
    * @param building	Building to add, must not be null
@@ -140,6 +460,141 @@ public:
   void
   RemoveVehicle (Ptr<Vehicle> vehicle);
 
+  /*!
+   * @brief Move several vehicles at once.
+   *
+   * Meant for the output of a traffic simulation step. The poses of
+   * registered vehicles are written into the vehicle store directly and
+   * their slots are marked as moved (see VehicleStore). Like vehicles
+   * moved individually, the vehicle index picks up the new poses at its
+   * next update, which only checks the moved vehicles or computes the
+   * boxes of all vehicles in one pass. Vehicles that are not registered
+   * are moved as with Vehicle::SetPosition() and Vehicle::SetHeading().
+   *
+   * @param vehicles	Vehicles to move, must not be null
+   * @param positions	New position of each vehicle
+   * @param headings	New heading of each vehicle [degree]
+   */
+  void
+  UpdateVehicles (const VehicleList& vehicles,
+		  const std::vector<Vector>& positions,
+		  const std::vector<double>& headings);
+
+  /*!
+   * @brief Queue a pose change of a vehicle.
+   *
+   * Queued changes are applied with a single call to UpdateVehicles()
+   * before the next query involving vehicles. Until then, the vehicle
+   * keeps its old pose. Queuing the same vehicle again replaces its
+   * queued pose, so frequent updates between queries are cheap.
+   *
+   * @param vehicle	Vehicle to move, must not be null
+   * @param position	New position of the vehicle
+   * @param heading	New heading of the vehicle [degree]
+   */
+  void
+  QueueVehicleUpdate (Ptr<Vehicle> vehicle, const Vector& position,
+		      double heading);
+
+  /*!
+   * @brief Keep a vehicle in sync with a mobility model.
+   *
+   * The vehicle is moved to the current pose of @a mobility right away.
+   * Afterwards, the pose of the vehicle is sampled from @a mobility before
+   * each query involving vehicles as long as the vehicle is moving, i.e.
+   * from a call to NotifyCourseChange() until a sample has no velocity.
+   * This covers mobility models that only report changes of the velocity,
+   * e.g. ns3::ConstantVelocityMobilityModel. The heading is derived from
+   * the velocity and kept while the vehicle stands still.
+   *
+   * Tracking the same vehicle again replaces the mobility model.
+   *
+   * @param vehicle	Vehicle to move, must not be null
+   * @param mobility	Mobility model to follow, must not be null
+   */
+  void
+  TrackVehicle (Ptr<Vehicle> vehicle, Ptr<const MobilityModel> mobility);
+
+  /*!
+   * @brief Stop following the mobility model of a vehicle.
+   *
+   * The vehicle keeps its last pose. Does nothing if the vehicle is
+   * not tracked.
+   *
+   * @param vehicle	Vehicle to stop tracking
+   */
+  void
+  UntrackVehicle (Ptr<Vehicle> vehicle);
+
+  /*!
+   * @brief Mark a tracked vehicle as moving.
+   *
+   * Meant to be connected to the CourseChange trace of the mobility
+   * model (see Gemv2VehicleAdapter). Only flags the vehicle, the pose is
+   * sampled before the next query involving vehicles. Does nothing if
+   * the vehicle is not tracked.
+   *
+   * @param vehicle	Vehicle whose mobility model changed its course
+   */
+  void
+  NotifyCourseChange (const Vehicle* vehicle);
+
+  /*!
+   * @brief Select the test for line intersections with buildings and foliage.
+   *
+   * By default, lines are tested against the flat edge arrays of the
+   * objects (see FlatPolygon). Disable this to use the generic boost
+   * geometry algorithm instead, e.g. to validate the results.
+   *
+   * @param enable	True to use the fast kernel, false for boost geometry
+   */
+  void
+  SetFastLineIntersection (bool enable);
+
+  /*!
+   * @brief Use the wall index for line intersections with buildings.
+   *
+   * If enabled, IntersectsAnyBuildings() and IntersectBuildings() test
+   * the line against the single walls close to it instead of the complete
+   * outlines of all buildings with an overlapping bounding box. This pays
+   * off for buildings with many vertices.
+   *
+   * @param enable	True to use the wall index
+   */
+  void
+  SetWallIndex (bool enable);
+
+  /*!
+   * @brief Use convex parts of the buildings for line and distance tests.
+   *
+   * If enabled, the buildings are split into convex parts, which are
+   * indexed separately (see ConvexPartIndex). IntersectsAnyBuildings()
+   * and IntersectBuildings() clip the line against the parts close to it,
+   * and the ellipse queries calculate the distance to the buildings from
+   * their parts. The queries still return whole buildings. The wall index
+   * takes precedence for line tests if both are enabled.
+   *
+   * @param enable	True to use the convex parts of the buildings
+   */
+  void
+  SetConvexDecomposition (bool enable);
+
+  /*!
+   * @brief Store the shapes of static objects in compact form.
+   *
+   * If enabled, buildings and foliage objects are compacted when they
+   * are added, loaded from a static layer file or loaded with a tile
+   * (see Building::Compact()). Their vertices are rounded to 1 mm and
+   * need about a sixth of the memory, queries work on the compact
+   * shapes directly. Objects added before enabling and objects already
+   * added to another environment keep their exact shape, since the
+   * trees of that environment depend on their bounding boxes.
+   *
+   * @param enable	True to compact new static objects
+   */
+  void
+  SetCompactStorage (bool enable);
+
   /*!
    * @brief Force rebuild of the vehicle tree
    */
@@ -170,6 +625,19 @@ public:
   BuildingList
   IntersectBuildings (const LineSegment2d& line) const;
 
+  /*!
+   * @brief Visit all buildings intersecting with a line segment.
+   *
+   * In contrast to the list version, this does neither allocate memory
+   * nor touch the reference counts of the found objects.
+   *
+   * @param line		Line to calculate the intersections for
+   * @param visitor		Called for each building intersecting with @a line
+   */
+  void
+  IntersectBuildings (const LineSegment2d& line,
+		      const BuildingVisitor& visitor) const;
+
   /*!
    * @brief Calculate intersection of a line segment with foliage objects.
    * @param line		Line to calculate the intersections for
@@ -178,6 +646,24 @@ public:
   FoliageList
   IntersectFoliage (const LineSegment2d& line) const;
 
+  /*!
+   * @brief Visit all foliage objects intersecting with a line segment.
+   * @param line		Line to calculate the intersections for
+   * @param visitor		Called for each foliage object intersecting with @a line
+   */
+  void
+  IntersectFoliage (const LineSegment2d& line,
+		    const FoliageVisitor& visitor) const;
+
+  /*!
+   * @brief Find all building walls intersecting with a line
+   * @param line	Line to test
+   * @return Hit walls with intersection points, sorted by the distance
+   *         from the start of @a line
+   */
+  WallHitList
+  IntersectWalls (const LineSegment2d& line) const;
+
   /*!
    * @brief Calculate intersection of a line segment with vehicles.
    *
@@ -185,11 +671,20 @@ public:
    * 	   the internal vehicle tree.
    *
    * @param line		Line to calculate the intersections for
-   * @return Vehicles intersecting with @a line
+   * @return Vehicles intersecting with @a line, in unspecified order
    */
   VehicleList
   IntersectVehicles (const LineSegment2d& line);
 
+  /*!
+   * @brief Visit all vehicles intersecting with a line segment.
+   * @param line		Line to calculate the intersections for
+   * @param visitor		Called for each vehicle intersecting with @a line
+   */
+  void
+  IntersectVehicles (const LineSegment2d& line,
+		     const VehicleVisitor& visitor);
+
   /*!
    * @brief Find all buildings in ellipse.
    * @param p1			First focal point of the ellipse
@@ -200,6 +695,17 @@ public:
   BuildingList
   FindBuildingsInEllipse (const Point2d& p1, const Point2d& p2, double range) const;
 
+  /*!
+   * @brief Visit all buildings in ellipse.
+   * @param p1			First focal point of the ellipse
+   * @param p2			Second focal point of the ellipse
+   * @param range		Length of the major diameter
+   * @param visitor		Called for each building in the ellipse
+   */
+  void
+  FindBuildingsInEllipse (const Point2d& p1, const Point2d& p2, double range,
+			  const BuildingVisitor& visitor) const;
+
   /*!
    * @brief Find all foliage in ellipse.
    * @param p1			First focal point of the ellipse
@@ -210,38 +716,289 @@ public:
   FoliageList
   FindFoliageInEllipse (const Point2d& p1, const Point2d& p2, double range) const;
 
+  /*!
+   * @brief Visit all foliage in ellipse.
+   * @param p1			First focal point of the ellipse
+   * @param p2			Second focal point of the ellipse
+   * @param range		Length of the major diameter
+   * @param visitor		Called for each foliage object in the ellipse
+   */
+  void
+  FindFoliageInEllipse (const Point2d& p1, const Point2d& p2, double range,
+			const FoliageVisitor& visitor) const;
+
   /*!
    * @brief Find all vehicles in ellipse.
    * @param p1			First focal point of the ellipse
    * @param p2			Second focal point of the ellipse
    * @param range		Length of the major diameter
-   * @return Vehicles where the sum of distance to @a p1 and @a p2 is less than @a range.
+   * @return Vehicles where the sum of distance to @a p1 and @a p2 is less than @a range,
+   *	     in unspecified order
    */
   VehicleList
   FindVehiclesInEllipse (const Point2d& p1, const Point2d& p2, double range);
 
+  /*!
+   * @brief Visit all vehicles in ellipse.
+   * @param p1			First focal point of the ellipse
+   * @param p2			Second focal point of the ellipse
+   * @param range		Length of the major diameter
+   * @param visitor		Called for each vehicle in the ellipse
+   */
+  void
+  FindVehiclesInEllipse (const Point2d& p1, const Point2d& p2, double range,
+			 const VehicleVisitor& visitor);
+
   /*!
    * @brief Find all objects in ellipse.
    * @param p1			First focal point
    * @param p2			Second focal point
    * @param range		Maximum combined distance to @a p1 and @a p2
-   * @return All objects where the sum of distance to @a p1 and @a p2 is less than @a range.
+   * @return All objects where the sum of distance to @a p1 and @a p2 is less than @a range,
+   *	     in unspecified order
    */
   ObjectCollection
   FindAllObjectsInEllipse (const Point2d& p1, const Point2d& p2, double range);
 
+  /*!
+   * @brief Visit all objects in ellipse.
+   *
+   * Visitors may be empty to skip the respective object type.
+   *
+   * @param p1			First focal point
+   * @param p2			Second focal point
+   * @param range		Maximum combined distance to @a p1 and @a p2
+   * @param buildingVisitor	Called for each building in the ellipse
+   * @param foliageVisitor	Called for each foliage object in the ellipse
+   * @param vehicleVisitor	Called for each vehicle in the ellipse
+   */
+  void
+  FindAllObjectsInEllipse (const Point2d& p1, const Point2d& p2, double range,
+			   const BuildingVisitor& buildingVisitor,
+			   const FoliageVisitor& foliageVisitor,
+			   const VehicleVisitor& vehicleVisitor);
+
+
+  /*!
+   * @brief Get the number of vehicles and the object area in an ellipse.
+   *
+   * This uses the same criterion as FindAllObjectsInEllipse() but works
+   * on trees storing the object count and area of each subtree. Subtrees
+   * completely inside the ellipse are accepted without visiting the single
+   * objects. For vehicles, this requires motion padding (see
+   * SetMaxVehicleSpeed()), otherwise every candidate vehicle is tested.
+   *
+   * @param p1			First focal point
+   * @param p2			Second focal point
+   * @param range		Maximum combined distance to @a p1 and @a p2
+   * @param excluded1		Vehicle not to count (e.g. the sender), may be null
+   * @param excluded2		Vehicle not to count (e.g. the receiver), may be null
+   * @return Vehicle count and summed area of buildings and foliage
+   */
+  EllipseOccupancy
+  GetOccupancyInEllipse (const Point2d& p1, const Point2d& p2, double range,
+			 Ptr<const Vehicle> excluded1 = nullptr,
+			 Ptr<const Vehicle> excluded2 = nullptr);
+
+  /*!
+   * @brief Publish a snapshot of all vehicles for concurrent readers.
+   *
+   * Must be called from the simulation thread, e.g. once per time step
+   * before link calculations are distributed to worker threads. This
+   * also builds all lazily constructed indexes of the static objects.
+   *
+   * With tiles (see OpenStaticLayerTiles()), the tiles around each
+   * vehicle up to half of the snapshot query range are loaded first (see
+   * SetSnapshotQueryRange()), all in a single request. They are pinned
+   * until the next call, even if they exceed the memory budget or other
+   * environments sharing the tiles load further tiles.
+   *
+   * @return The new snapshot, also returned by GetVehicleSnapshot()
+   */
+  VehicleSnapshotPtr
+  PublishVehicleSnapshot ();
+
+  /*!
+   * @brief Set the maximum range of snapshot based queries.
+   *
+   * Any point of an ellipse (or line) between two vehicles is closer
+   * than half of its range (or length) to one of them. So with tiles,
+   * PublishVehicleSnapshot() loads the tiles within half of @a range
+   * around each vehicle to cover all snapshot queries between vehicles
+   * up to this range. Queries that reach beyond the loaded tiles fail
+   * with an assertion.
+   *
+   * @param range	Maximum range of the ellipses and lines [m], 0 by default
+   */
+  void
+  SetSnapshotQueryRange (double range);
+
+  /*!
+   * @brief Get the last published vehicle snapshot.
+   *
+   * Can be called from any thread. The returned snapshot stays valid
+   * (and unchanged) as long as it is referenced, even if newer snapshots
+   * are published in the meantime.
+   *
+   * @return Last snapshot or null if none has been published yet
+   */
+  VehicleSnapshotPtr
+  GetVehicleSnapshot () const;
+
+  /*!
+   * @brief Get the number of vehicles and the object area in an ellipse.
+   *
+   * Same as GetOccupancyInEllipse() above, but the vehicles are taken
+   * from @a snapshot. This does not modify the environment and can be
+   * called from several threads at the same time, as long as no objects
+   * are added after the last call to PublishVehicleSnapshot().
+   *
+   * @param snapshot		Vehicle snapshot to use
+   * @param p1			First focal point
+   * @param p2			Second focal point
+   * @param range		Maximum combined distance to @a p1 and @a p2
+   * @param excluded1		Vehicle not to count (e.g. the sender), may be null
+   * @param excluded2		Vehicle not to count (e.g. the receiver), may be null
+   * @return Vehicle count and summed area of buildings and foliage
+   */
+  EllipseOccupancy
+  GetOccupancyInEllipse (const VehicleSnapshot& snapshot,
+			 const Point2d& p1, const Point2d& p2, double range,
+			 const Vehicle* excluded1 = nullptr,
+			 const Vehicle* excluded2 = nullptr) const;
+
+  /*!
+   * @brief Visit all buildings intersecting with a line segment.
+   *
+   * Same as IntersectBuildings() above, but only uses the indexes
+   * prepared by PublishVehicleSnapshot() and neither loads tiles nor
+   * touches reference counts. So it can be called from several threads
+   * at the same time like the snapshot version of GetOccupancyInEllipse().
+   * With tiles, @a line has to be within the snapshot query range (see
+   * SetSnapshotQueryRange()).
+   *
+   * @param snapshot		Last published vehicle snapshot, older snapshots
+   *				abort the simulation
+   * @param line		Line to calculate the intersections for
+   * @param visitor		Called for each building intersecting with @a line
+   */
+  void
+  IntersectBuildings (const VehicleSnapshot& snapshot, const LineSegment2d& line,
+		      const BuildingVisitor& visitor) const;
+
+  /*!
+   * @brief Visit all foliage objects intersecting with a line segment.
+   *
+   * Same as IntersectFoliage() above, but safe for concurrent readers
+   * like the snapshot version of IntersectBuildings().
+   *
+   * @param snapshot		Last published vehicle snapshot, older snapshots
+   *				abort the simulation
+   * @param line		Line to calculate the intersections for
+   * @param visitor		Called for each foliage object intersecting with @a line
+   */
+  void
+  IntersectFoliage (const VehicleSnapshot& snapshot, const LineSegment2d& line,
+		    const FoliageVisitor& visitor) const;
+
+  /*!
+   * @brief Visit all vehicles of a snapshot intersecting with a line segment.
+   *
+   * The vehicles are taken from @a snapshot (see
+   * VehicleSnapshot::IntersectVehicles()), so this is safe for concurrent
+   * readers as well.
+   *
+   * @param snapshot		Vehicle snapshot to use
+   * @param line		Line to calculate the intersections for
+   * @param visitor		Called for each vehicle entry intersecting with @a line
+   */
+  void
+  IntersectVehicles (const VehicleSnapshot& snapshot, const LineSegment2d& line,
+		     const VehicleSnapshot::EntryVisitor& visitor) const;
 
   //! Internal data structures moved to the implementation file.
   struct Data;
 
 private:
 
+  /*!
+   * @brief Apply the pose changes queued by QueueVehicleUpdate().
+   *
+   * The poses of all moving tracked vehicles (see TrackVehicle()) are
+   * sampled and queued first, once per simulation time.
+   */
+  void
+  ApplyQueuedVehicleUpdates ();
+
   /*!
    * @brief Check the status of the vehicle tree and rebuild if necessary.
    */
   void
   CheckVehcileTree ();
 
+  /*!
+   * @brief Get the box used to index a vehicle in the vehicle tree.
+   * @param vehicle	Vehicle to calculate the box for
+   * @return Current bounding box, enlarged by the possible movement
+   * 	     until the next tree update
+   */
+  Box2d
+  MakeVehicleIndexBox (Vehicle& vehicle) const;
+
+  /*!
+   * @brief Get the box used to index a vehicle in the vehicle tree.
+   * @param vehicle	Vehicle to calculate the box for
+   * @param horizon	Time the box has to cover the vehicle
+   * @return Current bounding box, enlarged by the possible movement
+   * 	     within @a horizon
+   */
+  Box2d
+  MakeVehicleIndexBox (Vehicle& vehicle, Time horizon) const;
+
+  /*!
+   * @brief Get the boxes used to index all registered vehicles.
+   *
+   * Same boxes as MakeVehicleIndexBox(), computed in one pass over the
+   * poses of all vehicles.
+   *
+   * @param horizon	Time the boxes have to cover the vehicles
+   * @param boxes	Box of each vehicle, in the order of the vehicle store
+   */
+  void
+  MakeVehicleIndexBoxes (Time horizon, std::vector<Box2d>& boxes);
+
+  /*!
+   * @brief Clear the vehicle tree and insert all vehicles again.
+   */
+  void
+  RebuildVehicleTree ();
+
+  /*!
+   * @brief Re-insert all vehicles that left their indexed bounding box.
+   */
+  void
+  UpdateMovedVehicles ();
+
+  /*!
+   * @brief Check if the vehicle tree is built on a worker thread.
+   * @return True if background rebuilds are enabled and supported
+   */
+  bool
+  UseBackgroundVehicleTreeRebuild () const;
+
+  /*!
+   * @brief Copy the vehicle boxes and start packing the next tree.
+   */
+  void
+  StartPendingVehicleTree ();
+
+  /*!
+   * @brief Replace the vehicle tree with the one built in the background.
+   * @return False if no valid tree is available
+   */
+  bool
+  SwapPendingVehicleTree ();
+
   // The environmental data
   std::unique_ptr<Data> m_data;
 
@@ -251,8 +1008,20 @@ private:
   //! Interval for vehicle tree rebuilds
   Time m_vehicleTreeRebuildInterval;
 
+  //! Maximum speed of the vehicles [m/s]
+  double m_maxVehicleSpeed;
+
+  //! Strategy used to update the vehicle tree
+  VehicleTreeUpdateMode m_vehicleTreeUpdateMode;
+
+  //! Buffer static objects until Finalize() is called
+  bool m_bulkLoading;
+
   //! Force rebuild of the vehicle tree
   bool m_forceVehicleTreeRebuild;
+
+  //! Build the vehicle tree on a worker thread
+  bool m_backgroundVehicleTreeRebuild;
 };
 
 }  // namespace gemv2
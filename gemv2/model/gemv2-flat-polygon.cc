@@ -0,0 +1,183 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "gemv2-flat-polygon.h"
+
+#include <algorithm>
+
+namespace ns3 {
+namespace gemv2 {
+
+namespace {
+
+//! Number of edges tested at once before checking for a hit
+const std::size_t EDGE_BLOCK_SIZE = 32;
+
+//! Edges of a ring, one vector per coordinate
+struct EdgeList
+{
+  std::vector<double> x0, y0, x1, y1;
+
+  void
+  AddRing (Polygon2d::ring_type const& ring)
+  {
+    if (ring.size () < 2)
+      {
+	return;
+      }
+
+    for (std::size_t i = 0; i + 1 < ring.size (); ++i)
+      {
+	AddEdge (ring[i], ring[i + 1]);
+      }
+
+    // close open rings
+    if (!boost::geometry::equals (ring.front (), ring.back ()))
+      {
+	AddEdge (ring.back (), ring.front ());
+      }
+  }
+
+  void
+  AddEdge (Point2d const& a, Point2d const& b)
+  {
+    x0.push_back (a.x ());
+    y0.push_back (a.y ());
+    x1.push_back (b.x ());
+    y1.push_back (b.y ());
+  }
+};
+
+}  // namespace
+
+FlatPolygon::FlatPolygon ()
+  : m_numEdges (0)
+{
+}
+
+FlatPolygon::FlatPolygon (Polygon2d const& shape)
+{
+  EdgeList edges;
+  edges.AddRing (shape.outer ());
+  for (auto const& ring : shape.inners ())
+    {
+      edges.AddRing (ring);
+    }
+
+  m_numEdges = edges.x0.size ();
+  m_coordinates.reserve (4 * m_numEdges);
+  m_coordinates.insert (m_coordinates.end (), edges.x0.begin (), edges.x0.end ());
+  m_coordinates.insert (m_coordinates.end (), edges.y0.begin (), edges.y0.end ());
+  m_coordinates.insert (m_coordinates.end (), edges.x1.begin (), edges.x1.end ());
+  m_coordinates.insert (m_coordinates.end (), edges.y1.begin (), edges.y1.end ());
+}
+
+bool
+FlatPolygon::Intersects (LineSegment2d const& segment) const
+{
+  double px = segment.first.x ();
+  double py = segment.first.y ();
+  double qx = segment.second.x ();
+  double qy = segment.second.y ();
+
+  // without crossing the border, the segment is either completely
+  // inside or completely outside
+  return IntersectsAnyEdge (px, py, qx, qy) || Contains (segment.first);
+}
+
+bool
+FlatPolygon::Contains (Point2d const& p) const
+{
+  const double* x0 = m_coordinates.data ();
+  const double* y0 = x0 + m_numEdges;
+  const double* x1 = y0 + m_numEdges;
+  const double* y1 = x1 + m_numEdges;
+
+  double px = p.x ();
+  double py = p.y ();
+
+  // even-odd rule, holes are handled by the edges of the inner rings
+  int crossings = 0;
+  for (std::size_t i = 0; i < m_numEdges; ++i)
+    {
+      int straddles = (y0[i] > py) != (y1[i] > py);
+      // is p left of the edge, relative to its direction in y
+      int left = ((px - x0[i]) * (y1[i] - y0[i]) <
+		  (x1[i] - x0[i]) * (py - y0[i])) == (y1[i] > y0[i]);
+      crossings += straddles & left;
+    }
+
+  return (crossings & 1) != 0;
+}
+
+std::size_t
+FlatPolygon::GetNumEdges () const
+{
+  return m_numEdges;
+}
+
+bool
+FlatPolygon::IntersectsAnyEdge (double px, double py, double qx, double qy) const
+{
+  const double* x0 = m_coordinates.data ();
+  const double* y0 = x0 + m_numEdges;
+  const double* x1 = y0 + m_numEdges;
+  const double* y1 = x1 + m_numEdges;
+
+  double minX = std::min (px, qx);
+  double maxX = std::max (px, qx);
+  double minY = std::min (py, qy);
+  double maxY = std::max (py, qy);
+  double dx = qx - px;
+  double dy = qy - py;
+
+  for (std::size_t first = 0; first < m_numEdges; first += EDGE_BLOCK_SIZE)
+    {
+      std::size_t last = std::min (first + EDGE_BLOCK_SIZE, m_numEdges);
+
+      int hit = 0;
+      for (std::size_t i = first; i < last; ++i)
+	{
+	  // boxes have to overlap, this also handles collinear segments
+	  int overlap =
+	      (std::max (x0[i], x1[i]) >= minX) & (std::min (x0[i], x1[i]) <= maxX) &
+	      (std::max (y0[i], y1[i]) >= minY) & (std::min (y0[i], y1[i]) <= maxY);
+
+	  // segment end points on different sides of the edge
+	  double ex = x1[i] - x0[i];
+	  double ey = y1[i] - y0[i];
+	  double d1 = ex * (py - y0[i]) - ey * (px - x0[i]);
+	  double d2 = ex * (qy - y0[i]) - ey * (qx - x0[i]);
+
+	  // edge end points on different sides of the segment
+	  double d3 = dx * (y0[i] - py) - dy * (x0[i] - px);
+	  double d4 = dx * (y1[i] - py) - dy * (x1[i] - px);
+
+	  hit |= overlap & (d1 * d2 <= 0) & (d3 * d4 <= 0);
+	}
+
+      if (hit)
+	{
+	  return true;
+	}
+    }
+
+  return false;
+}
+
+}  // namespace gemv2
+}  // namespace ns3
@@ -0,0 +1,106 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GEMV2_FLAT_POLYGON_H
+#define GEMV2_FLAT_POLYGON_H
+
+#include <vector>
+
+#include <ns3/gemv2-geometry.h>
+
+namespace ns3 {
+namespace gemv2 {
+
+/*!
+ * @brief Polygon edges in a flat array for fast intersection tests.
+ *
+ * The start and end coordinates of all edges (outer and inner rings) are
+ * stored as four consecutive blocks of a single array. The intersection
+ * test runs over the edges without branches, which allows the compiler
+ * to vectorize the loop.
+ *
+ * The results match boost::geometry::intersects () on polygons except
+ * for rounding differences in nearly degenerate configurations.
+ */
+class FlatPolygon
+{
+public:
+  /*!
+   * @brief Create polygon without edges.
+   */
+  FlatPolygon ();
+
+  /*!
+   * @brief Create flat representation of a polygon.
+   * @param shape	Polygon to convert
+   */
+  explicit FlatPolygon (Polygon2d const& shape);
+
+  /*!
+   * @brief Test if a line segment intersects with the polygon.
+   *
+   * This includes segments touching the border and segments completely
+   * inside of the polygon.
+   *
+   * @param segment	Segment to test
+   * @return True if @a segment and the polygon share at least one point
+   */
+  bool
+  Intersects (LineSegment2d const& segment) const;
+
+  /*!
+   * @brief Test if a point is inside the polygon.
+   *
+   * Points on the border might be reported as inside or outside.
+   *
+   * @param p	Point to test
+   * @return True if @a p is inside of the polygon
+   */
+  bool
+  Contains (Point2d const& p) const;
+
+  /*!
+   * @brief Get the number of edges.
+   * @return Number of edges of all rings
+   */
+  std::size_t
+  GetNumEdges () const;
+
+private:
+
+  /*!
+   * @brief Test if a segment crosses or touches any edge.
+   * @param px	X coordinate of the segment start
+   * @param py	Y coordinate of the segment start
+   * @param qx	X coordinate of the segment end
+   * @param qy	Y coordinate of the segment end
+   * @return True if at least one edge is hit
+   */
+  bool
+  IntersectsAnyEdge (double px, double py, double qx, double qy) const;
+
+  //! Number of edges
+  std::size_t m_numEdges;
+
+  //! Start x, start y, end x and end y of all edges in four blocks
+  std::vector<double> m_coordinates;
+};
+
+}  // namespace gemv2
+}  // namespace ns3
+
+#endif /* GEMV2_FLAT_POLYGON_H */
@@ -17,6 +17,7 @@
  */
 #include "gemv2-foliage.h"
 
+#include <ns3/assert.h>
 #include <ns3/log.h>
 #include <boost/geometry/io/wkt/wkt.hpp>
 
@@ -27,25 +28,108 @@ NS_LOG_COMPONENT_DEFINE("Gemv2Foliage");
 namespace gemv2 {
 
 Foliage::Foliage (Polygon2d const& shape)
-  : m_shape (shape)
+  : m_exactShape (new ExactShape {shape, FlatPolygon ()}),
+    m_indexed (false)
 {
   // fix potential issues with shape
-  boost::geometry::correct (m_shape);
-  NS_LOG_LOGIC ("Created foliage with outline: " << boost::geometry::wkt (m_shape));
+  auto& exact = *m_exactShape;
+  boost::geometry::correct (exact.shape);
+  NS_LOG_LOGIC ("Created foliage with outline: " << boost::geometry::wkt (exact.shape));
+
+  // flatten edges for the intersection kernel
+  exact.flatShape = FlatPolygon (exact.shape);
 
   // calculate bounding box
-  boost::geometry::envelope (m_shape, m_boundingBox);
+  boost::geometry::envelope (exact.shape, m_boundingBox);
   NS_LOG_LOGIC ("Foliage bounding box: " << boost::geometry::wkt (m_boundingBox));
 
   // calculate area
-  m_area = boost::geometry::area (m_shape);
+  m_area = boost::geometry::area (exact.shape);
   NS_LOG_LOGIC ("Area of the foliage object: " << m_area << " m^2");
 }
 
 Polygon2d const&
 Foliage::GetShape () const
 {
-  return m_shape;
+  NS_ASSERT_MSG (!IsCompact (), "shape of compact foliage object requested, use DecodeShape ()");
+  return m_exactShape->shape;
+}
+
+Polygon2d
+Foliage::DecodeShape () const
+{
+  if (IsCompact ())
+    {
+      return m_compactShape.GetPolygon ();
+    }
+  return m_exactShape->shape;
+}
+
+FlatPolygon const&
+Foliage::GetFlatShape () const
+{
+  NS_ASSERT_MSG (!IsCompact (), "flat shape of compact foliage object requested");
+  return m_exactShape->flatShape;
+}
+
+void
+Foliage::Compact ()
+{
+  if (IsCompact ())
+    {
+      return;
+    }
+  NS_ASSERT_MSG (!m_indexed, "foliage object in an environment must not be compacted");
+
+  m_compactShape = CompactPolygon (m_exactShape->shape);
+
+  // box and area have to match the rounded vertices
+  auto shape = m_compactShape.GetPolygon ();
+  boost::geometry::envelope (shape, m_boundingBox);
+  m_area = boost::geometry::area (shape);
+
+  // release the memory of the other shapes
+  m_exactShape.reset ();
+
+  NS_LOG_LOGIC ("Compacted foliage object with " << m_compactShape.GetNumEdges () << " edges");
+}
+
+bool
+Foliage::IsCompact () const
+{
+  return m_exactShape == nullptr;
+}
+
+void
+Foliage::MarkIndexed ()
+{
+  m_indexed = true;
+}
+
+bool
+Foliage::IsIndexed () const
+{
+  return m_indexed;
+}
+
+bool
+Foliage::Intersects (LineSegment2d const& line) const
+{
+  if (IsCompact ())
+    {
+      return m_compactShape.Intersects (line);
+    }
+  return m_exactShape->flatShape.Intersects (line);
+}
+
+double
+Foliage::GetDistance (Point2d const& p) const
+{
+  if (IsCompact ())
+    {
+      return m_compactShape.GetDistance (p);
+    }
+  return boost::geometry::distance (p, m_exactShape->shape);
 }
 
 Box2d const&
@@ -60,5 +144,11 @@ Foliage::GetArea () const
   return m_area;
 }
 
+double
+GetShapeDistance (const Point2d& p, const Foliage& foliage)
+{
+  return foliage.GetDistance (p);
+}
+
 }  // namespace gemv2
 }  // namespace ns3
@@ -18,8 +18,12 @@
 #ifndef GEMV2_FOLIAGE_H
 #define GEMV2_FOLIAGE_H
 
+#include <memory>
+
 #include <ns3/simple-ref-count.h>
 #include <ns3/gemv2-geometry.h>
+#include <ns3/gemv2-flat-polygon.h>
+#include <ns3/gemv2-compact-polygon.h>
 
 namespace ns3 {
 namespace gemv2 {
@@ -36,12 +40,82 @@ public:
   explicit Foliage (Polygon2d const& shape);
 
   /*!
-   * @brief Get the shape of the foliage
-   * @return Shape of the foliage
+   * @brief Get the shape of the foliage object
+   *
+   * Only available if the foliage object is not compact.
+   *
+   * @return Shape of the foliage object
    */
   Polygon2d const&
   GetShape () const;
 
+  /*!
+   * @brief Get the shape of the foliage object, also if it is compact.
+   *
+   * Compact shapes are decoded, other shapes are copied.
+   *
+   * @return Shape of the foliage object
+   */
+  Polygon2d
+  DecodeShape () const;
+
+  /*!
+   * @brief Get the shape of the foliage object for fast intersection tests
+   *
+   * Only available if the foliage object is not compact.
+   *
+   * @return Edges of the foliage object in a flat array
+   */
+  FlatPolygon const&
+  GetFlatShape () const;
+
+  /*!
+   * @brief Store the shape with quantized vertices.
+   *
+   * Works like Building::Compact(). Must not be called once the foliage
+   * object was added to an environment.
+   */
+  void
+  Compact ();
+
+  /*!
+   * @brief Check if the shape is stored in compact form.
+   * @return True if Compact() was called
+   */
+  bool
+  IsCompact () const;
+
+  /*!
+   * @brief Note that an environment indexes the foliage object.
+   *
+   * Called by the environment, the foliage object can not be compacted afterwards.
+   */
+  void
+  MarkIndexed ();
+
+  /*!
+   * @brief Check if any environment indexed the foliage object.
+   * @return True if MarkIndexed() was called
+   */
+  bool
+  IsIndexed () const;
+
+  /*!
+   * @brief Test if a line segment intersects with the foliage object.
+   * @param line	Line segment to test
+   * @return True if @a line touches or enters the foliage object
+   */
+  bool
+  Intersects (LineSegment2d const& line) const;
+
+  /*!
+   * @brief Get the distance of a point to the foliage object.
+   * @param p	Point to calculate the distance for
+   * @return Distance to the shape, 0 if @a p is inside
+   */
+  double
+  GetDistance (Point2d const& p) const;
+
   /*!
    * @brief Get the bounding box of the foliage
    * @return Bounding box of the foliage
@@ -58,16 +132,42 @@ public:
 
 private:
 
-  //! Shape of the foliage
-  Polygon2d m_shape;
+  //! Exact shape and the same shape for fast intersection tests
+  struct ExactShape
+  {
+    Polygon2d shape;
+    FlatPolygon flatShape;
+  };
+
+  //! Exact shape, null if the foliage object is compact
+  std::unique_ptr<ExactShape> m_exactShape;
+
+  /*!
+   * @brief Quantized shape, empty unless the foliage object is compact.
+   *
+   * Stored inline, so a compact foliage object only allocates the vertex buffer.
+   */
+  CompactPolygon m_compactShape;
 
   //! Bounding box of the foliage
   Box2d m_boundingBox;
 
   //! Area covered by the foliage objects
   double m_area;
+
+  //! Whether an environment indexes the foliage object, see MarkIndexed()
+  bool m_indexed;
 };
 
+/*!
+ * @brief Distance of a point to a foliage object for the ellipse queries.
+ * @param p		Point to calculate the distance for
+ * @param foliage	Foliage object to calculate the distance to
+ * @return Distance of @a p to the shape of @a foliage
+ */
+double
+GetShapeDistance (const Point2d& p, const Foliage& foliage);
+
 }  // namespace gemv2
 }  // namespace ns3
 
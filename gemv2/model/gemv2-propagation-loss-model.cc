@@ -75,21 +75,14 @@ constexpr double DEFAULT_MAX_OBJECT_DENSITY = 0.8;   // 80% covered with objects
  * Some small helper functions
  */
 
-//! Remove @a v.first and @a v.second from the provided list.
-void
-RemoveVehicles (
-    ns3::gemv2::Environment::VehicleList& l,
-    const ns3::Gemv2PropagationLossModel::VehiclePair& v)
+//! Check if @a v is either @a involved.first or @a involved.second.
+bool
+IsInvolvedVehicle (
+    const ns3::gemv2::Vehicle& v,
+    const ns3::Gemv2PropagationLossModel::VehiclePair& involved)
 {
-  if (v.first)
-    {
-      l.erase (std::remove (l.begin (), l.end (), v.first), l.end ());
-    }
-
-  if (v.second)
-    {
-      l.erase (std::remove (l.begin (), l.end (), v.second), l.end ());
-    }
+  return &v == ns3::PeekPointer (involved.first) ||
+      &v == ns3::PeekPointer (involved.second);
 }
 
 ns3::Ptr<ns3::gemv2::Vehicle>
@@ -217,7 +210,7 @@ Gemv2PropagationLossModel::ForceDeterminstic (bool determinstic)
 double
 Gemv2PropagationLossModel::CalculateSmallScaleVariations (
     double distance2d, double comRange,
-    const gemv2::Environment::ObjectCollection& objects,
+    const gemv2::Environment::EllipseOccupancy& occupancy,
     double sigmaMin, double sigmaMax) const
 {
   NS_LOG_FUNCTION(this);
@@ -235,24 +228,14 @@ Gemv2PropagationLossModel::CalculateSmallScaleVariations (
 
   NS_LOG_LOGIC("Ellipse area: " << ellipseArea << " m^2");
 
-  double objectArea = 0;
-
-  // collect area covered by objects
-  for (auto const& b : objects.buildings)
-    {
-      objectArea += b->GetArea ();
-    }
-  for (auto const& f : objects.foliage)
-    {
-      objectArea += f->GetArea ();
-    }
+  double objectArea = occupancy.objectArea;
 
   NS_LOG_LOGIC("Area covered by objects: " << objectArea << " m^2");
 
   double weight = std::min (
       1.0,
       std::sqrt (
-	  objects.vehicles.size ()
+	  occupancy.vehicles
 	      / (m_maxVehicleDensity * ellipseArea
 		  * SQR_METERS_TO_SQR_KILOMETERS)))
       + std::min (1.0,
@@ -314,20 +297,16 @@ Gemv2PropagationLossModel::CalculateSimpleNlosvLoss (
     }
 }
 
-gemv2::Environment::ObjectCollection
+gemv2::Environment::EllipseOccupancy
 Gemv2PropagationLossModel::GetObjectsInComEllipse (
     const gemv2::LineSegment2d& lineOfSight,
     double comRange,
     const VehiclePair& involvedVehicles) const
 {
-  // Find all objects in joint communication ellipse
-  auto jointObjects = m_environment->FindAllObjectsInEllipse (
-      lineOfSight.first, lineOfSight.second, comRange);
-
-  // remove sender and receiver from list
-  RemoveVehicles (jointObjects.vehicles, involvedVehicles);
-
-  return jointObjects;
+  // Sender and receiver are skipped while counting vehicles
+  return m_environment->GetOccupancyInEllipse (
+      lineOfSight.first, lineOfSight.second, comRange,
+      involvedVehicles.first, involvedVehicles.second);
 }
 
 
@@ -389,14 +368,20 @@ Gemv2PropagationLossModel::DoCalcRxPower (double txPowerDbm,
     }
   else
     {
-      // vehicles in LOS - will only be filled for NLOSv links
-      auto vehiclesInLos = m_environment->IntersectVehicles (lineOfSight);
-
-      // remove involved vehicles from list
-      RemoveVehicles (vehiclesInLos, involvedVehicles);
+      // count vehicles in LOS, except sender and receiver
+      std::size_t vehiclesInLos = 0;
+      m_environment->IntersectVehicles (
+	  lineOfSight,
+	  [&vehiclesInLos, &involvedVehicles](gemv2::Vehicle& v)
+	  {
+	    if (!IsInvolvedVehicle (v, involvedVehicles))
+	      {
+		++vehiclesInLos;
+	      }
+	  });
 
       // check if there are other vehicles in the LOS
-      if (!vehiclesInLos.empty ())
+      if (vehiclesInLos > 0)
 	{
 	  NS_LOG_LOGIC(
 	      ""
@@ -521,7 +506,7 @@ double
 Gemv2PropagationLossModel::CalcNlosvRxPower (
     double txPowerDbm, double distance,
     const gemv2::LineSegment2d& lineOfSight,
-    const gemv2::Environment::VehicleList& vehiclesInLos,
+    std::size_t vehiclesInLos,
     const VehiclePair& involvedVehicles,
     double txGainDbi, double rxGainDbi) const
 {
@@ -547,7 +532,7 @@ Gemv2PropagationLossModel::CalcNlosvRxPower (
     case gemv2::NLOSV_MODEL_SIMPLE:
       rxPowerLargeScaleDbm = txPowerDbm + txGainDbi + rxGainDbi
 	  - CalculateSimpleNlosvLoss (
-	      distance, vehiclesInLos.size ());
+	      distance, vehiclesInLos);
       NS_LOG_LOGIC(
 	  "Simple NLOSv model large scale loss: " <<
 	  (txPowerDbm - rxPowerLargeScaleDbm));
@@ -100,7 +100,7 @@ private:
    * @brief Calculate the small scale variations for a link.
    * @param distance2d	Distance between sender and receiver (2d)
    * @param comRange	Communication range
-   * @param objects	Objects in the ellipse around sender and receiver
+   * @param occupancy	Occupancy of the ellipse around sender and receiver
    * @param sigmaMin	Minimum value for sigma (depends on the link type)
    * @param sigmaMax	Maximum value for sigma (depends on the link type)
    * @return Small scale variations in dBm
@@ -108,7 +108,7 @@ private:
   double
   CalculateSmallScaleVariations (
       double distance2d, double comRange,
-      const gemv2::Environment::ObjectCollection& objects,
+      const gemv2::Environment::EllipseOccupancy& occupancy,
       double sigmaMin, double sigmaMax) const;
 
 
@@ -139,13 +139,13 @@ private:
 			    std::size_t vehiclesInLos) const;
 
   /*!
-   * @brief Get the environment objects in the communication ellipse.
+   * @brief Get the occupancy of the communication ellipse.
    * @param lineOfSight		Line of sight between sender and receiver
    * @param comRange		Communication range (meters)
    * @param involvedVehicles	Sender/receiver vehicles
-   * @return Collection of found objects
+   * @return Number of vehicles and area covered by objects in the ellipse
    */
-  gemv2::Environment::ObjectCollection
+  gemv2::Environment::EllipseOccupancy
   GetObjectsInComEllipse (const gemv2::LineSegment2d& lineOfSight,
 			  double comRange,
 			  const VehiclePair& involvedVehicles) const;
@@ -189,7 +189,7 @@ private:
   double
   CalcNlosvRxPower (double txPowerDbm, double distance,
 		    const gemv2::LineSegment2d& lineOfSight,
-		    const gemv2::Environment::VehicleList& vehiclesInLos,
+		    std::size_t vehiclesInLos,
 		    const VehiclePair& involvedVehicles,
 		    double txGainDbi, double rxGainDbi) const;
 
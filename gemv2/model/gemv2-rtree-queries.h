@@ -18,6 +18,8 @@
 #ifndef GEMV2_RTREE_QUERIES_H
 #define GEMV2_RTREE_QUERIES_H
 
+#include <type_traits>
+
 #include <ns3/gemv2-geometry.h>
 #include <ns3/gemv2-bounding-boxes.h>
 
@@ -31,6 +33,78 @@ namespace detail
 // selection of the shape adapter
 template<typename T>
 struct ShapeAdapterTrait {};
+
+/*!
+ * @brief Tells whether the indexed box of an object encloses its shape.
+ *
+ * If so, the box can be used to accept or reject objects in ellipse
+ * queries without looking at the shape. Specialize this as
+ * std::false_type for indexes with boxes that might be outdated.
+ */
+template<typename T>
+struct BoxCoversShapeTrait : std::true_type {};
+
+/*!
+ * @brief Access to the spatial queries of an index.
+ *
+ * The default implementation works on boost rtrees. Specialize this
+ * to use the query functions below with other index types.
+ */
+template<typename IndexType>
+struct IndexQuery
+{
+  /*!
+   * @brief Test if any object intersects with a geometry and matches a predicate.
+   * @param index	Index to query
+   * @param g		Geometry the indexed box has to intersect with
+   * @param predicate	Additional condition on the stored object
+   * @return True if at least one object matches
+   */
+  template<typename Geometry, typename Predicate>
+  static bool
+  Any (const IndexType& index, const Geometry& g, Predicate predicate)
+  {
+    return index.qbegin (
+	boost::geometry::index::intersects (g) &&
+	boost::geometry::index::satisfies (predicate)
+	) != index.qend ();
+  }
+
+  /*!
+   * @brief Find all objects intersecting with a geometry and matching a predicate.
+   * @param index		Index to query
+   * @param g			Geometry the indexed box has to intersect with
+   * @param predicate		Additional condition on the stored object
+   * @param outputIterator	All matching objects are added here
+   */
+  template<typename Geometry, typename Predicate, typename OutputIterator>
+  static void
+  Query (const IndexType& index, const Geometry& g, Predicate predicate,
+	 OutputIterator outputIterator)
+  {
+    index.query (
+	boost::geometry::index::intersects (g) &&
+	boost::geometry::index::satisfies (predicate),
+	outputIterator);
+  }
+};
+}
+
+/*!
+ * @brief Get the distance of a point to the shape of an object.
+ *
+ * Overload this for shapes which are no boost geometries, the overload
+ * is found by argument dependent lookup.
+ *
+ * @param p	Point to calculate the distance for
+ * @param shape	Shape as returned by the shape adapter
+ * @return Distance of @a p to @a shape
+ */
+template<typename Shape>
+double
+GetShapeDistance (const Point2d& p, const Shape& shape)
+{
+  return boost::geometry::distance (p, shape);
 }
 
 /*!
@@ -46,13 +120,10 @@ bool
 IntersectsAny (const TreeType& tree, const Geometry& g,
 	       ShapeAdapter shaper = ShapeAdapter ())
 {
-  return tree.qbegin (
-      boost::geometry::index::intersects (g) &&
-      boost::geometry::index::satisfies (
-	  [&g, &shaper](const typename TreeType::value_type& v)
-	  { return boost::geometry::intersects (shaper (v), g);}
-	)
-      ) != tree.qend ();
+  return detail::IndexQuery<TreeType>::Any (
+      tree, g,
+      [&g, &shaper](const typename TreeType::value_type& v)
+      { return boost::geometry::intersects (shaper (v), g);});
 }
 
 /*!
@@ -71,17 +142,22 @@ FindObjectsThatIntersect (
     OutputIterator outputIterator,
     ShapeAdapter shaper = ShapeAdapter ())
 {
-  tree.query (
-      boost::geometry::index::intersects (g) &&
-      boost::geometry::index::satisfies (
-      	  [&g, &shaper](const typename TreeType::value_type& v)
-      	  { return boost::geometry::intersects (shaper(v), g);}
-      	),
-	outputIterator);
+  detail::IndexQuery<TreeType>::Query (
+      tree, g,
+      [&g, &shaper](const typename TreeType::value_type& v)
+      { return boost::geometry::intersects (shaper(v), g);},
+      outputIterator);
 }
 
 /*!
  * @brief Find objects with maximum accumulated distance to two points.
+ *
+ * Candidates are taken from @a bBox and have to intersect the rotated
+ * rectangle around the ellipse as well. If the indexed boxes enclose the
+ * shapes (see detail::BoxCoversShapeTrait), most candidates are accepted
+ * or rejected based on their box alone. The exact distance to the shape
+ * is only calculated for boxes crossing the border of the ellipse.
+ *
  * @param tree		  Tree to query
  * @param bBox		  Bounding box to limit the search
  * @param p1		  First focal point
@@ -100,18 +176,37 @@ FindObjectsInEllipse (const TreeType& tree, const Box2d& bBox,
 		      OutputIterator outputIterator,
 		      ShapeAdapter shaper = ShapeAdapter ())
 {
+  auto getter = tree.indexable_get ();
+  auto rectangle = MakeBoundingRectangleEllipse (p1, p2, range);
+
   // query the tree with bounding box and range condition
-  tree.query (
-      boost::geometry::index::intersects (bBox) &&
-      boost::geometry::index::satisfies (
-	  [range, &p1, &p2, &shaper] (const typename TreeType::value_type& v)
+  detail::IndexQuery<TreeType>::Query (
+      tree, bBox,
+      [range, &p1, &p2, &shaper, &getter, &rectangle]
+       (const typename TreeType::value_type& v)
+      {
+	auto const& box = getter (v);
+	if (!Intersects (box, rectangle))
 	  {
-	    return
-		boost::geometry::distance (p1, shaper (v)) +
-		boost::geometry::distance (p2, shaper (v))
-		< range;
-	  }),
-	  outputIterator);
+	    return false;
+	  }
+
+	if (detail::BoxCoversShapeTrait<TreeType>::value)
+	  {
+	    if (IsBoxOutsideEllipse (box, p1, p2, range))
+	      {
+		return false;
+	      }
+	    if (IsBoxInsideEllipse (box, p1, p2, range))
+	      {
+		return true;
+	      }
+	  }
+
+	auto&& shape = shaper (v);
+	return GetShapeDistance (p1, shape) + GetShapeDistance (p2, shape) < range;
+      },
+      outputIterator);
 }
 
 /*!
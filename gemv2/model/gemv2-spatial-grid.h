@@ -0,0 +1,385 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GEMV2_SPATIAL_GRID_H
+#define GEMV2_SPATIAL_GRID_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/geometry/index/indexable.hpp>
+#include <boost/geometry/index/equal_to.hpp>
+
+#include <ns3/gemv2-geometry.h>
+#include <ns3/gemv2-rtree-queries.h>
+
+namespace ns3
+{
+namespace gemv2
+{
+
+/*!
+ * @brief Uniform grid (spatial hash) for small objects of similar size.
+ *
+ * Each object is stored in all cells overlapped by its bounding box.
+ * Only occupied cells are allocated, thus the grid is unbounded.
+ * Insertion and removal only touch the cells of the object, which makes
+ * the grid well suited for objects moving every step (e.g. vehicles).
+ *
+ * Queries report each object once by only accepting it in the first cell
+ * that is overlapped by both the object and the query box.
+ *
+ * The interface follows the boost rtree where possible, so the query
+ * functions in gemv2-rtree-queries.h can be used on the grid.
+ *
+ * @tparam Value		Type of the stored objects
+ * @tparam IndexableGetter	Function object returning the Box2d of a value
+ */
+template<typename Value,
+	 typename IndexableGetter = boost::geometry::index::indexable<Value>>
+class SpatialGrid
+{
+public:
+  //! Type of the stored objects
+  using value_type = Value;
+
+  /*!
+   * @brief Create empty grid.
+   * @param cellSize	Edge length of a grid cell [m]
+   */
+  explicit
+  SpatialGrid (double cellSize = 25.0)
+    : m_cellSize (cellSize),
+      m_size (0)
+  {
+  }
+
+  /*!
+   * @brief Get the edge length of a grid cell.
+   * @return Edge length of a grid cell [m]
+   */
+  double
+  GetCellSize () const
+  {
+    return m_cellSize;
+  }
+
+  /*!
+   * @brief Get the function object returning the box of a value.
+   * @return Copy of the indexable getter
+   */
+  IndexableGetter
+  indexable_get () const
+  {
+    return m_getter;
+  }
+
+  /*!
+   * @brief Insert an object into the grid.
+   * @param v	Object to insert
+   */
+  void
+  insert (const Value& v)
+  {
+    auto range = GetCellRange (m_getter (v));
+    for (auto x = range.minX; x <= range.maxX; ++x)
+      {
+	for (auto y = range.minY; y <= range.maxY; ++y)
+	  {
+	    m_cells[MakeKey (x, y)].push_back (v);
+	  }
+      }
+    ++m_size;
+  }
+
+  /*!
+   * @brief Remove an object from the grid.
+   *
+   * The object has to be provided with the same box it was inserted with.
+   *
+   * @param v	Object to remove
+   * @return Number of removed objects (0 or 1)
+   */
+  std::size_t
+  remove (const Value& v)
+  {
+    boost::geometry::index::equal_to<Value> equals;
+    bool found = false;
+
+    auto range = GetCellRange (m_getter (v));
+    for (auto x = range.minX; x <= range.maxX; ++x)
+      {
+	for (auto y = range.minY; y <= range.maxY; ++y)
+	  {
+	    auto cell = m_cells.find (MakeKey (x, y));
+	    if (cell == m_cells.end ())
+	      {
+		continue;
+	      }
+
+	    auto& values = cell->second;
+	    for (std::size_t i = 0; i < values.size (); ++i)
+	      {
+		if (equals (values[i], v))
+		  {
+		    // order within a cell is irrelevant
+		    values[i] = values.back ();
+		    values.pop_back ();
+		    found = true;
+		    break;
+		  }
+	      }
+
+	    if (values.empty ())
+	      {
+		m_cells.erase (cell);
+	      }
+	  }
+      }
+
+    if (found)
+      {
+	--m_size;
+	return 1;
+      }
+    return 0;
+  }
+
+  /*!
+   * @brief Remove all objects.
+   */
+  void
+  clear ()
+  {
+    m_cells.clear ();
+    m_size = 0;
+  }
+
+  /*!
+   * @brief Get the number of stored objects.
+   * @return Number of stored objects
+   */
+  std::size_t
+  size () const
+  {
+    return m_size;
+  }
+
+  /*!
+   * @brief Check if the grid is empty.
+   * @return True if no objects are stored
+   */
+  bool
+  empty () const
+  {
+    return m_size == 0;
+  }
+
+  /*!
+   * @brief Visit all objects whose box intersects a geometry.
+   *
+   * Each object is visited at most once.
+   *
+   * @param g		Geometry to test
+   * @param visitor	Called for each object, return false to stop
+   * @return False if the visitor stopped the query, true otherwise
+   */
+  template<typename Geometry, typename Visitor>
+  bool
+  Visit (const Geometry& g, Visitor visitor) const
+  {
+    Box2d queryBox = boost::geometry::return_envelope<Box2d> (g);
+    auto range = GetCellRange (queryBox);
+
+    // iterate over occupied cells only if this is cheaper
+    double cellsInRange =
+	(static_cast<double> (range.maxX) - range.minX + 1) *
+	(static_cast<double> (range.maxY) - range.minY + 1);
+
+    if (cellsInRange > m_cells.size ())
+      {
+	for (auto const& cell : m_cells)
+	  {
+	    auto x = static_cast<std::int32_t> (cell.first >> 32);
+	    auto y = static_cast<std::int32_t> (cell.first & 0xffffffff);
+	    if (x >= range.minX && x <= range.maxX &&
+		y >= range.minY && y <= range.maxY &&
+		!VisitCell (cell.second, x, y, g, range, visitor))
+	      {
+		return false;
+	      }
+	  }
+      }
+    else
+      {
+	for (auto x = range.minX; x <= range.maxX; ++x)
+	  {
+	    for (auto y = range.minY; y <= range.maxY; ++y)
+	      {
+		auto cell = m_cells.find (MakeKey (x, y));
+		if (cell != m_cells.end () &&
+		    !VisitCell (cell->second, x, y, g, range, visitor))
+		  {
+		    return false;
+		  }
+	      }
+	  }
+      }
+
+    return true;
+  }
+
+private:
+
+  //! Range of cells covered by a box
+  struct CellRange
+  {
+    std::int32_t minX;
+    std::int32_t minY;
+    std::int32_t maxX;
+    std::int32_t maxY;
+  };
+
+  /*!
+   * @brief Get the cell index for a coordinate.
+   *
+   * Coordinates beyond the range of the cell index share the outermost
+   * cells. The range leaves one index on each side, so loops over cell
+   * ranges cannot overflow.
+   */
+  std::int32_t
+  GetCell (double c) const
+  {
+    const double minCell = std::numeric_limits<std::int32_t>::min () + 1;
+    const double maxCell = std::numeric_limits<std::int32_t>::max () - 1;
+    double cell = std::floor (c / m_cellSize);
+    return static_cast<std::int32_t> (std::min (std::max (cell, minCell), maxCell));
+  }
+
+  //! Get the range of cells covered by @a box
+  CellRange
+  GetCellRange (const Box2d& box) const
+  {
+    return CellRange {
+      GetCell (box.min_corner ().x ()), GetCell (box.min_corner ().y ()),
+      GetCell (box.max_corner ().x ()), GetCell (box.max_corner ().y ())
+    };
+  }
+
+  //! Make hash key from cell coordinates
+  static std::uint64_t
+  MakeKey (std::int32_t x, std::int32_t y)
+  {
+    return (static_cast<std::uint64_t> (static_cast<std::uint32_t> (x)) << 32) |
+	static_cast<std::uint32_t> (y);
+  }
+
+  /*!
+   * @brief Visit matching objects of a single cell.
+   * @param values	Objects stored in the cell
+   * @param x		Column of the cell
+   * @param y		Row of the cell
+   * @param g		Geometry to test
+   * @param range	Cells covered by the query
+   * @param visitor	Called for each object, return false to stop
+   * @return False if the visitor stopped the query, true otherwise
+   */
+  template<typename Geometry, typename Visitor>
+  bool
+  VisitCell (const std::vector<Value>& values,
+	     std::int32_t x, std::int32_t y,
+	     const Geometry& g, const CellRange& range,
+	     Visitor& visitor) const
+  {
+    for (auto const& v : values)
+      {
+	auto const& box = m_getter (v);
+
+	// only report the object in the first cell shared with the query
+	auto objectRange = GetCellRange (box);
+	if (x != std::max (objectRange.minX, range.minX) ||
+	    y != std::max (objectRange.minY, range.minY))
+	  {
+	    continue;
+	  }
+
+	if (boost::geometry::intersects (box, g) && !visitor (v))
+	  {
+	    return false;
+	  }
+      }
+    return true;
+  }
+
+  //! Edge length of a cell
+  double m_cellSize;
+
+  //! Number of stored objects
+  std::size_t m_size;
+
+  //! Access to the box of a value
+  IndexableGetter m_getter;
+
+  //! Occupied cells
+  std::unordered_map<std::uint64_t, std::vector<Value>> m_cells;
+};
+
+namespace detail
+{
+
+//! Queries on the spatial grid
+template<typename Value, typename IndexableGetter>
+struct IndexQuery<SpatialGrid<Value, IndexableGetter>>
+{
+  using IndexType = SpatialGrid<Value, IndexableGetter>;
+
+  template<typename Geometry, typename Predicate>
+  static bool
+  Any (const IndexType& index, const Geometry& g, Predicate predicate)
+  {
+    return !index.Visit (
+	g, [&predicate] (const Value& v) { return !predicate (v); });
+  }
+
+  template<typename Geometry, typename Predicate, typename OutputIterator>
+  static void
+  Query (const IndexType& index, const Geometry& g, Predicate predicate,
+	 OutputIterator outputIterator)
+  {
+    index.Visit (
+	g,
+	[&predicate, &outputIterator] (const Value& v)
+	{
+	  if (predicate (v))
+	    {
+	      *outputIterator++ = v;
+	    }
+	  return true;
+	});
+  }
+};
+
+}  // namespace detail
+
+}  // namespace gemv2
+}  // namespace ns3
+
+#endif /* GEMV2_SPATIAL_GRID_H */
@@ -0,0 +1,534 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "gemv2-static-layer-file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <ns3/log.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("Gemv2StaticLayerFile");
+
+namespace gemv2 {
+
+namespace {
+
+/*
+ * File layout, all records are 8 byte aligned:
+ *
+ * FileHeader
+ * ObjectRecord[buildings]
+ * ObjectRecord[foliage]
+ * RingRecord[rings]		rings of all objects, outer ring first
+ * PointRecord[points]		vertices of all rings
+ * NodeRecord[buildingNodes]
+ * NodeRecord[foliageNodes]
+ */
+
+//! Magic string at the start of each file
+const char FILE_MAGIC[8] = {'G', 'E', 'M', 'V', '2', 'S', 'L', 'F'};
+
+//! Written in native byte order to detect foreign files
+const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+//! Position of a record array in the file
+struct SectionRecord
+{
+  std::uint64_t offset;
+  std::uint64_t count;
+};
+
+//! Sections of the file
+enum Section
+{
+  SECTION_BUILDINGS,
+  SECTION_FOLIAGE,
+  SECTION_RINGS,
+  SECTION_POINTS,
+  SECTION_BUILDING_NODES,
+  SECTION_FOLIAGE_NODES,
+  NUM_SECTIONS
+};
+
+struct FileHeader
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byteOrder;
+  std::uint64_t fileSize;
+  SectionRecord sections[NUM_SECTIONS];
+};
+
+struct ObjectRecord
+{
+  //! Area of the object [m^2]
+  double area;
+  //! Relative permittivity, only used for buildings
+  double relativePermittivity;
+  //! Index of the outer ring
+  std::uint64_t firstRing;
+  //! Number of rings (outer ring and holes)
+  std::uint64_t numRings;
+};
+
+struct RingRecord
+{
+  std::uint64_t firstPoint;
+  std::uint64_t numPoints;
+};
+
+struct PointRecord
+{
+  double x;
+  double y;
+};
+
+struct NodeRecord
+{
+  double minX;
+  double minY;
+  double maxX;
+  double maxY;
+  std::uint32_t first;
+  std::uint32_t count;
+  std::uint64_t objects;
+  double weight;
+  std::uint64_t leaf;
+};
+
+//! Read-only mapping of a whole file
+class MappedFile
+{
+public:
+  MappedFile ()
+    : m_data (nullptr),
+      m_size (0)
+  {
+  }
+
+  ~MappedFile ()
+  {
+    if (m_data)
+      {
+	munmap (m_data, m_size);
+      }
+  }
+
+  MappedFile (const MappedFile&) = delete;
+  MappedFile& operator= (const MappedFile&) = delete;
+
+  bool
+  Open (const std::string& fileName)
+  {
+    int fd = open (fileName.c_str (), O_RDONLY);
+    if (fd < 0)
+      {
+	return false;
+      }
+
+    struct stat st;
+    if (fstat (fd, &st) == 0 && st.st_size > 0)
+      {
+	void* data = mmap (nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data != MAP_FAILED)
+	  {
+	    m_data = data;
+	    m_size = st.st_size;
+	  }
+      }
+
+    // the mapping stays valid after closing the file
+    close (fd);
+    return m_data != nullptr;
+  }
+
+  const char*
+  GetData () const
+  {
+    return static_cast<const char*> (m_data);
+  }
+
+  std::size_t
+  GetSize () const
+  {
+    return m_size;
+  }
+
+private:
+  void* m_data;
+  std::size_t m_size;
+};
+
+//! Write the records of a vector
+template<typename T>
+void
+WriteRecords (std::ostream& os, const std::vector<T>& records)
+{
+  os.write (reinterpret_cast<const char*> (records.data ()),
+	    records.size () * sizeof (T));
+}
+
+//! Get the records of a section, null if it is out of bounds
+template<typename T>
+const T*
+GetRecords (const MappedFile& file, const SectionRecord& section)
+{
+  if (section.offset % alignof (T) != 0 ||
+      section.offset > file.GetSize () ||
+      section.count > (file.GetSize () - section.offset) / sizeof (T))
+    {
+      return nullptr;
+    }
+  return reinterpret_cast<const T*> (file.GetData () + section.offset);
+}
+
+//! Add the rings of a polygon to the record arrays
+void
+AddShape (const Polygon2d& shape, ObjectRecord& object,
+	  std::vector<RingRecord>& rings, std::vector<PointRecord>& points)
+{
+  object.firstRing = rings.size ();
+  object.numRings = 1 + shape.inners ().size ();
+
+  auto addRing = [&rings, &points] (const Polygon2d::ring_type& ring)
+  {
+    rings.push_back (RingRecord {static_cast<std::uint64_t> (points.size ()),
+				  static_cast<std::uint64_t> (ring.size ())});
+    for (auto const& p : ring)
+      {
+	points.push_back (PointRecord {p.x (), p.y ()});
+      }
+  };
+
+  addRing (shape.outer ());
+  for (auto const& ring : shape.inners ())
+    {
+      addRing (ring);
+    }
+}
+
+//! Create a polygon from the record arrays, false if out of bounds
+bool
+MakeShape (const ObjectRecord& object,
+	   const RingRecord* rings, std::size_t numRings,
+	   const PointRecord* points, std::size_t numPoints,
+	   Polygon2d& shape)
+{
+  if (object.numRings == 0 || object.firstRing >= numRings ||
+      object.numRings > numRings - object.firstRing)
+    {
+      return false;
+    }
+
+  for (std::size_t r = 0; r < object.numRings; ++r)
+    {
+      auto const& ring = rings[object.firstRing + r];
+      if (ring.firstPoint > numPoints || ring.numPoints > numPoints - ring.firstPoint)
+	{
+	  return false;
+	}
+
+      if (r > 0)
+	{
+	  shape.inners ().resize (r);
+	}
+      auto& target = r == 0 ? shape.outer () : shape.inners ()[r - 1];
+      target.reserve (ring.numPoints);
+      for (std::size_t i = 0; i < ring.numPoints; ++i)
+	{
+	  auto const& p = points[ring.firstPoint + i];
+	  target.push_back (Point2d (p.x, p.y));
+	}
+    }
+
+  return true;
+}
+
+NodeRecord
+MakeNodeRecord (const detail::AggregateNode& node)
+{
+  return NodeRecord {
+    node.box.min_corner ().x (), node.box.min_corner ().y (),
+    node.box.max_corner ().x (), node.box.max_corner ().y (),
+    node.first, node.count, node.objects, node.weight, node.leaf};
+}
+
+detail::AggregateNode
+MakeNode (const NodeRecord& record)
+{
+  detail::AggregateNode node;
+  node.box = Box2d (Point2d (record.minX, record.minY),
+		    Point2d (record.maxX, record.maxY));
+  node.first = record.first;
+  node.count = record.count;
+  node.objects = record.objects;
+  node.weight = record.weight;
+  node.leaf = record.leaf != 0;
+  return node;
+}
+
+/*!
+ * @brief Check that the nodes form a tree over all objects.
+ *
+ * The builder stores children before their parents and the root last, so
+ * requiring each child to precede its parent rules out cycles. Together
+ * with exactly one parent for all nodes but the root, every node belongs
+ * to the tree of the root. Each object has to be stored in exactly one
+ * leaf and the object counts of the nodes have to match.
+ */
+bool
+CheckNodes (const std::vector<detail::AggregateNode>& nodes, std::size_t objects)
+{
+  if (nodes.empty ())
+    {
+      return objects == 0;
+    }
+
+  std::vector<std::uint8_t> parents (nodes.size (), 0);
+  std::vector<std::uint8_t> stored (objects, 0);
+  for (std::size_t i = 0; i < nodes.size (); ++i)
+    {
+      auto const& n = nodes[i];
+      std::size_t children = n.leaf ? objects : i;
+      if (n.count == 0 || n.first > children || n.count > children - n.first)
+	{
+	  return false;
+	}
+
+      std::uint64_t count = 0;
+      for (std::size_t c = n.first; c < n.first + n.count; ++c)
+	{
+	  auto& references = n.leaf ? stored[c] : parents[c];
+	  if (references++ != 0)
+	    {
+	      return false;
+	    }
+	  count += n.leaf ? 1 : nodes[c].objects;
+	}
+
+      if (n.objects != count)
+	{
+	  return false;
+	}
+    }
+
+  // the root is the only node without a parent
+  for (std::size_t i = 0; i + 1 < nodes.size (); ++i)
+    {
+      if (parents[i] == 0)
+	{
+	  return false;
+	}
+    }
+
+  return std::all_of (stored.begin (), stored.end (),
+		      [] (std::uint8_t s) { return s != 0; });
+}
+
+}  // namespace
+
+bool
+WriteStaticLayerFile (const std::string& fileName,
+		      const StaticLayerContents& contents)
+{
+  NS_LOG_FUNCTION (fileName);
+
+  std::vector<ObjectRecord> buildings;
+  std::vector<ObjectRecord> foliage;
+  std::vector<RingRecord> rings;
+  std::vector<PointRecord> points;
+  std::vector<NodeRecord> buildingNodes;
+  std::vector<NodeRecord> foliageNodes;
+
+  for (auto const& b : contents.buildings)
+    {
+      ObjectRecord object {b->GetArea (), b->GetRelativePermittivity (), 0, 0};
+      AddShape (b->DecodeShape (), object, rings, points);
+      buildings.push_back (object);
+    }
+
+  for (auto const& f : contents.foliage)
+    {
+      ObjectRecord object {f->GetArea (), 0, 0, 0};
+      AddShape (f->DecodeShape (), object, rings, points);
+      foliage.push_back (object);
+    }
+
+  for (auto const& n : contents.buildingNodes)
+    {
+      buildingNodes.push_back (MakeNodeRecord (n));
+    }
+
+  for (auto const& n : contents.foliageNodes)
+    {
+      foliageNodes.push_back (MakeNodeRecord (n));
+    }
+
+  FileHeader header;
+  std::memcpy (header.magic, FILE_MAGIC, sizeof (header.magic));
+  header.version = STATIC_LAYER_FILE_VERSION;
+  header.byteOrder = BYTE_ORDER_MARK;
+
+  std::uint64_t offset = sizeof (FileHeader);
+  auto addSection = [&header, &offset] (Section s, std::size_t count, std::size_t size)
+  {
+    header.sections[s] = SectionRecord {offset, count};
+    offset += count * size;
+  };
+  addSection (SECTION_BUILDINGS, buildings.size (), sizeof (ObjectRecord));
+  addSection (SECTION_FOLIAGE, foliage.size (), sizeof (ObjectRecord));
+  addSection (SECTION_RINGS, rings.size (), sizeof (RingRecord));
+  addSection (SECTION_POINTS, points.size (), sizeof (PointRecord));
+  addSection (SECTION_BUILDING_NODES, buildingNodes.size (), sizeof (NodeRecord));
+  addSection (SECTION_FOLIAGE_NODES, foliageNodes.size (), sizeof (NodeRecord));
+  header.fileSize = offset;
+
+  std::ofstream os (fileName, std::ios::binary | std::ios::trunc);
+  if (!os.is_open ())
+    {
+      NS_LOG_ERROR ("Failed to open " << fileName);
+      return false;
+    }
+
+  os.write (reinterpret_cast<const char*> (&header), sizeof (header));
+  WriteRecords (os, buildings);
+  WriteRecords (os, foliage);
+  WriteRecords (os, rings);
+  WriteRecords (os, points);
+  WriteRecords (os, buildingNodes);
+  WriteRecords (os, foliageNodes);
+
+  NS_LOG_INFO ("Wrote " << buildings.size () << " buildings and "
+	       << foliage.size () << " foliage objects to " << fileName);
+
+  return static_cast<bool> (os);
+}
+
+bool
+ReadStaticLayerFile (const std::string& fileName,
+		     StaticLayerContents& contents)
+{
+  NS_LOG_FUNCTION (fileName);
+
+  MappedFile file;
+  if (!file.Open (fileName))
+    {
+      NS_LOG_ERROR ("Failed to map " << fileName);
+      return false;
+    }
+
+  if (file.GetSize () < sizeof (FileHeader))
+    {
+      NS_LOG_ERROR (fileName << " is too small");
+      return false;
+    }
+
+  auto header = reinterpret_cast<const FileHeader*> (file.GetData ());
+  if (std::memcmp (header->magic, FILE_MAGIC, sizeof (FILE_MAGIC)) != 0 ||
+      header->byteOrder != BYTE_ORDER_MARK ||
+      header->version != STATIC_LAYER_FILE_VERSION ||
+      header->fileSize != file.GetSize ())
+    {
+      NS_LOG_ERROR (fileName << " is not a static layer file of version "
+		    << STATIC_LAYER_FILE_VERSION << " in native byte order");
+      return false;
+    }
+
+  auto const* sections = header->sections;
+  auto buildings = GetRecords<ObjectRecord> (file, sections[SECTION_BUILDINGS]);
+  auto foliage = GetRecords<ObjectRecord> (file, sections[SECTION_FOLIAGE]);
+  auto rings = GetRecords<RingRecord> (file, sections[SECTION_RINGS]);
+  auto points = GetRecords<PointRecord> (file, sections[SECTION_POINTS]);
+  auto buildingNodes = GetRecords<NodeRecord> (file, sections[SECTION_BUILDING_NODES]);
+  auto foliageNodes = GetRecords<NodeRecord> (file, sections[SECTION_FOLIAGE_NODES]);
+  if (!buildings || !foliage || !rings || !points || !buildingNodes || !foliageNodes)
+    {
+      NS_LOG_ERROR (fileName << " is truncated");
+      return false;
+    }
+
+  std::size_t numRings = sections[SECTION_RINGS].count;
+  std::size_t numPoints = sections[SECTION_POINTS].count;
+
+  StaticLayerContents result;
+  for (std::size_t i = 0; i < sections[SECTION_BUILDINGS].count; ++i)
+    {
+      Polygon2d shape;
+      if (!MakeShape (buildings[i], rings, numRings, points, numPoints, shape))
+	{
+	  NS_LOG_ERROR ("Invalid building " << i << " in " << fileName);
+	  return false;
+	}
+      auto b = Create<Building> (shape);
+      b->SetRelativePermittivity (buildings[i].relativePermittivity);
+      if (!(std::abs (b->GetArea () - buildings[i].area) <=
+	    1e-9 * std::max (1.0, buildings[i].area)))
+	{
+	  NS_LOG_ERROR ("Invalid area of building " << i << " in " << fileName);
+	  return false;
+	}
+      result.buildings.push_back (b);
+    }
+
+  for (std::size_t i = 0; i < sections[SECTION_FOLIAGE].count; ++i)
+    {
+      Polygon2d shape;
+      if (!MakeShape (foliage[i], rings, numRings, points, numPoints, shape))
+	{
+	  NS_LOG_ERROR ("Invalid foliage object " << i << " in " << fileName);
+	  return false;
+	}
+      result.foliage.push_back (Create<Foliage> (shape));
+    }
+
+  for (std::size_t i = 0; i < sections[SECTION_BUILDING_NODES].count; ++i)
+    {
+      result.buildingNodes.push_back (MakeNode (buildingNodes[i]));
+    }
+
+  for (std::size_t i = 0; i < sections[SECTION_FOLIAGE_NODES].count; ++i)
+    {
+      result.foliageNodes.push_back (MakeNode (foliageNodes[i]));
+    }
+
+  if (!CheckNodes (result.buildingNodes, result.buildings.size ()) ||
+      !CheckNodes (result.foliageNodes, result.foliage.size ()))
+    {
+      NS_LOG_ERROR ("Invalid tree nodes in " << fileName);
+      return false;
+    }
+
+  NS_LOG_INFO ("Read " << result.buildings.size () << " buildings and "
+	       << result.foliage.size () << " foliage objects from " << fileName);
+
+  contents = std::move (result);
+  return true;
+}
+
+}  // namespace gemv2
+}  // namespace ns3
@@ -0,0 +1,89 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GEMV2_STATIC_LAYER_FILE_H
+#define GEMV2_STATIC_LAYER_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <ns3/ptr.h>
+
+#include <ns3/gemv2-building.h>
+#include <ns3/gemv2-foliage.h>
+#include <ns3/gemv2-aggregate-tree.h>
+
+namespace ns3 {
+namespace gemv2 {
+
+//! Version of the binary static layer format written by this code
+const std::uint32_t STATIC_LAYER_FILE_VERSION = 1;
+
+/*!
+ * @brief Buildings and foliage together with their packed indexes.
+ *
+ * The objects are stored in the order of the leaves of the aggregate
+ * trees, which is also a good order to pack other trees from.
+ */
+struct StaticLayerContents
+{
+  //! Buildings in index order
+  std::vector<Ptr<Building>> buildings;
+  //! Nodes of the building aggregate tree
+  std::vector<detail::AggregateNode> buildingNodes;
+  //! Foliage objects in index order
+  std::vector<Ptr<Foliage>> foliage;
+  //! Nodes of the foliage aggregate tree
+  std::vector<detail::AggregateNode> foliageNodes;
+};
+
+/*!
+ * @brief Write static objects to a binary file.
+ *
+ * The file starts with a header containing a magic string, the format
+ * version and the byte order, followed by fixed size records for the
+ * objects, their rings, the vertices and the tree nodes. All records are
+ * 8 byte aligned, so the file can be used directly after mapping it.
+ *
+ * @param fileName	File to write
+ * @param contents	Objects and indexes to write
+ * @return False if the file could not be written
+ */
+bool
+WriteStaticLayerFile (const std::string& fileName,
+		      const StaticLayerContents& contents);
+
+/*!
+ * @brief Read static objects from a binary file.
+ *
+ * The file is mapped into memory and the objects are created from the
+ * records without any parsing. Files of other versions or with another
+ * byte order are rejected.
+ *
+ * @param fileName	File to read
+ * @param contents	Read objects and indexes, only modified on success
+ * @return False if the file could not be read or is invalid
+ */
+bool
+ReadStaticLayerFile (const std::string& fileName,
+		     StaticLayerContents& contents);
+
+}  // namespace gemv2
+}  // namespace ns3
+
+#endif /* GEMV2_STATIC_LAYER_FILE_H */
@@ -0,0 +1,434 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "gemv2-static-layer-tiles.h"
+
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <utility>
+
+#include <boost/geometry/index/rtree.hpp>
+#include <boost/function_output_iterator.hpp>
+
+#include <ns3/assert.h>
+#include <ns3/log.h>
+#include <ns3/system-path.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("Gemv2StaticLayerTiles");
+
+namespace gemv2 {
+
+namespace {
+
+//! First token of each manifest
+const char MANIFEST_MAGIC[] = "GEMV2-TILES";
+
+//! Version of the manifest format
+const unsigned MANIFEST_VERSION = 1;
+
+//! Join a directory and a file name
+std::string
+MakePath (const std::string& directory, const std::string& fileName)
+{
+  return directory + "/" + fileName;
+}
+
+//! Size of a file in bytes, 0 if it cannot be opened
+std::uint64_t
+GetFileSize (const std::string& fileName)
+{
+  std::ifstream is (fileName, std::ios::binary | std::ios::ate);
+  return is.is_open () ? static_cast<std::uint64_t> (is.tellg ()) : 0;
+}
+
+}  // namespace
+
+bool
+WriteStaticLayerTiles (const std::string& directory,
+		       const std::vector<StaticLayerContents>& tiles)
+{
+  NS_LOG_FUNCTION (directory << tiles.size ());
+
+  SystemPath::MakeDirectories (directory);
+
+  std::vector<StaticLayerTile> manifest;
+  for (auto const& contents : tiles)
+    {
+      if (contents.buildings.empty () && contents.foliage.empty ())
+	{
+	  continue;
+	}
+
+      StaticLayerTile tile;
+      boost::geometry::assign_inverse (tile.bounds);
+      for (auto const& b : contents.buildings)
+	{
+	  boost::geometry::expand (tile.bounds, b->GetBoundingBox ());
+	}
+      for (auto const& f : contents.foliage)
+	{
+	  boost::geometry::expand (tile.bounds, f->GetBoundingBox ());
+	}
+
+      std::ostringstream fileName;
+      fileName << "tile-" << manifest.size () << ".bin";
+      tile.fileName = fileName.str ();
+
+      auto path = MakePath (directory, tile.fileName);
+      if (!WriteStaticLayerFile (path, contents))
+	{
+	  return false;
+	}
+      tile.size = GetFileSize (path);
+      manifest.push_back (tile);
+    }
+
+  auto manifestName = MakePath (directory, STATIC_LAYER_TILE_MANIFEST);
+  std::ofstream os (manifestName, std::ios::trunc);
+  if (!os.is_open ())
+    {
+      NS_LOG_ERROR ("Failed to open " << manifestName);
+      return false;
+    }
+
+  // the bounds have to enclose the objects, so write them without rounding
+  os.precision (std::numeric_limits<double>::max_digits10);
+  os << MANIFEST_MAGIC << " " << MANIFEST_VERSION << " " << manifest.size () << "\n";
+  for (auto const& tile : manifest)
+    {
+      os << tile.fileName << " "
+	  << tile.bounds.min_corner ().x () << " " << tile.bounds.min_corner ().y () << " "
+	  << tile.bounds.max_corner ().x () << " " << tile.bounds.max_corner ().y () << " "
+	  << tile.size << "\n";
+    }
+
+  NS_LOG_INFO ("Wrote " << manifest.size () << " tiles to " << directory);
+
+  return static_cast<bool> (os);
+}
+
+bool
+ReadStaticLayerTileManifest (const std::string& directory,
+			     std::vector<StaticLayerTile>& tiles)
+{
+  NS_LOG_FUNCTION (directory);
+
+  auto manifestName = MakePath (directory, STATIC_LAYER_TILE_MANIFEST);
+  std::ifstream is (manifestName);
+  if (!is.is_open ())
+    {
+      NS_LOG_ERROR ("Failed to open " << manifestName);
+      return false;
+    }
+
+  std::string magic;
+  unsigned version = 0;
+  std::size_t count = 0;
+  if (!(is >> magic >> version >> count) ||
+      magic != MANIFEST_MAGIC || version != MANIFEST_VERSION)
+    {
+      NS_LOG_ERROR (manifestName << " is not a tile manifest of version "
+		    << MANIFEST_VERSION);
+      return false;
+    }
+
+  std::vector<StaticLayerTile> result;
+  for (std::size_t i = 0; i < count; ++i)
+    {
+      StaticLayerTile tile;
+      double minX, minY, maxX, maxY;
+      if (!(is >> tile.fileName >> minX >> minY >> maxX >> maxY >> tile.size) ||
+	  minX > maxX || minY > maxY)
+	{
+	  NS_LOG_ERROR ("Invalid tile " << i << " in " << manifestName);
+	  return false;
+	}
+      tile.bounds = Box2d (Point2d (minX, minY), Point2d (maxX, maxY));
+      result.push_back (tile);
+    }
+
+  tiles = std::move (result);
+  return true;
+}
+
+/*
+ * Manifest and state of the tiles
+ */
+struct StaticLayerTileCache::Data
+{
+  //! Tree over the bounds of the tiles, storing the tile index
+  using TileTree =
+      boost::geometry::index::rtree<
+      std::pair<Box2d, std::size_t>, boost::geometry::index::quadratic<16>>;
+
+  //! State of a single tile
+  struct TileState
+  {
+    //! True if the objects are loaded
+    bool resident = false;
+    //! True if the file could not be read
+    bool failed = false;
+    //! Clock value of the last request touching the tile
+    std::uint64_t lastUse = 0;
+    //! Number of times the tile is pinned, pinned tiles are not evicted
+    std::size_t pins = 0;
+    //! Objects of the tile while resident
+    StaticLayerContents contents;
+  };
+
+  //! Directory containing the tile files
+  std::string directory;
+
+  //! Manifest of the directory, shared between copies
+  std::shared_ptr<const std::vector<StaticLayerTile>> tiles;
+
+  //! Index of the tile bounds, shared between copies
+  std::shared_ptr<const TileTree> tree;
+
+  //! State of each tile in the manifest
+  std::vector<TileState> states;
+
+  //! Indexes of the resident tiles
+  std::vector<std::size_t> resident;
+
+  //! Maximum summed size of the resident tiles [byte]
+  std::uint64_t memoryBudget = 0;
+
+  //! Summed size of the resident tiles [byte]
+  std::uint64_t residentSize = 0;
+
+  //! Incremented on each request
+  std::uint64_t clock = 0;
+
+  //! Number of tile loads
+  std::size_t loads = 0;
+
+  //! Number of tile evictions
+  std::size_t evictions = 0;
+
+  //! Number of tiles that could not be read
+  std::size_t failures = 0;
+
+  /*!
+   * @brief Read a tile and pass its objects to @a load.
+   * @param i		Index of the tile
+   * @param load	Called with the objects on success
+   */
+  void
+  Load (std::size_t i, const TileVisitor& load)
+  {
+    auto& state = states[i];
+    auto const& tile = (*tiles)[i];
+    if (!ReadStaticLayerFile (MakePath (directory, tile.fileName), state.contents))
+      {
+	NS_LOG_ERROR ("Failed to load tile " << tile.fileName << ", skipping it");
+	state.failed = true;
+	++failures;
+	return;
+      }
+
+    NS_LOG_LOGIC ("Loaded tile " << tile.fileName << " with "
+		  << state.contents.buildings.size () << " buildings and "
+		  << state.contents.foliage.size () << " foliage objects");
+
+    state.resident = true;
+    resident.push_back (i);
+    residentSize += tile.size;
+    ++loads;
+    load (i, state.contents);
+  }
+
+  /*!
+   * @brief Mark the tiles touching any of several boxes as used.
+   *
+   * Starts a new request, missing tiles are loaded.
+   *
+   * @param boxes	Boxes the objects of interest intersect with
+   * @param load	Called with the objects of each loaded tile
+   * @param used	If not null, receives the indexes of the resident
+   *			tiles touching @a boxes, each only once
+   */
+  void
+  Use (const std::vector<Box2d>& boxes, const TileVisitor& load,
+       std::vector<std::size_t>* used)
+  {
+    ++clock;
+    for (auto const& box : boxes)
+      {
+	tree->query (
+	    boost::geometry::index::intersects (box),
+	    boost::make_function_output_iterator (
+		[this, &load, used](const TileTree::value_type& v)
+		{
+		  auto& state = states[v.second];
+		  if (state.lastUse == clock)
+		    {
+		      return;
+		    }
+		  state.lastUse = clock;
+		  if (!state.resident && !state.failed)
+		    {
+		      Load (v.second, load);
+		    }
+		  if (used && state.resident)
+		    {
+		      used->push_back (v.second);
+		    }
+		}));
+      }
+  }
+
+  /*!
+   * @brief Evict least recently used tiles until the budget is met.
+   *
+   * Tiles used by the current request and pinned tiles are kept.
+   *
+   * @param evict	Called with the objects of each evicted tile
+   */
+  void
+  EvictTiles (const TileVisitor& evict)
+  {
+    while (residentSize > memoryBudget)
+      {
+	auto lru = resident.end ();
+	for (auto it = resident.begin (); it != resident.end (); ++it)
+	  {
+	    auto lastUse = states[*it].lastUse;
+	    if (lastUse < clock && states[*it].pins == 0 &&
+		(lru == resident.end () || lastUse < states[*lru].lastUse))
+	      {
+		lru = it;
+	      }
+	  }
+	if (lru == resident.end ())
+	  {
+	    return;
+	  }
+
+	std::size_t i = *lru;
+	*lru = resident.back ();
+	resident.pop_back ();
+
+	auto& state = states[i];
+	NS_LOG_LOGIC ("Evicting tile " << (*tiles)[i].fileName);
+	evict (i, state.contents);
+	state.contents = StaticLayerContents ();
+	state.resident = false;
+	residentSize -= (*tiles)[i].size;
+	++evictions;
+      }
+  }
+};
+
+StaticLayerTileCache::StaticLayerTileCache (const std::string& directory,
+					    std::vector<StaticLayerTile> tiles,
+					    std::uint64_t memoryBudget)
+  : m_data (new Data)
+{
+  std::vector<Data::TileTree::value_type> boxes;
+  for (std::size_t i = 0; i < tiles.size (); ++i)
+    {
+      boxes.push_back (std::make_pair (tiles[i].bounds, i));
+    }
+
+  m_data->directory = directory;
+  m_data->states.resize (tiles.size ());
+  m_data->tiles = std::make_shared<const std::vector<StaticLayerTile>> (std::move (tiles));
+  m_data->tree = std::make_shared<const Data::TileTree> (boxes.begin (), boxes.end ());
+  m_data->memoryBudget = memoryBudget;
+}
+
+StaticLayerTileCache::StaticLayerTileCache (const StaticLayerTileCache& other)
+  : m_data (new Data (*other.m_data))
+{
+  for (auto& state : m_data->states)
+    {
+      state.pins = 0;
+    }
+}
+
+StaticLayerTileCache::~StaticLayerTileCache () = default;
+
+void
+StaticLayerTileCache::Request (const Box2d& box, const TileVisitor& load,
+			       const TileVisitor& evict)
+{
+  Request (std::vector<Box2d> {box}, load, evict);
+}
+
+void
+StaticLayerTileCache::Request (const std::vector<Box2d>& boxes,
+			       const TileVisitor& load, const TileVisitor& evict)
+{
+  m_data->Use (boxes, load, nullptr);
+
+  // tiles kept over budget for the previous request are evicted now
+  m_data->EvictTiles (evict);
+}
+
+std::vector<std::size_t>
+StaticLayerTileCache::Pin (const std::vector<Box2d>& boxes,
+			   const TileVisitor& load, const TileVisitor& evict)
+{
+  std::vector<std::size_t> pinned;
+  m_data->Use (boxes, load, &pinned);
+  for (auto i : pinned)
+    {
+      ++m_data->states[i].pins;
+    }
+  m_data->EvictTiles (evict);
+  return pinned;
+}
+
+void
+StaticLayerTileCache::Unpin (const std::vector<std::size_t>& tiles)
+{
+  for (auto i : tiles)
+    {
+      NS_ASSERT_MSG (m_data->states[i].pins > 0, "tile " << i << " is not pinned");
+      --m_data->states[i].pins;
+    }
+}
+
+bool
+StaticLayerTileCache::IsResident (const Box2d& box) const
+{
+  auto const& data = *m_data;
+  return data.tree->qbegin (
+      boost::geometry::index::intersects (box) &&
+      boost::geometry::index::satisfies (
+	  [&data](const Data::TileTree::value_type& v)
+	  {
+	    auto const& state = data.states[v.second];
+	    return !state.resident && !state.failed;
+	  })
+      ) == data.tree->qend ();
+}
+
+StaticLayerTileCache::Statistics
+StaticLayerTileCache::GetStatistics () const
+{
+  return Statistics {m_data->tiles->size (), m_data->resident.size (),
+		     m_data->residentSize, m_data->loads, m_data->evictions,
+		     m_data->failures};
+}
+
+}  // namespace gemv2
+}  // namespace ns3
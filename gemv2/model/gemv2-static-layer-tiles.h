@@ -0,0 +1,227 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GEMV2_STATIC_LAYER_TILES_H
+#define GEMV2_STATIC_LAYER_TILES_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <ns3/gemv2-geometry.h>
+#include <ns3/gemv2-static-layer-file.h>
+
+namespace ns3 {
+namespace gemv2 {
+
+//! Name of the file listing the tiles of a tile directory
+const char* const STATIC_LAYER_TILE_MANIFEST = "tiles.txt";
+
+/*!
+ * @brief Entry of the tile manifest.
+ *
+ * Each tile is a static layer file (see WriteStaticLayerFile()). Objects
+ * belong to exactly one tile, but may reach into neighboring tiles. The
+ * bounds of a tile enclose all of its objects, not only its grid cell.
+ */
+struct StaticLayerTile
+{
+  //! Box around all objects of the tile
+  Box2d bounds;
+  //! Name of the static layer file, relative to the tile directory
+  std::string fileName;
+  //! Size of the file, used to estimate the memory of the objects [byte]
+  std::uint64_t size;
+};
+
+/*!
+ * @brief Write tiles and their manifest to a directory.
+ *
+ * The directory is created if necessary. Tiles without objects are
+ * skipped.
+ *
+ * @param directory	Directory to write to
+ * @param tiles		Objects and packed aggregate trees of each tile
+ * @return False if a file could not be written
+ */
+bool
+WriteStaticLayerTiles (const std::string& directory,
+		       const std::vector<StaticLayerContents>& tiles);
+
+/*!
+ * @brief Read the manifest of a tile directory.
+ * @param directory	Directory written by WriteStaticLayerTiles()
+ * @param tiles		Entries of the manifest, only modified on success
+ * @return False if the manifest could not be read or is invalid
+ */
+bool
+ReadStaticLayerTileManifest (const std::string& directory,
+			     std::vector<StaticLayerTile>& tiles);
+
+/*!
+ * @brief Loads tiles on demand and evicts the least recently used ones.
+ *
+ * The cache only decides which tiles have to be loaded or evicted and
+ * reads the files. Adding the objects to the indexes and removing them
+ * again is up to the owner, which is notified by the callbacks passed to
+ * Request().
+ *
+ * The memory budget is compared with the summed file sizes of the
+ * resident tiles, which is proportional to the memory of the objects.
+ * Tiles needed by the current request are never evicted, so the budget
+ * does not apply to a single request: a request touching more tiles than
+ * fit into the budget keeps all of them resident, the surplus is evicted
+ * by the next request.
+ */
+class StaticLayerTileCache
+{
+public:
+  /*!
+   * @brief Callback for loaded and evicted tiles.
+   *
+   * Called with the index of the tile in the manifest and its objects.
+   */
+  using TileVisitor =
+      std::function<void (std::size_t, const StaticLayerContents&)>;
+
+  //! Counters of the cache
+  struct Statistics
+  {
+    //! Number of tiles in the manifest
+    std::size_t tiles;
+    //! Number of tiles currently loaded
+    std::size_t residentTiles;
+    //! Summed file size of the loaded tiles [byte]
+    std::uint64_t residentSize;
+    //! Number of tile loads
+    std::size_t loads;
+    //! Number of tile evictions
+    std::size_t evictions;
+    //! Number of tiles that could not be read
+    std::size_t failures;
+  };
+
+  /*!
+   * @brief Create cache without resident tiles.
+   * @param directory		Directory containing the tile files
+   * @param tiles		Manifest of the directory
+   * @param memoryBudget	Maximum summed size of the resident tiles [byte]
+   */
+  StaticLayerTileCache (const std::string& directory,
+			std::vector<StaticLayerTile> tiles,
+			std::uint64_t memoryBudget);
+
+  /*!
+   * @brief Copy the cache including the resident tiles.
+   *
+   * The objects of the resident tiles are shared with @a other. Pins
+   * are not copied.
+   *
+   * @param other	Cache to copy
+   */
+  StaticLayerTileCache (const StaticLayerTileCache& other);
+
+  ~StaticLayerTileCache ();
+
+  /*!
+   * @brief Make sure all tiles touching a box are loaded.
+   *
+   * Missing tiles are read and passed to @a load. Afterwards, the least
+   * recently used tiles are passed to @a evict until the resident tiles
+   * fit into the memory budget again. Tiles that cannot be read are
+   * logged and skipped for the rest of the simulation.
+   *
+   * @param box		Box the objects of interest intersect with
+   * @param load	Called with the objects of each loaded tile
+   * @param evict	Called with the objects of each evicted tile
+   */
+  void
+  Request (const Box2d& box, const TileVisitor& load, const TileVisitor& evict);
+
+  /*!
+   * @brief Make sure all tiles touching any of several boxes are loaded.
+   *
+   * Same as Request() above, but all tiles touching @a boxes count as
+   * used by the same request, so none of them is evicted.
+   *
+   * @param boxes	Boxes the objects of interest intersect with
+   * @param load	Called with the objects of each loaded tile
+   * @param evict	Called with the objects of each evicted tile
+   */
+  void
+  Request (const std::vector<Box2d>& boxes, const TileVisitor& load,
+	   const TileVisitor& evict);
+
+  /*!
+   * @brief Load the tiles touching any of several boxes and keep them.
+   *
+   * Same as Request() above, but the tiles are not evicted, even over
+   * budget, until Unpin() was called for each time they were pinned.
+   *
+   * @param boxes	Boxes the objects of interest intersect with
+   * @param load	Called with the objects of each loaded tile
+   * @param evict	Called with the objects of each evicted tile
+   * @return Indexes of the pinned tiles, to be passed to Unpin()
+   */
+  std::vector<std::size_t>
+  Pin (const std::vector<Box2d>& boxes, const TileVisitor& load,
+       const TileVisitor& evict);
+
+  /*!
+   * @brief Release tiles pinned by Pin().
+   *
+   * The tiles are evicted by later requests if they exceed the budget.
+   *
+   * @param tiles	Indexes returned by Pin()
+   */
+  void
+  Unpin (const std::vector<std::size_t>& tiles);
+
+  /*!
+   * @brief Check if all tiles touching a box are loaded.
+   *
+   * Tiles that could not be read are ignored. Does not modify the cache,
+   * so it can be called from several threads as long as no request is
+   * running.
+   *
+   * @param box		Box to check
+   * @return True if no tile touching @a box has to be loaded
+   */
+  bool
+  IsResident (const Box2d& box) const;
+
+  /*!
+   * @brief Get the counters of the cache.
+   * @return Current statistics
+   */
+  Statistics
+  GetStatistics () const;
+
+private:
+  // Manifest and state of the tiles
+  struct Data;
+
+  //! Internal data structures moved to the implementation file.
+  std::unique_ptr<Data> m_data;
+};
+
+}  // namespace gemv2
+}  // namespace ns3
+
+#endif /* GEMV2_STATIC_LAYER_TILES_H */
@@ -75,6 +75,32 @@ enum AntennaPolarization
   ANTENNA_POLARIZATION_HORIZONTAL    //!< horizontal polarization
 };
 
+/*!
+ * @brief Strategies to keep the vehicle tree up to date.
+ * @note We cannot use a class enum here because it is not supported
+ *       by the EnumValue provided with ns3.
+ */
+enum VehicleTreeUpdateMode
+{
+  //! Clear and re-insert all vehicles on every update
+  VEHICLE_TREE_UPDATE_FULL_REBUILD = 0,
+  //! Only re-insert moved vehicles, apply adds and removes directly
+  VEHICLE_TREE_UPDATE_INCREMENTAL
+};
+
+/*!
+ * @brief Spatial index types for vehicles.
+ * @note We cannot use a class enum here because it is not supported
+ *       by the EnumValue provided with ns3.
+ */
+enum VehicleIndexType
+{
+  //! R-tree with quadratic split algorithm
+  VEHICLE_INDEX_RTREE = 0,
+  //! Uniform grid (spatial hash)
+  VEHICLE_INDEX_GRID
+};
+
 //! A tuple consisting of a min/med/max value.
 typedef std::tuple<double, double, double> MinMedMaxDoubleValue;
 
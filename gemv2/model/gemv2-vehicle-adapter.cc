@@ -17,8 +17,13 @@
  */
 #include "gemv2-vehicle-adapter.h"
 
+#include <ns3/assert.h>
+#include <ns3/callback.h>
+#include <ns3/log.h>
+
 namespace ns3 {
 
+NS_LOG_COMPONENT_DEFINE("Gemv2VehicleAdapter");
 NS_OBJECT_ENSURE_REGISTERED (Gemv2VehicleAdapter);
 
 TypeId
@@ -44,4 +49,42 @@ Gemv2VehicleAdapter::SetVehicle (Ptr<gemv2::Vehicle> vehicle)
   m_vehicle = vehicle;
 }
 
+void
+Gemv2VehicleAdapter::Track (Ptr<MobilityModel> mobility,
+			    Ptr<gemv2::Environment> environment)
+{
+  NS_LOG_FUNCTION (this << mobility << environment);
+  NS_ASSERT_MSG (m_vehicle, "a vehicle has to be assigned first");
+  NS_ASSERT_MSG (mobility && environment, "mobility and environment must not be null");
+  NS_ASSERT_MSG (!m_environment, "already tracking a mobility model");
+
+  m_environment = environment;
+  m_environment->TrackVehicle (m_vehicle, mobility);
+  mobility->TraceConnectWithoutContext (
+      "CourseChange", MakeCallback (&Gemv2VehicleAdapter::CourseChanged, this));
+}
+
+void
+Gemv2VehicleAdapter::DoDispose (void)
+{
+  if (m_environment)
+    {
+      // the environment holds the mobility model, which holds this adapter
+      m_environment->UntrackVehicle (m_vehicle);
+    }
+  m_vehicle = nullptr;
+  m_environment = nullptr;
+  Object::DoDispose ();
+}
+
+void
+Gemv2VehicleAdapter::CourseChanged (Ptr<const MobilityModel> mobility)
+{
+  if (m_environment && m_vehicle)
+    {
+      // only flag the vehicle, its pose is sampled when it is needed
+      m_environment->NotifyCourseChange (PeekPointer (m_vehicle));
+    }
+}
+
 }  // namespace ns3
@@ -20,13 +20,19 @@
 
 #include <ns3/object.h>
 #include <ns3/ptr.h>
+#include <ns3/mobility-model.h>
 
 #include "gemv2-vehicle.h"
+#include "gemv2-environment.h"
 
 namespace ns3 {
 
 /*!
  * @brief This is an object linking an ns-3 node to a GEMV^2 vehicle.
+ *
+ * The adapter has to be aggregated to the mobility model of the node.
+ * Optionally, it keeps the vehicle in sync with the mobility model
+ * (see Track()).
  */
 class Gemv2VehicleAdapter : public Object {
 public:
@@ -48,10 +54,39 @@ public:
   void
   SetVehicle (Ptr<gemv2::Vehicle> vehicle);
 
+  /*!
+   * @brief Follow the course changes of a mobility model.
+   *
+   * The vehicle is tracked by @a environment (see
+   * gemv2::Environment::TrackVehicle()), which moves it to the current
+   * position of @a mobility right away. Afterwards, each course change
+   * marks the vehicle as moving and the environment samples its pose
+   * before the next vehicle query until it stands still again. The
+   * heading is derived from the velocity and kept while the vehicle
+   * stands still.
+   *
+   * A vehicle has to be assigned before. Call this only once.
+   *
+   * @param mobility	Mobility model the adapter is aggregated to
+   * @param environment	Environment the vehicle is registered with
+   */
+  void
+  Track (Ptr<MobilityModel> mobility, Ptr<gemv2::Environment> environment);
+
+protected:
+  void DoDispose (void) override;
+
 private:
 
+  //! Trace sink for course changes of the tracked mobility model
+  void
+  CourseChanged (Ptr<const MobilityModel> mobility);
+
   //! Assigned GEMV^2 vehicle object
   Ptr<gemv2::Vehicle> m_vehicle;
+
+  //! Environment tracking the vehicle, null if not tracking
+  Ptr<gemv2::Environment> m_environment;
 };
 
 
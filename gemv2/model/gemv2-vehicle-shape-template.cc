@@ -0,0 +1,218 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "gemv2-vehicle-shape-template.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <tuple>
+
+#include <ns3/log.h>
+#include <boost/geometry/io/wkt/wkt.hpp>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE("Gemv2VehicleShapeTemplate");
+
+namespace gemv2 {
+
+namespace {
+
+//! Maximum distance of a point on the shape from the origin
+double
+CalculateRadius (const Polygon2d& shape)
+{
+  double radius = 0;
+  for (auto const& p : shape.outer ())
+    {
+      radius = std::max (radius, std::hypot (p.x (), p.y ()));
+    }
+  return radius;
+}
+
+//! Dimensions of a box shaped template
+using BoxKey = std::tuple<double, double, double>;
+
+//! Shared templates of box shaped vehicles
+std::map<BoxKey, Ptr<const VehicleShapeTemplate>>&
+GetBoxTemplates ()
+{
+  static std::map<BoxKey, Ptr<const VehicleShapeTemplate>> templates;
+  return templates;
+}
+
+//! Number of box templates left after the last release
+std::size_t&
+GetBoxTemplatesAfterRelease ()
+{
+  static std::size_t count = 0;
+  return count;
+}
+
+//! Templates registered by name
+std::map<std::string, Ptr<const VehicleShapeTemplate>>&
+GetNamedTemplates ()
+{
+  static std::map<std::string, Ptr<const VehicleShapeTemplate>> templates;
+  return templates;
+}
+
+}  // namespace
+
+VehicleShapeTemplate::VehicleShapeTemplate (double length, double width,
+					    double height)
+  : m_height (height),
+    m_isBox (true),
+    m_halfLength (length / 2),
+    m_halfWidth (width / 2)
+{
+  // generate basic shape based on width and length
+  std::vector<Point2d> pts =
+      {
+	  {-width/2, -length/2},
+	  {-width/2, length/2},
+	  {width/2, length/2},
+	  {width/2, -length/2},
+	  {-width/2, -length/2}
+      };
+
+  boost::geometry::append (m_shape, pts);
+  boost::geometry::correct (m_shape);
+  m_radius = CalculateRadius (m_shape);
+  NS_LOG_LOGIC ("Created vehicle shape: " << boost::geometry::wkt (m_shape));
+}
+
+VehicleShapeTemplate::VehicleShapeTemplate (const Polygon2d& shape, double height)
+  : m_shape (shape),
+    m_height (height),
+    m_isBox (false),
+    m_halfLength (0),
+    m_halfWidth (0)
+{
+  boost::geometry::correct (m_shape);
+  m_radius = CalculateRadius (m_shape);
+  NS_LOG_LOGIC ("Created vehicle shape: " << boost::geometry::wkt (m_shape));
+}
+
+Polygon2d const&
+VehicleShapeTemplate::GetShape () const
+{
+  return m_shape;
+}
+
+double
+VehicleShapeTemplate::GetRadius () const
+{
+  return m_radius;
+}
+
+double
+VehicleShapeTemplate::GetHeight () const
+{
+  return m_height;
+}
+
+bool
+VehicleShapeTemplate::IsBox () const
+{
+  return m_isBox;
+}
+
+double
+VehicleShapeTemplate::GetHalfLength () const
+{
+  return m_halfLength;
+}
+
+double
+VehicleShapeTemplate::GetHalfWidth () const
+{
+  return m_halfWidth;
+}
+
+Ptr<const VehicleShapeTemplate>
+VehicleShapeTemplate::GetBox (double length, double width, double height)
+{
+  auto& templates = GetBoxTemplates ();
+  auto key = BoxKey (length, width, height);
+  auto it = templates.find (key);
+  if (it != templates.end ())
+    {
+      return it->second;
+    }
+
+  // release the unused templates whenever their number has doubled, so
+  // vehicles with ever changing dimensions do not accumulate them
+  if (templates.size () >= std::max<std::size_t> (16, 2 * GetBoxTemplatesAfterRelease ()))
+    {
+      ReleaseUnusedBoxes ();
+    }
+
+  NS_LOG_LOGIC ("New box template " << length << "x" << width << "x" << height);
+  auto shape = Create<VehicleShapeTemplate> (length, width, height);
+  templates.emplace (key, shape);
+  return shape;
+}
+
+std::size_t
+VehicleShapeTemplate::ReleaseUnusedBoxes ()
+{
+  auto& templates = GetBoxTemplates ();
+  std::size_t released = 0;
+  for (auto it = templates.begin (); it != templates.end (); )
+    {
+      // only referenced by the map itself
+      if (it->second->GetReferenceCount () == 1)
+	{
+	  it = templates.erase (it);
+	  ++released;
+	}
+      else
+	{
+	  ++it;
+	}
+    }
+
+  GetBoxTemplatesAfterRelease () = templates.size ();
+  NS_LOG_LOGIC ("Released " << released << " box templates, "
+		<< templates.size () << " left");
+  return released;
+}
+
+void
+VehicleShapeTemplate::Register (const std::string& name,
+				Ptr<const VehicleShapeTemplate> shapeTemplate)
+{
+  NS_LOG_FUNCTION (name);
+  GetNamedTemplates ()[name] = shapeTemplate;
+}
+
+Ptr<const VehicleShapeTemplate>
+VehicleShapeTemplate::Find (const std::string& name)
+{
+  auto const& templates = GetNamedTemplates ();
+  auto it = templates.find (name);
+  if (it == templates.end ())
+    {
+      return Ptr<const VehicleShapeTemplate> ();
+    }
+  return it->second;
+}
+
+}  // namespace gemv2
+}  // namespace ns3
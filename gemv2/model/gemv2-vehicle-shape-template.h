@@ -0,0 +1,178 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GEMV2_VEHICLE_SHAPE_TEMPLATE_H
+#define GEMV2_VEHICLE_SHAPE_TEMPLATE_H
+
+#include <string>
+
+#include <ns3/ptr.h>
+#include <ns3/simple-ref-count.h>
+#include <ns3/gemv2-geometry.h>
+
+namespace ns3 {
+namespace gemv2 {
+
+/*!
+ * @brief Immutable shape and dimensions of a class of vehicles.
+ *
+ * Vehicles of the same class (e.g. car, van, truck, bus) share a single
+ * template instead of each storing their own base shape. Templates are
+ * either created explicitly and passed to the vehicles, taken from the
+ * registry by name, or shared automatically for box shaped vehicles
+ * with the same dimensions (see GetBox()).
+ *
+ * The registry is not synchronized, vehicles should only be created
+ * from the simulation thread.
+ */
+class VehicleShapeTemplate : public SimpleRefCount<VehicleShapeTemplate>
+{
+public:
+  /*!
+   * @brief Create a box shaped template.
+   *
+   * The box is centered around the origin with the length along the
+   * y axis (heading 0).
+   *
+   * @param length	Length of the vehicle [m]
+   * @param width	Width of the vehicle [m]
+   * @param height	Height of the vehicle [m]
+   */
+  VehicleShapeTemplate (double length, double width, double height);
+
+  /*!
+   * @brief Create a template with a custom shape.
+   * @param shape	Shape of the vehicle, center must be at (0, 0, 0)
+   * @param height	Height of the vehicle [m]
+   */
+  VehicleShapeTemplate (const Polygon2d& shape, double height);
+
+  /*!
+   * @brief Get the shape at the origin with heading 0.
+   * @return Shape of the vehicles
+   */
+  Polygon2d const&
+  GetShape () const;
+
+  /*!
+   * @brief Get the radius of the shape.
+   * @return Maximum distance of the shape from the origin [m]
+   */
+  double
+  GetRadius () const;
+
+  /*!
+   * @brief Get the height of the vehicles.
+   * @return Height of the vehicles [m]
+   */
+  double
+  GetHeight () const;
+
+  /*!
+   * @brief Check if the template was created from length and width.
+   * @return True for box shaped templates
+   */
+  bool
+  IsBox () const;
+
+  /*!
+   * @brief Get half of the length of a box shaped template.
+   * @return Half length [m], 0 for custom shapes
+   */
+  double
+  GetHalfLength () const;
+
+  /*!
+   * @brief Get half of the width of a box shaped template.
+   * @return Half width [m], 0 for custom shapes
+   */
+  double
+  GetHalfWidth () const;
+
+  /*!
+   * @brief Get the shared template for box shaped vehicles.
+   *
+   * Boxes with the same dimensions share a single template, which is
+   * created on the first request. The registry of the boxes holds a
+   * reference to each template, templates no longer used elsewhere are
+   * released from time to time (see ReleaseUnusedBoxes()). Like the rest
+   * of the registry, this is not thread-safe.
+   *
+   * @param length	Length of the vehicle [m]
+   * @param width	Width of the vehicle [m]
+   * @param height	Height of the vehicle [m]
+   * @return Template with the requested dimensions
+   */
+  static Ptr<const VehicleShapeTemplate>
+  GetBox (double length, double width, double height);
+
+  /*!
+   * @brief Release the box templates that are not used by any vehicle.
+   *
+   * This is done automatically by GetBox() whenever the number of box
+   * templates has doubled since the last release. It is not thread-safe.
+   *
+   * @return Number of released templates
+   */
+  static std::size_t
+  ReleaseUnusedBoxes ();
+
+  /*!
+   * @brief Register a template for a class of vehicles.
+   *
+   * A template registered earlier with the same name is replaced.
+   * Vehicles already using it keep their shape.
+   *
+   * @param name		Name of the vehicle class
+   * @param shapeTemplate	Template of the class
+   */
+  static void
+  Register (const std::string& name, Ptr<const VehicleShapeTemplate> shapeTemplate);
+
+  /*!
+   * @brief Find a registered template.
+   * @param name	Name of the vehicle class
+   * @return Template registered with @a name, null if there is none
+   */
+  static Ptr<const VehicleShapeTemplate>
+  Find (const std::string& name);
+
+private:
+
+  //! Shape of the vehicles at the origin
+  Polygon2d m_shape;
+
+  //! Maximum distance of the shape from the origin
+  double m_radius;
+
+  //! Height of the vehicles
+  double m_height;
+
+  //! True if created from length and width
+  bool m_isBox;
+
+  //! Half of the length of a box shaped template [m]
+  double m_halfLength;
+
+  //! Half of the width of a box shaped template [m]
+  double m_halfWidth;
+};
+
+}  // namespace gemv2
+}  // namespace ns3
+
+#endif /* GEMV2_VEHICLE_SHAPE_TEMPLATE_H */
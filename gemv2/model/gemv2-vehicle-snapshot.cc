@@ -0,0 +1,154 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "gemv2-vehicle-snapshot.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <ns3/gemv2-bounding-boxes.h>
+
+namespace ns3 {
+namespace gemv2 {
+
+VehicleSnapshot::VehicleSnapshot (std::vector<Entry> entries,
+				  std::uint64_t epoch, Time time)
+  : m_epoch (epoch),
+    m_time (time),
+    m_entries (std::move (entries))
+{
+  std::sort (m_entries.begin (), m_entries.end (),
+	     [](const Entry& a, const Entry& b) { return a.vehicle < b.vehicle; });
+
+  // the entries do not move anymore, index them by address
+  std::vector<const Entry*> pointers;
+  pointers.reserve (m_entries.size ());
+  for (auto const& e : m_entries)
+    {
+      pointers.push_back (&e);
+    }
+  m_index.Build (pointers.begin (), pointers.end ());
+}
+
+std::uint64_t
+VehicleSnapshot::GetEpoch () const
+{
+  return m_epoch;
+}
+
+Time
+VehicleSnapshot::GetTime () const
+{
+  return m_time;
+}
+
+std::size_t
+VehicleSnapshot::GetNumVehicles () const
+{
+  return m_entries.size ();
+}
+
+const VehicleSnapshot::Entry*
+VehicleSnapshot::Find (const Vehicle* vehicle) const
+{
+  auto it = std::lower_bound (
+      m_entries.begin (), m_entries.end (), vehicle,
+      [](const Entry& e, const Vehicle* v) { return e.vehicle < v; });
+  return it != m_entries.end () && it->vehicle == vehicle ? &*it : nullptr;
+}
+
+void
+VehicleSnapshot::IntersectVehicles (const LineSegment2d& line,
+				    const EntryVisitor& visitor) const
+{
+  m_index.Visit (
+      line,
+      [&line, &visitor](const Entry* e)
+      {
+	if (boost::geometry::intersects (e->shape, line))
+	  {
+	    visitor (*e);
+	  }
+      });
+}
+
+void
+VehicleSnapshot::FindVehiclesInEllipse (const Point2d& p1, const Point2d& p2,
+					double range,
+					const EntryVisitor& visitor) const
+{
+  auto bBox = MakeBoundingBoxEllipse (p1, p2, range);
+  m_index.Visit (
+      bBox,
+      [&](const Entry* e)
+      {
+	if (IsInEllipse (*e, p1, p2, range, bBox))
+	  {
+	    visitor (*e);
+	  }
+      });
+}
+
+std::size_t
+VehicleSnapshot::CountVehiclesInEllipse (const Point2d& p1, const Point2d& p2,
+					 double range,
+					 const Vehicle* excluded1,
+					 const Vehicle* excluded2) const
+{
+  auto bBox = MakeBoundingBoxEllipse (p1, p2, range);
+
+  // the boxes are exact, whole subtrees can be accepted
+  auto aggregate = m_index.Accumulate (
+      bBox, p1, p2, range,
+      [&p1, &p2, range](const Entry* e)
+      {
+	return boost::geometry::distance (p1, e->shape) +
+	    boost::geometry::distance (p2, e->shape) < range;
+      });
+
+  for (const Vehicle* v : {excluded1, excluded2 != excluded1 ? excluded2 : nullptr})
+    {
+      auto e = v ? Find (v) : nullptr;
+      if (e && IsInEllipse (*e, p1, p2, range, bBox))
+	{
+	  --aggregate.objects;
+	}
+    }
+
+  return aggregate.objects;
+}
+
+bool
+VehicleSnapshot::IsInEllipse (const Entry& e, const Point2d& p1,
+			      const Point2d& p2, double range,
+			      const Box2d& bBox)
+{
+  // same classification as AggregateTree::Accumulate ()
+  if (!boost::geometry::intersects (e.box, bBox) ||
+      !Intersects (e.box, MakeBoundingRectangleEllipse (p1, p2, range)) ||
+      IsBoxOutsideEllipse (e.box, p1, p2, range))
+    {
+      return false;
+    }
+
+  return IsBoxInsideEllipse (e.box, p1, p2, range) ||
+      boost::geometry::distance (p1, e.shape) +
+      boost::geometry::distance (p2, e.shape) < range;
+}
+
+}  // namespace gemv2
+}  // namespace ns3
@@ -0,0 +1,173 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GEMV2_VEHICLE_SNAPSHOT_H
+#define GEMV2_VEHICLE_SNAPSHOT_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <ns3/nstime.h>
+
+#include <ns3/gemv2-geometry.h>
+#include <ns3/gemv2-aggregate-tree.h>
+
+namespace ns3 {
+namespace gemv2 {
+
+class Vehicle;
+
+/*!
+ * @brief Immutable copy of all vehicles at one point in time.
+ *
+ * The snapshot contains the shapes of the vehicles and its own index.
+ * All methods are const and do not touch the Vehicle objects. Thus, a
+ * snapshot can be queried from several threads at the same time while
+ * the simulation thread keeps moving the vehicles.
+ *
+ * The vehicle pointers are only meant to identify vehicles (e.g. to
+ * compare them with the sender and receiver of a link). Do not access
+ * the vehicles through them from other threads.
+ */
+class VehicleSnapshot
+{
+public:
+  //! State of a single vehicle
+  struct Entry
+  {
+    //! Identity of the vehicle
+    const Vehicle* vehicle;
+    //! Shape at the time of the snapshot
+    Polygon2d shape;
+    //! Bounding box of @a shape
+    Box2d box;
+    //! Height of the vehicle [m]
+    double height;
+  };
+
+  //! Visitor for vehicles in the snapshot
+  using EntryVisitor = std::function<void (const Entry&)>;
+
+  /*!
+   * @brief Create snapshot from vehicle states.
+   * @param entries	States of all vehicles
+   * @param epoch	Sequence number of the snapshot
+   * @param time	Simulation time of the snapshot
+   */
+  VehicleSnapshot (std::vector<Entry> entries, std::uint64_t epoch, Time time);
+
+  // the index refers to the entries by address
+  VehicleSnapshot (const VehicleSnapshot&) = delete;
+  VehicleSnapshot& operator= (const VehicleSnapshot&) = delete;
+
+  /*!
+   * @brief Get the sequence number of the snapshot.
+   * @return Number of snapshots published before this one
+   */
+  std::uint64_t
+  GetEpoch () const;
+
+  /*!
+   * @brief Get the simulation time the snapshot was taken.
+   * @return Simulation time of the snapshot
+   */
+  Time
+  GetTime () const;
+
+  /*!
+   * @brief Get the number of vehicles.
+   * @return Number of vehicles in the snapshot
+   */
+  std::size_t
+  GetNumVehicles () const;
+
+  /*!
+   * @brief Find the state of a vehicle.
+   * @param vehicle	Vehicle to look up
+   * @return State of @a vehicle or null if it is not part of the snapshot
+   */
+  const Entry*
+  Find (const Vehicle* vehicle) const;
+
+  /*!
+   * @brief Visit all vehicles intersecting with a line.
+   * @param line	Line to test
+   * @param visitor	Called for each intersecting vehicle
+   */
+  void
+  IntersectVehicles (const LineSegment2d& line, const EntryVisitor& visitor) const;
+
+  /*!
+   * @brief Visit all vehicles within an ellipse.
+   *
+   * This uses the same criterion as Environment::FindVehiclesInEllipse().
+   *
+   * @param p1		First focal point
+   * @param p2		Second focal point
+   * @param range	Maximum combined distance to @a p1 and @a p2
+   * @param visitor	Called for each vehicle in the ellipse
+   */
+  void
+  FindVehiclesInEllipse (const Point2d& p1, const Point2d& p2, double range,
+			 const EntryVisitor& visitor) const;
+
+  /*!
+   * @brief Count the vehicles within an ellipse.
+   * @param p1		First focal point
+   * @param p2		Second focal point
+   * @param range	Maximum combined distance to @a p1 and @a p2
+   * @param excluded1	Vehicle not to count (e.g. the sender), may be null
+   * @param excluded2	Vehicle not to count (e.g. the receiver), may be null
+   * @return Number of vehicles in the ellipse
+   */
+  std::size_t
+  CountVehiclesInEllipse (const Point2d& p1, const Point2d& p2, double range,
+			  const Vehicle* excluded1 = nullptr,
+			  const Vehicle* excluded2 = nullptr) const;
+
+private:
+
+  //! Access to the box of an entry
+  struct EntryIndexable
+  {
+    using result_type = Box2d const&;
+    result_type operator()(const Entry* e) const { return e->box; }
+  };
+
+  //! Test if an entry is within an ellipse
+  static bool
+  IsInEllipse (const Entry& e, const Point2d& p1, const Point2d& p2,
+	       double range, const Box2d& bBox);
+
+  //! Sequence number
+  std::uint64_t m_epoch;
+
+  //! Simulation time
+  Time m_time;
+
+  //! States of all vehicles, ordered by vehicle
+  std::vector<Entry> m_entries;
+
+  //! Index over the entries
+  AggregateTree<const Entry*, EntryIndexable> m_index;
+};
+
+}  // namespace gemv2
+}  // namespace ns3
+
+#endif /* GEMV2_VEHICLE_SNAPSHOT_H */
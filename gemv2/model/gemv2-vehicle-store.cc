@@ -0,0 +1,400 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "gemv2-vehicle-store.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <ns3/assert.h>
+
+namespace ns3 {
+namespace gemv2 {
+
+const std::size_t VehicleStore::NOT_FOUND;
+
+VehicleStore::~VehicleStore ()
+{
+  Clear ();
+}
+
+bool
+VehicleStore::Add (Ptr<Vehicle> vehicle, const Box2d& indexedBox)
+{
+  NS_ASSERT_MSG (vehicle, "vehicle must not be null");
+
+  std::size_t slot = m_vehicles.size ();
+  if (!m_slots.insert (std::make_pair (PeekPointer (vehicle), slot)).second)
+    {
+      return false;
+    }
+
+  auto shapeTemplate = vehicle->GetShapeTemplate ();
+  auto position = vehicle->GetPosition ();
+  bool owned = vehicle->m_store == nullptr;
+  m_x.push_back (position.x);
+  m_y.push_back (position.y);
+  m_z.push_back (position.z);
+  m_heading.push_back (vehicle->GetHeading ());
+  m_poseVersion.push_back (vehicle->GetPoseVersion ());
+  m_radius.push_back (shapeTemplate->GetRadius ());
+  m_halfLength.push_back (shapeTemplate->IsBox () ? shapeTemplate->GetHalfLength () : -1);
+  m_halfWidth.push_back (shapeTemplate->GetHalfWidth ());
+  m_indexedBoxes.push_back (indexedBox);
+  m_owned.push_back (owned);
+  m_dirty.push_back (0);
+  m_vehicles.push_back (vehicle);
+
+  if (owned)
+    {
+      vehicle->Attach (this, slot);
+    }
+  else
+    {
+      m_foreignSlots.push_back (slot);
+    }
+  return true;
+}
+
+void
+VehicleStore::Remove (std::size_t slot)
+{
+  NS_ASSERT (slot < m_vehicles.size ());
+
+  auto& vehicle = *m_vehicles[slot];
+  m_slots.erase (&vehicle);
+  if (m_owned[slot])
+    {
+      vehicle.Detach (GetPosition (slot), m_heading[slot]);
+    }
+  else
+    {
+      RemoveForeignSlot (slot);
+    }
+
+  std::size_t last = m_vehicles.size () - 1;
+  if (slot != last)
+    {
+      m_vehicles[slot] = m_vehicles[last];
+      m_x[slot] = m_x[last];
+      m_y[slot] = m_y[last];
+      m_z[slot] = m_z[last];
+      m_heading[slot] = m_heading[last];
+      m_poseVersion[slot] = m_poseVersion[last];
+      m_radius[slot] = m_radius[last];
+      m_halfLength[slot] = m_halfLength[last];
+      m_halfWidth[slot] = m_halfWidth[last];
+      m_indexedBoxes[slot] = m_indexedBoxes[last];
+      m_owned[slot] = m_owned[last];
+      m_dirty[slot] = m_dirty[last];
+      m_slots[PeekPointer (m_vehicles[slot])] = slot;
+      if (m_owned[slot])
+	{
+	  m_vehicles[slot]->m_slot = slot;
+	}
+      else
+	{
+	  *std::find (m_foreignSlots.begin (), m_foreignSlots.end (), last) = slot;
+	}
+      if (m_dirty[slot])
+	{
+	  m_dirtySlots.push_back (slot);
+	}
+    }
+
+  m_vehicles.pop_back ();
+  m_x.pop_back ();
+  m_y.pop_back ();
+  m_z.pop_back ();
+  m_heading.pop_back ();
+  m_poseVersion.pop_back ();
+  m_radius.pop_back ();
+  m_halfLength.pop_back ();
+  m_halfWidth.pop_back ();
+  m_indexedBoxes.pop_back ();
+  m_owned.pop_back ();
+  m_dirty.pop_back ();
+}
+
+void
+VehicleStore::Clear ()
+{
+  for (std::size_t i = 0; i < m_vehicles.size (); ++i)
+    {
+      if (m_owned[i])
+	{
+	  m_vehicles[i]->Detach (GetPosition (i), m_heading[i]);
+	}
+    }
+
+  m_vehicles.clear ();
+  m_x.clear ();
+  m_y.clear ();
+  m_z.clear ();
+  m_heading.clear ();
+  m_poseVersion.clear ();
+  m_radius.clear ();
+  m_halfLength.clear ();
+  m_halfWidth.clear ();
+  m_indexedBoxes.clear ();
+  m_owned.clear ();
+  m_dirty.clear ();
+  m_dirtySlots.clear ();
+  m_foreignSlots.clear ();
+  m_slots.clear ();
+}
+
+std::size_t
+VehicleStore::Find (const Vehicle* vehicle) const
+{
+  auto it = m_slots.find (vehicle);
+  return it != m_slots.end () ? it->second : NOT_FOUND;
+}
+
+std::size_t
+VehicleStore::GetSize () const
+{
+  return m_vehicles.size ();
+}
+
+bool
+VehicleStore::IsEmpty () const
+{
+  return m_vehicles.empty ();
+}
+
+Ptr<Vehicle> const&
+VehicleStore::GetVehicle (std::size_t slot) const
+{
+  return m_vehicles[slot];
+}
+
+Box2d&
+VehicleStore::GetIndexedBox (std::size_t slot)
+{
+  return m_indexedBoxes[slot];
+}
+
+void
+VehicleStore::SetPose (std::size_t slot, const Vector& position, double heading)
+{
+  NS_ASSERT (slot < m_vehicles.size ());
+
+  if (m_owned[slot])
+    {
+      if (m_x[slot] == position.x && m_y[slot] == position.y &&
+	  m_z[slot] == position.z && m_heading[slot] == heading)
+	{
+	  return;
+	}
+      m_x[slot] = position.x;
+      m_y[slot] = position.y;
+      m_z[slot] = position.z;
+      m_heading[slot] = heading;
+      ++m_poseVersion[slot];
+    }
+  else
+    {
+      auto& vehicle = *m_vehicles[slot];
+      auto current = vehicle.GetPosition ();
+      if (current.x == position.x && current.y == position.y &&
+	  current.z == position.z && vehicle.GetHeading () == heading)
+	{
+	  return;
+	}
+
+      // foreign slots are synchronized before computing boxes
+      vehicle.SetPosition (position);
+      vehicle.SetHeading (heading);
+    }
+  MarkDirty (slot);
+}
+
+Vector
+VehicleStore::GetPosition (std::size_t slot) const
+{
+  return Vector (m_x[slot], m_y[slot], m_z[slot]);
+}
+
+double
+VehicleStore::GetHeading (std::size_t slot) const
+{
+  return m_heading[slot];
+}
+
+std::vector<std::size_t>
+VehicleStore::TakeDirtySlots ()
+{
+  // vehicles owned by other stores may have moved at any time
+  SyncForeignPoses ();
+
+  std::vector<std::size_t> slots;
+  for (auto slot : m_dirtySlots)
+    {
+      if (slot < m_dirty.size () && m_dirty[slot])
+	{
+	  m_dirty[slot] = 0;
+	  slots.push_back (slot);
+	}
+    }
+  m_dirtySlots.clear ();
+  return slots;
+}
+
+void
+VehicleStore::ClearDirty ()
+{
+  for (auto slot : m_dirtySlots)
+    {
+      if (slot < m_dirty.size ())
+	{
+	  m_dirty[slot] = 0;
+	}
+    }
+  m_dirtySlots.clear ();
+}
+
+void
+VehicleStore::ComputeBoundingBoxes (std::vector<Box2d>& boxes)
+{
+  SyncForeignPoses ();
+
+  std::size_t n = m_vehicles.size ();
+  boxes.resize (n);
+  for (std::size_t i = 0; i < n; ++i)
+    {
+      boxes[i] = m_halfLength[i] < 0 ?
+	  m_vehicles[i]->GetBoundingBox () : ComputeBoundingBoxFromPose (i);
+    }
+}
+
+Box2d
+VehicleStore::ComputeBoundingBox (std::size_t slot)
+{
+  if (m_halfLength[slot] < 0)
+    {
+      return m_vehicles[slot]->GetBoundingBox ();
+    }
+  if (!m_owned[slot])
+    {
+      SyncForeignPose (slot);
+    }
+  return ComputeBoundingBoxFromPose (slot);
+}
+
+void
+VehicleStore::ComputeCircleBoxes (double padding, std::vector<Box2d>& boxes)
+{
+  SyncForeignPoses ();
+
+  std::size_t n = m_vehicles.size ();
+  boxes.resize (n);
+
+  const double* x = m_x.data ();
+  const double* y = m_y.data ();
+  const double* radius = m_radius.data ();
+  for (std::size_t i = 0; i < n; ++i)
+    {
+      double r = radius[i] + padding;
+      boxes[i] = Box2d (Point2d (x[i] - r, y[i] - r), Point2d (x[i] + r, y[i] + r));
+    }
+}
+
+Box2d
+VehicleStore::ComputeCircleBox (std::size_t slot, double padding)
+{
+  if (!m_owned[slot])
+    {
+      SyncForeignPose (slot);
+    }
+  double x = m_x[slot];
+  double y = m_y[slot];
+  double r = m_radius[slot] + padding;
+  return Box2d (Point2d (x - r, y - r), Point2d (x + r, y + r));
+}
+
+std::uint32_t
+VehicleStore::GetPoseVersion (std::size_t slot) const
+{
+  return m_poseVersion[slot];
+}
+
+void
+VehicleStore::SyncForeignPoses ()
+{
+  for (auto slot : m_foreignSlots)
+    {
+      SyncForeignPose (slot);
+    }
+}
+
+void
+VehicleStore::SyncForeignPose (std::size_t slot)
+{
+  auto& vehicle = *m_vehicles[slot];
+  auto version = vehicle.GetPoseVersion ();
+  if (version == m_poseVersion[slot])
+    {
+      return;
+    }
+
+  auto position = vehicle.GetPosition ();
+  m_x[slot] = position.x;
+  m_y[slot] = position.y;
+  m_z[slot] = position.z;
+  m_heading[slot] = vehicle.GetHeading ();
+  m_poseVersion[slot] = version;
+  MarkDirty (slot);
+}
+
+void
+VehicleStore::RemoveForeignSlot (std::size_t slot)
+{
+  auto it = std::find (m_foreignSlots.begin (), m_foreignSlots.end (), slot);
+  *it = m_foreignSlots.back ();
+  m_foreignSlots.pop_back ();
+}
+
+void
+VehicleStore::MarkDirty (std::size_t slot)
+{
+  if (!m_dirty[slot])
+    {
+      m_dirty[slot] = 1;
+      m_dirtySlots.push_back (slot);
+    }
+}
+
+Box2d
+VehicleStore::ComputeBoundingBoxFromPose (std::size_t slot) const
+{
+  // same arithmetic as Vehicle::UpdateBoxShape (), so the boxes
+  // match the shapes exactly
+  double angle = m_heading[slot] * M_PI / 180;
+  double s = std::sin (angle);
+  double c = std::cos (angle);
+  double halfWidth = m_halfWidth[slot];
+  double halfLength = m_halfLength[slot];
+  double ex = std::abs (c * halfWidth) + std::abs (s * halfLength);
+  double ey = std::abs (s * halfWidth) + std::abs (c * halfLength);
+  double x = m_x[slot];
+  double y = m_y[slot];
+  return Box2d (Point2d (x - ex, y - ey), Point2d (x + ex, y + ey));
+}
+
+}  // namespace gemv2
+}  // namespace ns3
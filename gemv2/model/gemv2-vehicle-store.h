@@ -0,0 +1,309 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GEMV2_VEHICLE_STORE_H
+#define GEMV2_VEHICLE_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include <ns3/ptr.h>
+#include <ns3/vector.h>
+
+#include <ns3/gemv2-geometry.h>
+#include <ns3/gemv2-vehicle.h>
+
+namespace ns3 {
+namespace gemv2 {
+
+/*!
+ * @brief Registered vehicles of an environment as structure of arrays.
+ *
+ * Each vehicle occupies one slot. The slot indexes the vehicle, its
+ * pose, its dimensions and the box it is indexed with in the arrays of
+ * the store. Removing a vehicle moves the last vehicle into its slot, so
+ * the arrays stay dense and the boxes of all vehicles can be computed in
+ * a single pass over contiguous memory.
+ *
+ * The pose of a vehicle lives in the first store it is added to, which
+ * owns it until the vehicle is removed again. Vehicle::GetPosition() and
+ * Vehicle::SetPosition() read and write the arrays of that store, and
+ * SetPose() updates them without touching the vehicle. Poses written
+ * since the last TakeDirtySlots() or ClearDirty() mark their slots dirty.
+ *
+ * A vehicle registered with several stores (e.g. environments sharing
+ * their vehicles) is read through the vehicle by the other stores. They
+ * remember the pose version (see Vehicle::GetPoseVersion()) they copied
+ * the pose at and refresh the copy, marking the slot dirty, only if the
+ * version changed since.
+ *
+ * A store is not copyable, since vehicles refer to the store owning them.
+ */
+class VehicleStore
+{
+public:
+  //! Returned by Find() for vehicles that are not registered
+  static const std::size_t NOT_FOUND = std::numeric_limits<std::size_t>::max ();
+
+  VehicleStore () = default;
+
+  //! Hands the poses back to the vehicles
+  ~VehicleStore ();
+
+  VehicleStore (const VehicleStore&) = delete;
+  VehicleStore& operator= (const VehicleStore&) = delete;
+
+  /*!
+   * @brief Register a vehicle.
+   *
+   * The store takes over the pose of @a vehicle if no other store owns it.
+   *
+   * @param vehicle	Vehicle to add, must not be null
+   * @param indexedBox	Box the vehicle is indexed with
+   * @return False if the vehicle was registered already
+   */
+  bool
+  Add (Ptr<Vehicle> vehicle, const Box2d& indexedBox);
+
+  /*!
+   * @brief Unregister the vehicle in a slot.
+   *
+   * The vehicle keeps its last pose. The last vehicle is moved into
+   * @a slot.
+   *
+   * @param slot	Slot of the vehicle to remove
+   */
+  void
+  Remove (std::size_t slot);
+
+  //! Unregister all vehicles
+  void
+  Clear ();
+
+  /*!
+   * @brief Find the slot of a vehicle.
+   * @param vehicle	Vehicle to look up
+   * @return Slot of @a vehicle or NOT_FOUND if it is not registered
+   */
+  std::size_t
+  Find (const Vehicle* vehicle) const;
+
+  /*!
+   * @brief Get the number of registered vehicles.
+   * @return Number of occupied slots
+   */
+  std::size_t
+  GetSize () const;
+
+  /*!
+   * @brief Check if no vehicle is registered.
+   * @return True if the store is empty
+   */
+  bool
+  IsEmpty () const;
+
+  /*!
+   * @brief Get the vehicle in a slot.
+   * @param slot	Slot of the vehicle
+   * @return Registered vehicle
+   */
+  Ptr<Vehicle> const&
+  GetVehicle (std::size_t slot) const;
+
+  /*!
+   * @brief Get the box a vehicle is indexed with.
+   *
+   * The box is required to remove the vehicle from the index again.
+   *
+   * @param slot	Slot of the vehicle
+   * @return Indexed box, may be modified
+   */
+  Box2d&
+  GetIndexedBox (std::size_t slot);
+
+  /*!
+   * @brief Move a vehicle.
+   *
+   * Owned poses are written into the arrays, other vehicles are moved
+   * through the store owning them. The slot becomes dirty unless the
+   * pose is unchanged.
+   *
+   * @param slot	Slot of the vehicle
+   * @param position	New position
+   * @param heading	New heading [degree]
+   */
+  void
+  SetPose (std::size_t slot, const Vector& position, double heading);
+
+  /*!
+   * @brief Get the position of a vehicle.
+   * @param slot	Slot of the vehicle
+   * @return Current position of the vehicle
+   */
+  Vector
+  GetPosition (std::size_t slot) const;
+
+  /*!
+   * @brief Get the heading of a vehicle.
+   * @param slot	Slot of the vehicle
+   * @return Current heading of the vehicle [degree]
+   */
+  double
+  GetHeading (std::size_t slot) const;
+
+  /*!
+   * @brief Get the slots moved since the last call and reset them.
+   * @return Dirty slots in no particular order, each slot once
+   */
+  std::vector<std::size_t>
+  TakeDirtySlots ();
+
+  //! Reset all dirty slots, e.g. after all boxes have been recomputed
+  void
+  ClearDirty ();
+
+  /*!
+   * @brief Compute the bounding boxes of all vehicles.
+   *
+   * Box shaped vehicles are computed from their pose and dimensions
+   * without updating their shape. Other vehicles fall back to
+   * Vehicle::GetBoundingBox().
+   *
+   * @param boxes	Box of each slot, resized to the number of vehicles
+   */
+  void
+  ComputeBoundingBoxes (std::vector<Box2d>& boxes);
+
+  /*!
+   * @brief Compute the bounding box of a single vehicle.
+   * @param slot	Slot of the vehicle
+   * @return Same box as ComputeBoundingBoxes() for @a slot
+   */
+  Box2d
+  ComputeBoundingBox (std::size_t slot);
+
+  /*!
+   * @brief Compute boxes around the circles covering the vehicles in any heading.
+   * @param padding	Distance added to the radius of each vehicle [m]
+   * @param boxes	Box of each slot, resized to the number of vehicles
+   */
+  void
+  ComputeCircleBoxes (double padding, std::vector<Box2d>& boxes);
+
+  /*!
+   * @brief Compute the circle box of a single vehicle.
+   * @param slot	Slot of the vehicle
+   * @param padding	Distance added to the radius of the vehicle [m]
+   * @return Same box as ComputeCircleBoxes() for @a slot
+   */
+  Box2d
+  ComputeCircleBox (std::size_t slot, double padding);
+
+private:
+  friend class Vehicle;
+
+  /*!
+   * @brief Get the number of pose changes of an owned vehicle.
+   *
+   * Used by the vehicle to detect that its shape is outdated. Foreign
+   * slots hold the version the pose was copied at.
+   *
+   * @param slot	Slot of the vehicle
+   * @return Counter increased by every pose change
+   */
+  std::uint32_t
+  GetPoseVersion (std::size_t slot) const;
+
+  //! Refresh the pose of vehicles owned by other stores
+  void
+  SyncForeignPoses ();
+
+  /*!
+   * @brief Refresh the pose of a vehicle owned by another store.
+   *
+   * The slot becomes dirty if the vehicle moved since the last refresh.
+   *
+   * @param slot	Foreign slot of the vehicle
+   */
+  void
+  SyncForeignPose (std::size_t slot);
+
+  //! Forget a foreign slot
+  void
+  RemoveForeignSlot (std::size_t slot);
+
+  //! Mark a slot as dirty
+  void
+  MarkDirty (std::size_t slot);
+
+  //! Box of a vehicle from the pose arrays
+  Box2d
+  ComputeBoundingBoxFromPose (std::size_t slot) const;
+
+  //! Registered vehicles
+  std::vector<Ptr<Vehicle>> m_vehicles;
+
+  //! X coordinate of each vehicle [m]
+  std::vector<double> m_x;
+
+  //! Y coordinate of each vehicle [m]
+  std::vector<double> m_y;
+
+  //! Z coordinate of each vehicle [m]
+  std::vector<double> m_z;
+
+  //! Heading of each vehicle [degree]
+  std::vector<double> m_heading;
+
+  //! Pose changes of each owned vehicle, last copied version otherwise
+  std::vector<std::uint32_t> m_poseVersion;
+
+  //! Radius of each vehicle [m]
+  std::vector<double> m_radius;
+
+  //! Half length of box shaped vehicles, negative for other shapes [m]
+  std::vector<double> m_halfLength;
+
+  //! Half width of box shaped vehicles [m]
+  std::vector<double> m_halfWidth;
+
+  //! Box each vehicle is indexed with
+  std::vector<Box2d> m_indexedBoxes;
+
+  //! True (1) if this store owns the pose of the vehicle
+  std::vector<std::uint8_t> m_owned;
+
+  //! True (1) if the vehicle moved since the dirty slots were reset
+  std::vector<std::uint8_t> m_dirty;
+
+  //! Slots marked dirty, may contain removed or repeated slots
+  std::vector<std::size_t> m_dirtySlots;
+
+  //! Slots of the vehicles owned by other stores
+  std::vector<std::size_t> m_foreignSlots;
+
+  //! Slot of each registered vehicle
+  std::unordered_map<const Vehicle*, std::size_t> m_slots;
+};
+
+}  // namespace gemv2
+}  // namespace ns3
+
+#endif /* GEMV2_VEHICLE_STORE_H */
@@ -16,7 +16,12 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 #include "gemv2-vehicle.h"
+#include "gemv2-vehicle-store.h"
 
+#include <cmath>
+#include <algorithm>
+
+#include <ns3/assert.h>
 #include <ns3/log.h>
 #include <boost/geometry/io/wkt/wkt.hpp>
 
@@ -34,41 +39,27 @@ NS_LOG_COMPONENT_DEFINE("Gemv2Vehicle");
 namespace gemv2 {
 
 Vehicle::Vehicle (double length, double width, double height)
-  : m_height (height),
-    m_position (0, 0, 0),
-    m_heading (0),
-    m_shapeUpdated (true),
-    m_relativePermittivity (DEFAULT_RELATIVE_PERMITTIVITY_VEHICLES)
+  : Vehicle (VehicleShapeTemplate::GetBox (length, width, height))
 {
-  // generate basic shape based on width and length
-  // for now, this is just a box
-  std::vector<Point2d> pts =
-      {
-	  {-width/2, -length/2},
-	  {-width/2, length/2},
-	  {width/2, length/2},
-	  {width/2, -length/2},
-	  {-width/2, -length/2}
-      };
-
-  boost::geometry::append(m_initialShape, pts);
-  boost::geometry::correct (m_initialShape);
-  NS_LOG_LOGIC ("Created vehicle shape: " << boost::geometry::wkt (m_initialShape));
-
-  // note current shape and bounding box will be updated on first access
 }
 
-
 Vehicle::Vehicle (const Polygon2d& shape, double height)
-: m_height (height),
-  m_position (0, 0, 0),
-  m_heading (0),
-  m_initialShape (shape),
-  m_shapeUpdated (true),
-  m_relativePermittivity (DEFAULT_RELATIVE_PERMITTIVITY_VEHICLES)
+  : Vehicle (Create<VehicleShapeTemplate> (shape, height))
 {
-  boost::geometry::correct (m_initialShape);
-  NS_LOG_LOGIC ("Created vehicle shape: " << boost::geometry::wkt (m_initialShape));
+}
+
+Vehicle::Vehicle (Ptr<const VehicleShapeTemplate> shapeTemplate)
+  : m_template (shapeTemplate),
+    m_store (nullptr),
+    m_slot (0),
+    m_shapeVersion (0),
+    m_poseVersion (0),
+    m_position (0, 0, 0),
+    m_heading (0),
+    m_shapeUpdated (true),
+    m_relativePermittivity (DEFAULT_RELATIVE_PERMITTIVITY_VEHICLES)
+{
+  NS_ASSERT_MSG (m_template, "shape template must not be null");
 
   // note current shape and bounding box will be updated on first access
 }
@@ -77,7 +68,18 @@ void
 Vehicle::SetPosition (const Vector& position)
 {
   NS_LOG_FUNCTION (this << position);
+  if (m_store)
+    {
+      m_store->SetPose (m_slot, position, m_store->GetHeading (m_slot));
+      return;
+    }
+  if (m_position.x == position.x && m_position.y == position.y &&
+      m_position.z == position.z)
+    {
+      return;
+    }
   m_position = position;
+  ++m_poseVersion;
   m_shapeUpdated = true;
 }
 
@@ -85,14 +87,54 @@ void
 Vehicle::SetHeading (double heading)
 {
   NS_LOG_FUNCTION (this << heading);
+  if (m_store)
+    {
+      m_store->SetPose (m_slot, m_store->GetPosition (m_slot), heading);
+      return;
+    }
+  if (m_heading == heading)
+    {
+      return;
+    }
   m_heading = heading;
+  ++m_poseVersion;
   m_shapeUpdated = true;
 }
 
+Vector
+Vehicle::GetPosition () const
+{
+  return m_store ? m_store->GetPosition (m_slot) : m_position;
+}
+
+double
+Vehicle::GetHeading () const
+{
+  return m_store ? m_store->GetHeading (m_slot) : m_heading;
+}
+
+std::uint32_t
+Vehicle::GetPoseVersion () const
+{
+  return m_store ? m_store->GetPoseVersion (m_slot) : m_poseVersion;
+}
+
+double
+Vehicle::GetRadius () const
+{
+  return m_template->GetRadius ();
+}
+
 double
 Vehicle::GetHeight () const
 {
-  return m_height;
+  return m_template->GetHeight ();
+}
+
+Ptr<const VehicleShapeTemplate>
+Vehicle::GetShapeTemplate () const
+{
+  return m_template;
 }
 
 Polygon2d const&
@@ -123,20 +165,53 @@ Vehicle::SetRelativePermittivity (double perm)
   m_relativePermittivity = perm;
 }
 
+void
+Vehicle::Attach (VehicleStore* store, std::size_t slot)
+{
+  m_store = store;
+  m_slot = slot;
+  // the versions of the store are unrelated to the current shape
+  m_shapeUpdated = true;
+}
+
+void
+Vehicle::Detach (const Vector& position, double heading)
+{
+  // continue counting where the store stopped, the store may have moved
+  // the vehicle since the shape was last updated
+  m_poseVersion = m_store->GetPoseVersion (m_slot);
+  m_store = nullptr;
+  m_position = position;
+  m_heading = heading;
+  m_shapeUpdated = true;
+}
+
 void
 Vehicle::CheckUpdateShape ()
 {
   NS_LOG_FUNCTION (this);
-  if (m_shapeUpdated)
+  if (m_store && m_store->GetPoseVersion (m_slot) != m_shapeVersion)
+    {
+      m_shapeUpdated = true;
+      m_shapeVersion = m_store->GetPoseVersion (m_slot);
+    }
+
+  if (m_shapeUpdated && m_template->IsBox ())
+    {
+      UpdateBoxShape ();
+      m_shapeUpdated = false;
+    }
+  else if (m_shapeUpdated)
     {
       NS_LOG_LOGIC ("Updating vehicle shape");
       // first step: rotate by heading
-      RotateDegree2d rotate (m_heading);
+      RotateDegree2d rotate (GetHeading ());
       Polygon2d rotatedShape;
-      boost::geometry::transform (m_initialShape, rotatedShape, rotate);
+      boost::geometry::transform (m_template->GetShape (), rotatedShape, rotate);
 
       // second step: translate to position
-      Translate2d translate (m_position.x, m_position.y);
+      auto position = GetPosition ();
+      Translate2d translate (position.x, position.y);
       boost::geometry::transform (rotatedShape, m_currentShape, translate);
 
       NS_LOG_LOGIC ("New shape: " << boost::geometry::wkt (m_currentShape));
@@ -150,6 +225,42 @@ Vehicle::CheckUpdateShape ()
     }
 }
 
+void
+Vehicle::UpdateBoxShape ()
+{
+  NS_LOG_LOGIC ("Updating box shape of vehicle");
+
+  // same clockwise rotation as RotateDegree2d
+  double angle = GetHeading () * M_PI / 180;
+  double s = std::sin (angle);
+  double c = std::cos (angle);
+
+  // rotated half axes, the corners are combinations of them
+  double halfWidth = m_template->GetHalfWidth ();
+  double halfLength = m_template->GetHalfLength ();
+  double wx = c * halfWidth;
+  double wy = s * halfWidth;
+  double lx = s * halfLength;
+  double ly = c * halfLength;
+
+  // same corner order as the initial shape, only allocates on first use
+  auto& ring = m_currentShape.outer ();
+  ring.resize (5);
+  auto position = GetPosition ();
+  double x = position.x;
+  double y = position.y;
+  ring[0] = Point2d (x + (-wx - lx), y + (wy - ly));
+  ring[1] = Point2d (x + (-wx + lx), y + (wy + ly));
+  ring[2] = Point2d (x + (wx + lx), y + (-wy + ly));
+  ring[3] = Point2d (x + (wx - lx), y + (-wy - ly));
+  ring[4] = ring[0];
+
+  // the extreme corners add up the absolute values of the half axes
+  double ex = std::abs (wx) + std::abs (lx);
+  double ey = std::abs (wy) + std::abs (ly);
+  m_boundingBox = Box2d (Point2d (x - ex, y - ey), Point2d (x + ex, y + ey));
+}
+
 
 }  // namespace gemv2
 }  // namespace ns3
@@ -18,20 +18,31 @@
 #ifndef GEMV2_VEHICLE_H
 #define GEMV2_VEHICLE_H
 
+#include <cstddef>
+#include <cstdint>
+
 #include <ns3/ptr.h>
 #include <ns3/simple-ref-count.h>
 #include <ns3/vector.h>
 #include <ns3/gemv2-geometry.h>
+#include <ns3/gemv2-vehicle-shape-template.h>
 
 namespace ns3 {
 namespace gemv2 {
 
+class VehicleStore;
+
 /*!
  * @brief A single vehicle within the GEMV^2 environment.
  *
  * Vehicles appear independent from nodes. Since there may be many
  * more vehicles in a scenario than actually communicating (equipped)
  * ones.
+ *
+ * While a vehicle is registered with an environment, its pose is stored
+ * in the VehicleStore of the environment, which allows moving many
+ * vehicles at once without touching the vehicle objects. The accessors
+ * of the pose read and write the store transparently.
  */
 class Vehicle : public SimpleRefCount<Vehicle>
 {
@@ -42,6 +53,10 @@ public:
    * Position and bearing are initialized to 0. The permittivity
    * is set to 6.0 for an approximation of glass, metal and rubber.
    *
+   * The shape of such vehicles is a box, which is updated in place
+   * without the generic polygon transformations. Vehicles with the same
+   * dimensions share their template (see VehicleShapeTemplate::GetBox()).
+   *
    * @param length	Length of the vehicle [m]
    * @param width	Width of the vehicle [m]
    * @param height	Height of the vehicle [m]
@@ -60,6 +75,16 @@ public:
    */
   Vehicle (const Polygon2d& shape, double height);
 
+  /*!
+   * @brief Create vehicle from a shared template.
+   *
+   * Position and bearing are initialized to 0. The permittivity
+   * is set to 6.0 for an approximation of glass, metal and rubber.
+   *
+   * @param shapeTemplate	Shape and dimensions of the vehicle class
+   */
+  explicit Vehicle (Ptr<const VehicleShapeTemplate> shapeTemplate);
+
   /*!
    * @brief Update the position of the vehicle.
    *
@@ -80,6 +105,41 @@ public:
   void
   SetHeading (double heading);
 
+  /*!
+   * @brief Get the position of the vehicle.
+   * @return Current position of the vehicle
+   */
+  Vector
+  GetPosition () const;
+
+  /*!
+   * @brief Get the heading of the vehicle.
+   * @return Heading of the car in degrees from north
+   */
+  double
+  GetHeading () const;
+
+  /*!
+   * @brief Get the number of pose changes of the vehicle.
+   *
+   * Setting the current pose again does not count as a change.
+   *
+   * @return Counter increased by every change of position or heading
+   */
+  std::uint32_t
+  GetPoseVersion () const;
+
+  /*!
+   * @brief Get the radius of the vehicle.
+   *
+   * The circle with this radius around the position of the vehicle
+   * encloses its shape for every possible heading.
+   *
+   * @return Maximum distance of the shape from the vehicle position [m]
+   */
+  double
+  GetRadius () const;
+
   /*!
    * @brief Get the height of the vehicle.
    * @return Height of the vehicle [m]
@@ -87,6 +147,13 @@ public:
   double
   GetHeight () const;
 
+  /*!
+   * @brief Get the template the vehicle was created from.
+   * @return Shape and dimensions of the vehicle class
+   */
+  Ptr<const VehicleShapeTemplate>
+  GetShapeTemplate () const;
+
   /*!
    * @brief Get the shape of the vehicle
    * @return Shape of the vehicle
@@ -116,6 +183,23 @@ public:
   SetRelativePermittivity (double perm);
 
 private:
+  friend class VehicleStore;
+
+  /*!
+   * @brief Let a store keep the pose of the vehicle.
+   * @param store	Store owning the pose from now on
+   * @param slot	Slot of the vehicle in @a store
+   */
+  void
+  Attach (VehicleStore* store, std::size_t slot);
+
+  /*!
+   * @brief Take the pose back from the store.
+   * @param position	Last position of the vehicle in the store
+   * @param heading	Last heading of the vehicle in the store
+   */
+  void
+  Detach (const Vector& position, double heading);
 
   /*!
    * @brief Check and update the value of the current shape.
@@ -123,18 +207,36 @@ private:
   void
   CheckUpdateShape ();
 
-  //! Height of the vehicle
-  double m_height;
+  /*!
+   * @brief Update shape and bounding box of a box shaped vehicle.
+   *
+   * Computes the corners with a single sine and cosine evaluation and
+   * overwrites the points of the current shape in place.
+   */
+  void
+  UpdateBoxShape ();
+
+  //! Shape and dimensions, shared with other vehicles of the same class
+  Ptr<const VehicleShapeTemplate> m_template;
+
+  //! Store owning the pose, null if the vehicle keeps it on its own
+  VehicleStore* m_store;
+
+  //! Slot of the vehicle in @a m_store
+  std::size_t m_slot;
 
-  //! Position of the vehicle
+  //! Pose version of the store the current shape was computed for
+  std::uint32_t m_shapeVersion;
+
+  //! Pose changes of the vehicle, only used without store
+  std::uint32_t m_poseVersion;
+
+  //! Position of the vehicle, only used without store
   Vector m_position;
 
-  //! Current heading of the vehicle
+  //! Current heading of the vehicle, only used without store
   double m_heading;
 
-  //! Shape of the vehicle at the origin
-  Polygon2d m_initialShape;
-
   /*!
    * @brief Shape of the vehicle at the current location and rotation
    *
@@ -144,7 +246,8 @@ private:
    */
   Polygon2d m_currentShape;
 
-  //! Indicate that the current shape needs to be recalculated.
+  //! Indicate that the current shape needs to be recalculated,
+  //! also see @a m_shapeVersion
   bool m_shapeUpdated;
 
   //! Bounding box of the building
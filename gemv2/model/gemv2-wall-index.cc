@@ -0,0 +1,322 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "gemv2-wall-index.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <boost/geometry/index/rtree.hpp>
+#include <boost/function_output_iterator.hpp>
+
+namespace ns3 {
+namespace gemv2 {
+
+namespace {
+
+//! Cross product of (b - a) and (c - a)
+double
+Orientation (const Point2d& a, const Point2d& b, const Point2d& c)
+{
+  return (b.x () - a.x ()) * (c.y () - a.y ()) -
+      (b.y () - a.y ()) * (c.x () - a.x ());
+}
+
+//! Position of @a p on @a s as multiple of the segment length
+double
+Project (const LineSegment2d& s, const Point2d& p)
+{
+  double dx = s.second.x () - s.first.x ();
+  double dy = s.second.y () - s.first.y ();
+  double length2 = dx * dx + dy * dy;
+  if (length2 == 0)
+    {
+      return 0;
+    }
+  return ((p.x () - s.first.x ()) * dx + (p.y () - s.first.y ()) * dy) / length2;
+}
+
+//! Point on @a s at position @a t
+Point2d
+PointAt (const LineSegment2d& s, double t)
+{
+  return Point2d (s.first.x () + t * (s.second.x () - s.first.x ()),
+		  s.first.y () + t * (s.second.y () - s.first.y ()));
+}
+
+}  // namespace
+
+bool
+SegmentsIntersect (const LineSegment2d& a, const LineSegment2d& b)
+{
+  // boxes have to overlap, this also handles collinear segments
+  if (std::max (a.first.x (), a.second.x ()) < std::min (b.first.x (), b.second.x ()) ||
+      std::max (b.first.x (), b.second.x ()) < std::min (a.first.x (), a.second.x ()) ||
+      std::max (a.first.y (), a.second.y ()) < std::min (b.first.y (), b.second.y ()) ||
+      std::max (b.first.y (), b.second.y ()) < std::min (a.first.y (), a.second.y ()))
+    {
+      return false;
+    }
+
+  return Orientation (a.first, a.second, b.first) *
+      Orientation (a.first, a.second, b.second) <= 0 &&
+      Orientation (b.first, b.second, a.first) *
+      Orientation (b.first, b.second, a.second) <= 0;
+}
+
+bool
+FindSegmentIntersection (const LineSegment2d& a, const LineSegment2d& b,
+			 Point2d& point)
+{
+  if (!SegmentsIntersect (a, b))
+    {
+      return false;
+    }
+
+  double rx = a.second.x () - a.first.x ();
+  double ry = a.second.y () - a.first.y ();
+  double sx = b.second.x () - b.first.x ();
+  double sy = b.second.y () - b.first.y ();
+  double denominator = rx * sy - ry * sx;
+
+  double t;
+  if (denominator != 0)
+    {
+      // regular crossing
+      t = ((b.first.x () - a.first.x ()) * sy -
+	   (b.first.y () - a.first.y ()) * sx) / denominator;
+    }
+  else
+    {
+      // collinear, take the start of the overlap
+      t = std::min (Project (a, b.first), Project (a, b.second));
+    }
+
+  point = PointAt (a, std::min (std::max (t, 0.0), 1.0));
+  return true;
+}
+
+/*
+ * Index data structures
+ */
+struct WallIndex::Data
+{
+  //! A single wall
+  struct Wall
+  {
+    //! Box around the wall
+    Box2d box;
+    //! The wall segment
+    LineSegment2d segment;
+    //! Building the wall belongs to
+    Ptr<Building> building;
+  };
+
+  //! Access to the box of a wall
+  struct WallIndexable
+  {
+    using result_type = Box2d const&;	// required for rtree
+    result_type operator()(Wall const& w) const { return w.box; }
+  };
+
+  //! Compare walls by building and position, required for rtree
+  struct WallEqual
+  {
+    bool
+    operator()(Wall const& a, Wall const& b) const
+    {
+      return a.building == b.building &&
+	  boost::geometry::equals (a.segment.first, b.segment.first) &&
+	  boost::geometry::equals (a.segment.second, b.segment.second);
+    }
+  };
+
+  /*!
+   * @brief Type of the wall tree
+   *
+   * The tree is built with the packing algorithm, buildings added or
+   * removed later (e.g. with tiles) are updated in place.
+   */
+  using WallTree =
+      boost::geometry::index::rtree<
+      Wall, boost::geometry::index::rstar<16>, WallIndexable, WallEqual>;
+
+  //! All walls
+  WallTree walls;
+
+  //! Add the walls of a ring to @a out
+  static void
+  AddRing (const Polygon2d::ring_type& ring, const Ptr<Building>& building,
+	   std::vector<Wall>& out)
+  {
+    for (std::size_t i = 0; i + 1 < ring.size (); ++i)
+      {
+	Wall w;
+	w.segment = LineSegment2d (ring[i], ring[i + 1]);
+	boost::geometry::envelope (w.segment, w.box);
+	w.building = building;
+	out.push_back (w);
+      }
+  }
+
+  /*!
+   * @brief Call @a f once for each building with a wall hit by a line.
+   * @param line	Line to test
+   * @param f		Called with the address of each hit building
+   */
+  template<typename F>
+  void
+  VisitHitBuildings (const LineSegment2d& line, F f) const
+  {
+    std::vector<Building*> found;
+    walls.query (
+	boost::geometry::index::intersects (line) &&
+	boost::geometry::index::satisfies (
+	    [&line](const Wall& w)
+	    { return SegmentsIntersect (line, w.segment); }),
+	boost::make_function_output_iterator (
+	    [&found](const Wall& w)
+	    {
+	      auto building = PeekPointer (w.building);
+	      if (std::find (found.begin (), found.end (), building) == found.end ())
+		{
+		  found.push_back (building);
+		}
+	    }));
+
+    for (auto building : found)
+      {
+	f (building);
+      }
+  }
+
+  //! Add the walls of all rings of buildings to @a out
+  static void
+  AddWalls (const std::vector<Ptr<Building>>& buildings, std::vector<Wall>& out)
+  {
+    for (auto const& b : buildings)
+      {
+	auto shape = b->DecodeShape ();
+	AddRing (shape.outer (), b, out);
+	for (auto const& ring : shape.inners ())
+	  {
+	    AddRing (ring, b, out);
+	  }
+      }
+  }
+};
+
+WallIndex::WallIndex ()
+  : m_data (new Data)
+{
+}
+
+WallIndex::~WallIndex () = default;
+
+void
+WallIndex::Build (const std::vector<Ptr<Building>>& buildings)
+{
+  std::vector<Data::Wall> walls;
+  Data::AddWalls (buildings, walls);
+
+  Data::WallTree packed (walls.begin (), walls.end ());
+  m_data->walls.swap (packed);
+}
+
+void
+WallIndex::Insert (const std::vector<Ptr<Building>>& buildings)
+{
+  std::vector<Data::Wall> walls;
+  Data::AddWalls (buildings, walls);
+  m_data->walls.insert (walls.begin (), walls.end ());
+}
+
+void
+WallIndex::Remove (const std::vector<Ptr<Building>>& buildings)
+{
+  std::vector<Data::Wall> walls;
+  Data::AddWalls (buildings, walls);
+  m_data->walls.remove (walls.begin (), walls.end ());
+}
+
+void
+WallIndex::Clear ()
+{
+  m_data->walls.clear ();
+}
+
+std::size_t
+WallIndex::GetNumWalls () const
+{
+  return m_data->walls.size ();
+}
+
+bool
+WallIndex::IntersectsAny (const LineSegment2d& line) const
+{
+  return m_data->walls.qbegin (
+      boost::geometry::index::intersects (line) &&
+      boost::geometry::index::satisfies (
+	  [&line](const Data::Wall& w)
+	  { return SegmentsIntersect (line, w.segment); })
+      ) != m_data->walls.qend ();
+}
+
+WallIndex::WallHitList
+WallIndex::Intersect (const LineSegment2d& line) const
+{
+  WallHitList hits;
+
+  m_data->walls.query (
+      boost::geometry::index::intersects (line),
+      boost::make_function_output_iterator (
+	  [&line, &hits](const Data::Wall& w)
+	  {
+	    Point2d p;
+	    if (FindSegmentIntersection (line, w.segment, p))
+	      {
+		hits.push_back (WallHit {w.building, w.segment, p,
+					 boost::geometry::distance (line.first, p)});
+	      }
+	  }));
+
+  std::sort (hits.begin (), hits.end (),
+	     [](const WallHit& a, const WallHit& b)
+	     { return a.distance < b.distance; });
+
+  return hits;
+}
+
+void
+WallIndex::IntersectBuildings (const LineSegment2d& line,
+			       const BuildingVisitor& visitor) const
+{
+  m_data->VisitHitBuildings (
+      line, [&visitor](Building* building) { visitor (*building); });
+}
+
+void
+WallIndex::IntersectBuildings (const LineSegment2d& line,
+			       std::vector<Ptr<Building>>& buildings) const
+{
+  m_data->VisitHitBuildings (
+      line, [&buildings](Building* building)
+      { buildings.push_back (Ptr<Building> (building)); });
+}
+
+}  // namespace gemv2
+}  // namespace ns3
@@ -0,0 +1,189 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2016 Karsten Roscher
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef GEMV2_WALL_INDEX_H
+#define GEMV2_WALL_INDEX_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <ns3/ptr.h>
+
+#include <ns3/gemv2-geometry.h>
+#include <ns3/gemv2-building.h>
+
+namespace ns3 {
+namespace gemv2 {
+
+/*!
+ * @brief Intersection of a line with the wall of a building.
+ */
+struct WallHit
+{
+  //! Building the wall belongs to
+  Ptr<Building> building;
+  //! The wall that has been hit
+  LineSegment2d wall;
+  //! Intersection point closest to the start of the line
+  Point2d point;
+  //! Distance of @a point from the start of the line [m]
+  double distance;
+};
+
+/*!
+ * @brief Test if two line segments share at least one point.
+ * @param a	First segment
+ * @param b	Second segment
+ * @return True if @a a and @a b intersect or touch
+ */
+bool
+SegmentsIntersect (const LineSegment2d& a, const LineSegment2d& b);
+
+/*!
+ * @brief Calculate the intersection of two line segments.
+ *
+ * For overlapping collinear segments, the common point closest to the
+ * start of @a a is returned.
+ *
+ * @param a		First segment
+ * @param b		Second segment
+ * @param point		Intersection point, only set if the segments intersect
+ * @return True if @a a and @a b intersect or touch
+ */
+bool
+FindSegmentIntersection (const LineSegment2d& a, const LineSegment2d& b,
+			 Point2d& point);
+
+/*!
+ * @brief Spatial index of the walls of buildings.
+ *
+ * The outlines (including holes) of the buildings are split into single
+ * wall segments. Line tests only look at the walls close to the line,
+ * independent of the number of vertices of the buildings.
+ */
+class WallIndex
+{
+public:
+  //! List of wall hits
+  using WallHitList = std::vector<WallHit>;
+
+  //! Callback for buildings found by a query
+  using BuildingVisitor = std::function<void (const Building&)>;
+
+  /*!
+   * @brief Create empty index.
+   */
+  WallIndex ();
+
+  ~WallIndex ();
+
+  /*!
+   * @brief Replace the content of the index with the walls of @a buildings.
+   * @param buildings	Buildings to index
+   */
+  void
+  Build (const std::vector<Ptr<Building>>& buildings);
+
+  /*!
+   * @brief Add the walls of buildings to the index.
+   *
+   * The walls are inserted one by one, so queries are slightly slower
+   * than after Build().
+   *
+   * @param buildings	Buildings to add, must not be indexed yet
+   */
+  void
+  Insert (const std::vector<Ptr<Building>>& buildings);
+
+  /*!
+   * @brief Remove the walls of buildings from the index.
+   * @param buildings	Buildings added with Build() or Insert() before
+   */
+  void
+  Remove (const std::vector<Ptr<Building>>& buildings);
+
+  /*!
+   * @brief Remove all walls.
+   */
+  void
+  Clear ();
+
+  /*!
+   * @brief Get the number of indexed walls.
+   * @return Number of walls
+   */
+  std::size_t
+  GetNumWalls () const;
+
+  /*!
+   * @brief Test if a line hits any wall.
+   *
+   * Lines completely inside of a building do not hit any wall.
+   *
+   * @param line	Line to test
+   * @return True if @a line intersects or touches at least one wall
+   */
+  bool
+  IntersectsAny (const LineSegment2d& line) const;
+
+  /*!
+   * @brief Find all walls hit by a line.
+   * @param line	Line to test
+   * @return Hit walls, sorted by the distance from the start of @a line
+   */
+  WallHitList
+  Intersect (const LineSegment2d& line) const;
+
+  /*!
+   * @brief Visit all buildings with a wall hit by a line.
+   *
+   * Each building is visited once. In contrast to Intersect(), this does
+   * not touch the reference counts of the buildings, so several threads
+   * may query the index at the same time.
+   *
+   * @param line	Line to test
+   * @param visitor	Called for each building with a wall hit by @a line
+   */
+  void
+  IntersectBuildings (const LineSegment2d& line, const BuildingVisitor& visitor) const;
+
+  /*!
+   * @brief Find all buildings with a wall hit by a line.
+   *
+   * Same as the visitor version, but collects the buildings. In contrast
+   * to Intersect(), the hit points are not computed.
+   *
+   * @param line	Line to test
+   * @param buildings	Each building with a wall hit by @a line is added once
+   */
+  void
+  IntersectBuildings (const LineSegment2d& line,
+		      std::vector<Ptr<Building>>& buildings) const;
+
+private:
+  // Index data structures
+  struct Data;
+
+  //! Internal data structures moved to the implementation file.
+  std::unique_ptr<Data> m_data;
+};
+
+}  // namespace gemv2
+}  // namespace ns3
+
+#endif /* GEMV2_WALL_INDEX_H */
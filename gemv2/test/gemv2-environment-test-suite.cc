@@ -1,9 +1,25 @@
 // An essential include is test.h
 #include "ns3/test.h"
 
+#include "ns3/simulator.h"
+#include "ns3/node.h"
+#include "ns3/constant-velocity-mobility-model.h"
 #include "ns3/gemv2-environment.h"
+#include "ns3/gemv2-vehicle-store.h"
+#include "ns3/gemv2-building-merging.h"
+#include "ns3/gemv2-helper.h"
+#include "ns3/gemv2-vehicle-adapter.h"
+#include "ns3/gemv2-obstacle-importer.h"
+#include "ns3/gemv2-osm-importer.h"
 #include <boost/geometry/io/wkt/read.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
 // Do not put your test classes in namespace ns3.  You may find it useful
 // to use the using directive to access the ns3 namespace directly
 using namespace ns3;
@@ -61,11 +77,82 @@ Gemv2BuildingIntersectionTestCase::DoRun (void)
 }
 
 
+// This will test bulk loading of buildings
+class Gemv2BulkLoadingTestCase : public TestCase
+{
+public:
+  Gemv2BulkLoadingTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2BulkLoadingTestCase::Gemv2BulkLoadingTestCase ()
+  : TestCase ("GEMV^2 bulk loading test case")
+{
+}
+
+void
+Gemv2BulkLoadingTestCase::DoRun (void)
+{
+  auto incremental = Create<gemv2::Environment> ();
+  auto bulk = Create<gemv2::Environment> ();
+  bulk->SetBulkLoading (true);
+
+  // grid of 20x20 buildings with 10m gaps
+  for (int x = 0; x < 20; ++x)
+    {
+      for (int y = 0; y < 20; ++y)
+	{
+	  gemv2::Polygon2d p;
+	  boost::geometry::convert (
+	      gemv2::Box2d ({x * 30.0, y * 30.0}, {x * 30.0 + 20, y * 30.0 + 20}), p);
+	  auto building = Create<gemv2::Building> (p);
+	  incremental->AddBuilding (building);
+	  bulk->AddBuilding (building);
+	}
+    }
+
+  // tree is only constructed when finalizing
+  NS_TEST_ASSERT_MSG_EQ (bulk->GetBuildingTreeStatistics ().objects, 0,
+			 "Buildings should be buffered");
+  bulk->Finalize ();
+
+  auto stats = bulk->GetBuildingTreeStatistics ();
+  NS_TEST_ASSERT_MSG_EQ (stats.objects, 400, "All buildings should be in the tree");
+  NS_TEST_ASSERT_MSG_EQ (incremental->GetBuildingTreeStatistics ().objects, 400,
+			 "All buildings should be in the tree");
+
+  gemv2::LineSegment2d lines[] = {
+      {{5, -5}, {5, 600}},
+      {{0, 0}, {600, 600}},
+      {{25, 0}, {25, 600}},
+      {{100, 25}, {350, 25}}
+  };
+
+  for (auto const& line : lines)
+    {
+      NS_TEST_ASSERT_MSG_EQ (bulk->IntersectBuildings (line).size (),
+			     incremental->IntersectBuildings (line).size (),
+			     "Bulk loaded tree should find the same buildings");
+      NS_TEST_ASSERT_MSG_EQ (bulk->IntersectsAnyBuildings (line),
+			     incremental->IntersectsAnyBuildings (line),
+			     "Bulk loaded tree should find the same buildings");
+    }
+
+  NS_TEST_ASSERT_MSG_EQ (
+      bulk->FindBuildingsInEllipse ({100, 100}, {300, 300}, 400).size (),
+      incremental->FindBuildingsInEllipse ({100, 100}, {300, 300}, 400).size (),
+      "Bulk loaded tree should find the same buildings");
+}
+
+
 // This will just test basic intersection checks on vehicles
 class Gemv2VehicleIntersectionTestCase : public TestCase
 {
 public:
-  Gemv2VehicleIntersectionTestCase ();
+  Gemv2VehicleIntersectionTestCase (
+      gemv2::VehicleIndexType indexType = gemv2::VEHICLE_INDEX_RTREE);
 
 private:
   void DoRun (void) override;
@@ -75,11 +162,18 @@ private:
   std::vector<Ptr<gemv2::Vehicle>> vehicles;
 };
 
-Gemv2VehicleIntersectionTestCase::Gemv2VehicleIntersectionTestCase ()
-  : TestCase ("GEMV^2 vehicle intersection test case")
+Gemv2VehicleIntersectionTestCase::Gemv2VehicleIntersectionTestCase (
+    gemv2::VehicleIndexType indexType)
+  : TestCase (indexType == gemv2::VEHICLE_INDEX_GRID ?
+	      "GEMV^2 vehicle intersection test case (grid)" :
+	      "GEMV^2 vehicle intersection test case")
 {
   // create environment
   env = Create<gemv2::Environment> ();
+  env->SetVehicleIndexType (indexType);
+
+  // cells smaller than the vehicles to test objects spanning multiple cells
+  env->SetVehicleGridCellSize (2.0);
 
   // create a few vehicles
   vehicles.push_back (Create<gemv2::Vehicle> (4.5, 1.8, 1.5));	// small
@@ -134,6 +228,2019 @@ Gemv2VehicleIntersectionTestCase::DoRun (void)
   // test with ray slightly off the tilted truck
   iv = env->IntersectVehicles (gemv2::LineSegment2d ({13, 21}, {33, 41}));
   NS_TEST_ASSERT_MSG_EQ (iv.size (), 0, "Should not intersect any vehicle");
+
+  // coordinates far beyond the range of the grid cells
+  vehicles[0]->SetPosition (Vector (1e10, 40, 0));
+  env->ForceVehicleTreeRebuild ();
+  iv = env->IntersectVehicles (gemv2::LineSegment2d ({1e10 - 0.5, 0}, {1e10 + 0.5, 70}));
+  NS_TEST_ASSERT_MSG_EQ (iv.size (), 1, "Should find far away vehicles");
+}
+
+
+// This will test incremental updates of the vehicle tree
+class Gemv2IncrementalVehicleTreeTestCase : public TestCase
+{
+public:
+  Gemv2IncrementalVehicleTreeTestCase ();
+
+private:
+  void DoRun (void) override;
+
+  // move the vehicles after the first round of checks
+  void MoveVehicles (void);
+
+  // check the moved vehicles after the rebuild interval expired
+  void CheckMovedVehicles (void);
+
+  Ptr<gemv2::Environment> env;
+
+  std::vector<Ptr<gemv2::Vehicle>> vehicles;
+};
+
+Gemv2IncrementalVehicleTreeTestCase::Gemv2IncrementalVehicleTreeTestCase ()
+  : TestCase ("GEMV^2 incremental vehicle tree test case")
+{
+}
+
+void
+Gemv2IncrementalVehicleTreeTestCase::DoRun (void)
+{
+  env = Create<gemv2::Environment> ();
+  env->SetVehicleTreeUpdateMode (gemv2::VEHICLE_TREE_UPDATE_INCREMENTAL);
+  env->SetVehicleTreeRebuildInterval (Seconds (1.0));
+
+  vehicles.push_back (Create<gemv2::Vehicle> (4.5, 1.8, 1.5));
+  vehicles.back()->SetPosition (Vector (25, 40, 0));
+  env->AddVehicle (vehicles.back ());
+
+  gemv2::LineSegment2d line ({0, 40}, {100, 40});
+
+  // initial query builds the tree
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectVehicles (line).size (), 1,
+			 "Should intersect the first vehicle");
+
+  // added vehicles are visible without rebuild
+  vehicles.push_back (Create<gemv2::Vehicle> (4.5, 1.8, 1.5));
+  vehicles.back()->SetPosition (Vector (75, 40, 0));
+  env->AddVehicle (vehicles.back ());
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectVehicles (line).size (), 2,
+			 "Should intersect both vehicles");
+
+  // adding a vehicle twice must not duplicate it
+  env->AddVehicle (vehicles.back ());
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectVehicles (line).size (), 2,
+			 "Should still intersect both vehicles");
+
+  // removed vehicles disappear without rebuild
+  env->RemoveVehicle (vehicles.front ());
+  auto iv = env->IntersectVehicles (line);
+  NS_TEST_ASSERT_MSG_EQ (iv.size (), 1, "Should intersect one vehicle");
+  NS_TEST_ASSERT_MSG_EQ (iv.front (), vehicles.back (),
+			 "Should intersect the second vehicle");
+
+  Simulator::Schedule (Seconds (0.5),
+		       &Gemv2IncrementalVehicleTreeTestCase::MoveVehicles, this);
+  Simulator::Schedule (Seconds (2.0),
+		       &Gemv2IncrementalVehicleTreeTestCase::CheckMovedVehicles, this);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+Gemv2IncrementalVehicleTreeTestCase::MoveVehicles (void)
+{
+  vehicles.back ()->SetPosition (Vector (75, 80, 0));
+}
+
+void
+Gemv2IncrementalVehicleTreeTestCase::CheckMovedVehicles (void)
+{
+  gemv2::LineSegment2d oldLine ({0, 40}, {100, 40});
+  gemv2::LineSegment2d newLine ({0, 80}, {100, 80});
+
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectVehicles (oldLine).size (), 0,
+			 "Moved vehicle should not be found at the old position");
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectVehicles (newLine).size (), 1,
+			 "Moved vehicle should be found at the new position");
+}
+
+
+// This will test queries on motion padded vehicle boxes
+class Gemv2PaddedVehicleTreeTestCase : public TestCase
+{
+public:
+  Gemv2PaddedVehicleTreeTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2PaddedVehicleTreeTestCase::Gemv2PaddedVehicleTreeTestCase ()
+  : TestCase ("GEMV^2 motion padded vehicle tree test case")
+{
+}
+
+void
+Gemv2PaddedVehicleTreeTestCase::DoRun (void)
+{
+  auto env = Create<gemv2::Environment> ();
+  env->SetVehicleTreeRebuildInterval (Seconds (1.0));
+  env->SetMaxVehicleSpeed (20.0);
+
+  auto vehicle = Create<gemv2::Vehicle> (4.5, 1.8, 1.5);
+  vehicle->SetPosition (Vector (25, 40, 0));
+  env->AddVehicle (vehicle);
+
+  gemv2::LineSegment2d line ({0, 40}, {100, 40});
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectVehicles (line).size (), 1,
+			 "Should intersect the vehicle");
+
+  // move and turn the vehicle within the padding, no rebuild required
+  vehicle->SetPosition (Vector (40, 50, 0));
+  vehicle->SetHeading (90);
+
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectVehicles (line).size (), 0,
+			 "Should not intersect the vehicle at the old position");
+  NS_TEST_ASSERT_MSG_EQ (
+      env->IntersectVehicles (gemv2::LineSegment2d ({0, 50}, {100, 50})).size (),
+      1, "Should intersect the vehicle at the new position");
+  NS_TEST_ASSERT_MSG_EQ (
+      env->FindVehiclesInEllipse (gemv2::Point2d (30, 50), gemv2::Point2d (50, 50),
+				  22.0).size (),
+      1, "Should find the vehicle in the ellipse");
+  NS_TEST_ASSERT_MSG_EQ (
+      env->FindVehiclesInEllipse (gemv2::Point2d (20, 40), gemv2::Point2d (30, 40),
+				  12.0).size (),
+      0, "Should not find the vehicle in the old ellipse");
+}
+
+
+// This will test the fast shape update of box shaped vehicles
+class Gemv2VehicleShapeTestCase : public TestCase
+{
+public:
+  Gemv2VehicleShapeTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2VehicleShapeTestCase::Gemv2VehicleShapeTestCase ()
+  : TestCase ("GEMV^2 vehicle shape test case")
+{
+}
+
+void
+Gemv2VehicleShapeTestCase::DoRun (void)
+{
+  // same box, once with the fast path and once as generic polygon
+  auto box = Create<gemv2::Vehicle> (4.5, 1.8, 1.5);
+  gemv2::Polygon2d shape;
+  boost::geometry::read_wkt (
+      "POLYGON((-0.9 -2.25, -0.9 2.25, 0.9 2.25, 0.9 -2.25, -0.9 -2.25))", shape);
+  auto polygon = Create<gemv2::Vehicle> (shape, 1.5);
+
+  std::size_t mismatches = 0;
+  for (int i = 0; i < 100; ++i)
+    {
+      Vector position ((i * 37) % 83 - 11.5, (i * 53) % 71 - 10.25, 0);
+      double heading = i * 17.5 - 200;
+      box->SetPosition (position);
+      box->SetHeading (heading);
+      polygon->SetPosition (position);
+      polygon->SetHeading (heading);
+
+      auto const& expected = polygon->GetShape ().outer ();
+      auto const& found = box->GetShape ().outer ();
+      if (found.size () != expected.size ())
+	{
+	  ++mismatches;
+	  continue;
+	}
+      auto const& foundBox = box->GetBoundingBox ();
+      for (std::size_t j = 0; j < found.size (); ++j)
+	{
+	  if (boost::geometry::distance (found[j], expected[j]) > 1e-9 ||
+	      !boost::geometry::covered_by (found[j], foundBox))
+	    {
+	      ++mismatches;
+	    }
+	}
+
+      auto const& expectedBox = polygon->GetBoundingBox ();
+      if (boost::geometry::distance (foundBox.min_corner (), expectedBox.min_corner ()) > 1e-9 ||
+	  boost::geometry::distance (foundBox.max_corner (), expectedBox.max_corner ()) > 1e-9)
+	{
+	  ++mismatches;
+	}
+    }
+  NS_TEST_ASSERT_MSG_EQ (mismatches, 0, "Box should match the generic shape");
+  NS_TEST_ASSERT_MSG_GT (boost::geometry::area (box->GetShape ()), 0,
+			 "Box should be oriented clockwise");
+}
+
+
+// This will test vehicles sharing their shape templates
+class Gemv2VehicleShapeTemplateTestCase : public TestCase
+{
+public:
+  Gemv2VehicleShapeTemplateTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2VehicleShapeTemplateTestCase::Gemv2VehicleShapeTemplateTestCase ()
+  : TestCase ("GEMV^2 vehicle shape template test case")
+{
+}
+
+void
+Gemv2VehicleShapeTemplateTestCase::DoRun (void)
+{
+  // boxes with the same dimensions share their template
+  auto car1 = Create<gemv2::Vehicle> (4.5, 1.8, 1.5);
+  auto car2 = Create<gemv2::Vehicle> (4.5, 1.8, 1.5);
+  auto truck = Create<gemv2::Vehicle> (12.0, 2.5, 3.5);
+  NS_TEST_ASSERT_MSG_EQ (car1->GetShapeTemplate (), car2->GetShapeTemplate (),
+			 "Cars should share the template");
+  NS_TEST_ASSERT_MSG_NE (car1->GetShapeTemplate (), truck->GetShapeTemplate (),
+			 "Truck should have its own template");
+  NS_TEST_ASSERT_MSG_EQ (truck->GetHeight (), 3.5, "");
+  NS_TEST_ASSERT_MSG_EQ_TOL (truck->GetRadius (), std::hypot (6.0, 1.25), 1e-9, "");
+
+  // templates of released vehicles are dropped from the registry
+  Create<gemv2::Vehicle> (14.0, 2.5, 3.2);
+  NS_TEST_ASSERT_MSG_GT (gemv2::VehicleShapeTemplate::ReleaseUnusedBoxes (), 0,
+			 "Should release the template of the bus");
+  NS_TEST_ASSERT_MSG_EQ (gemv2::VehicleShapeTemplate::ReleaseUnusedBoxes (), 0,
+			 "Should have released all unused templates");
+  NS_TEST_ASSERT_MSG_EQ (gemv2::VehicleShapeTemplate::GetBox (4.5, 1.8, 1.5),
+			 car1->GetShapeTemplate (), "Should keep used templates");
+
+  // vehicles of a registered class
+  gemv2::Polygon2d shape;
+  boost::geometry::read_wkt (
+      "POLYGON((-1 -3, -1 2, 0 3, 1 2, 1 -3, -1 -3))", shape);
+  gemv2::VehicleShapeTemplate::Register (
+      "test-van", Create<gemv2::VehicleShapeTemplate> (shape, 2.2));
+  auto vanTemplate = gemv2::VehicleShapeTemplate::Find ("test-van");
+  NS_TEST_ASSERT_MSG_EQ (!vanTemplate, false, "Should find the registered class");
+  NS_TEST_ASSERT_MSG_EQ (!gemv2::VehicleShapeTemplate::Find ("test-unknown"), true, "");
+
+  auto van1 = Create<gemv2::Vehicle> (vanTemplate);
+  auto van2 = Create<gemv2::Vehicle> (vanTemplate);
+  van1->SetPosition (Vector (10, 20, 0));
+  van2->SetPosition (Vector (30, 20, 0));
+  van2->SetHeading (180);
+  NS_TEST_ASSERT_MSG_EQ (van1->GetHeight (), 2.2, "");
+  NS_TEST_ASSERT_MSG_EQ_TOL (van1->GetBoundingBox ().max_corner ().y (), 23, 1e-9,
+			     "Should move the shared shape");
+  NS_TEST_ASSERT_MSG_EQ_TOL (van2->GetBoundingBox ().min_corner ().y (), 17, 1e-9,
+			     "Should rotate the shared shape");
+  NS_TEST_ASSERT_MSG_EQ_TOL (vanTemplate->GetShape ().outer ()[2].y (), 3, 1e-9,
+			     "Template should not change");
+}
+
+
+// This will test the vehicle store and moving vehicles in bulk
+class Gemv2BulkVehicleUpdateTestCase : public TestCase
+{
+public:
+  Gemv2BulkVehicleUpdateTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2BulkVehicleUpdateTestCase::Gemv2BulkVehicleUpdateTestCase ()
+  : TestCase ("GEMV^2 bulk vehicle update test case")
+{
+}
+
+void
+Gemv2BulkVehicleUpdateTestCase::DoRun (void)
+{
+  gemv2::Polygon2d shape;
+  boost::geometry::read_wkt (
+      "POLYGON((-1 -3, -1 2, 0 3, 1 2, 1 -3, -1 -3))", shape);
+
+  std::vector<Ptr<gemv2::Vehicle>> vehicles {
+    Create<gemv2::Vehicle> (4.5, 1.8, 1.5),
+    Create<gemv2::Vehicle> (shape, 2.2),
+    Create<gemv2::Vehicle> (12.0, 2.5, 3.5)};
+  std::vector<Vector> positions {
+    Vector (10, 40, 0), Vector (50, 40, 0), Vector (90, 40, 0)};
+  std::vector<double> headings {30, 45, 90};
+
+  // boxes computed by the store match the shapes of the vehicles
+  {
+    gemv2::VehicleStore store;
+    for (auto const& v : vehicles)
+      {
+	NS_TEST_ASSERT_MSG_EQ (store.Add (v, gemv2::Box2d ()), true, "");
+      }
+    NS_TEST_ASSERT_MSG_EQ (store.Add (vehicles[1], gemv2::Box2d ()), false,
+			   "Should not add a vehicle twice");
+
+    // the vehicles write their poses into the store
+    for (std::size_t i = 0; i < vehicles.size (); ++i)
+      {
+	vehicles[i]->SetPosition (positions[i]);
+	vehicles[i]->SetHeading (headings[i]);
+      }
+    auto slot = store.Find (PeekPointer (vehicles[1]));
+    NS_TEST_ASSERT_MSG_EQ (store.GetPosition (slot).x, 50, "");
+    NS_TEST_ASSERT_MSG_EQ (store.TakeDirtySlots ().size (), 3, "Should mark moved vehicles");
+    NS_TEST_ASSERT_MSG_EQ (store.TakeDirtySlots ().size (), 0, "");
+
+    std::vector<gemv2::Box2d> boxes;
+    store.ComputeBoundingBoxes (boxes);
+    NS_TEST_ASSERT_MSG_EQ (boxes.size (), 3, "Should compute a box per vehicle");
+    for (std::size_t i = 0; i < vehicles.size (); ++i)
+      {
+	auto const& expected = vehicles[i]->GetBoundingBox ();
+	NS_TEST_ASSERT_MSG_EQ (boost::geometry::equals (boxes[i], expected), true,
+			       "Box of vehicle " << i << " should match its shape");
+	NS_TEST_ASSERT_MSG_EQ (
+	    boost::geometry::equals (store.ComputeBoundingBox (i), expected), true, "");
+      }
+
+    store.ComputeCircleBoxes (1.0, boxes);
+    NS_TEST_ASSERT_MSG_EQ_TOL (boxes[2].max_corner ().x (),
+			       90 + std::hypot (6.0, 1.25) + 1.0, 1e-9, "");
+
+    // poses written into the store move the vehicles
+    store.SetPose (slot, Vector (50, 45, 0), 45);
+    auto dirty = store.TakeDirtySlots ();
+    NS_TEST_ASSERT_MSG_EQ (dirty.size (), 1, "");
+    NS_TEST_ASSERT_MSG_EQ (dirty.front (), slot, "Should only mark the moved vehicle");
+    NS_TEST_ASSERT_MSG_EQ (vehicles[1]->GetPosition ().y, 45, "");
+    NS_TEST_ASSERT_MSG_EQ_TOL (vehicles[1]->GetBoundingBox ().max_corner ().y (),
+			       45 + 3 * std::sqrt (0.5), 1e-9,
+			       "Should update the shape from the store");
+    store.SetPose (slot, positions[1], headings[1]);
+
+    // unchanged poses do not mark the slot
+    store.TakeDirtySlots ();
+    store.SetPose (slot, positions[1], headings[1]);
+    NS_TEST_ASSERT_MSG_EQ (store.TakeDirtySlots ().size (), 0, "Should ignore unchanged poses");
+
+    // removing a vehicle moves the last one into its slot
+    store.SetPose (slot, positions[1], headings[1] + 1);
+    store.SetPose (store.Find (PeekPointer (vehicles[2])), positions[2], headings[2] + 1);
+    store.Remove (store.Find (PeekPointer (vehicles[0])));
+    NS_TEST_ASSERT_MSG_EQ (store.GetSize (), 2, "");
+    NS_TEST_ASSERT_MSG_EQ (store.Find (PeekPointer (vehicles[0])),
+			   gemv2::VehicleStore::NOT_FOUND, "");
+    NS_TEST_ASSERT_MSG_EQ (vehicles[0]->GetPosition ().x, 10,
+			   "Removed vehicle should keep its pose");
+    NS_TEST_ASSERT_MSG_EQ (store.GetVehicle (store.Find (PeekPointer (vehicles[2]))),
+			   vehicles[2], "Should find the moved vehicle");
+    dirty = store.TakeDirtySlots ();
+    NS_TEST_ASSERT_MSG_EQ (dirty.size (), 2, "Should keep the moved vehicles dirty");
+    store.ComputeBoundingBoxes (boxes);
+    NS_TEST_ASSERT_MSG_EQ (
+	boost::geometry::equals (boxes[store.Find (PeekPointer (vehicles[2]))],
+				 vehicles[2]->GetBoundingBox ()), true,
+	"Moved vehicle should keep its pose");
+
+    // other stores only refresh the vehicles which moved since
+    gemv2::VehicleStore foreign;
+    for (auto const& v : vehicles)
+      {
+	foreign.Add (v, gemv2::Box2d ());
+      }
+    NS_TEST_ASSERT_MSG_EQ (foreign.TakeDirtySlots ().size (), 0,
+			   "Should copy the poses when adding");
+    vehicles[1]->SetPosition (Vector (50, 50, 0));
+    dirty = foreign.TakeDirtySlots ();
+    NS_TEST_ASSERT_MSG_EQ (dirty.size (), 1, "");
+    NS_TEST_ASSERT_MSG_EQ (dirty.front (), foreign.Find (PeekPointer (vehicles[1])),
+			   "Should mark the moved foreign vehicle");
+    NS_TEST_ASSERT_MSG_EQ (foreign.GetPosition (dirty.front ()).y, 50, "");
+    NS_TEST_ASSERT_MSG_EQ (foreign.TakeDirtySlots ().size (), 0,
+			   "Should skip unchanged foreign vehicles");
+
+    // the pose version continues after the owner drops the vehicle
+    store.Remove (store.Find (PeekPointer (vehicles[2])));
+    NS_TEST_ASSERT_MSG_EQ (foreign.TakeDirtySlots ().size (), 0, "");
+    vehicles[2]->SetPosition (Vector (90, 41, 0));
+    NS_TEST_ASSERT_MSG_EQ (foreign.TakeDirtySlots ().size (), 1, "");
+    vehicles[1]->SetPosition (positions[1]);
+    vehicles[2]->SetPosition (positions[2]);
+  }
+  NS_TEST_ASSERT_MSG_EQ (vehicles[2]->GetPosition ().x, 90,
+			 "Vehicles should keep their pose without store");
+
+  // move all vehicles of an environment in one call, with and without
+  // motion padding
+  for (double speed : {0.0, 50.0})
+    {
+      auto env = Create<gemv2::Environment> ();
+      env->SetMaxVehicleSpeed (speed);
+      for (auto const& v : vehicles)
+	{
+	  env->AddVehicle (v);
+	}
+
+      gemv2::LineSegment2d line ({0, 40}, {100, 40});
+      NS_TEST_ASSERT_MSG_EQ (env->IntersectVehicles (line).size (), 3,
+			     "Should intersect all vehicles");
+
+      // the truck turns along the line, the others leave it
+      env->UpdateVehicles (
+	  vehicles,
+	  {Vector (10, 80, 0), Vector (50, 60, 0), Vector (90, 41, 0)},
+	  {0, 0, 90});
+      NS_TEST_ASSERT_MSG_EQ (vehicles[0]->GetPosition ().y, 80, "");
+      NS_TEST_ASSERT_MSG_EQ (vehicles[2]->GetHeading (), 90, "");
+
+      env->ForceVehicleTreeRebuild ();
+      auto iv = env->IntersectVehicles (line);
+      NS_TEST_ASSERT_MSG_EQ (iv.size (), 1, "Should only intersect the truck");
+      NS_TEST_ASSERT_MSG_EQ (iv.front (), vehicles[2], "");
+
+      // remaining vehicles keep their slots consistent
+      env->RemoveVehicle (vehicles[0]);
+      env->UpdateVehicles (
+	  {vehicles[1], vehicles[2]},
+	  {Vector (50, 40, 0), Vector (90, 80, 0)},
+	  {0, 0});
+      env->ForceVehicleTreeRebuild ();
+      iv = env->IntersectVehicles (line);
+      NS_TEST_ASSERT_MSG_EQ (iv.size (), 1, "Should only intersect the custom shape");
+      NS_TEST_ASSERT_MSG_EQ (iv.front (), vehicles[1], "");
+
+      // restore the initial poses for the next round
+      env->UpdateVehicles (vehicles, positions, headings);
+    }
+
+  // removed vehicles update their shape for moves made by the store
+  {
+    auto env = Create<gemv2::Environment> ();
+    env->AddVehicle (vehicles[0]);
+    gemv2::Box2d box = vehicles[0]->GetBoundingBox ();
+    env->UpdateVehicles ({vehicles[0]}, {Vector (10, 60, 0)}, {headings[0]});
+    env->RemoveVehicle (vehicles[0]);
+    NS_TEST_ASSERT_MSG_EQ_TOL (vehicles[0]->GetBoundingBox ().min_corner ().y (),
+			       box.min_corner ().y () + 20, 1e-9,
+			       "Should not keep the shape from before the move");
+    vehicles[0]->SetPosition (positions[0]);
+  }
+}
+
+
+// This will test pose changes queued until the next vehicle query
+class Gemv2QueuedVehicleUpdateTestCase : public TestCase
+{
+public:
+  Gemv2QueuedVehicleUpdateTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2QueuedVehicleUpdateTestCase::Gemv2QueuedVehicleUpdateTestCase ()
+  : TestCase ("GEMV^2 queued vehicle update test case")
+{
+}
+
+void
+Gemv2QueuedVehicleUpdateTestCase::DoRun (void)
+{
+  auto env = Create<gemv2::Environment> ();
+
+  auto vehicle = Create<gemv2::Vehicle> (4.5, 1.8, 1.5);
+  vehicle->SetPosition (Vector (50, 40, 0));
+  env->AddVehicle (vehicle);
+
+  gemv2::LineSegment2d line ({0, 40}, {100, 40});
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectVehicles (line).size (), 1,
+			 "Should intersect the vehicle");
+
+  // only the latest queued pose is applied, and only on the next query
+  env->QueueVehicleUpdate (vehicle, Vector (50, 60, 0), 0);
+  env->QueueVehicleUpdate (vehicle, Vector (50, 80, 0), 90);
+  NS_TEST_ASSERT_MSG_EQ (vehicle->GetPosition ().y, 40,
+			 "Queued pose should not be applied yet");
+
+  env->ForceVehicleTreeRebuild ();
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectVehicles (line).size (), 0,
+			 "Should apply the queued pose before the query");
+  NS_TEST_ASSERT_MSG_EQ (vehicle->GetPosition ().y, 80, "");
+  NS_TEST_ASSERT_MSG_EQ (vehicle->GetHeading (), 90, "");
+
+  // the queue is empty after it was applied
+  vehicle->SetPosition (Vector (50, 40, 0));
+  env->ForceVehicleTreeRebuild ();
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectVehicles (line).size (), 1,
+			 "Should not apply the pose again");
+}
+
+
+// This will test the visitor versions of the queries
+class Gemv2VisitorQueryTestCase : public TestCase
+{
+public:
+  Gemv2VisitorQueryTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2VisitorQueryTestCase::Gemv2VisitorQueryTestCase ()
+  : TestCase ("GEMV^2 visitor query test case")
+{
+}
+
+void
+Gemv2VisitorQueryTestCase::DoRun (void)
+{
+  auto env = Create<gemv2::Environment> ();
+
+  gemv2::Polygon2d p1, p2, f1;
+  boost::geometry::read_wkt("POLYGON((10 10, 10 20, 20 20, 20 10, 10 10))", p1);
+  boost::geometry::read_wkt("POLYGON((30 30, 30 50, 50 50, 50 30, 30 30))", p2);
+  boost::geometry::read_wkt("POLYGON((60 0, 60 10, 70 10, 70 0, 60 0))", f1);
+  env->AddBuilding (Create<gemv2::Building> (p1));
+  env->AddBuilding (Create<gemv2::Building> (p2));
+  env->AddFoliage (Create<gemv2::Foliage> (f1));
+
+  auto vehicle = Create<gemv2::Vehicle> (4.5, 1.8, 1.5);
+  vehicle->SetPosition (Vector (25, 25, 0));
+  env->AddVehicle (vehicle);
+
+  gemv2::LineSegment2d line ({0, 0}, {100, 100});
+
+  double area = 0;
+  env->IntersectBuildings (
+      line, [&area](const gemv2::Building& b) { area += b.GetArea (); });
+  NS_TEST_ASSERT_MSG_EQ_TOL (area, 500.0, 1e-6, "Should visit both buildings");
+
+  std::size_t count = 0;
+  env->IntersectVehicles (
+      line, [this, &count, &vehicle](gemv2::Vehicle& v)
+      {
+	NS_TEST_ASSERT_MSG_EQ (&v, PeekPointer (vehicle), "Should visit the vehicle");
+	++count;
+      });
+  NS_TEST_ASSERT_MSG_EQ (count, 1, "Should visit one vehicle");
+
+  gemv2::Point2d a (0, 0), b (70, 0);
+  auto objects = env->FindAllObjectsInEllipse (a, b, 100);
+
+  std::size_t buildings = 0, foliage = 0, vehicles = 0;
+  env->FindAllObjectsInEllipse (
+      a, b, 100,
+      [&buildings](const gemv2::Building&) { ++buildings; },
+      [&foliage](const gemv2::Foliage&) { ++foliage; },
+      [&vehicles](gemv2::Vehicle&) { ++vehicles; });
+
+  NS_TEST_ASSERT_MSG_EQ (buildings, objects.buildings.size (),
+			 "Should visit the same buildings");
+  NS_TEST_ASSERT_MSG_EQ (foliage, objects.foliage.size (),
+			 "Should visit the same foliage objects");
+  NS_TEST_ASSERT_MSG_EQ (vehicles, objects.vehicles.size (),
+			 "Should visit the same vehicles");
+  NS_TEST_ASSERT_MSG_EQ (foliage, 1, "Should visit the foliage object");
+
+  // empty visitors skip the object type
+  buildings = 0;
+  env->FindAllObjectsInEllipse (
+      a, b, 100,
+      [&buildings](const gemv2::Building&) { ++buildings; },
+      nullptr, nullptr);
+  NS_TEST_ASSERT_MSG_EQ (buildings, objects.buildings.size (),
+			 "Should visit the same buildings");
+}
+
+// This will test the aggregated ellipse query
+class Gemv2EllipseOccupancyTestCase : public TestCase
+{
+public:
+  Gemv2EllipseOccupancyTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2EllipseOccupancyTestCase::Gemv2EllipseOccupancyTestCase ()
+  : TestCase ("GEMV^2 ellipse occupancy test case")
+{
+}
+
+void
+Gemv2EllipseOccupancyTestCase::DoRun (void)
+{
+  auto env = Create<gemv2::Environment> ();
+
+  gemv2::Polygon2d p1, p2, f1;
+  boost::geometry::read_wkt("POLYGON((10 10, 10 20, 20 20, 20 10, 10 10))", p1);
+  boost::geometry::read_wkt("POLYGON((300 300, 300 320, 320 320, 320 300, 300 300))", p2);
+  boost::geometry::read_wkt("POLYGON((60 0, 60 10, 70 10, 70 0, 60 0))", f1);
+  env->AddBuilding (Create<gemv2::Building> (p1));
+  env->AddBuilding (Create<gemv2::Building> (p2));
+  env->AddFoliage (Create<gemv2::Foliage> (f1));
+
+  auto tx = Create<gemv2::Vehicle> (4.5, 1.8, 1.5);
+  tx->SetPosition (Vector (0, 0, 0));
+  auto rx = Create<gemv2::Vehicle> (4.5, 1.8, 1.5);
+  rx->SetPosition (Vector (70, 0, 0));
+  auto other = Create<gemv2::Vehicle> (4.5, 1.8, 1.5);
+  other->SetPosition (Vector (35, 5, 0));
+  env->AddVehicle (tx);
+  env->AddVehicle (rx);
+  env->AddVehicle (other);
+
+  gemv2::Point2d a (0, 0), b (70, 0);
+  auto objects = env->FindAllObjectsInEllipse (a, b, 100);
+
+  double area = 0;
+  for (auto const& building : objects.buildings)
+    {
+      area += building->GetArea ();
+    }
+  for (auto const& foliage : objects.foliage)
+    {
+      area += foliage->GetArea ();
+    }
+
+  auto occupancy = env->GetOccupancyInEllipse (a, b, 100);
+  NS_TEST_ASSERT_MSG_EQ (occupancy.vehicles, objects.vehicles.size (),
+			 "Should count the same vehicles");
+  NS_TEST_ASSERT_MSG_EQ_TOL (occupancy.objectArea, area, 1e-6,
+			     "Should sum up the same area");
+  NS_TEST_ASSERT_MSG_EQ_TOL (occupancy.objectArea, 200.0, 1e-6,
+			     "Should only include the close objects");
+  NS_TEST_ASSERT_MSG_EQ (occupancy.vehicles, 3, "Should count all vehicles");
+
+  occupancy = env->GetOccupancyInEllipse (a, b, 100, tx, rx);
+  NS_TEST_ASSERT_MSG_EQ (occupancy.vehicles, 1,
+			 "Should not count sender and receiver");
+  NS_TEST_ASSERT_MSG_EQ_TOL (occupancy.objectArea, 200.0, 1e-6,
+			     "Exclusion should not change the area");
+}
+
+// This will compare the aggregate trees with the exact queries
+class Gemv2AggregateTreeTestCase : public TestCase
+{
+public:
+  Gemv2AggregateTreeTestCase (double maxVehicleSpeed);
+
+private:
+  void DoRun (void) override;
+
+  double m_maxVehicleSpeed;
+};
+
+Gemv2AggregateTreeTestCase::Gemv2AggregateTreeTestCase (double maxVehicleSpeed)
+  : TestCase (maxVehicleSpeed > 0 ?
+		  "GEMV^2 aggregate tree test case (padded)" :
+		  "GEMV^2 aggregate tree test case"),
+    m_maxVehicleSpeed (maxVehicleSpeed)
+{
+}
+
+void
+Gemv2AggregateTreeTestCase::DoRun (void)
+{
+  auto env = Create<gemv2::Environment> ();
+  env->SetMaxVehicleSpeed (m_maxVehicleSpeed);
+  env->SetBulkLoading (true);
+
+  // enough objects for several levels in the trees
+  gemv2::Environment::BuildingList buildings;
+  std::vector<Ptr<gemv2::Vehicle>> vehicles;
+  for (int x = 0; x < 40; ++x)
+    {
+      for (int y = 0; y < 40; ++y)
+	{
+	  gemv2::Polygon2d shape;
+	  double size = 5 + (x * 7 + y * 3) % 10;
+	  boost::geometry::append (shape.outer (), gemv2::Point2d (x * 20, y * 20));
+	  boost::geometry::append (shape.outer (), gemv2::Point2d (x * 20, y * 20 + size));
+	  boost::geometry::append (shape.outer (), gemv2::Point2d (x * 20 + size, y * 20 + size));
+	  boost::geometry::append (shape.outer (), gemv2::Point2d (x * 20 + size, y * 20));
+	  boost::geometry::append (shape.outer (), gemv2::Point2d (x * 20, y * 20));
+	  buildings.push_back (Create<gemv2::Building> (shape));
+
+	  auto vehicle = Create<gemv2::Vehicle> (4.5, 1.8, 1.5);
+	  vehicle->SetPosition (Vector (x * 20 + 17, y * 20 + 10, 0));
+	  env->AddVehicle (vehicle);
+	  vehicles.push_back (vehicle);
+	}
+    }
+  env->AddBuildings (buildings);
+  env->Finalize ();
+
+  gemv2::Point2d foci[][2] = {
+    {{100, 100}, {300, 120}},
+    {{400, 50}, {420, 600}},
+    {{10, 10}, {790, 790}},
+    {{250, 250}, {250, 250}}
+  };
+  double ranges[] = {250, 600, 1200, 150};
+
+  for (std::size_t i = 0; i < 4; ++i)
+    {
+      auto const& p1 = foci[i][0];
+      auto const& p2 = foci[i][1];
+      auto objects = env->FindAllObjectsInEllipse (p1, p2, ranges[i]);
+
+      double area = 0;
+      for (auto const& b : objects.buildings)
+	{
+	  area += b->GetArea ();
+	}
+
+      auto occupancy = env->GetOccupancyInEllipse (p1, p2, ranges[i]);
+      NS_TEST_ASSERT_MSG_EQ (occupancy.vehicles, objects.vehicles.size (),
+			     "Should count the same vehicles");
+      NS_TEST_ASSERT_MSG_EQ_TOL (occupancy.objectArea, area, 1e-6 * area,
+				 "Should sum up the same area");
+
+      // exclude one vehicle inside and one outside of the ellipse
+      auto inside = objects.vehicles.front ();
+      auto outside = std::find_if (
+	  vehicles.begin (), vehicles.end (),
+	  [&objects](const Ptr<gemv2::Vehicle>& v)
+	  {
+	    return std::find (objects.vehicles.begin (), objects.vehicles.end (), v)
+		== objects.vehicles.end ();
+	  });
+      auto excluded = env->GetOccupancyInEllipse (
+	  p1, p2, ranges[i], inside,
+	  outside != vehicles.end () ? *outside : nullptr);
+      NS_TEST_ASSERT_MSG_EQ (excluded.vehicles, objects.vehicles.size () - 1,
+			     "Should only skip the vehicle in the ellipse");
+    }
+}
+
+// This will test the wall index
+class Gemv2WallIndexTestCase : public TestCase
+{
+public:
+  Gemv2WallIndexTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2WallIndexTestCase::Gemv2WallIndexTestCase ()
+  : TestCase ("GEMV^2 wall index test case")
+{
+}
+
+void
+Gemv2WallIndexTestCase::DoRun (void)
+{
+  auto env = Create<gemv2::Environment> ();
+
+  gemv2::Polygon2d p1, p2;
+  boost::geometry::read_wkt("POLYGON((10 0, 10 10, 20 10, 20 0, 10 0))", p1);
+  boost::geometry::read_wkt("POLYGON((30 -5, 30 5, 40 5, 40 -5, 30 -5))", p2);
+  auto b1 = Create<gemv2::Building> (p1);
+  auto b2 = Create<gemv2::Building> (p2);
+  env->AddBuilding (b1);
+  env->AddBuilding (b2);
+
+  gemv2::LineSegment2d line ({0, 2}, {50, 2});
+  auto hits = env->IntersectWalls (line);
+  NS_TEST_ASSERT_MSG_EQ (hits.size (), 4, "Should hit two walls of each building");
+  double expected[] = {10, 20, 30, 40};
+  for (std::size_t i = 0; i < hits.size (); ++i)
+    {
+      NS_TEST_ASSERT_MSG_EQ_TOL (hits[i].point.x (), expected[i], 1e-9,
+				 "Wrong intersection point");
+      NS_TEST_ASSERT_MSG_EQ_TOL (hits[i].point.y (), 2, 1e-9,
+				 "Wrong intersection point");
+      NS_TEST_ASSERT_MSG_EQ_TOL (hits[i].distance, expected[i], 1e-9,
+				 "Wrong distance");
+    }
+  NS_TEST_ASSERT_MSG_EQ (hits.front ().building, b1, "First hit should be b1");
+  NS_TEST_ASSERT_MSG_EQ (hits.back ().building, b2, "Last hit should be b2");
+
+  gemv2::LineSegment2d lines[] = {
+    line,
+    {{0, 20}, {50, 20}},	// passes above
+    {{12, 2}, {18, 8}},		// inside of b1
+    {{0, 10}, {5, 10}},		// ends before b1
+    {{5, 15}, {15, 10}}		// touches b1
+  };
+
+  for (bool useWalls : {false, true})
+    {
+      env->SetWallIndex (useWalls);
+      NS_TEST_ASSERT_MSG_EQ (env->IntersectsAnyBuildings (lines[0]), true, "");
+      NS_TEST_ASSERT_MSG_EQ (env->IntersectBuildings (lines[0]).size (), 2, "");
+      NS_TEST_ASSERT_MSG_EQ (env->IntersectsAnyBuildings (lines[1]), false, "");
+      NS_TEST_ASSERT_MSG_EQ (env->IntersectsAnyBuildings (lines[2]), true,
+			     "Line inside of a building should intersect");
+      NS_TEST_ASSERT_MSG_EQ (env->IntersectBuildings (lines[2]).size (), 1, "");
+      NS_TEST_ASSERT_MSG_EQ (env->IntersectsAnyBuildings (lines[3]), false, "");
+      NS_TEST_ASSERT_MSG_EQ (env->IntersectsAnyBuildings (lines[4]), true,
+			     "Touching line should intersect");
+    }
+}
+
+
+// This will compare queries on convex parts with the full shapes
+class Gemv2ConvexPartIndexTestCase : public TestCase
+{
+public:
+  Gemv2ConvexPartIndexTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2ConvexPartIndexTestCase::Gemv2ConvexPartIndexTestCase ()
+  : TestCase ("GEMV^2 convex part index test case")
+{
+}
+
+void
+Gemv2ConvexPartIndexTestCase::DoRun (void)
+{
+  auto env = Create<gemv2::Environment> ();
+
+  const char* shapes[] = {
+    "POLYGON((0 0, 0 10, 4 10, 4 4, 10 4, 10 0, 0 0))",
+    "POLYGON((20 0, 20 20, 40 20, 40 0, 20 0),(25 5, 35 5, 35 15, 25 15, 25 5))",
+    "POLYGON((50 0, 50 10, 52 10, 52 2, 58 2, 58 10, 60 10, 60 0, 50 0))",
+    "POLYGON((0 30, 0 40, 10 40, 10 30, 0 30))"
+  };
+  for (auto wkt : shapes)
+    {
+      gemv2::Polygon2d shape;
+      boost::geometry::read_wkt (wkt, shape);
+      boost::geometry::correct (shape);
+      env->AddBuilding (Create<gemv2::Building> (shape));
+    }
+
+  auto sorted = [](gemv2::Environment::BuildingList buildings)
+  {
+    std::sort (buildings.begin (), buildings.end ());
+    return buildings;
+  };
+
+  std::size_t mismatches = 0;
+  for (int i = 0; i < 500; ++i)
+    {
+      gemv2::Point2d p1 ((i * 37) % 73 - 6.5, (i * 53) % 47 - 3.25);
+      gemv2::Point2d p2 ((i * 19) % 71 - 5.75, (i * 41) % 43 - 2.5);
+      gemv2::LineSegment2d line (p1, p2);
+      double range = boost::geometry::distance (p1, p2) + (i % 7) * 2.5;
+
+      env->SetConvexDecomposition (false);
+      auto hits = sorted (env->IntersectBuildings (line));
+      bool any = env->IntersectsAnyBuildings (line);
+      auto inEllipse = sorted (env->FindBuildingsInEllipse (p1, p2, range));
+      auto occupancy = env->GetOccupancyInEllipse (p1, p2, range);
+
+      env->SetConvexDecomposition (true);
+      if (hits != sorted (env->IntersectBuildings (line)) ||
+	  any != env->IntersectsAnyBuildings (line) ||
+	  inEllipse != sorted (env->FindBuildingsInEllipse (p1, p2, range)) ||
+	  std::abs (occupancy.objectArea -
+		    env->GetOccupancyInEllipse (p1, p2, range).objectArea) > 1e-6)
+	{
+	  ++mismatches;
+	}
+    }
+  NS_TEST_ASSERT_MSG_EQ (mismatches, 0, "Results should not depend on the decomposition");
+
+  // line through the courtyard only
+  gemv2::LineSegment2d courtyard ({27, 7}, {33, 13});
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectsAnyBuildings (courtyard), false,
+			 "Line inside the courtyard should not intersect");
+  // line through several parts of the same building
+  gemv2::LineSegment2d notch ({49, 5}, {61, 5});
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectBuildings (notch).size (), 1,
+			 "Building should only be reported once");
+}
+
+
+// This will test vehicle snapshots and concurrent queries on them
+class Gemv2VehicleSnapshotTestCase : public TestCase
+{
+public:
+  Gemv2VehicleSnapshotTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2VehicleSnapshotTestCase::Gemv2VehicleSnapshotTestCase ()
+  : TestCase ("GEMV^2 vehicle snapshot test case")
+{
+}
+
+void
+Gemv2VehicleSnapshotTestCase::DoRun (void)
+{
+  auto env = Create<gemv2::Environment> ();
+  NS_TEST_ASSERT_MSG_EQ (env->GetVehicleSnapshot () == nullptr, true,
+			 "Nothing should be published yet");
+
+  gemv2::Polygon2d shape;
+  boost::geometry::read_wkt("POLYGON((40 40, 40 60, 60 60, 60 40, 40 40))", shape);
+  env->AddBuilding (Create<gemv2::Building> (shape));
+
+  std::vector<Ptr<gemv2::Vehicle>> vehicles;
+  for (int i = 0; i < 50; ++i)
+    {
+      auto vehicle = Create<gemv2::Vehicle> (4.5, 1.8, 1.5);
+      vehicle->SetPosition (Vector (i * 10, (i % 5) * 10, 0));
+      env->AddVehicle (vehicle);
+      vehicles.push_back (vehicle);
+    }
+
+  auto snapshot = env->PublishVehicleSnapshot ();
+  NS_TEST_ASSERT_MSG_EQ (env->GetVehicleSnapshot (), snapshot, "Should be published");
+  NS_TEST_ASSERT_MSG_EQ (snapshot->GetNumVehicles (), vehicles.size (), "");
+  NS_TEST_ASSERT_MSG_NE (snapshot->Find (PeekPointer (vehicles[7])), nullptr, "");
+
+  gemv2::Point2d p1 (0, 0);
+  gemv2::Point2d p2 (200, 20);
+  double range = 260;
+
+  auto expected = env->GetOccupancyInEllipse (p1, p2, range, vehicles[3]);
+  auto occupancy = env->GetOccupancyInEllipse (*snapshot, p1, p2, range,
+					       PeekPointer (vehicles[3]));
+  NS_TEST_ASSERT_MSG_EQ (occupancy.vehicles, expected.vehicles,
+			 "Should count the same vehicles");
+  NS_TEST_ASSERT_MSG_EQ_TOL (occupancy.objectArea, expected.objectArea, 1e-9,
+			     "Should sum up the same area");
+
+  std::size_t found = 0;
+  snapshot->FindVehiclesInEllipse (
+      p1, p2, range, [&found](const gemv2::VehicleSnapshot::Entry&) { ++found; });
+  NS_TEST_ASSERT_MSG_EQ (found, env->FindVehiclesInEllipse (p1, p2, range).size (),
+			 "Should find the same vehicles");
+
+  gemv2::LineSegment2d line ({0, 0}, {100, 0});
+  std::size_t intersected = 0;
+  snapshot->IntersectVehicles (
+      line, [&intersected](const gemv2::VehicleSnapshot::Entry&) { ++intersected; });
+  NS_TEST_ASSERT_MSG_EQ (intersected, env->IntersectVehicles (line).size (),
+			 "Should intersect the same vehicles");
+
+  intersected = 0;
+  env->IntersectVehicles (
+      *snapshot, line,
+      [&intersected](const gemv2::VehicleSnapshot::Entry&) { ++intersected; });
+  NS_TEST_ASSERT_MSG_EQ (intersected, env->IntersectVehicles (line).size (), "");
+
+  gemv2::LineSegment2d street ({0, 50}, {100, 50});
+  std::size_t buildings = 0;
+  env->IntersectBuildings (
+      *snapshot, street, [&buildings](const gemv2::Building&) { ++buildings; });
+  NS_TEST_ASSERT_MSG_EQ (buildings, env->IntersectBuildings (street).size (),
+			 "Should intersect the same buildings");
+  std::size_t foliage = 0;
+  env->IntersectFoliage (
+      *snapshot, street, [&foliage](const gemv2::Foliage&) { ++foliage; });
+  NS_TEST_ASSERT_MSG_EQ (foliage, 0, "");
+
+  // moving the vehicles must not change a published snapshot
+  for (auto& v : vehicles)
+    {
+      v->SetPosition (Vector (v->GetPosition ().x, 1000, 0));
+    }
+  NS_TEST_ASSERT_MSG_EQ (env->GetOccupancyInEllipse (*snapshot, p1, p2, range).vehicles,
+			 expected.vehicles + 1, "Snapshot should be unchanged");
+
+  auto next = env->PublishVehicleSnapshot ();
+  NS_TEST_ASSERT_MSG_EQ (next->GetEpoch (), snapshot->GetEpoch () + 1,
+			 "Epoch should be increased");
+  NS_TEST_ASSERT_MSG_EQ (env->GetOccupancyInEllipse (*next, p1, p2, range).vehicles, 0,
+			 "New snapshot should contain the moved vehicles");
+
+  // concurrent readers on the same snapshot
+  std::vector<std::size_t> counts (4, 0);
+  std::vector<std::size_t> hits (4, 0);
+  std::vector<std::thread> readers;
+  for (std::size_t t = 0; t < counts.size (); ++t)
+    {
+      readers.emplace_back (
+	  [&env, &counts, &hits, t, p1, p2, range, street]()
+	  {
+	    auto s = env->GetVehicleSnapshot ();
+	    for (int i = 0; i < 100; ++i)
+	      {
+		counts[t] += env->GetOccupancyInEllipse (
+		    *s, p1, gemv2::Point2d (200, 1000), range + 1000).vehicles;
+		env->IntersectBuildings (
+		    *s, street, [&hits, t](const gemv2::Building&) { ++hits[t]; });
+	      }
+	  });
+    }
+  for (auto& r : readers)
+    {
+      r.join ();
+    }
+  auto single = env->GetOccupancyInEllipse (
+      *next, p1, gemv2::Point2d (200, 1000), range + 1000).vehicles;
+  for (std::size_t t = 0; t < counts.size (); ++t)
+    {
+      NS_TEST_ASSERT_MSG_EQ (counts[t], 100 * single, "Readers should agree");
+      NS_TEST_ASSERT_MSG_EQ (hits[t], 100, "");
+    }
+
+  // the wall index is prepared by publishing, lines may start inside
+  env->SetWallIndex (true);
+  auto indexed = env->PublishVehicleSnapshot ();
+  gemv2::LineSegment2d inside ({50, 50}, {55, 50});
+  for (auto const& l : {street, inside})
+    {
+      buildings = 0;
+      env->IntersectBuildings (
+	  *indexed, l, [&buildings](const gemv2::Building&) { ++buildings; });
+      NS_TEST_ASSERT_MSG_EQ (buildings, 1, "Should use the wall index");
+    }
+}
+
+
+// This will compare background vehicle tree rebuilds with synchronous ones
+class Gemv2BackgroundVehicleTreeTestCase : public TestCase
+{
+public:
+  Gemv2BackgroundVehicleTreeTestCase ();
+
+private:
+  void DoRun (void) override;
+
+  // move the vehicles and compare the query results of both environments
+  void Step (int step);
+
+  Ptr<gemv2::Environment> synchronous;
+
+  Ptr<gemv2::Environment> background;
+
+  std::vector<Ptr<gemv2::Vehicle>> vehicles;
+};
+
+Gemv2BackgroundVehicleTreeTestCase::Gemv2BackgroundVehicleTreeTestCase ()
+  : TestCase ("GEMV^2 background vehicle tree test case")
+{
+}
+
+void
+Gemv2BackgroundVehicleTreeTestCase::DoRun (void)
+{
+  synchronous = Create<gemv2::Environment> ();
+  background = Create<gemv2::Environment> ();
+  for (auto env : {synchronous, background})
+    {
+      env->SetMaxVehicleSpeed (20);
+      env->SetVehicleTreeRebuildInterval (Seconds (1.0));
+    }
+  background->SetBackgroundVehicleTreeRebuild (true);
+
+  for (int i = 0; i < 100; ++i)
+    {
+      auto vehicle = Create<gemv2::Vehicle> (4.5, 1.8, 1.5);
+      vehicle->SetPosition (Vector ((i % 10) * 30, (i / 10) * 30, 0));
+      synchronous->AddVehicle (vehicle);
+      background->AddVehicle (vehicle);
+      vehicles.push_back (vehicle);
+    }
+
+  for (int step = 0; step < 50; ++step)
+    {
+      Simulator::Schedule (Seconds (0.1 * step),
+			   &Gemv2BackgroundVehicleTreeTestCase::Step, this, step);
+    }
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  auto statistics = background->GetVehicleTreeRebuildStatistics ();
+  NS_TEST_ASSERT_MSG_GT (statistics.backgroundRebuilds, 0,
+			 "Should swap in trees built in the background");
+  NS_TEST_ASSERT_MSG_EQ (statistics.synchronousRebuilds, 1,
+			 "Should only build the first tree synchronously");
+}
+
+void
+Gemv2BackgroundVehicleTreeTestCase::Step (int step)
+{
+  // every vehicle moves at up to 20 m/s
+  for (std::size_t i = 0; i < vehicles.size (); ++i)
+    {
+      auto p = vehicles[i]->GetPosition ();
+      vehicles[i]->SetPosition (Vector (p.x + (i % 2), p.y + (i % 3) - 1, 0));
+    }
+
+  // vehicles leave and enter while trees are built
+  if (step == 17 || step == 33)
+    {
+      synchronous->RemoveVehicle (vehicles[step]);
+      background->RemoveVehicle (vehicles[step]);
+      auto vehicle = Create<gemv2::Vehicle> (4.5, 1.8, 1.5);
+      vehicle->SetPosition (Vector (step * 5, 100, 0));
+      synchronous->AddVehicle (vehicle);
+      background->AddVehicle (vehicle);
+      vehicles[step] = vehicle;
+    }
+
+  gemv2::Point2d p1 (step * 3, 50);
+  gemv2::Point2d p2 (200, 150 + step);
+  double range = 260;
+  gemv2::LineSegment2d line ({0, step * 5.0}, {300, 300 - step * 5.0});
+
+  auto sorted = [](gemv2::Environment::VehicleList l)
+  {
+    std::sort (l.begin (), l.end ());
+    return l;
+  };
+
+  NS_TEST_ASSERT_MSG_EQ (
+      sorted (background->FindVehiclesInEllipse (p1, p2, range)) ==
+      sorted (synchronous->FindVehiclesInEllipse (p1, p2, range)),
+      true, "Should find the same vehicles at step " << step);
+  NS_TEST_ASSERT_MSG_EQ (
+      sorted (background->IntersectVehicles (line)) ==
+      sorted (synchronous->IntersectVehicles (line)),
+      true, "Should intersect the same vehicles at step " << step);
+  NS_TEST_ASSERT_MSG_EQ (
+      background->GetOccupancyInEllipse (p1, p2, range, vehicles[0]).vehicles,
+      synchronous->GetOccupancyInEllipse (p1, p2, range, vehicles[0]).vehicles,
+      "Should count the same vehicles at step " << step);
+}
+
+
+// This will test environments sharing buildings and foliage
+class Gemv2SharedStaticLayerTestCase : public TestCase
+{
+public:
+  Gemv2SharedStaticLayerTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2SharedStaticLayerTestCase::Gemv2SharedStaticLayerTestCase ()
+  : TestCase ("GEMV^2 shared static layer test case")
+{
+}
+
+void
+Gemv2SharedStaticLayerTestCase::DoRun (void)
+{
+  auto env = Create<gemv2::Environment> ();
+  env->SetBulkLoading (true);
+
+  gemv2::Polygon2d p1, p2, p3;
+  boost::geometry::read_wkt("POLYGON((10 0, 10 10, 20 10, 20 0, 10 0))", p1);
+  boost::geometry::read_wkt("POLYGON((30 -5, 30 5, 40 5, 40 -5, 30 -5))", p2);
+  boost::geometry::read_wkt("POLYGON((50 -5, 50 5, 60 5, 60 -5, 50 -5))", p3);
+  env->AddBuilding (Create<gemv2::Building> (p1));
+  env->AddFoliage (Create<gemv2::Foliage> (p2));
+  env->Finalize ();
+
+  auto clone = env->CloneStaticLayer ();
+  NS_TEST_ASSERT_MSG_EQ (clone->SharesStaticLayer (*env), true,
+			 "Clone should share the static objects");
+
+  gemv2::LineSegment2d line ({0, 2}, {100, 2});
+  NS_TEST_ASSERT_MSG_EQ (clone->IntersectBuildings (line) == env->IntersectBuildings (line),
+			 true, "Should find the same buildings");
+  NS_TEST_ASSERT_MSG_EQ (clone->IntersectFoliage (line) == env->IntersectFoliage (line),
+			 true, "Should find the same foliage");
+  NS_TEST_ASSERT_MSG_EQ (
+      clone->GetOccupancyInEllipse ({0, 0}, {100, 0}, 120).objectArea, 200,
+      "Should sum up the shared objects");
+
+  // vehicles are not shared
+  auto vehicle = Create<gemv2::Vehicle> (4.5, 1.8, 1.5);
+  vehicle->SetPosition (Vector (25, 2, 0));
+  clone->AddVehicle (vehicle);
+  NS_TEST_ASSERT_MSG_EQ (clone->IntersectVehicles (line).size (), 1, "");
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectVehicles (line).size (), 0, "");
+
+  // adding objects copies the static objects
+  clone->AddBuilding (Create<gemv2::Building> (p3));
+  NS_TEST_ASSERT_MSG_EQ (clone->SharesStaticLayer (*env), false,
+			 "Clone should have its own copy");
+  NS_TEST_ASSERT_MSG_EQ (clone->IntersectBuildings (line).size (), 2, "");
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectBuildings (line).size (), 1,
+			 "Original should not be modified");
+  NS_TEST_ASSERT_MSG_EQ (clone->IntersectFoliage (line).size (), 1, "");
+}
+
+
+// This will test writing and reading the binary static layer file
+class Gemv2StaticLayerFileTestCase : public TestCase
+{
+public:
+  Gemv2StaticLayerFileTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2StaticLayerFileTestCase::Gemv2StaticLayerFileTestCase ()
+  : TestCase ("GEMV^2 static layer file test case")
+{
+}
+
+void
+Gemv2StaticLayerFileTestCase::DoRun (void)
+{
+  auto env = Create<gemv2::Environment> ();
+  env->SetBulkLoading (true);
+
+  // enough buildings for several tree levels, one with a courtyard
+  gemv2::Environment::BuildingList buildings;
+  for (int i = 0; i < 400; ++i)
+    {
+      double x = (i % 20) * 30;
+      double y = (i / 20) * 30;
+      gemv2::Polygon2d shape;
+      boost::geometry::append (shape.outer (), gemv2::Point2d (x, y));
+      boost::geometry::append (shape.outer (), gemv2::Point2d (x, y + 20));
+      boost::geometry::append (shape.outer (), gemv2::Point2d (x + 20, y + 20));
+      boost::geometry::append (shape.outer (), gemv2::Point2d (x + 20, y));
+      boost::geometry::append (shape.outer (), gemv2::Point2d (x, y));
+      if (i == 0)
+	{
+	  shape.inners ().resize (1);
+	  boost::geometry::append (shape.inners ()[0], gemv2::Point2d (5, 5));
+	  boost::geometry::append (shape.inners ()[0], gemv2::Point2d (15, 5));
+	  boost::geometry::append (shape.inners ()[0], gemv2::Point2d (15, 15));
+	  boost::geometry::append (shape.inners ()[0], gemv2::Point2d (5, 15));
+	  boost::geometry::append (shape.inners ()[0], gemv2::Point2d (5, 5));
+	}
+      buildings.push_back (Create<gemv2::Building> (shape));
+      buildings.back ()->SetRelativePermittivity (3 + i % 4);
+    }
+  env->AddBuildings (buildings);
+
+  gemv2::Polygon2d trees;
+  boost::geometry::read_wkt("POLYGON((25 -10, 25 -5, 100 -5, 100 -10, 25 -10))", trees);
+  env->AddFoliage (Create<gemv2::Foliage> (trees));
+  env->Finalize ();
+
+  auto fileName = CreateTempDirFilename ("gemv2-static-layer.bin");
+  NS_TEST_ASSERT_MSG_EQ (env->SaveStaticLayer (fileName), true, "Should write the file");
+
+  auto loaded = Create<gemv2::Environment> ();
+  NS_TEST_ASSERT_MSG_EQ (loaded->LoadStaticLayer (fileName), true, "Should read the file");
+  NS_TEST_ASSERT_MSG_EQ (loaded->GetBuildingTreeStatistics ().objects, buildings.size (), "");
+  NS_TEST_ASSERT_MSG_EQ (loaded->GetFoliageTreeStatistics ().objects, 1, "");
+
+  gemv2::LineSegment2d lines[] = {
+    {{10, 10}, {10, 11}},	// inside of the courtyard
+    {{-5, 2}, {400, 300}},
+    {{30, -7}, {30, 50}}
+  };
+  for (auto const& line : lines)
+    {
+      auto expected = env->IntersectBuildings (line);
+      auto found = loaded->IntersectBuildings (line);
+      NS_TEST_ASSERT_MSG_EQ (found.size (), expected.size (), "Should hit the same buildings");
+      double expectedPermittivity = 0;
+      double foundPermittivity = 0;
+      for (std::size_t i = 0; i < found.size (); ++i)
+	{
+	  expectedPermittivity += expected[i]->GetRelativePermittivity ();
+	  foundPermittivity += found[i]->GetRelativePermittivity ();
+	}
+      NS_TEST_ASSERT_MSG_EQ (foundPermittivity, expectedPermittivity,
+			     "Should keep the permittivity");
+      NS_TEST_ASSERT_MSG_EQ (loaded->IntersectFoliage (line).size (),
+			     env->IntersectFoliage (line).size (), "");
+    }
+
+  auto expected = env->GetOccupancyInEllipse ({0, 0}, {300, 200}, 450);
+  auto occupancy = loaded->GetOccupancyInEllipse ({0, 0}, {300, 200}, 450);
+  NS_TEST_ASSERT_MSG_EQ_TOL (occupancy.objectArea, expected.objectArea, 1e-6,
+			     "Should sum up the same area");
+
+  // corrupted records are rejected, the file starts with the header
+  // (120 bytes) and ends with the building and foliage nodes (64 bytes
+  // each), there is a single foliage node
+  std::string original;
+  {
+    std::ifstream is (fileName, std::ios::binary);
+    std::stringstream ss;
+    ss << is.rdbuf ();
+    original = ss.str ();
+  }
+  auto writeCorrupted = [&fileName, &original] (std::size_t offset,
+						 const void* data, std::size_t size)
+  {
+    std::string bytes = original;
+    bytes.replace (offset, size, static_cast<const char*> (data), size);
+    std::ofstream os (fileName, std::ios::binary | std::ios::trunc);
+    os << bytes;
+  };
+
+  double wrongArea = 1;
+  writeCorrupted (120, &wrongArea, sizeof (wrongArea));
+  NS_TEST_ASSERT_MSG_EQ (loaded->LoadStaticLayer (fileName), false,
+			 "Should reject a wrong area");
+
+  // let the building root refer to itself as its only child, the number
+  // of building nodes is stored in the header at offset 96
+  std::uint64_t numNodes;
+  original.copy (reinterpret_cast<char*> (&numNodes), sizeof (numNodes), 96);
+  std::uint32_t selfReference[] = {static_cast<std::uint32_t> (numNodes - 1), 1};
+  writeCorrupted (original.size () - 2 * 64 + 32, selfReference, sizeof (selfReference));
+  NS_TEST_ASSERT_MSG_EQ (loaded->LoadStaticLayer (fileName), false,
+			 "Should reject a cyclic tree");
+
+  // let the root count one object less than stored
+  std::uint64_t objects = buildings.size () - 1;
+  writeCorrupted (original.size () - 2 * 64 + 40, &objects, sizeof (objects));
+  NS_TEST_ASSERT_MSG_EQ (loaded->LoadStaticLayer (fileName), false,
+			 "Should reject inconsistent object counts");
+
+  // invalid files leave the environment untouched
+  {
+    std::ofstream os (fileName, std::ios::binary | std::ios::trunc);
+    os << "POLYGON((0 0, 0 1, 1 1, 1 0, 0 0))" << std::endl;
+  }
+  NS_TEST_ASSERT_MSG_EQ (loaded->LoadStaticLayer (fileName), false,
+			 "Should reject other files");
+  NS_TEST_ASSERT_MSG_EQ (loaded->LoadStaticLayer (fileName + ".missing"), false,
+			 "Should reject missing files");
+  NS_TEST_ASSERT_MSG_EQ (loaded->GetBuildingTreeStatistics ().objects, buildings.size (), "");
+  std::remove (fileName.c_str ());
+}
+
+
+// This will test the compact storage of static objects
+class Gemv2CompactStorageTestCase : public TestCase
+{
+public:
+  Gemv2CompactStorageTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2CompactStorageTestCase::Gemv2CompactStorageTestCase ()
+  : TestCase ("GEMV^2 compact storage test case")
+{
+}
+
+void
+Gemv2CompactStorageTestCase::DoRun (void)
+{
+  auto env = Create<gemv2::Environment> ();
+  auto compact = Create<gemv2::Environment> ();
+  compact->SetCompactStorage (true);
+
+  // buildings off the grid of the compact shapes, one with a courtyard
+  const char* shapes[] = {
+    "POLYGON((0.0004 0.0002, 0 10.0007, 4 10, 4.0003 4, 10 4, 10 0, 0.0004 0.0002))",
+    "POLYGON((20 0, 20 20, 40.0006 20, 40 0, 20 0),(25 5, 35 5, 35 15, 25 15.0004, 25 5))",
+    "POLYGON((0 30, 0 40, 10.0009 40, 10 30, 0 30))"
+  };
+  for (auto wkt : shapes)
+    {
+      gemv2::Polygon2d shape;
+      boost::geometry::read_wkt (wkt, shape);
+      env->AddBuilding (Create<gemv2::Building> (shape));
+      compact->AddBuilding (Create<gemv2::Building> (shape));
+    }
+  gemv2::Polygon2d trees;
+  boost::geometry::read_wkt ("POLYGON((50 0, 50 5, 60.0002 5, 60 0, 50 0))", trees);
+  env->AddFoliage (Create<gemv2::Foliage> (trees));
+  auto foliage = Create<gemv2::Foliage> (trees);
+  compact->AddFoliage (foliage);
+  NS_TEST_ASSERT_MSG_EQ (foliage->IsCompact (), true, "Should compact new objects");
+  NS_TEST_ASSERT_MSG_EQ_TOL (foliage->GetArea (), 50, 1e-2, "");
+  NS_TEST_ASSERT_MSG_EQ_TOL (foliage->DecodeShape ().outer ()[2].x (), 60, 1e-9,
+			     "Should decode the rounded vertices");
+
+  // objects shared with another environment keep the box of its trees
+  gemv2::Polygon2d kiosk;
+  boost::geometry::read_wkt ("POLYGON((60 30, 60 32, 62.0004 32, 62 30, 60 30))", kiosk);
+  auto shared = Create<gemv2::Building> (kiosk);
+  env->AddBuilding (shared);
+  gemv2::Box2d sharedBox = shared->GetBoundingBox ();
+  compact->AddBuilding (shared);
+  NS_TEST_ASSERT_MSG_EQ (shared->IsIndexed (), true, "");
+  NS_TEST_ASSERT_MSG_EQ (shared->IsCompact (), false,
+			 "Should not compact objects indexed by another environment");
+  NS_TEST_ASSERT_MSG_EQ (boost::geometry::equals (shared->GetBoundingBox (), sharedBox),
+			 true, "");
+
+  std::size_t mismatches = 0;
+  for (int i = 0; i < 500; ++i)
+    {
+      gemv2::Point2d p1 ((i * 37) % 73 - 6.5, (i * 53) % 47 - 3.25);
+      gemv2::Point2d p2 ((i * 19) % 71 - 5.75, (i * 41) % 43 - 2.5);
+      gemv2::LineSegment2d line (p1, p2);
+      double range = boost::geometry::distance (p1, p2) + (i % 7) * 2.5 + 0.1;
+
+      compact->SetFastLineIntersection (i % 2 == 0);
+      if (env->IntersectBuildings (line).size () !=
+	  compact->IntersectBuildings (line).size () ||
+	  env->IntersectsAnyFoliage (line) != compact->IntersectsAnyFoliage (line) ||
+	  env->FindBuildingsInEllipse (p1, p2, range).size () !=
+	  compact->FindBuildingsInEllipse (p1, p2, range).size () ||
+	  std::abs (env->GetOccupancyInEllipse (p1, p2, range).objectArea -
+		    compact->GetOccupancyInEllipse (p1, p2, range).objectArea) > 1e-2)
+	{
+	  ++mismatches;
+	}
+    }
+  NS_TEST_ASSERT_MSG_EQ (mismatches, 0, "Results should not depend on the storage");
+
+  // line through the courtyard only
+  gemv2::LineSegment2d courtyard ({27, 7}, {33, 13});
+  NS_TEST_ASSERT_MSG_EQ (compact->IntersectsAnyBuildings (courtyard), false,
+			 "Line inside the courtyard should not intersect");
+
+  // loaded static layers are compacted as well
+  auto fileName = CreateTempDirFilename ("gemv2-compact-layer.bin");
+  NS_TEST_ASSERT_MSG_EQ (env->SaveStaticLayer (fileName), true, "Should write the file");
+  auto loaded = Create<gemv2::Environment> ();
+  loaded->SetCompactStorage (true);
+  NS_TEST_ASSERT_MSG_EQ (loaded->LoadStaticLayer (fileName), true, "Should read the file");
+  auto expected = env->GetOccupancyInEllipse ({-5, -5}, {45, 45}, 80);
+  auto occupancy = loaded->GetOccupancyInEllipse ({-5, -5}, {45, 45}, 80);
+  NS_TEST_ASSERT_MSG_EQ_TOL (occupancy.objectArea, expected.objectArea, 1e-2,
+			     "Should sum up the same area");
+  NS_TEST_ASSERT_MSG_EQ (loaded->IntersectBuildings (courtyard).size (), 0, "");
+  std::remove (fileName.c_str ());
+}
+
+
+// This will test tiles loaded on demand
+class Gemv2StaticLayerTilesTestCase : public TestCase
+{
+public:
+  Gemv2StaticLayerTilesTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2StaticLayerTilesTestCase::Gemv2StaticLayerTilesTestCase ()
+  : TestCase ("GEMV^2 static layer tiles test case")
+{
+}
+
+void
+Gemv2StaticLayerTilesTestCase::DoRun (void)
+{
+  auto env = Create<gemv2::Environment> ();
+  env->SetBulkLoading (true);
+
+  // grid of buildings, some of them crossing the tile borders
+  for (int i = 0; i < 400; ++i)
+    {
+      double x = (i % 20) * 30 + 5;
+      double y = (i / 20) * 30 + 5;
+      gemv2::Polygon2d shape;
+      boost::geometry::append (shape.outer (), gemv2::Point2d (x, y));
+      boost::geometry::append (shape.outer (), gemv2::Point2d (x, y + 20));
+      boost::geometry::append (shape.outer (), gemv2::Point2d (x + 20, y + 20));
+      boost::geometry::append (shape.outer (), gemv2::Point2d (x + 20, y));
+      boost::geometry::append (shape.outer (), gemv2::Point2d (x, y));
+      env->AddBuilding (Create<gemv2::Building> (shape));
+    }
+
+  gemv2::Polygon2d trees;
+  boost::geometry::read_wkt("POLYGON((25 -10, 25 -5, 500 -5, 500 -10, 25 -10))", trees);
+  env->AddFoliage (Create<gemv2::Foliage> (trees));
+  env->Finalize ();
+
+  auto directory = CreateTempDirFilename ("gemv2-tiles");
+  NS_TEST_ASSERT_MSG_EQ (env->SaveStaticLayerTiles (directory, 100), true,
+			 "Should write the tiles");
+
+  // the smallest budget only keeps the tiles of the last query
+  auto tiled = Create<gemv2::Environment> ();
+  NS_TEST_ASSERT_MSG_EQ (tiled->OpenStaticLayerTiles (directory, 1), true,
+			 "Should read the manifest");
+  NS_TEST_ASSERT_MSG_EQ (tiled->GetTileStatistics ().tiles, 37,
+			 "Should write 6x6 building tiles and one foliage tile");
+  NS_TEST_ASSERT_MSG_EQ (tiled->GetTileStatistics ().residentTiles, 0,
+			 "Tiles should only be loaded on demand");
+
+  gemv2::LineSegment2d lines[] = {
+    {{10, 10}, {10, 11}},	// inside of a single building
+    {{-5, 2}, {600, 590}},	// across the map
+    {{95, 20}, {105, 20}},	// crosses a tile border inside of a building
+    {{30, -7}, {30, 50}}	// through the foliage
+  };
+  for (auto const& line : lines)
+    {
+      NS_TEST_ASSERT_MSG_EQ (tiled->IntersectBuildings (line).size (),
+			     env->IntersectBuildings (line).size (),
+			     "Should hit the same buildings");
+      NS_TEST_ASSERT_MSG_EQ (tiled->IntersectsAnyBuildings (line),
+			     env->IntersectsAnyBuildings (line), "");
+      NS_TEST_ASSERT_MSG_EQ (tiled->IntersectFoliage (line).size (),
+			     env->IntersectFoliage (line).size (), "");
+    }
+
+  gemv2::Point2d focals[][2] = {
+    {{0, 0}, {50, 50}},
+    {{90, 90}, {110, 110}},
+    {{0, 0}, {300, 200}}
+  };
+  for (auto const& f : focals)
+    {
+      double range = boost::geometry::distance (f[0], f[1]) + 20;
+      NS_TEST_ASSERT_MSG_EQ (tiled->FindBuildingsInEllipse (f[0], f[1], range).size (),
+			     env->FindBuildingsInEllipse (f[0], f[1], range).size (),
+			     "Should find the same buildings");
+      NS_TEST_ASSERT_MSG_EQ_TOL (
+	  tiled->GetOccupancyInEllipse (f[0], f[1], range).objectArea,
+	  env->GetOccupancyInEllipse (f[0], f[1], range).objectArea, 1e-6,
+	  "Should sum up the same area");
+    }
+
+  auto stats = tiled->GetTileStatistics ();
+  NS_TEST_ASSERT_MSG_GT (stats.evictions, 0, "Should evict tiles over budget");
+  NS_TEST_ASSERT_MSG_EQ (stats.failures, 0, "");
+
+  // a small query only keeps the tiles it touches
+  tiled->IntersectsAnyBuildings (lines[0]);
+  NS_TEST_ASSERT_MSG_EQ (tiled->GetTileStatistics ().residentTiles, 1, "");
+  NS_TEST_ASSERT_MSG_EQ (tiled->GetBuildingTreeStatistics ().objects, 9,
+			 "Should only keep the buildings of a single tile");
+
+  // indexes built before are updated per tile
+  auto indexed = Create<gemv2::Environment> ();
+  indexed->SetWallIndex (true);
+  indexed->SetConvexDecomposition (true);
+  NS_TEST_ASSERT_MSG_EQ (indexed->OpenStaticLayerTiles (directory, 1), true, "");
+  for (int pass = 0; pass < 2; ++pass)
+    {
+      for (auto const& line : lines)
+	{
+	  NS_TEST_ASSERT_MSG_EQ (indexed->IntersectBuildings (line).size (),
+				 env->IntersectBuildings (line).size (),
+				 "Should update the wall index per tile");
+	}
+      for (auto const& f : focals)
+	{
+	  double range = boost::geometry::distance (f[0], f[1]) + 20;
+	  NS_TEST_ASSERT_MSG_EQ_TOL (
+	      indexed->GetOccupancyInEllipse (f[0], f[1], range).objectArea,
+	      env->GetOccupancyInEllipse (f[0], f[1], range).objectArea, 1e-6,
+	      "Should update the convex parts per tile");
+	}
+    }
+
+  // snapshots load the reach of each vehicle in a single request
+  auto snapshotEnv = Create<gemv2::Environment> ();
+  NS_TEST_ASSERT_MSG_EQ (snapshotEnv->OpenStaticLayerTiles (directory, 1), true, "");
+  snapshotEnv->SetSnapshotQueryRange (80);
+  Vector positions[] = {Vector (20, 2, 0), Vector (90, 2, 0), Vector (560, 560, 0)};
+  for (auto const& position : positions)
+    {
+      auto vehicle = Create<gemv2::Vehicle> (4.5, 1.8, 1.5);
+      vehicle->SetPosition (position);
+      snapshotEnv->AddVehicle (vehicle);
+    }
+  auto snapshot = snapshotEnv->PublishVehicleSnapshot ();
+  NS_TEST_ASSERT_MSG_LT (snapshotEnv->GetTileStatistics ().residentTiles, 6,
+			 "Should not load the tiles between distant vehicles");
+  NS_TEST_ASSERT_MSG_GT (snapshotEnv->GetTileStatistics ().residentSize, 1,
+			 "Should keep all tiles of the snapshot over budget");
+
+  gemv2::Point2d p1 (20, 2);
+  gemv2::Point2d p2 (90, 2);
+  NS_TEST_ASSERT_MSG_EQ_TOL (
+      snapshotEnv->GetOccupancyInEllipse (*snapshot, p1, p2, 80).objectArea,
+      env->GetOccupancyInEllipse (p1, p2, 80).objectArea, 1e-6,
+      "Should cover the whole ellipse");
+
+  // clones cannot evict the tiles of a published snapshot
+  auto snapshotClone = snapshotEnv->CloneStaticLayer ();
+  snapshotClone->IntersectsAnyBuildings (lines[1]);
+  snapshotClone->IntersectsAnyBuildings (lines[0]);
+  NS_TEST_ASSERT_MSG_EQ_TOL (
+      snapshotEnv->GetOccupancyInEllipse (*snapshot, p1, p2, 80).objectArea,
+      env->GetOccupancyInEllipse (p1, p2, 80).objectArea, 1e-6,
+      "Should keep the tiles of the snapshot");
+
+  // with a large budget, tiles are kept
+  auto cached = Create<gemv2::Environment> ();
+  NS_TEST_ASSERT_MSG_EQ (cached->OpenStaticLayerTiles (directory, 1 << 30), true, "");
+  cached->IntersectsAnyBuildings (lines[1]);
+  cached->IntersectsAnyBuildings (lines[0]);
+  NS_TEST_ASSERT_MSG_EQ (cached->GetTileStatistics ().evictions, 0, "");
+  NS_TEST_ASSERT_MSG_EQ (cached->GetTileStatistics ().residentTiles,
+			 cached->GetTileStatistics ().loads, "");
+
+  // clones load tiles into the shared layer
+  auto clone = cached->CloneStaticLayer ();
+  auto loads = cached->GetTileStatistics ().loads;
+  gemv2::LineSegment2d corner ({580, 5}, {590, 5});
+  NS_TEST_ASSERT_MSG_EQ (clone->IntersectBuildings (corner).size (),
+			 env->IntersectBuildings (corner).size (), "");
+  NS_TEST_ASSERT_MSG_EQ (clone->SharesStaticLayer (*cached), true,
+			 "Loading a tile should not copy the layer");
+  NS_TEST_ASSERT_MSG_EQ (cached->GetTileStatistics ().loads, loads + 1,
+			 "Tiles loaded by the clone should serve the source");
+  cached->IntersectBuildings (corner);
+  NS_TEST_ASSERT_MSG_EQ (clone->GetTileStatistics ().loads, loads + 1, "");
+
+  NS_TEST_ASSERT_MSG_EQ (cached->OpenStaticLayerTiles (directory + ".missing", 1), false,
+			 "Should reject missing directories");
+}
+
+
+// This will test importing obstacles from WKT and GeoJSON
+class Gemv2ObstacleImporterTestCase : public TestCase
+{
+public:
+  Gemv2ObstacleImporterTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2ObstacleImporterTestCase::Gemv2ObstacleImporterTestCase ()
+  : TestCase ("GEMV^2 obstacle importer test case")
+{
+}
+
+void
+Gemv2ObstacleImporterTestCase::DoRun (void)
+{
+  // many buildings along a street, small chunks to use several workers
+  std::stringstream wkt;
+  for (int i = 0; i < 200; ++i)
+    {
+      double x = i * 30;
+      wkt << "POLYGON((" << x << " 10, " << x << " 30, " << x + 20 << " 30, "
+	  << x + 20 << " 10, " << x << " 10))\n";
+      if (i == 100)
+	{
+	  wkt << "POLYGON((broken\n\n";
+	}
+    }
+  wkt << "MULTIPOLYGON(((0 -30, 0 -10, 20 -10, 20 -30, 0 -30)),"
+      << "((30 -30, 30 -10, 50 -10, 50 -30, 30 -30)))";
+
+  gemv2::ObstacleImporter importer;
+  importer.SetNumThreads (4);
+  importer.SetChunkSize (256);
+
+  auto env = Create<gemv2::Environment> ();
+  auto statistics = importer.ImportBuildings (wkt, gemv2::ObstacleFileFormat::WKT, *env);
+  NS_TEST_ASSERT_MSG_EQ (statistics.objects, 202, "Should import all buildings");
+  NS_TEST_ASSERT_MSG_EQ (statistics.invalidLines, 1, "Should skip the broken line");
+  NS_TEST_ASSERT_MSG_EQ (statistics.bytes, wkt.str ().size (), "Should read everything");
+  NS_TEST_ASSERT_MSG_EQ (env->GetBuildingTreeStatistics ().objects, 202, "");
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectBuildings ({{-5, 20}, {6000, 20}}).size (), 200, "");
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectBuildings ({{-5, -20}, {100, -20}}).size (), 2, "");
+
+  // one feature per line, counter-clockwise with altitude and a courtyard
+  std::stringstream geojson;
+  geojson << "{\"type\": \"FeatureCollection\", \"features\": [\n"
+	  << "{\"type\": \"Feature\", \"properties\": {\"type\": \"Polygon\"}, "
+	  << "\"geometry\": {\"type\": \"Polygon\", \"coordinates\": "
+	  << "[[[0, 0, 1], [30, 0, 1], [30, 30, 1], [0, 30, 1], [0, 0, 1]], "
+	  << "[[10, 10], [10, 20], [20, 20], [20, 10], [10, 10]]]}},\n"
+	  << "{\"type\": \"Feature\", \"geometry\": {\"type\": \"Point\", "
+	  << "\"coordinates\": [5, 5]}},\n"
+	  << "{\"type\": \"Feature\", \"geometry\": {\"type\": \"MultiPolygon\", "
+	  << "\"coordinates\": [[[[40, 0], [50, 0], [50, 10], [40, 10], [40, 0]]], "
+	  << "[[[60, 0], [70, 0], [70, 10], [60, 10], [60, 0]]]]}},\n"
+	  << "{\"type\": \"Feature\", \"geometry\": {\"type\": \"Polygon\", "
+	  << "\"coordinates\": [[[0, 0], [1, 0]}},\n"
+	  << "]}\n";
+
+  auto env2 = Create<gemv2::Environment> ();
+  statistics = importer.ImportFoliage (geojson, gemv2::ObstacleFileFormat::GEOJSON, *env2);
+  NS_TEST_ASSERT_MSG_EQ (statistics.objects, 3, "Should import all polygons");
+  NS_TEST_ASSERT_MSG_EQ (statistics.invalidLines, 1, "Should skip the broken feature");
+  NS_TEST_ASSERT_MSG_EQ (env2->GetFoliageTreeStatistics ().objects, 3, "");
+  NS_TEST_ASSERT_MSG_EQ (env2->IntersectFoliage ({{15, 12}, {15, 18}}).size (), 0,
+			 "Should keep the courtyard");
+  NS_TEST_ASSERT_MSG_EQ (env2->IntersectFoliage ({{-5, 5}, {80, 5}}).size (), 3, "");
+
+  // a whole collection on one line, with the type after the coordinates
+  // and a geometry of unknown type, into an environment still loading
+  std::stringstream line;
+  line << "{\"type\": \"FeatureCollection\", \"features\": ["
+       << "{\"type\": \"Feature\", \"geometry\": {\"coordinates\": "
+       << "[[[0, 40], [10, 40], [10, 50], [0, 50], [0, 40]]], \"type\": \"Polygon\"}}, "
+       << "{\"type\": \"Feature\", \"geometry\": {\"type\": \"Polygon\", \"coordinates\": "
+       << "[[[20, 40], [30, 40], [30, 50], [20, 50], [20, 40]]]}}, "
+       << "{\"type\": \"Feature\", \"geometry\": {\"type\": \"Polyhedron\", "
+       << "\"coordinates\": [[[40, 40], [50, 40], [50, 50], [40, 40]]]}}]}";
+
+  auto env3 = Create<gemv2::Environment> ();
+  env3->SetBulkLoading (true);
+  statistics = importer.ImportBuildings (line, gemv2::ObstacleFileFormat::GEOJSON, *env3);
+  NS_TEST_ASSERT_MSG_EQ (statistics.objects, 2, "Should import both polygons");
+  NS_TEST_ASSERT_MSG_EQ (statistics.invalidLines, 1, "Should report the unknown geometry");
+  NS_TEST_ASSERT_MSG_EQ (env3->IsBulkLoading (), true, "Should keep bulk loading enabled");
+  env3->Finalize ();
+  NS_TEST_ASSERT_MSG_EQ (env3->IntersectBuildings ({{-5, 45}, {60, 45}}).size (), 2, "");
+
+  // neighbors in different chunks keep their bent common wall
+  std::stringstream neighbors;
+  neighbors << "POLYGON((10 0, 0 0, 1 20, 10 20, 9.25 15, 10.85 10, 11 5, 10 0))\n"
+	    << "POLYGON((10 0, 11 5, 10.85 10, 9.25 15, 10 20, 10.35 40, "
+	    << "19.75 40, 20.1 20, 20 0, 10 0))\n";
+  importer.SetChunkSize (64);
+  importer.SetSimplificationTolerance (0.6);
+  auto env4 = Create<gemv2::Environment> ();
+  statistics = importer.ImportBuildings (neighbors, gemv2::ObstacleFileFormat::WKT, *env4);
+  NS_TEST_ASSERT_MSG_EQ (statistics.objects, 2, "");
+  NS_TEST_ASSERT_MSG_EQ (statistics.verticesAfter < statistics.verticesBefore, true,
+			 "Should simplify the walls that are not shared");
+  auto simplified = env4->IntersectBuildings ({{-5, 10}, {25, 10}});
+  NS_TEST_ASSERT_MSG_EQ (simplified.size (), 2, "");
+  boost::geometry::model::multi_polygon<gemv2::Polygon2d> overlap;
+  boost::geometry::intersection (simplified[0]->GetShape (), simplified[1]->GetShape (),
+				 overlap);
+  NS_TEST_ASSERT_MSG_EQ_TOL (boost::geometry::area (overlap), 0, 1e-9,
+			     "Neighbors should not overlap");
+
+  NS_TEST_ASSERT_MSG_EQ (gemv2::ObstacleImporter::GetFormatFromFileName ("a.GeoJSON")
+			 == gemv2::ObstacleFileFormat::GEOJSON, true, "");
+  NS_TEST_ASSERT_MSG_EQ (gemv2::ObstacleImporter::GetFormatFromFileName ("a.wkt")
+			 == gemv2::ObstacleFileFormat::WKT, true, "");
+}
+
+
+// This will test importing buildings and foliage from OSM XML
+class Gemv2OsmImporterTestCase : public TestCase
+{
+public:
+  Gemv2OsmImporterTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2OsmImporterTestCase::Gemv2OsmImporterTestCase ()
+  : TestCase ("GEMV^2 OSM importer test case")
+{
+}
+
+void
+Gemv2OsmImporterTestCase::DoRun (void)
+{
+  // 0.0001 deg of latitude are about 11.1 m
+  std::stringstream osm;
+  osm << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      << "<osm version=\"0.6\" generator=\"test\">\n"
+      << " <bounds minlat=\"0\" minlon=\"0\" maxlat=\"1\" maxlon=\"1\"/>\n"
+      << " <node id=\"1\" lat=\"50.0000\" lon=\"8.0000\"/>\n"
+      << " <node id=\"2\" lat=\"50.0000\" lon=\"8.0002\"/>\n"
+      << " <node id=\"3\" lat=\"50.0002\" lon=\"8.0002\"/>\n"
+      << " <node id=\"4\" lat=\"50.0002\" lon=\"8.0000\">\n"
+      << "  <tag k=\"name\" v=\"corner &amp; more\"/>\n"
+      << " </node>\n"
+      << " <node id=\"5\" lat=\"50.0010\" lon=\"8.0010\"/>\n"
+      << " <node id=\"6\" lat=\"50.0010\" lon=\"8.0020\"/>\n"
+      << " <node id=\"7\" lat=\"50.0020\" lon=\"8.0020\"/>\n"
+      << " <node id=\"8\" lat=\"50.0005\" lon=\"8.0000\"/>\n"
+      << " <node id=\"9\" lat=\"50.0005\" lon=\"8.0010\"/>\n"
+      << " <node id=\"10\" lat=\"51.0000\" lon=\"9.0000\"/>\n"
+      // building
+      << " <way id=\"100\">\n"
+      << "  <nd ref=\"1\"/><nd ref=\"2\"/><nd ref=\"3\"/><nd ref=\"4\"/><nd ref=\"1\"/>\n"
+      << "  <tag k=\"building\" v=\"yes\"/>\n"
+      << " </way>\n"
+      // forest
+      << " <way id=\"101\">\n"
+      << "  <nd ref=\"5\"/><nd ref=\"6\"/><nd ref=\"7\"/><nd ref=\"5\"/>\n"
+      << "  <tag k=\"landuse\" v=\"forest\"/>\n"
+      << " </way>\n"
+      // tree row
+      << " <way id=\"102\">\n"
+      << "  <nd ref=\"8\"/><nd ref=\"9\"/>\n"
+      << "  <tag k=\"natural\" v=\"tree_row\"/>\n"
+      << " </way>\n"
+      // open building outline and building with missing node
+      << " <way id=\"103\">\n"
+      << "  <nd ref=\"1\"/><nd ref=\"2\"/><nd ref=\"3\"/>\n"
+      << "  <tag k=\"building\" v=\"house\"/>\n"
+      << " </way>\n"
+      << " <way id=\"104\">\n"
+      << "  <nd ref=\"1\"/><nd ref=\"2\"/><nd ref=\"99\"/><nd ref=\"1\"/>\n"
+      << "  <tag k=\"building\" v=\"yes\"/>\n"
+      << " </way>\n"
+      // ignored ways
+      << " <way id=\"105\">\n"
+      << "  <nd ref=\"1\"/><nd ref=\"10\"/>\n"
+      << "  <tag k=\"highway\" v=\"residential\"/>\n"
+      << " </way>\n"
+      << " <way id=\"106\">\n"
+      << "  <nd ref=\"1\"/><nd ref=\"2\"/><nd ref=\"3\"/><nd ref=\"1\"/>\n"
+      << "  <tag k=\"building\" v=\"no\"/>\n"
+      << " </way>\n"
+      << " <relation id=\"200\">\n"
+      << "  <member type=\"way\" ref=\"100\" role=\"outer\"/>\n"
+      << "  <tag k=\"type\" v=\"multipolygon\"/>\n"
+      << " </relation>\n"
+      << "</osm>\n";
+
+  auto env = Create<gemv2::Environment> ();
+  gemv2::OsmImporter importer;
+  auto statistics = importer.Import (osm, *env);
+  NS_TEST_ASSERT_MSG_EQ (statistics.buildings, 1, "Should import the building");
+  NS_TEST_ASSERT_MSG_EQ (statistics.foliage, 2, "Should import forest and tree row");
+  NS_TEST_ASSERT_MSG_EQ (statistics.skippedWays, 2, "Should skip open and incomplete ways");
+  NS_TEST_ASSERT_MSG_EQ (statistics.storedNodes, 9, "Should only keep used nodes");
+
+  // origin at the south west corner of the objects
+  auto buildings = env->IntersectBuildings ({{-5, 10}, {50, 10}});
+  NS_TEST_ASSERT_MSG_EQ (buildings.size (), 1, "");
+  auto const& box = buildings.front ()->GetBoundingBox ();
+  NS_TEST_ASSERT_MSG_EQ_TOL (box.min_corner ().x (), 0, 1e-6, "");
+  NS_TEST_ASSERT_MSG_EQ_TOL (box.min_corner ().y (), 0, 1e-6, "");
+  NS_TEST_ASSERT_MSG_EQ_TOL (box.max_corner ().x (), 14.3, 0.1, "");
+  NS_TEST_ASSERT_MSG_EQ_TOL (box.max_corner ().y (), 22.2, 0.1, "");
+
+  // tree row is 5 m wide
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectFoliage ({{30, 53}, {30, 58}}).size (), 1, "");
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectFoliage ({{30, 59}, {30, 62}}).size (), 0, "");
+
+  // explicit origin
+  osm.clear ();
+  osm.seekg (0);
+  auto env2 = Create<gemv2::Environment> ();
+  importer.SetOrigin (49.9999, 7.9999);
+  importer.SetTreeRowWidth (0);
+  statistics = importer.Import (osm, *env2);
+  NS_TEST_ASSERT_MSG_EQ (statistics.foliage, 1, "Should ignore tree rows");
+  NS_TEST_ASSERT_MSG_EQ (env2->IntersectBuildings ({{-5, 10}, {50, 10}}).size (), 0, "");
+  NS_TEST_ASSERT_MSG_EQ (env2->IntersectBuildings ({{-5, 20}, {50, 20}}).size (), 1, "");
+}
+
+
+// This will test merging touching buildings into blocks
+class Gemv2BuildingMergingTestCase : public TestCase
+{
+public:
+  Gemv2BuildingMergingTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2BuildingMergingTestCase::Gemv2BuildingMergingTestCase ()
+  : TestCase ("GEMV^2 building merging test case")
+{
+}
+
+void
+Gemv2BuildingMergingTestCase::DoRun (void)
+{
+  gemv2::Environment::BuildingList buildings;
+
+  // row of ten houses sharing their walls
+  for (int i = 0; i < 10; ++i)
+    {
+      gemv2::Polygon2d shape;
+      boost::geometry::read_wkt ("POLYGON((0 0, 0 10, 10 10, 10 0, 0 0))", shape);
+      boost::geometry::for_each_point (shape, [i] (gemv2::Point2d& p) {
+	p.x (p.x () + 10 * i);
+      });
+      buildings.push_back (Create<gemv2::Building> (shape));
+      buildings.back ()->SetRelativePermittivity (i < 5 ? 4 : 6);
+    }
+
+  // separate building and two overlapping ones
+  gemv2::Polygon2d shape;
+  boost::geometry::read_wkt ("POLYGON((0 20, 0 30, 10 30, 10 20, 0 20))", shape);
+  buildings.push_back (Create<gemv2::Building> (shape));
+  boost::geometry::read_wkt ("POLYGON((20 20, 20 30, 30 30, 30 20, 20 20))", shape);
+  buildings.push_back (Create<gemv2::Building> (shape));
+  boost::geometry::read_wkt ("POLYGON((25 25, 25 35, 35 35, 35 25, 25 25))", shape);
+  buildings.push_back (Create<gemv2::Building> (shape));
+
+  auto merged = gemv2::MergeBuildings (buildings);
+  NS_TEST_ASSERT_MSG_EQ (merged.size (), 3, "Should merge row and overlapping buildings");
+  NS_TEST_ASSERT_MSG_EQ_TOL (merged[0]->GetArea (), 1000, 1e-6, "");
+  NS_TEST_ASSERT_MSG_EQ_TOL (merged[0]->GetRelativePermittivity (), 5, 1e-9,
+			     "Should average the permittivity by area");
+  NS_TEST_ASSERT_MSG_EQ (merged[1], buildings[10], "Should keep single buildings");
+  NS_TEST_ASSERT_MSG_EQ_TOL (merged[2]->GetArea (), 175, 1e-6, "");
+
+  auto env = Create<gemv2::Environment> ();
+  env->AddBuildings (merged);
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectBuildings ({{-5, 5}, {105, 5}}).size (), 1,
+			 "Row should be hit as one block");
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectsAnyBuildings ({{5, 1}, {95, 1}}), true, "");
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectsAnyBuildings ({{-5, 15}, {105, 15}}), false, "");
+
+  // merging through the importer
+  std::stringstream wkt;
+  for (int i = 0; i < 20; ++i)
+    {
+      double x = i * 10;
+      wkt << "POLYGON((" << x << " 0, " << x << " 10, " << x + 10 << " 10, "
+	  << x + 10 << " 0, " << x << " 0))\n";
+    }
+  gemv2::ObstacleImporter importer;
+  importer.SetMergeBuildings (true);
+  auto env2 = Create<gemv2::Environment> ();
+  auto statistics = importer.ImportBuildings (wkt, gemv2::ObstacleFileFormat::WKT, *env2);
+  NS_TEST_ASSERT_MSG_EQ (statistics.objects, 1, "Should import a single block");
+  NS_TEST_ASSERT_MSG_EQ (env2->GetBuildingTreeStatistics ().objects, 1, "");
+}
+
+
+// This will test vehicles following the mobility model of a node
+class Gemv2VehicleTrackingTestCase : public TestCase
+{
+public:
+  Gemv2VehicleTrackingTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2VehicleTrackingTestCase::Gemv2VehicleTrackingTestCase ()
+  : TestCase ("GEMV^2 vehicle tracking test case")
+{
+}
+
+void
+Gemv2VehicleTrackingTestCase::DoRun (void)
+{
+  auto env = Create<gemv2::Environment> ();
+
+  auto node = CreateObject<Node> ();
+  auto mobility = CreateObject<ConstantVelocityMobilityModel> ();
+  mobility->SetPosition (Vector (50, 40, 0));
+  node->AggregateObject (mobility);
+
+  Gemv2Helper helper;
+  helper.SetEnvironment (env);
+  auto vehicle = helper.Install (node);
+
+  auto adapter = mobility->GetObject<Gemv2VehicleAdapter> ();
+  NS_TEST_ASSERT_MSG_EQ (!adapter, false, "Should aggregate the adapter");
+  NS_TEST_ASSERT_MSG_EQ (adapter->GetVehicle (), vehicle, "");
+  NS_TEST_ASSERT_MSG_EQ (vehicle->GetPosition ().x, 50,
+			 "Should start at the position of the node");
+
+  gemv2::LineSegment2d line ({0, 40}, {100, 40});
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectVehicles (line).size (), 1,
+			 "Should intersect the vehicle");
+
+  // course changes are applied on the next query, heading follows the velocity
+  mobility->SetPosition (Vector (50, 80, 0));
+  mobility->SetVelocity (Vector (10, 0, 0));
+  NS_TEST_ASSERT_MSG_EQ (vehicle->GetPosition ().y, 40,
+			 "Course change should be queued");
+
+  env->ForceVehicleTreeRebuild ();
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectVehicles (line).size (), 0,
+			 "Should move the vehicle before the query");
+  NS_TEST_ASSERT_MSG_EQ (vehicle->GetPosition ().y, 80, "");
+  NS_TEST_ASSERT_MSG_EQ_TOL (vehicle->GetHeading (), 90, 1e-9,
+			     "Should head east");
+
+  // the model does not report any course change while driving
+  gemv2::LineSegment2d crossing ({100, 0}, {100, 100});
+  Simulator::Stop (Seconds (5));
+  Simulator::Run ();
+  env->ForceVehicleTreeRebuild ();
+  NS_TEST_ASSERT_MSG_EQ (env->IntersectVehicles (crossing).size (), 1,
+			 "Should follow the vehicle between course changes");
+  NS_TEST_ASSERT_MSG_EQ_TOL (vehicle->GetPosition ().x, 100, 1e-9,
+			     "Should sample the position before the query");
+
+  // the poses cannot change before the simulation time advances
+  auto version = vehicle->GetPoseVersion ();
+  env->IntersectVehicles (crossing);
+  env->IntersectVehicles (line);
+  NS_TEST_ASSERT_MSG_EQ (vehicle->GetPoseVersion (), version,
+			 "Should sample once per simulation time");
+
+  // sampling the same pose again does not count as a change
+  mobility->SetVelocity (Vector (10, 0, 0));
+  env->IntersectVehicles (crossing);
+  NS_TEST_ASSERT_MSG_EQ (vehicle->GetPoseVersion (), version,
+			 "Should ignore unchanged poses");
+
+  // standing still keeps the heading
+  mobility->SetVelocity (Vector (0, 0, 0));
+  env->ForceVehicleTreeRebuild ();
+  env->IntersectVehicles (line);
+  NS_TEST_ASSERT_MSG_EQ_TOL (vehicle->GetHeading (), 90, 1e-9,
+			     "Should keep the heading");
+
+  Simulator::Stop (Seconds (5));
+  Simulator::Run ();
+  env->ForceVehicleTreeRebuild ();
+  env->IntersectVehicles (line);
+  NS_TEST_ASSERT_MSG_EQ_TOL (vehicle->GetPosition ().x, 100, 1e-9,
+			     "Should stay after stopping");
+
+  Simulator::Destroy ();
 }
 
 
@@ -152,7 +2259,32 @@ Gemv2EnvironmentTestSuite::Gemv2EnvironmentTestSuite ()
 {
   // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
   AddTestCase (new Gemv2BuildingIntersectionTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2BulkLoadingTestCase, TestCase::QUICK);
   AddTestCase (new Gemv2VehicleIntersectionTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2VehicleIntersectionTestCase (gemv2::VEHICLE_INDEX_GRID),
+	       TestCase::QUICK);
+  AddTestCase (new Gemv2IncrementalVehicleTreeTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2PaddedVehicleTreeTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2VehicleShapeTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2VehicleShapeTemplateTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2BulkVehicleUpdateTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2QueuedVehicleUpdateTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2VisitorQueryTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2EllipseOccupancyTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2AggregateTreeTestCase (0), TestCase::QUICK);
+  AddTestCase (new Gemv2AggregateTreeTestCase (30), TestCase::QUICK);
+  AddTestCase (new Gemv2WallIndexTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2ConvexPartIndexTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2VehicleSnapshotTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2BackgroundVehicleTreeTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2SharedStaticLayerTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2StaticLayerFileTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2CompactStorageTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2StaticLayerTilesTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2ObstacleImporterTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2OsmImporterTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2BuildingMergingTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2VehicleTrackingTestCase, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite
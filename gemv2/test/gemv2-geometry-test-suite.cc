@@ -2,6 +2,18 @@
 #include "ns3/test.h"
 
 #include "ns3/gemv2-geometry.h"
+#include "ns3/gemv2-bounding-boxes.h"
+#include "ns3/gemv2-flat-polygon.h"
+#include "ns3/gemv2-compact-polygon.h"
+#include "ns3/gemv2-polygon-simplification.h"
+#include "ns3/gemv2-convex-polygon.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <boost/geometry/io/wkt/read.hpp>
 
 // Do not put your test classes in namespace ns3.  You may find it useful
 // to use the using directive to access the ns3 namespace directly
@@ -39,7 +51,413 @@ Gemv2BasicGeometryTestCase::DoRun (void)
 }
 
 
+// This will test the classification of boxes against an ellipse
+class Gemv2BoxEllipseTestCase : public TestCase
+{
+public:
+  Gemv2BoxEllipseTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+Gemv2BoxEllipseTestCase::Gemv2BoxEllipseTestCase ()
+  : TestCase ("Gemv2 box ellipse test case")
+{
+}
+
+void
+Gemv2BoxEllipseTestCase::DoRun (void)
+{
+  // ellipse with foci on the x axis, semi-axes 50 and 40
+  gemv2::Point2d p1 (-30, 0), p2 (30, 0);
+  double range = 100;
+
+  gemv2::Box2d center ({-10, -10}, {10, 10});
+  NS_TEST_ASSERT_MSG_EQ (gemv2::IsBoxInsideEllipse (center, p1, p2, range), true,
+			 "Box around the center should be inside");
+  NS_TEST_ASSERT_MSG_EQ (gemv2::IsBoxOutsideEllipse (center, p1, p2, range), false,
+			 "Box around the center should not be outside");
+
+  gemv2::Box2d border ({40, -5}, {60, 5});
+  NS_TEST_ASSERT_MSG_EQ (gemv2::IsBoxInsideEllipse (border, p1, p2, range), false,
+			 "Box on the border should not be inside");
+  NS_TEST_ASSERT_MSG_EQ (gemv2::IsBoxOutsideEllipse (border, p1, p2, range), false,
+			 "Box on the border should not be outside");
+
+  gemv2::Box2d far ({0, 45}, {10, 55});
+  NS_TEST_ASSERT_MSG_EQ (gemv2::IsBoxInsideEllipse (far, p1, p2, range), false,
+			 "Box beyond the minor axis should not be inside");
+  NS_TEST_ASSERT_MSG_EQ (gemv2::IsBoxOutsideEllipse (far, p1, p2, range), true,
+			 "Box beyond the minor axis should be outside");
+}
+
+// This will test the bounding regions of an ellipse
+class Gemv2EllipseBoundsTestCase : public TestCase
+{
+public:
+  Gemv2EllipseBoundsTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+Gemv2EllipseBoundsTestCase::Gemv2EllipseBoundsTestCase ()
+  : TestCase ("Gemv2 ellipse bounds test case")
+{
+}
+
+void
+Gemv2EllipseBoundsTestCase::DoRun (void)
+{
+  // diagonal ellipse with semi-axes 50 and 30
+  gemv2::Point2d p1 (0, 0), p2 (80 / std::sqrt (2.0), 80 / std::sqrt (2.0));
+  double range = 100;
+
+  auto box = gemv2::MakeBoundingBoxEllipse (p1, p2, range);
+  auto rectangle = gemv2::MakeBoundingRectangleEllipse (p1, p2, range);
+  NS_TEST_ASSERT_MSG_EQ_TOL (rectangle.halfLength, 50, 1e-9, "Wrong major semi-axis");
+  NS_TEST_ASSERT_MSG_EQ_TOL (rectangle.halfWidth, 30, 1e-9, "Wrong minor semi-axis");
+
+  // points on the border of the ellipse have to be in both regions
+  double maxX = -1e9;
+  for (int i = 0; i < 360; ++i)
+    {
+      double t = i * M_PI / 180;
+      double u = 50 * std::cos (t);
+      double v = 30 * std::sin (t);
+      gemv2::Point2d p (rectangle.center.x () + u * rectangle.cosAngle - v * rectangle.sinAngle,
+			rectangle.center.y () + u * rectangle.sinAngle + v * rectangle.cosAngle);
+      gemv2::Box2d point (p, p);
+
+      NS_TEST_ASSERT_MSG_EQ (boost::geometry::covered_by (p, box), true,
+			     "Ellipse should be inside the bounding box");
+      NS_TEST_ASSERT_MSG_EQ (gemv2::Intersects (point, rectangle), true,
+			     "Ellipse should be inside the rectangle");
+      maxX = std::max (maxX, p.x ());
+    }
+  NS_TEST_ASSERT_MSG_EQ_TOL (box.max_corner ().x (), maxX, 0.1,
+			     "Bounding box should be tight");
+
+  // the corners of the axis-aligned box are outside of the rectangle
+  gemv2::Box2d corner (box.max_corner (), box.max_corner ());
+  NS_TEST_ASSERT_MSG_EQ (gemv2::Intersects (corner, rectangle), false,
+			 "Corner should be outside of the rectangle");
+  gemv2::Box2d cover ({-100, -100}, {100, 100});
+  NS_TEST_ASSERT_MSG_EQ (gemv2::Intersects (cover, rectangle), true,
+			 "Large box should intersect the rectangle");
+}
+
+// This will compare the flat polygon kernel with boost geometry
+class Gemv2FlatPolygonTestCase : public TestCase
+{
+public:
+  Gemv2FlatPolygonTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+Gemv2FlatPolygonTestCase::Gemv2FlatPolygonTestCase ()
+  : TestCase ("Gemv2 flat polygon test case")
+{
+}
+
+void
+Gemv2FlatPolygonTestCase::DoRun (void)
+{
+  // concave polygon with a hole
+  gemv2::Polygon2d shape;
+  boost::geometry::read_wkt (
+      "POLYGON((0 0, 0 50, 20 50, 20 20, 40 20, 40 50, 60 50, 60 0, 0 0),"
+      "(5 5, 55 5, 55 10, 5 10, 5 5))", shape);
+  boost::geometry::correct (shape);
+  gemv2::FlatPolygon flat (shape);
+
+  NS_TEST_ASSERT_MSG_EQ (flat.GetNumEdges (), 12, "Wrong number of edges");
+
+  gemv2::LineSegment2d inside ({1, 1}, {2, 2});
+  NS_TEST_ASSERT_MSG_EQ (flat.Intersects (inside), true,
+			 "Segment inside the polygon should intersect");
+  gemv2::LineSegment2d hole ({10, 6}, {50, 9});
+  NS_TEST_ASSERT_MSG_EQ (flat.Intersects (hole), false,
+			 "Segment inside the hole should not intersect");
+  gemv2::LineSegment2d notch ({25, 30}, {35, 60});
+  NS_TEST_ASSERT_MSG_EQ (flat.Intersects (notch), false,
+			 "Segment inside the notch should not intersect");
+  gemv2::LineSegment2d touch ({20, 60}, {20, 50});
+  NS_TEST_ASSERT_MSG_EQ (flat.Intersects (touch), true,
+			 "Segment touching a corner should intersect");
+
+  // compare with boost for segments on a grid around the polygon
+  std::size_t mismatches = 0;
+  for (int i = 0; i < 2000; ++i)
+    {
+      gemv2::LineSegment2d segment (
+	  {(i * 37) % 83 - 11.5, (i * 53) % 71 - 10.25},
+	  {(i * 19) % 79 - 9.75, (i * 41) % 67 - 8.5});
+      if (flat.Intersects (segment) !=
+	  boost::geometry::intersects (shape, segment))
+	{
+	  ++mismatches;
+	}
+    }
+  NS_TEST_ASSERT_MSG_EQ (mismatches, 0, "Results should match boost geometry");
+}
+
+
+// This will test the simplification of obstacle outlines
+class Gemv2PolygonSimplificationTestCase : public TestCase
+{
+public:
+  Gemv2PolygonSimplificationTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2PolygonSimplificationTestCase::Gemv2PolygonSimplificationTestCase ()
+  : TestCase ("GEMV^2 polygon simplification test case")
+{
+}
+
+void
+Gemv2PolygonSimplificationTestCase::DoRun (void)
+{
+  // rectangle with nearly collinear vertices on all edges
+  gemv2::Polygon2d noisy;
+  for (int i = 0; i < 40; ++i)
+    {
+      double t = (i % 10) / 10.0;
+      double noise = (i % 2) * 0.02;
+      switch (i / 10)
+	{
+	case 0: noisy.outer ().push_back ({20 * t, noise}); break;
+	case 1: noisy.outer ().push_back ({20 + noise, 10 * t}); break;
+	case 2: noisy.outer ().push_back ({20 - 20 * t, 10 + noise}); break;
+	default: noisy.outer ().push_back ({noise, 10 - 10 * t}); break;
+	}
+    }
+  noisy.outer ().push_back (noisy.outer ().front ());
+  NS_TEST_ASSERT_MSG_EQ (gemv2::GetNumVertices (noisy), 41, "");
+
+  auto simplified = noisy;
+  NS_TEST_ASSERT_MSG_EQ (gemv2::SimplifyPolygon (simplified, 0.1), true, "");
+  NS_TEST_ASSERT_MSG_EQ (gemv2::GetNumVertices (simplified), 5, "Should keep the corners");
+  NS_TEST_ASSERT_MSG_EQ_TOL (boost::geometry::area (simplified), 200, 0.5, "");
+
+  // removing the bulge would move the courtyard outside
+  gemv2::Polygon2d courtyard;
+  boost::geometry::read_wkt ("POLYGON((0 0, 5 -6, 10 0, 10 10, 0 10, 0 0),"
+			     "(4 -3, 6 -3, 6 -1, 4 -1, 4 -3))", courtyard);
+  NS_TEST_ASSERT_MSG_EQ (gemv2::SimplifyPolygon (courtyard, 8), true,
+			 "Should find a valid simplification");
+  NS_TEST_ASSERT_MSG_EQ (boost::geometry::is_valid (courtyard), true, "");
+  NS_TEST_ASSERT_MSG_EQ (courtyard.inners ().size (), 1, "Should keep the courtyard");
+  NS_TEST_ASSERT_MSG_EQ (boost::geometry::within (gemv2::Point2d (5, -5), courtyard),
+			 true, "Should keep the bulge");
+
+  // invalid outlines are not touched
+  gemv2::Polygon2d bowtie;
+  boost::geometry::read_wkt ("POLYGON((0 0, 10 10, 10 0, 0 10, 0 0))", bowtie);
+  NS_TEST_ASSERT_MSG_EQ (gemv2::SimplifyPolygon (bowtie, 1), false, "");
+  NS_TEST_ASSERT_MSG_EQ (gemv2::GetNumVertices (bowtie), 5, "");
+
+  // neighbors sharing a bent wall, which continues straight in the right
+  // one, so simplifying them independently lets them overlap
+  std::vector<gemv2::Polygon2d> neighbors (2);
+  boost::geometry::read_wkt ("POLYGON((10 0, 0 0, 1 20, 10 20, 9.25 15, "
+			     "10.85 10, 11 5, 10 0))", neighbors[0]);
+  boost::geometry::read_wkt ("POLYGON((10 0, 11 5, 10.85 10, 9.25 15, 10 20, "
+			     "10.35 40, 19.75 40, 20.1 20, 20 0, 10 0))", neighbors[1]);
+  NS_TEST_ASSERT_MSG_EQ (gemv2::SimplifyPolygons (neighbors, 0.6), 0, "");
+  NS_TEST_ASSERT_MSG_EQ (gemv2::GetNumVertices (neighbors[1]), 9,
+			 "Should simplify the walls that are not shared");
+  for (auto const& n : neighbors)
+    {
+      auto const& ring = n.outer ();
+      NS_TEST_ASSERT_MSG_EQ (std::any_of (ring.begin (), ring.end (),
+					  [](const gemv2::Point2d& p)
+					  { return p.x () == 10 && p.y () == 20; }),
+			     true, "Should keep the end of the shared wall");
+    }
+  boost::geometry::model::multi_polygon<gemv2::Polygon2d> overlap;
+  boost::geometry::intersection (neighbors[0], neighbors[1], overlap);
+  NS_TEST_ASSERT_MSG_EQ_TOL (boost::geometry::area (overlap), 0, 1e-9,
+			     "Neighbors should not overlap");
+  boost::geometry::model::multi_polygon<gemv2::Polygon2d> block;
+  boost::geometry::union_ (neighbors[0], neighbors[1], block);
+  NS_TEST_ASSERT_MSG_EQ (block.size (), 1, "");
+  NS_TEST_ASSERT_MSG_EQ (block[0].inners ().size (), 0,
+			 "Should not open a sliver between the neighbors");
+  double area = boost::geometry::area (neighbors[0]) + boost::geometry::area (neighbors[1]);
+  NS_TEST_ASSERT_MSG_EQ_TOL (boost::geometry::area (block), area, 1e-9, "");
+}
+
+
+// This will test the decomposition of polygons into convex parts
+class Gemv2ConvexDecompositionTestCase : public TestCase
+{
+public:
+  Gemv2ConvexDecompositionTestCase ();
+
+private:
+  void DoRun (void) override;
+};
+
+Gemv2ConvexDecompositionTestCase::Gemv2ConvexDecompositionTestCase ()
+  : TestCase ("GEMV^2 convex decomposition test case")
+{
+}
+
+void
+Gemv2ConvexDecompositionTestCase::DoRun (void)
+{
+  // L-shaped building needs two parts
+  gemv2::Polygon2d lShape;
+  boost::geometry::read_wkt ("POLYGON((0 0, 0 10, 4 10, 4 4, 10 4, 10 0, 0 0))", lShape);
+  boost::geometry::correct (lShape);
+  std::vector<gemv2::Polygon2d> parts;
+  NS_TEST_ASSERT_MSG_EQ (gemv2::DecomposeConvex (lShape, parts), true, "");
+  NS_TEST_ASSERT_MSG_EQ (parts.size (), 2, "Wrong number of parts");
+
+  // same shape as in the flat polygon test, concave with a hole
+  gemv2::Polygon2d shape;
+  boost::geometry::read_wkt (
+      "POLYGON((0 0, 0 50, 20 50, 20 20, 40 20, 40 50, 60 50, 60 0, 0 0),"
+      "(5 5, 55 5, 55 10, 5 10, 5 5))", shape);
+  boost::geometry::correct (shape);
+  parts.clear ();
+  NS_TEST_ASSERT_MSG_EQ (gemv2::DecomposeConvex (shape, parts), true, "");
+
+  double area = 0;
+  std::vector<gemv2::ConvexPolygon> convex;
+  for (auto const& part : parts)
+    {
+      area += boost::geometry::area (part);
+      convex.emplace_back (part);
+    }
+  NS_TEST_ASSERT_MSG_EQ_TOL (area, boost::geometry::area (shape), 1e-6,
+			     "Parts should cover the polygon");
+
+  // compare with boost for segments and points on a grid around the polygon
+  std::size_t mismatches = 0;
+  for (int i = 0; i < 2000; ++i)
+    {
+      gemv2::LineSegment2d segment (
+	  {(i * 37) % 83 - 11.5, (i * 53) % 71 - 10.25},
+	  {(i * 19) % 79 - 9.75, (i * 41) % 67 - 8.5});
+      bool intersects = std::any_of (
+	  convex.begin (), convex.end (),
+	  [&segment](const gemv2::ConvexPolygon& p) { return p.Intersects (segment); });
+      if (intersects != boost::geometry::intersects (shape, segment))
+	{
+	  ++mismatches;
+	}
+
+      double distance = std::numeric_limits<double>::infinity ();
+      for (auto const& p : convex)
+	{
+	  distance = std::min (distance, p.GetDistance (segment.first));
+	}
+      if (std::abs (distance - boost::geometry::distance (segment.first, shape)) > 1e-9)
+	{
+	  ++mismatches;
+	}
+    }
+  NS_TEST_ASSERT_MSG_EQ (mismatches, 0, "Results should match boost geometry");
+
+  // invalid outlines are not decomposed
+  gemv2::Polygon2d bowtie;
+  boost::geometry::read_wkt ("POLYGON((0 0, 10 10, 10 0, 0 10, 0 0))", bowtie);
+  parts.clear ();
+  NS_TEST_ASSERT_MSG_EQ (gemv2::DecomposeConvex (bowtie, parts), false, "");
+  NS_TEST_ASSERT_MSG_EQ (parts.empty (), true, "No parts should be added");
+}
+
+
+
+// This will test the compact polygon storage
+class Gemv2CompactPolygonTestCase : public TestCase
+{
+public:
+  Gemv2CompactPolygonTestCase ();
 
+private:
+  void DoRun (void) override;
+};
+
+Gemv2CompactPolygonTestCase::Gemv2CompactPolygonTestCase ()
+  : TestCase ("GEMV^2 compact polygon test case")
+{
+}
+
+void
+Gemv2CompactPolygonTestCase::DoRun (void)
+{
+  // same shape as in the flat polygon test, moved off the grid
+  gemv2::Polygon2d shape;
+  boost::geometry::read_wkt (
+      "POLYGON((0 0, 0 50, 20 50, 20 20, 40 20, 40 50, 60 50, 60 0, 0 0),"
+      "(5 5, 55 5, 55 10, 5 10, 5 5))", shape);
+  boost::geometry::correct (shape);
+  gemv2::Polygon2d moved;
+  boost::geometry::transform (shape, moved,
+			      gemv2::Translate2d (1000.0004, 2000.0006));
+  gemv2::CompactPolygon compact (moved);
+
+  NS_TEST_ASSERT_MSG_EQ (compact.GetNumEdges (), 12, "Wrong number of edges");
+
+  // vertices are rounded to the resolution
+  auto decoded = compact.GetPolygon ();
+  NS_TEST_ASSERT_MSG_EQ (decoded.inners ().size (), 1, "Hole should be kept");
+  NS_TEST_ASSERT_MSG_EQ (decoded.outer ().size (), moved.outer ().size (),
+			 "Wrong number of vertices");
+  for (std::size_t i = 0; i < decoded.outer ().size (); ++i)
+    {
+      NS_TEST_ASSERT_MSG_LT (
+	  boost::geometry::distance (decoded.outer ()[i], moved.outer ()[i]),
+	  gemv2::COMPACT_POLYGON_RESOLUTION, "Vertex moved too far");
+    }
+
+  // compacting again does not change the vertices
+  auto again = gemv2::CompactPolygon (decoded).GetPolygon ();
+  std::size_t changed = 0;
+  for (std::size_t i = 0; i < decoded.outer ().size (); ++i)
+    {
+      if (decoded.outer ()[i].x () != again.outer ()[i].x () ||
+	  decoded.outer ()[i].y () != again.outer ()[i].y ())
+	{
+	  ++changed;
+	}
+    }
+  NS_TEST_ASSERT_MSG_EQ (changed, 0, "Compacting should be idempotent");
+
+  // compare with boost on the decoded polygon
+  std::size_t mismatches = 0;
+  for (int i = 0; i < 2000; ++i)
+    {
+      gemv2::LineSegment2d segment (
+	  {(i * 37) % 83 + 988.5, (i * 53) % 71 + 1989.75},
+	  {(i * 19) % 79 + 990.25, (i * 41) % 67 + 1991.5});
+      if (compact.Intersects (segment) !=
+	  boost::geometry::intersects (decoded, segment))
+	{
+	  ++mismatches;
+	}
+      if (compact.Contains (segment.first) !=
+	  boost::geometry::within (segment.first, decoded))
+	{
+	  ++mismatches;
+	}
+      if (std::abs (compact.GetDistance (segment.first) -
+		    boost::geometry::distance (segment.first, decoded)) > 1e-6)
+	{
+	  ++mismatches;
+	}
+    }
+  NS_TEST_ASSERT_MSG_EQ (mismatches, 0, "Results should match boost geometry");
+}
 
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
 // and enables the TestCases to be run.  Typically, only the constructor for
@@ -56,6 +474,12 @@ Gemv2GeometryTestSuite::Gemv2GeometryTestSuite ()
 {
   // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
   AddTestCase (new Gemv2BasicGeometryTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2BoxEllipseTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2EllipseBoundsTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2FlatPolygonTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2PolygonSimplificationTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2ConvexDecompositionTestCase, TestCase::QUICK);
+  AddTestCase (new Gemv2CompactPolygonTestCase, TestCase::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite